@@ -0,0 +1,109 @@
+/*
+ * mathcompilecache.h - Declaration of the MathCompileCache class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+
+#ifndef _RUSH_MATHCOMPILECACHE_H_
+#define _RUSH_MATHCOMPILECACHE_H_
+
+
+#include <rush/config.h>
+#include <rush/string.h>
+#include <rush/stringarray.h>
+#include <rush/mutex.h>
+#include <rush/mathevaluation.h>
+
+namespace rush {
+
+/**
+ * \brief The MathCompileCacheStatistics struct contains the counters of a
+ * MathCompileCache.
+ **/
+struct MathCompileCacheStatistics
+{
+    /// \brief Number of requests which found a compiled program.
+    size_t Hits;
+    /// \brief Number of requests which had to compile the statements.
+    size_t Misses;
+    /// \brief Number of programs removed, because the cache was full.
+    size_t Evictions;
+    /// \brief Number of cached programs.
+    size_t Count;
+    /// \brief Maximum number of cached programs.
+    size_t Capacity;
+};
+
+
+/**
+ * \brief The MathCompileCache class maps statements to compiled programs, so
+ * repeated statements are neither tokenized nor compiled again. The statements
+ * are normalized first (see Normalize()). If the cache is full, the least
+ * recently used program is removed. All methods can be called from multible
+ * threads.
+ * A program is acquired with Acquire() and must be given back with Release().
+ * A removed program is deleted, when the last thread released it.
+ * \code {.cpp}
+ * const MathProgram* program = cache.Acquire(_T("result = x*x"));
+ * if (program != NULL)
+ * {
+ *     MathContext context(program);
+ *     context.SetVariable(_T("x"), 2.0);
+ *     context.Execute();
+ *     cache.Release(program);
+ * }
+ * \endcode
+ * \remarks The statements are compiled while the cache is locked.
+ **/
+class MathCompileCache
+{
+    public:
+        MathCompileCache(size_t capacity = 1024);
+        virtual ~MathCompileCache();
+
+        void SetFunction(MathFunction* function);
+        void SetJitEnabled(bool enabled);
+
+        const MathProgram* Acquire(const String& statements, StringArray* errors = NULL);
+        void Release(const MathProgram* program);
+        void Clear();
+
+        size_t Count() const;
+        size_t GetCapacity() const;
+        MathCompileCacheStatistics GetStatistics() const;
+        void ResetStatistics();
+
+        static String Normalize(const String& statements);
+
+    private:
+        MathCompileCacheEntry* Find(const String& key, size_t hash) const;
+        void Link(MathCompileCacheEntry* entry);
+        void Unlink(MathCompileCacheEntry* entry);
+        void Retire(MathCompileCacheEntry* entry);
+
+    private:
+        mutable Mutex m_mutex;
+        MathEvaluation* m_compiler;
+        MathCompileCacheEntry** m_buckets;
+        size_t m_countBuckets;
+        MathCompileCacheEntry* m_newest;
+        MathCompileCacheEntry* m_oldest;
+        MathCompileCacheEntry* m_retired;
+        size_t m_count;
+        size_t m_capacity;
+        size_t m_hits;
+        size_t m_misses;
+        size_t m_evictions;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHCOMPILECACHE_H_
+
+
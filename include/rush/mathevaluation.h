@@ -19,11 +19,43 @@
 #include <rush/stringarray.h>
 #include <rush/mathopcode.h>
 #include <rush/mathtokenizer.h>
+#include <rush/mathprogram.h>
+#include <rush/mathprofile.h>
+#include <type_traits>
 
 namespace rush {
 
-// Forward declaration
-class MathVariable;
+/**
+ * \brief The MathAccuracy enum selects how MathEvaluation::ExecuteBatch()
+ * calculates exp, ln, pow, sin, cos and tan.
+ **/
+enum class MathAccuracy
+{
+    /// \brief Math library, the results are equal to Execute().
+    Exact,
+    /// \brief Vectorized functions, max. error 3 ULP.
+    Precise,
+    /// \brief Vectorized functions with shorter polynomials, max. relative error
+    /// 2e-9 (pow: (1 + |b*ln(a)|) * 2e-9).
+    Fast
+};
+
+
+/**
+ * \brief The MathFusion enum selects which instruction sequences are combined
+ * into superinstructions for the interpreter of Execute().
+ **/
+enum class MathFusion
+{
+    /// \brief The instructions are interpreted as compiled.
+    None,
+    /// \brief Loads of variables and constants are combined with the following
+    /// operator (e.g. x*2), the results are unchanged.
+    Superinstructions,
+    /// \brief Superinstructions and multiply-add with one rounding (fma), the
+    /// results can differ in the last bit. Fast only on processors with FMA.
+    MultiplyAdd
+};
 
 
 /**
@@ -33,14 +65,17 @@ class MathVariable;
  * Method. The last thing todo is set the function via SetFunction() in the
  * MathEvaluator class. The existing functions can be overridden if the function
  * has the same name and will be set by SetFunction().
+ * A function can be marked as pure, if the result only depends on the
+ * arguments. Calls of pure functions with constant arguments will be
+ * evaluated once while compiling.
  **/
 class MathFunction
 {
     private:
         MathFunction() {}
     public:
-        MathFunction(const String& name, size_t args)
-            : m_name(name), m_args(args) {}
+        MathFunction(const String& name, size_t args, bool pure = false)
+            : m_name(name), m_args(args), m_pure(pure) {}
         virtual ~MathFunction() {}
 
         inline const String& GetName() const
@@ -49,11 +84,189 @@ class MathFunction
         inline size_t GetArgs() const
         { return (m_args); }
 
+        inline bool IsPure() const
+        { return (m_pure); }
+
+        /**
+         * \brief Returns the opcode, which executes the function. Only the
+         * default functions have intrinsic opcodes, all other functions are
+         * called with MathOpcodeType::CallFunction.
+         * \return Opcode type.
+         **/
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::CallFunction); }
+
+        /**
+         * \brief Returns the address of a function double f(double, ...) with
+         * GetArgs() arguments, which returns the same result as Evaluate().
+         * The interpreter and the JIT call functions with one to three
+         * arguments directly, instead of calling Evaluate().
+         * \return Address of the function or NULL, if only Evaluate() exists.
+         **/
+        virtual void* GetNative() const
+        { return (NULL); }
+
         virtual double Evaluate(double* values, size_t num) = 0;
 
     private:
         String m_name;
         size_t m_args;
+        bool m_pure;
+};
+
+
+/**
+ * \brief The MathCallableDouble template checks if all types are double.
+ **/
+template <typename... A>
+struct MathCallableDouble
+{
+    static const bool Value = true;
+};
+
+template <typename T, typename... A>
+struct MathCallableDouble<T, A...>
+{
+    static const bool Value = std::is_same<T, double>::value && MathCallableDouble<A...>::Value;
+};
+
+
+/**
+ * \brief The MathCallableTraits template returns the number of arguments of
+ * a function pointer, a lambda or a class with one operator(), which takes
+ * double arguments and returns double.
+ **/
+template <typename F>
+struct MathCallableTraits : public MathCallableTraits<decltype(&F::operator())>
+{
+};
+
+template <typename R, typename... A>
+struct MathCallableTraits<R (*)(A...)>
+{
+    /// \brief Number of arguments.
+    static const size_t Args = sizeof...(A);
+    /// \brief Type of the function pointer with the same signature.
+    typedef R (*Pointer)(A...);
+    /// \brief True, if the result and all arguments are double.
+    static const bool Double = MathCallableDouble<R, A...>::Value;
+};
+
+template <typename C, typename R, typename... A>
+struct MathCallableTraits<R (C::*)(A...)> : public MathCallableTraits<R (*)(A...)>
+{
+};
+
+template <typename C, typename R, typename... A>
+struct MathCallableTraits<R (C::*)(A...) const> : public MathCallableTraits<R (*)(A...)>
+{
+};
+
+
+/**
+ * \brief The MathCallableInvoke template calls a callable with the first
+ * Args values as arguments. Up to four arguments are supported.
+ **/
+template <typename F, size_t Args>
+struct MathCallableInvoke;
+
+template <typename F>
+struct MathCallableInvoke<F, 0>
+{
+    static inline double Call(F& callable, const double* values)
+    { return (callable()); }
+};
+
+template <typename F>
+struct MathCallableInvoke<F, 1>
+{
+    static inline double Call(F& callable, const double* values)
+    { return (callable(values[0])); }
+};
+
+template <typename F>
+struct MathCallableInvoke<F, 2>
+{
+    static inline double Call(F& callable, const double* values)
+    { return (callable(values[0], values[1])); }
+};
+
+template <typename F>
+struct MathCallableInvoke<F, 3>
+{
+    static inline double Call(F& callable, const double* values)
+    { return (callable(values[0], values[1], values[2])); }
+};
+
+template <typename F>
+struct MathCallableInvoke<F, 4>
+{
+    static inline double Call(F& callable, const double* values)
+    { return (callable(values[0], values[1], values[2], values[3])); }
+};
+
+
+/**
+ * \brief The MathCallableNative template converts a callable into a function
+ * pointer, if it is one or a lambda without captures; otherwise into NULL.
+ * The pointer is called as double (*)(double, ...), so other signatures
+ * (e.g. float or int) give NULL and are called through Evaluate().
+ **/
+template <typename F, typename P>
+struct MathCallableNative
+{
+    static char Test(P pointer);
+    static long Test(...);
+    static const F& Make();
+
+    template <bool convertible, int dummy = 0>
+    struct Convert
+    {
+        static inline void* Get(const F& callable)
+        { return ((void*)(P)callable); }
+    };
+
+    template <int dummy>
+    struct Convert<false, dummy>
+    {
+        static inline void* Get(const F& callable)
+        { return (NULL); }
+    };
+
+    static inline void* Get(const F& callable)
+    { return (Convert<MathCallableTraits<F>::Double && sizeof(Test(Make())) == sizeof(char)>::Get(callable)); }
+};
+
+
+/**
+ * \brief The MathCallableFunction template is a MathFunction, which calls
+ * a function pointer, a lambda or a functor with up to four double arguments.
+ * It is created by MathEvaluation::SetFunction(name, callable). The call of the
+ * callable is inlined into Evaluate(), so the arguments are not copied.
+ * Function pointers and lambdas without captures are also returned by
+ * GetNative(), so the interpreter and the JIT call them directly.
+ **/
+template <typename F>
+class MathCallableFunction : public MathFunction
+{
+    public:
+        /**
+         * \brief Constructor, initializes the function.
+         * \param name Function name.
+         * \param callable Callable, which is copied.
+         * \param pure True, if the result only depends on the arguments.
+         **/
+        MathCallableFunction(const String& name, const F& callable, bool pure)
+            : MathFunction(name, MathCallableTraits<F>::Args, pure), m_callable(callable) {}
+
+        virtual void* GetNative() const
+        { return (MathCallableNative<F, typename MathCallableTraits<F>::Pointer>::Get(m_callable)); }
+
+        virtual double Evaluate(double* values, size_t num)
+        { return (MathCallableInvoke<F, MathCallableTraits<F>::Args>::Call(m_callable, values)); }
+
+    private:
+        F m_callable;
 };
 
 
@@ -81,46 +294,176 @@ class MathFunction
  * - asin(x): Arcus sinus of x
  * - acos(x): Arcus cosinus of x
  * - atan(x): Arcus tanges of x
+ * - select(c, a, b): a, if c is not zero, otherwise b. Both a and b are
+ *   evaluated, the value is selected without a branch.
+ *
+ * The comparison operators <, <=, >, >=, == and != have the lowest priority
+ * and give 1, if the comparison is true, otherwise 0. Together with select()
+ * they describe piecewise formulas, e.g. select(x < 0, -x, x*x), which run
+ * without branches in all execution modes.
+ *
+ * Array variables are set with SetArray() or BindArray() before compiling and
+ * are used by the reductions:
+ * - sum(a): Sum of the values
+ * - mean(a): Arithmetic mean of the values
+ * - min(a): Smallest value
+ * - max(a): Largest value
+ * - dot(a, b): Sum of the products of the values of two arrays with the same length
+ *
+ * The compiled code can be shared with other threads by creating a MathProgram
+ * with CreateProgram(). Each thread executes the program with its own MathContext.
+ * Large batches of rows can be split over all processors with ExecuteParallel().
+ * Both accept columns of double or of float values.
+ * With SetIncrementalEnabled() Execute() runs only the statements, which are
+ * affected by the variables changed since the last execution.
+ * SetProfilingEnabled() counts the executed opcodes and function calls.
+ * The interpreter combines frequent instruction sequences into superinstructions,
+ * see SetFusion().
+ * Variables can be bound to memory of the caller with BindVariable() and
+ * BindMember(), so the values are not copied with SetVariable() and GetVariable().
+ * Very large scripts can be compiled statement by statement with CompileStream()
+ * and CompileFile(), which need memory for the largest statement only.
  **/
 class MathEvaluation
 {
+    friend class MathCompiler;
+    friend class MathStreamCompiler;
+
 	public:
         MathEvaluation();
         virtual ~MathEvaluation();
 
         void SetVariable(const String& name, double value);
         double GetVariable(const String& name) const;
+        MathVariableHandle GetVariableHandle(const String& name);
+        void SetVariable(MathVariableHandle handle, double value);
+        double GetVariable(MathVariableHandle handle) const;
         void ClearVariables();
         StringArray* GetVariableNames() const;
 
+        void BindVariable(const String& name, double* address);
+        void BindMember(const String& name, size_t offset);
+        void UnbindVariable(const String& name);
+        void BindObject(void* object);
+        void* GetBoundObject() const;
+
+        void SetArray(const String& name, const double* values, size_t count);
+        void BindArray(const String& name, const double* values, size_t count);
+
         void SetFunction(MathFunction* function);
 
+        /**
+         * \brief Sets a function pointer, a lambda or a functor with up to four
+         * double arguments as function, e.g.
+         * SetFunction(_T("hypot"), [](double a, double b) { return (sqrt(a*a+b*b)); }, true).
+         * Function pointers and lambdas without captures are called directly.
+         * \param name Function name.
+         * \param callable Callable, which is copied.
+         * \param pure True, if the result only depends on the arguments, so calls
+         * with constant arguments are evaluated while compiling.
+         **/
+        template <typename F>
+        void SetFunction(const String& name, F callable, bool pure = false)
+        { this->SetFunction(new MathCallableFunction<F>(name, callable, pure)); }
+
         bool HasErrors() const;
         String GetErrorMessage() const;
 
+        void SetJitEnabled(bool enabled);
+        bool IsJitEnabled() const;
+        bool IsJitCompiled() const;
+        static bool IsJitSupported();
+
+        void SetIncrementalEnabled(bool enabled);
+        bool IsIncrementalEnabled() const;
+        size_t GetExecutedStatementCount() const;
+
+        void SetProfilingEnabled(bool enabled);
+        bool IsProfilingEnabled() const;
+        const MathProfile* GetProfile() const;
+        void ResetProfile();
+
+        void SetAccuracy(MathAccuracy accuracy);
+        MathAccuracy GetAccuracy() const;
+
+        void SetFusion(MathFusion fusion);
+        MathFusion GetFusion() const;
+
         bool Compile(const String& function);
+        bool CompileStream(const Char* statements, size_t length);
+        bool CompileFile(const String& fileName);
         bool Execute();
+        MathProgram* CreateProgram() const;
+        MathProgram* LoadProgram(const void* image, size_t size) const;
+        bool ExecuteBatch(const StringArray& inputNames, const double* const* inputs,
+                          const String& outputName, double* output, size_t rows);
+        bool ExecuteParallel(const StringArray& inputNames, const double* const* inputs,
+                             const String& outputName, double* output, size_t rows,
+                             size_t maxThreads = 0);
+        bool ExecuteBatch(const StringArray& inputNames, const float* const* inputs,
+                          const String& outputName, float* output, size_t rows);
+        bool ExecuteParallel(const StringArray& inputNames, const float* const* inputs,
+                             const String& outputName, float* output, size_t rows,
+                             size_t maxThreads = 0);
 
         #ifdef _RUSH_DEBUG_
         String GetTokenizerText(const String& statements) const;
         String GetOpcodeText() const;
+        String GetProfileText() const;
         #endif
 
     private:
-        bool HasHigherPriority(MathOpcodeType a, MathOpcodeType b);
-        void PopInput(MathOpcodeArray* code, MathOpcodeDeque* inputs);
-        void ResolveOperator(MathOpcodeArray* code, MathOpcodeDeque* operators, MathOpcodeDeque* inputs, bool checkPriority);
-        MathOpcodeArray* CompileStep(MathTokenArray* tokens, size_t startIndex, size_t endIndex);
-        int GetVariableIndex(const String& name) const;
+        int GetVariableIndex(const String& name);
+        int GetVariableIndex(const MathToken* token);
+        int AddVariable(const String& name);
+        int FindVariableIndex(const String& name) const;
         int GetFunctionIndex(const String& name) const;
-        MathOpcode* CreateOpcode(MathToken* token);
+        int GetFunctionIndex(const Char* name, size_t length) const;
         void OptimizeCode();
+        void SelectIntrinsics();
+        bool PrepareCode();
+        void ClearCode();
+        bool CheckCode(size_t* maxDepth, size_t* maxArgs);
+        double* GetBoundValue(size_t index) const;
+        void BindProgram();
+        void ReadBindings();
+        void WriteBindings();
+        int GetArrayIndex(const String& name);
+        size_t AddReduction(MathReductionType type, size_t first, size_t second);
+        bool ReduceArrays(double* values, StringArray* errors) const;
+        template <typename T>
+        bool ExecuteColumns(const StringArray& inputNames, const T* const* inputs,
+                            const String& outputName, T* output, size_t rows, size_t maxThreads);
 
     private:
         ObjectArray<MathFunction>* m_functions;
-        ObjectArray<MathOpcode>* m_opcodes;
-        ObjectArray<MathVariable>* m_variables;
+        MathSymbolTable* m_functionNames;
+        ObjectArray<MathFunction>* m_retiredFunctions;
+        MathSymbolTable* m_variables;
+        double* m_values;
+        MathBinding* m_bindings;
+        size_t m_valuesCapacity;
+        size_t m_countBindings;
+        char* m_object;
+        MathSymbolTable* m_arrayNames;
+        MathArray* m_arrays;
+        size_t m_arraysCapacity;
+        MathReduction* m_reductions;
+        size_t m_countReductions;
+        size_t m_reductionsCapacity;
         StringArray* m_errors;
+        MathInstruction* m_code;
+        size_t m_codeCount;
+        double* m_stack;
+        size_t m_stackDepth;
+        size_t m_countTemporaries;
+        MathProgram* m_program;
+        MathDependencyGraph* m_graph;
+        MathProfile* m_profile;
+        bool m_jitEnabled;
+        bool m_incremental;
+        MathAccuracy m_accuracy;
+        MathFusion m_fusion;
 };
 
 
@@ -0,0 +1,688 @@
+/*
+ * mathexpression.h - Declaration and implementation of the MathExpression class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+
+#ifndef _RUSH_MATHEXPRESSION_H_
+#define _RUSH_MATHEXPRESSION_H_
+
+
+#include <rush/config.h>
+#include <rush/mathopcode.h>
+#include <stddef.h>
+#include <math.h>
+
+
+/**
+ * \brief Parses an expression string literal while compiling and returns a
+ * MathExpression object, which evaluates the expression with inlined code.
+ * The variables are numbered in order of their first appearance.
+ * \code
+ * auto f = RUSH_MATH_EXPRESSION("x*y + sin(x)");
+ * double a = f(2.0, 3.0);                  // x = 2, y = 3
+ * double values[] = { 2.0, 3.0 };
+ * double b = f.Evaluate(values);
+ * static_assert(f.GetVariableIndex("y") == 1, "y is the second variable");
+ * \endcode
+ * \param text String literal with one expression (no assignments or statements).
+ **/
+#define RUSH_MATH_EXPRESSION(text) \
+    ([]() { \
+        struct MathExpressionText \
+        { \
+            static constexpr decltype(&(text)[0]) Get() { return (text); } \
+            static constexpr size_t Size() { return (sizeof(text)/sizeof((text)[0]) - 1); } \
+        }; \
+        return (rush::MathExpressionParser<MathExpressionText>::Create()); \
+    }())
+
+
+namespace rush {
+
+
+/**
+ * \brief Character classes of the expression parser. They are a subset of the
+ * input codes of the MathTokenizer: the comparison characters < > ! are
+ * invalid, so comparisons and select() are not supported by the constexpr
+ * expressions, only by the MathEvaluation.
+ **/
+enum class MathCharClass
+{
+    Letter,
+    Digit,
+    Space,
+    Point,
+    BracketOpen,
+    BracketClose,
+    Operator,
+    Assignment,
+    EndStatement,
+    Comma,
+    End,
+    Invalid
+};
+
+
+/**
+ * \brief Predefined functions, which can be called by a MathExpression.
+ **/
+enum class MathExpressionFunctionType
+{
+    Unknown,
+    Pi,
+    Abs,
+    Exp,
+    Pow,
+    Sqrt,
+    Root,
+    Ln,
+    Log10,
+    Log,
+    Fact,
+    Mod,
+    Ceil,
+    Floor,
+    Frac,
+    Int,
+    Sin,
+    Cos,
+    Tan
+};
+
+
+//-----------------------------------------------------------------------------
+// Character scanning, all functions are evaluated while compiling.
+// Ranges are split in halves, so the recursion depth stays low for long expressions.
+//-----------------------------------------------------------------------------
+const size_t MathExpressionNotFound = (size_t)-1;
+
+template <class T>
+constexpr MathCharClass MathExpressionClassify(T c)
+{
+    return ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' ? MathCharClass::Letter :
+            c >= '0' && c <= '9' ? MathCharClass::Digit :
+            c == ' ' || c == '\t' || c == '\n' || c == '\r' ? MathCharClass::Space :
+            c == '.' ? MathCharClass::Point :
+            c == '(' ? MathCharClass::BracketOpen :
+            c == ')' ? MathCharClass::BracketClose :
+            c == '+' || c == '-' || c == '*' || c == '/' ? MathCharClass::Operator :
+            c == '=' ? MathCharClass::Assignment :
+            c == ';' ? MathCharClass::EndStatement :
+            c == ',' ? MathCharClass::Comma :
+            c == 0 ? MathCharClass::End : MathCharClass::Invalid);
+}
+
+template <class T>
+constexpr bool MathExpressionIsNameChar(T c)
+{
+    return (MathExpressionClassify(c) == MathCharClass::Letter || MathExpressionClassify(c) == MathCharClass::Digit);
+}
+
+template <class T>
+constexpr size_t MathExpressionSkip(const T* s, size_t p)
+{
+    return (MathExpressionClassify(s[p]) == MathCharClass::Space ? MathExpressionSkip(s, p+1) : p);
+}
+
+template <class T>
+constexpr MathCharClass MathExpressionPeek(const T* s, size_t p)
+{
+    return (MathExpressionClassify(s[MathExpressionSkip(s, p)]));
+}
+
+template <class T>
+constexpr char MathExpressionOperator(const T* s, size_t p)
+{
+    return (MathExpressionPeek(s, p) == MathCharClass::Operator ? (char)s[MathExpressionSkip(s, p)] : '\0');
+}
+
+template <class T>
+constexpr size_t MathExpressionNameEnd(const T* s, size_t p)
+{
+    return (MathExpressionIsNameChar(s[p]) ? MathExpressionNameEnd(s, p+1) : p);
+}
+
+template <class T>
+constexpr size_t MathExpressionNumberEnd(const T* s, size_t p, bool point = false)
+{
+    return (MathExpressionClassify(s[p]) == MathCharClass::Digit ? MathExpressionNumberEnd(s, p+1, point) :
+            MathExpressionClassify(s[p]) == MathCharClass::Point && !point ? MathExpressionNumberEnd(s, p+1, true) : p);
+}
+
+
+//-----------------------------------------------------------------------------
+// Numbers: the digits are summed up exactly and divided once by a power of
+// ten, so constants with up to 15 digits are rounded like strtod().
+//-----------------------------------------------------------------------------
+template <class T>
+constexpr double MathExpressionMantissa(const T* s, size_t p, size_t end, double value = 0.0)
+{
+    return (p >= end ? value :
+            MathExpressionClassify(s[p]) == MathCharClass::Point ? MathExpressionMantissa(s, p+1, end, value) :
+            MathExpressionMantissa(s, p+1, end, value*10.0 + (double)(s[p] - '0')));
+}
+
+template <class T>
+constexpr size_t MathExpressionDecimals(const T* s, size_t p, size_t end)
+{
+    return (p >= end ? 0 :
+            MathExpressionClassify(s[p]) == MathCharClass::Point ? end - p - 1 : MathExpressionDecimals(s, p+1, end));
+}
+
+constexpr double MathExpressionPow10(size_t n)
+{
+    return (n == 0 ? 1.0 : n == 1 ? 10.0 : MathExpressionPow10(n/2) * MathExpressionPow10(n - n/2));
+}
+
+template <class T>
+constexpr double MathExpressionNumber(const T* s, size_t p)
+{
+    return (MathExpressionMantissa(s, p, MathExpressionNumberEnd(s, p)) /
+            MathExpressionPow10(MathExpressionDecimals(s, p, MathExpressionNumberEnd(s, p))));
+}
+
+
+//-----------------------------------------------------------------------------
+// Names of functions and variables
+//-----------------------------------------------------------------------------
+template <class T, class U>
+constexpr bool MathExpressionSameName(const T* s, size_t a, const U* t, size_t b)
+{
+    return (MathExpressionIsNameChar(s[a]) ?
+                (s[a] == t[b] && MathExpressionSameName(s, a+1, t, b+1)) :
+                !MathExpressionIsNameChar(t[b]));
+}
+
+template <class T>
+constexpr bool MathExpressionIsName(const T* s, size_t p, const char* name)
+{
+    return (MathExpressionSameName(s, p, name, 0));
+}
+
+template <class T>
+constexpr MathExpressionFunctionType MathExpressionFindFunction(const T* s, size_t p)
+{
+    return (MathExpressionIsName(s, p, "pi") ? MathExpressionFunctionType::Pi :
+            MathExpressionIsName(s, p, "abs") ? MathExpressionFunctionType::Abs :
+            MathExpressionIsName(s, p, "exp") ? MathExpressionFunctionType::Exp :
+            MathExpressionIsName(s, p, "pow") ? MathExpressionFunctionType::Pow :
+            MathExpressionIsName(s, p, "sqrt") ? MathExpressionFunctionType::Sqrt :
+            MathExpressionIsName(s, p, "root") ? MathExpressionFunctionType::Root :
+            MathExpressionIsName(s, p, "ln") ? MathExpressionFunctionType::Ln :
+            MathExpressionIsName(s, p, "log10") ? MathExpressionFunctionType::Log10 :
+            MathExpressionIsName(s, p, "log") ? MathExpressionFunctionType::Log :
+            MathExpressionIsName(s, p, "fact") ? MathExpressionFunctionType::Fact :
+            MathExpressionIsName(s, p, "mod") ? MathExpressionFunctionType::Mod :
+            MathExpressionIsName(s, p, "ceil") ? MathExpressionFunctionType::Ceil :
+            MathExpressionIsName(s, p, "floor") ? MathExpressionFunctionType::Floor :
+            MathExpressionIsName(s, p, "frac") ? MathExpressionFunctionType::Frac :
+            MathExpressionIsName(s, p, "int") ? MathExpressionFunctionType::Int :
+            MathExpressionIsName(s, p, "sin") ? MathExpressionFunctionType::Sin :
+            MathExpressionIsName(s, p, "cos") ? MathExpressionFunctionType::Cos :
+            MathExpressionIsName(s, p, "tan") ? MathExpressionFunctionType::Tan :
+            MathExpressionFunctionType::Unknown);
+}
+
+template <class T>
+constexpr bool MathExpressionIsVariable(const T* s, size_t p)
+{
+    return (MathExpressionClassify(s[p]) == MathCharClass::Letter &&
+            (p == 0 || !MathExpressionIsNameChar(s[p-1])) &&
+            MathExpressionPeek(s, MathExpressionNameEnd(s, p)) != MathCharClass::BracketOpen);
+}
+
+template <class T, class U>
+constexpr size_t MathExpressionFindVariable(const T* s, size_t from, size_t to, const U* name, size_t p)
+{
+    return (to - from == 0 ? MathExpressionNotFound :
+            to - from == 1 ? (MathExpressionIsVariable(s, from) && MathExpressionSameName(s, from, name, p) ?
+                              from : MathExpressionNotFound) :
+            MathExpressionFindVariable(s, from, from + (to-from)/2, name, p) != MathExpressionNotFound ?
+                MathExpressionFindVariable(s, from, from + (to-from)/2, name, p) :
+                MathExpressionFindVariable(s, from + (to-from)/2, to, name, p));
+}
+
+template <class T>
+constexpr size_t MathExpressionCountVariables(const T* s, size_t from, size_t to)
+{
+    return (to - from == 0 ? 0 :
+            to - from == 1 ? (MathExpressionIsVariable(s, from) &&
+                              MathExpressionFindVariable(s, 0, from, s, from) == MathExpressionNotFound ? 1 : 0) :
+            MathExpressionCountVariables(s, from, from + (to-from)/2) +
+            MathExpressionCountVariables(s, from + (to-from)/2, to));
+}
+
+template <class T>
+constexpr size_t MathExpressionSlot(const T* s, size_t p)
+{
+    return (MathExpressionCountVariables(s, 0, MathExpressionFindVariable(s, 0, p+1, s, p)));
+}
+
+
+//-----------------------------------------------------------------------------
+// Nodes of the expression tree, evaluated by inlined static methods
+//-----------------------------------------------------------------------------
+template <class S, size_t P>
+struct MathExpressionConstant
+{
+    static constexpr double Value = MathExpressionNumber(S::Get(), P);
+
+    static inline double Evaluate(const double* values)
+    { return (Value); }
+};
+
+template <class S, size_t P>
+constexpr double MathExpressionConstant<S, P>::Value;
+
+template <size_t Slot>
+struct MathExpressionVariable
+{
+    static inline double Evaluate(const double* values)
+    { return (values[Slot]); }
+};
+
+template <class A>
+struct MathExpressionNeg
+{
+    static inline double Evaluate(const double* values)
+    { return (-A::Evaluate(values)); }
+};
+
+template <MathOpcodeType Type, class A, class B>
+struct MathExpressionBinary;
+
+template <class A, class B>
+struct MathExpressionBinary<MathOpcodeType::Add, A, B>
+{
+    static inline double Evaluate(const double* values)
+    { return (A::Evaluate(values) + B::Evaluate(values)); }
+};
+
+template <class A, class B>
+struct MathExpressionBinary<MathOpcodeType::Sub, A, B>
+{
+    static inline double Evaluate(const double* values)
+    { return (A::Evaluate(values) - B::Evaluate(values)); }
+};
+
+template <class A, class B>
+struct MathExpressionBinary<MathOpcodeType::Mul, A, B>
+{
+    static inline double Evaluate(const double* values)
+    { return (A::Evaluate(values) * B::Evaluate(values)); }
+};
+
+template <class A, class B>
+struct MathExpressionBinary<MathOpcodeType::Div, A, B>
+{
+    static inline double Evaluate(const double* values)
+    { return (A::Evaluate(values) / B::Evaluate(values)); }
+};
+
+
+//-----------------------------------------------------------------------------
+// Predefined functions, calculated like the functions of the MathEvaluation
+//-----------------------------------------------------------------------------
+template <MathExpressionFunctionType Type>
+struct MathExpressionFunction;
+
+#define RUSH_MATH_EXPRESSION_FUNCTION(type, args, parameters, result) \
+    template <> \
+    struct MathExpressionFunction<MathExpressionFunctionType::type> \
+    { \
+        static const size_t Args = args; \
+        static inline double Evaluate parameters \
+        { return (result); } \
+    };
+
+RUSH_MATH_EXPRESSION_FUNCTION(Pi, 0, (), M_PI)
+RUSH_MATH_EXPRESSION_FUNCTION(Abs, 1, (double a), fabs(a))
+RUSH_MATH_EXPRESSION_FUNCTION(Exp, 1, (double a), exp(a))
+RUSH_MATH_EXPRESSION_FUNCTION(Pow, 2, (double a, double b), pow(a, b))
+RUSH_MATH_EXPRESSION_FUNCTION(Sqrt, 1, (double a), sqrt(a))
+RUSH_MATH_EXPRESSION_FUNCTION(Root, 2, (double a, double b), exp(1/b*log(a)))
+RUSH_MATH_EXPRESSION_FUNCTION(Ln, 1, (double a), log(a))
+RUSH_MATH_EXPRESSION_FUNCTION(Log10, 1, (double a), log10(a))
+RUSH_MATH_EXPRESSION_FUNCTION(Log, 2, (double a, double b), log(a)/log(b))
+RUSH_MATH_EXPRESSION_FUNCTION(Mod, 2, (double a, double b), fmod(a, b))
+RUSH_MATH_EXPRESSION_FUNCTION(Ceil, 1, (double a), ceil(a))
+RUSH_MATH_EXPRESSION_FUNCTION(Floor, 1, (double a), floor(a))
+RUSH_MATH_EXPRESSION_FUNCTION(Sin, 1, (double a), sin(a))
+RUSH_MATH_EXPRESSION_FUNCTION(Cos, 1, (double a), cos(a))
+RUSH_MATH_EXPRESSION_FUNCTION(Tan, 1, (double a), tan(a))
+#undef RUSH_MATH_EXPRESSION_FUNCTION
+
+template <>
+struct MathExpressionFunction<MathExpressionFunctionType::Fact>
+{
+    static const size_t Args = 1;
+    static inline double Evaluate(double a)
+    {
+        // NOTE: Only natural numbers
+        double value = floor(a);
+        if (a == 0) return (1);
+        double result = 1.0d;
+        for (double i=2; i<=value; i += 1.0d)
+        {
+            result *= i;
+        }
+        return (result);
+    }
+};
+
+template <>
+struct MathExpressionFunction<MathExpressionFunctionType::Frac>
+{
+    static const size_t Args = 1;
+    static inline double Evaluate(double a)
+    {
+        double intpart = 0.0d;
+        return (modf(a, &intpart));
+    }
+};
+
+template <>
+struct MathExpressionFunction<MathExpressionFunctionType::Int>
+{
+    static const size_t Args = 1;
+    static inline double Evaluate(double a)
+    {
+        double intpart = 0.0d;
+        modf(a, &intpart);
+        return (intpart);
+    }
+};
+
+template <MathExpressionFunctionType Type, class... Operands>
+struct MathExpressionCall
+{
+    static_assert(sizeof...(Operands) == MathExpressionFunction<Type>::Args,
+                  "Wrong number of arguments in a function call of the expression.");
+
+    static inline double Evaluate(const double* values)
+    { return (MathExpressionFunction<Type>::Evaluate(Operands::Evaluate(values)...)); }
+};
+
+
+//-----------------------------------------------------------------------------
+// Recursive descent parser, every rule is a template with the parsed node as
+// Type and the position after the rule as End. The priorities are the same as
+// in the MathCompiler: Add/Sub < Mul/Div < Neg.
+//-----------------------------------------------------------------------------
+template <class S>
+struct MathExpressionFalse
+{
+    static const bool Value = false;
+};
+
+template <class S, size_t P>
+struct MathExpressionSum;
+
+template <class S, size_t P, MathCharClass Class = MathExpressionPeek(S::Get(), P)>
+struct MathExpressionPrimary
+{
+    static_assert(MathExpressionFalse<S>::Value, "Unexpected character or missing operand in the expression.");
+    typedef MathExpressionVariable<0> Type;
+    static constexpr size_t End = P;
+};
+
+template <class S, size_t P>
+struct MathExpressionPrimary<S, P, MathCharClass::Digit>
+{
+    typedef MathExpressionConstant<S, MathExpressionSkip(S::Get(), P)> Type;
+    static constexpr size_t End = MathExpressionNumberEnd(S::Get(), MathExpressionSkip(S::Get(), P));
+};
+
+template <class S, size_t P>
+struct MathExpressionPrimary<S, P, MathCharClass::Point> : public MathExpressionPrimary<S, P, MathCharClass::Digit>
+{
+};
+
+template <class S, size_t P>
+struct MathExpressionPrimary<S, P, MathCharClass::BracketOpen>
+{
+    typedef MathExpressionSum<S, MathExpressionSkip(S::Get(), P) + 1> Inner;
+    static_assert(MathExpressionPeek(S::Get(), Inner::End) == MathCharClass::BracketClose,
+                  "Missing closing bracket in the expression.");
+    typedef typename Inner::Type Type;
+    static constexpr size_t End = (MathExpressionPeek(S::Get(), Inner::End) == MathCharClass::BracketClose ?
+                                   MathExpressionSkip(S::Get(), Inner::End) + 1 : Inner::End);
+};
+
+template <class... Args>
+struct MathExpressionList
+{
+};
+
+template <class S, size_t P, MathExpressionFunctionType Function, class List,
+          MathCharClass Class = MathExpressionPeek(S::Get(), P)>
+struct MathExpressionArguments
+{
+    static_assert(MathExpressionFalse<S>::Value, "Missing comma or closing bracket in a function call of the expression.");
+    typedef MathExpressionCall<Function> Type;
+    static constexpr size_t End = P;
+};
+
+template <class S, size_t P, MathExpressionFunctionType Function, class... Args>
+struct MathExpressionArguments<S, P, Function, MathExpressionList<Args...>, MathCharClass::Comma>
+{
+    typedef MathExpressionSum<S, MathExpressionSkip(S::Get(), P) + 1> Next;
+    typedef MathExpressionArguments<S, Next::End, Function, MathExpressionList<Args..., typename Next::Type> > Rest;
+    typedef typename Rest::Type Type;
+    static constexpr size_t End = Rest::End;
+};
+
+template <class S, size_t P, MathExpressionFunctionType Function, class... Args>
+struct MathExpressionArguments<S, P, Function, MathExpressionList<Args...>, MathCharClass::BracketClose>
+{
+    typedef MathExpressionCall<Function, Args...> Type;
+    static constexpr size_t End = MathExpressionSkip(S::Get(), P) + 1;
+};
+
+template <class S, size_t P, MathExpressionFunctionType Function,
+          bool Empty = (MathExpressionPeek(S::Get(), P) == MathCharClass::BracketClose)>
+struct MathExpressionCallParser
+{
+    typedef MathExpressionSum<S, P> First;
+    typedef MathExpressionArguments<S, First::End, Function, MathExpressionList<typename First::Type> > Rest;
+    typedef typename Rest::Type Type;
+    static constexpr size_t End = Rest::End;
+};
+
+template <class S, size_t P, MathExpressionFunctionType Function>
+struct MathExpressionCallParser<S, P, Function, true>
+{
+    typedef MathExpressionCall<Function> Type;
+    static constexpr size_t End = MathExpressionSkip(S::Get(), P) + 1;
+};
+
+template <class S, size_t P, bool Call = (MathExpressionPeek(S::Get(), MathExpressionNameEnd(S::Get(), P)) ==
+                                          MathCharClass::BracketOpen)>
+struct MathExpressionName
+{
+    typedef MathExpressionVariable<MathExpressionSlot(S::Get(), P)> Type;
+    static constexpr size_t End = MathExpressionNameEnd(S::Get(), P);
+};
+
+template <class S, size_t P>
+struct MathExpressionName<S, P, true>
+{
+    static constexpr MathExpressionFunctionType Function = MathExpressionFindFunction(S::Get(), P);
+    static_assert(Function != MathExpressionFunctionType::Unknown, "Unknown function in the expression.");
+    typedef MathExpressionCallParser<S, MathExpressionSkip(S::Get(), MathExpressionNameEnd(S::Get(), P)) + 1,
+                                     Function> Call;
+    typedef typename Call::Type Type;
+    static constexpr size_t End = Call::End;
+};
+
+template <class S, size_t P>
+struct MathExpressionPrimary<S, P, MathCharClass::Letter> : public MathExpressionName<S, MathExpressionSkip(S::Get(), P)>
+{
+};
+
+template <class S, size_t P, char Operator = MathExpressionOperator(S::Get(), P)>
+struct MathExpressionUnary : public MathExpressionPrimary<S, P>
+{
+};
+
+template <class S, size_t P>
+struct MathExpressionUnary<S, P, '-'>
+{
+    typedef MathExpressionUnary<S, MathExpressionSkip(S::Get(), P) + 1> Operand;
+    typedef MathExpressionNeg<typename Operand::Type> Type;
+    static constexpr size_t End = Operand::End;
+};
+
+template <class S, size_t P, class Left, char Operator = MathExpressionOperator(S::Get(), P)>
+struct MathExpressionProductRest
+{
+    typedef Left Type;
+    static constexpr size_t End = P;
+};
+
+template <class S, size_t P, class Left, MathOpcodeType Opcode>
+struct MathExpressionProductNext
+{
+    typedef MathExpressionUnary<S, MathExpressionSkip(S::Get(), P) + 1> Right;
+    typedef MathExpressionProductRest<S, Right::End, MathExpressionBinary<Opcode, Left, typename Right::Type> > Rest;
+    typedef typename Rest::Type Type;
+    static constexpr size_t End = Rest::End;
+};
+
+template <class S, size_t P, class Left>
+struct MathExpressionProductRest<S, P, Left, '*'> : public MathExpressionProductNext<S, P, Left, MathOpcodeType::Mul>
+{
+};
+
+template <class S, size_t P, class Left>
+struct MathExpressionProductRest<S, P, Left, '/'> : public MathExpressionProductNext<S, P, Left, MathOpcodeType::Div>
+{
+};
+
+template <class S, size_t P>
+struct MathExpressionProduct
+{
+    typedef MathExpressionUnary<S, P> First;
+    typedef MathExpressionProductRest<S, First::End, typename First::Type> Rest;
+    typedef typename Rest::Type Type;
+    static constexpr size_t End = Rest::End;
+};
+
+template <class S, size_t P, class Left, char Operator = MathExpressionOperator(S::Get(), P)>
+struct MathExpressionSumRest
+{
+    typedef Left Type;
+    static constexpr size_t End = P;
+};
+
+template <class S, size_t P, class Left, MathOpcodeType Opcode>
+struct MathExpressionSumNext
+{
+    typedef MathExpressionProduct<S, MathExpressionSkip(S::Get(), P) + 1> Right;
+    typedef MathExpressionSumRest<S, Right::End, MathExpressionBinary<Opcode, Left, typename Right::Type> > Rest;
+    typedef typename Rest::Type Type;
+    static constexpr size_t End = Rest::End;
+};
+
+template <class S, size_t P, class Left>
+struct MathExpressionSumRest<S, P, Left, '+'> : public MathExpressionSumNext<S, P, Left, MathOpcodeType::Add>
+{
+};
+
+template <class S, size_t P, class Left>
+struct MathExpressionSumRest<S, P, Left, '-'> : public MathExpressionSumNext<S, P, Left, MathOpcodeType::Sub>
+{
+};
+
+template <class S, size_t P>
+struct MathExpressionSum
+{
+    typedef MathExpressionProduct<S, P> First;
+    typedef MathExpressionSumRest<S, First::End, typename First::Type> Rest;
+    typedef typename Rest::Type Type;
+    static constexpr size_t End = Rest::End;
+};
+
+
+/**
+ * \brief The MathExpression class is an expression, which was parsed while
+ * compiling by RUSH_MATH_EXPRESSION(). The expression is a tree of types,
+ * so the compiler inlines the whole evaluation like hand-written code and
+ * nothing is parsed or allocated at runtime.
+ * The grammar is the grammar of the MathTokenizer and the MathCompiler for
+ * one expression: numbers, variables, + - * /, negation, brackets and calls
+ * of the predefined functions of the MathEvaluation. Syntax errors are
+ * reported by static assertions.
+ * The variables are slots, numbered in order of their first appearance.
+ **/
+template <class S, class Node>
+class MathExpression
+{
+    public:
+        /**
+         * \brief Returns the number of variable slots.
+         * \return Number of variables.
+         **/
+        static constexpr size_t GetVariableCount()
+        { return (MathExpressionCountVariables(S::Get(), 0, S::Size())); }
+
+        /**
+         * \brief Returns the slot of a variable or -1 if the expression does
+         * not use the variable. Can be used in constant expressions.
+         * \param name Variable name.
+         * \return Variable slot or -1.
+         **/
+        static constexpr int GetVariableIndex(const char* name)
+        {
+            return (MathExpressionFindVariable(S::Get(), 0, S::Size(), name, 0) == MathExpressionNotFound ? -1 :
+                    (int)MathExpressionCountVariables(S::Get(), 0, MathExpressionFindVariable(S::Get(), 0, S::Size(), name, 0)));
+        }
+
+        /**
+         * \brief Evaluates the expression.
+         * \param values Values of the variables, at least GetVariableCount() values.
+         * \return Result.
+         **/
+        inline double Evaluate(const double* values) const
+        { return (Node::Evaluate(values)); }
+
+        /**
+         * \brief Evaluates the expression with one argument per variable slot.
+         * \param args Values of the variables in order of their slots.
+         * \return Result.
+         **/
+        template <class... Args>
+        inline double operator()(Args... args) const
+        {
+            static_assert(sizeof...(Args) == GetVariableCount(), "Wrong number of values for the variables of the expression.");
+            const double values[sizeof...(Args) + 1] = { (double)args... };
+            return (Node::Evaluate(values));
+        }
+};
+
+
+/**
+ * \brief The MathExpressionParser struct parses the text of S and creates the
+ * MathExpression, it is used by RUSH_MATH_EXPRESSION().
+ **/
+template <class S>
+struct MathExpressionParser
+{
+    typedef MathExpressionSum<S, 0> Root;
+    static_assert(MathExpressionPeek(S::Get(), Root::End) == MathCharClass::End,
+                  "Unexpected character in the expression (only one expression without assignments is allowed).");
+
+    static inline MathExpression<S, typename Root::Type> Create()
+    { return (MathExpression<S, typename Root::Type>()); }
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHEXPRESSION_H_
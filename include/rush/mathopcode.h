@@ -46,8 +46,88 @@ enum class MathOpcodeType
     Neg,
     /// \brief Pops a value from the stack and pushes the value twice into the stack.
     Double,
+    /// \brief Loads a temporary value (common subexpression) into the stack.
+    LoadTemporary,
+    /// \brief Copies the first value from the stack into a temporary value, the value stays on the stack.
+    StoreTemporary,
+    /// \brief Intrinsic of abs(x), replaces the first value of the stack by its absolute value.
+    Abs,
+    /// \brief Intrinsic of sqrt(x), replaces the first value of the stack by its square root.
+    Sqrt,
+    /// \brief Intrinsic of exp(x), replaces the first value of the stack by e^x.
+    Exp,
+    /// \brief Intrinsic of ln(x), replaces the first value of the stack by its natural logarithmus.
+    Ln,
+    /// \brief Intrinsic of log10(x), replaces the first value of the stack by its logarithmus by base 10.
+    Log10,
+    /// \brief Intrinsic of pow(a, b), pops two values from the stack and pushes a^b.
+    Pow,
+    /// \brief Intrinsic of mod(a, b), pops two values from the stack and pushes the remainder of a / b.
+    Mod,
+    /// \brief Intrinsic of floor(x), rounds the first value of the stack down.
+    Floor,
+    /// \brief Intrinsic of ceil(x), rounds the first value of the stack up.
+    Ceil,
+    /// \brief Intrinsic of sin(x), replaces the first value of the stack by its sinus.
+    Sin,
+    /// \brief Intrinsic of cos(x), replaces the first value of the stack by its cosinus.
+    Cos,
+    /// \brief Intrinsic of tan(x), replaces the first value of the stack by its tangens.
+    Tan,
     /// \brief No operation. Does nothing.
     Nop,
+    // Comparisons, which push 1 if the comparison is true and 0 otherwise
+    /// \brief Pops a and b from the stack and pushes a < b.
+    Less,
+    /// \brief Pops a and b from the stack and pushes a <= b.
+    LessEqual,
+    /// \brief Pops a and b from the stack and pushes a > b.
+    Greater,
+    /// \brief Pops a and b from the stack and pushes a >= b.
+    GreaterEqual,
+    /// \brief Pops a and b from the stack and pushes a == b.
+    Equal,
+    /// \brief Pops a and b from the stack and pushes a != b.
+    NotEqual,
+    /// \brief Intrinsic of select(c, a, b), pops three values from the stack and pushes a if c is not zero, otherwise b.
+    Select,
+    // Superinstructions, which are only created by the MathPeephole for the interpreter
+    /// \brief Adds a variable to the first value of the stack (LoadVariable, Add).
+    AddVariable,
+    /// \brief Substracts a variable from the first value of the stack (LoadVariable, Sub).
+    SubVariable,
+    /// \brief Multiplies the first value of the stack with a variable (LoadVariable, Mul).
+    MulVariable,
+    /// \brief Divides the first value of the stack by a variable (LoadVariable, Div).
+    DivVariable,
+    /// \brief Adds a constant to the first value of the stack (LoadConstant, Add or Sub).
+    AddConstant,
+    /// \brief Multiplies the first value of the stack with a constant (LoadConstant, Mul).
+    MulConstant,
+    /// \brief Divides the first value of the stack by a constant (LoadConstant, Div).
+    DivConstant,
+    /// \brief Pops a, b and c from the stack and pushes a+b*c with one rounding (Mul, Add).
+    MulAdd,
+    /// \brief Pops a and b from the stack and pushes a+b*variable with one rounding (MulVariable, Add).
+    MulVariableAdd,
+    /// \brief Pops a and b from the stack and pushes a+b*constant with one rounding (MulConstant, Add).
+    MulConstantAdd,
+    // Variables bound to memory of the caller, only created by the MathPeephole for the interpreter
+    /// \brief Loads the value at an address into the stack (LoadVariable of a bound variable).
+    LoadAddress,
+    /// \brief Saves the first value from the stack at an address (SaveVariable of a bound variable).
+    SaveAddress,
+    /// \brief Loads a member of the bound object into the stack, the index is its offset in bytes.
+    LoadMember,
+    /// \brief Saves the first value from the stack in a member of the bound object.
+    SaveMember,
+    // Direct calls of native functions (see MathFunction::GetNative()), only created by the MathPeephole
+    /// \brief Replaces the first value of the stack by the result of a native function f(a).
+    CallNative1,
+    /// \brief Pops two values from the stack and pushes the result of a native function f(a, b).
+    CallNative2,
+    /// \brief Pops three values from the stack and pushes the result of a native function f(a, b, c).
+    CallNative3,
     /// \brief Opcode which contains multible other opcodes.
     Opcodes
 };
@@ -84,6 +164,13 @@ class MathOpcode
         MathOpcode(MathOpcodeType type, MathOpcodeArray* array);
         ~MathOpcode();
 
+        static bool IsIntrinsic(MathOpcodeType type);
+        static bool IsComparison(MathOpcodeType type);
+        static bool IsSuperinstruction(MathOpcodeType type);
+        static bool IsBound(MathOpcodeType type);
+        static bool IsNativeCall(MathOpcodeType type);
+        static const Char* GetMnemonic(MathOpcodeType type);
+
         /**
          * \brief Returns the opcode type.
          * \return Opcode type.
@@ -131,6 +218,32 @@ class MathOpcode
 
 
 
+/**
+ * \brief The MathInstruction struct is the packed form of a MathOpcode, which is
+ * executed by the interpreter. The compiled code is stored as a contiguous array
+ * of instructions without any nesting, so the interpreter can walk it with a plain
+ * pointer. Instructions of type MathOpcodeType::Opcodes never appear in this form.
+ **/
+struct MathInstruction
+{
+    /// \brief Opcode type.
+    MathOpcodeType Type;
+    union
+    {
+        /// \brief Value for LoadConstant.
+        double Value;
+        /// \brief Index for LoadVariable, SaveVariable, CallFunction, LoadTemporary, StoreTemporary
+        /// and the function index for intrinsics. Offset in bytes for LoadMember and SaveMember.
+        size_t Index;
+        /// \brief Address for LoadAddress and SaveAddress.
+        double* Address;
+        /// \brief Address of the native function for CallNative1 to CallNative3.
+        void* Native;
+    };
+};
+
+
+
 } // namespace rush
 
 #endif // _RUSH_MATHOPCODE_H_
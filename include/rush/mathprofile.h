@@ -0,0 +1,105 @@
+/*
+ * mathprofile.h - Declaration of the MathProfile class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+
+#ifndef _RUSH_MATHPROFILE_H_
+#define _RUSH_MATHPROFILE_H_
+
+
+#include <rush/config.h>
+#include <rush/string.h>
+#include <rush/mathopcode.h>
+
+namespace rush {
+
+// Forward declaration
+class MathFunction;
+class MathProgram;
+
+/**
+ * \brief Number of opcode types, which are counted by the MathProfile.
+ **/
+const size_t MathProfileOpcodeCount = (size_t)MathOpcodeType::Opcodes + 1;
+
+
+/**
+ * \brief The MathOpcodeProfile struct contains the counters of one opcode type.
+ **/
+struct MathOpcodeProfile
+{
+    /// \brief Number of executed instructions.
+    unsigned long long Count;
+    /// \brief Cycles spent in the instructions (see System::GetCycles()), including
+    /// the dispatch and one read of the counter per instruction.
+    unsigned long long Cycles;
+};
+
+
+/**
+ * \brief The MathFunctionProfile struct contains the counters of one function,
+ * which was called with MathOpcodeType::CallFunction. Intrinsics and direct
+ * calls of native functions (CallNative1 to CallNative3) are counted as
+ * opcodes only.
+ **/
+struct MathFunctionProfile
+{
+    /// \brief Name of the function.
+    String Name;
+    /// \brief Number of calls.
+    unsigned long long Calls;
+    /// \brief Cycles spent in the function, without the interpreter.
+    unsigned long long Cycles;
+};
+
+
+/**
+ * \brief The MathProfile class is the report of the profiled executions of a
+ * program, see MathEvaluation::SetProfilingEnabled(). The counters are summed
+ * up over all executions until Reset() is called.
+ **/
+class MathProfile
+{
+    friend class MathProgram;
+
+    public:
+        MathProfile();
+        ~MathProfile();
+
+        void Reset();
+
+        const MathOpcodeProfile& GetOpcode(MathOpcodeType type) const;
+        size_t GetFunctionCount() const;
+        const MathFunctionProfile& GetFunction(size_t index) const;
+
+        unsigned long long GetExecutions() const;
+        unsigned long long GetCycles() const;
+        size_t GetMaxStackDepth() const;
+
+        String ToString() const;
+
+    private:
+        MathProfile(const MathProfile& profile) {}
+        MathProfile& operator=(const MathProfile& profile) { return (*this); }
+
+        void Prepare(MathFunction* const* functions, size_t count);
+
+    private:
+        MathOpcodeProfile m_opcodes[MathProfileOpcodeCount];
+        MathFunctionProfile* m_functions;
+        size_t m_countFunctions;
+        unsigned long long m_executions;
+        unsigned long long m_cycles;
+        size_t m_maxStackDepth;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHPROFILE_H_
@@ -0,0 +1,165 @@
+/*
+ * mathprogram.h - Declaration of the MathProgram and MathContext classes
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+
+#ifndef _RUSH_MATHPROGRAM_H_
+#define _RUSH_MATHPROGRAM_H_
+
+
+#include <rush/config.h>
+#include <rush/string.h>
+#include <rush/objectarray.h>
+#include <rush/stringarray.h>
+#include <rush/mathopcode.h>
+
+namespace rush {
+
+// Forward declaration
+class MathFunction;
+class MathEvaluation;
+class MathJit;
+class MathSymbolTable;
+class MathDependencyGraph;
+class MathProfile;
+enum class MathFusion;
+enum class MathReductionType;
+struct MathBinding;
+struct MathArray;
+struct MathReduction;
+struct MathCompileCacheEntry;
+
+/**
+ * \brief The MathVariableHandle struct is a variable name resolved into the
+ * index of the variable. Handles are returned by GetVariableHandle() and allow
+ * to set and get variables without comparing any strings.
+ **/
+struct MathVariableHandle
+{
+    /// \brief Index of the variable or (size_t)-1 if the variable does not exist.
+    size_t Index;
+
+    /**
+     * \brief Checks if the handle refers to a variable.
+     * \return True, if the variable exists; otherwise false.
+     **/
+    inline bool IsValid() const
+    { return (Index != (size_t)-1); }
+};
+
+/**
+ * \brief The MathProgram class is the compiled code of a MathEvaluation. A
+ * program is read-only after it was created by MathEvaluation::CreateProgram(),
+ * so one program can be executed by many threads at the same time. Every thread
+ * needs its own MathContext, which holds the variable values, the stack and the
+ * errors of the execution.
+ * \remarks The program uses the functions of the MathEvaluation which created
+ * it, the MathEvaluation must not be deleted before the program. Functions which
+ * are called from multible threads must be thread-safe (all predefined functions are).
+ * A program can be saved as binary image with SaveImage() and loaded with
+ * MathEvaluation::LoadProgram(), which uses the image in place.
+ **/
+class MathProgram
+{
+    friend class MathEvaluation;
+    friend class MathContext;
+    friend class MathCompileCache;
+    friend class MathDependencyGraph;
+
+    private:
+        MathProgram();
+    public:
+        ~MathProgram();
+
+        size_t GetVariableCount() const;
+        const String& GetVariableName(size_t index) const;
+        int FindVariableIndex(const String& name) const;
+        double GetInitialValue(size_t index) const;
+
+        size_t GetStackDepth() const;
+        bool IsJitCompiled() const;
+        bool IsVerified() const;
+
+        size_t GetImageSize() const;
+        bool SaveImage(void* image, size_t size) const;
+
+    private:
+        bool Execute(double* values, double* stack, StringArray* errors, char* object = NULL) const;
+        bool ExecuteRange(size_t first, size_t count, double* values, double* stack, StringArray* errors) const;
+        bool Profile(double* values, double* stack, StringArray* errors, MathProfile* profile,
+                     char* object = NULL) const;
+        template <bool checked, bool profiled>
+        bool Interpret(const MathInstruction* code, size_t count, double* values, double* stack,
+                       char* object, StringArray* errors, MathProfile* profile) const;
+        void Combine(MathFusion fusion, const MathBinding* bindings = NULL, size_t countBindings = 0);
+        static bool IsCall(const MathInstruction& instruction);
+        size_t MapFunctions(size_t* map) const;
+
+    private:
+        MathInstruction* m_code;
+        size_t m_codeCount;
+        MathInstruction* m_combined;
+        size_t m_combinedCount;
+        size_t m_stackDepth;
+        size_t m_countTemporaries;
+        MathFunction** m_functions;
+        size_t m_countFunctions;
+        MathSymbolTable* m_variables;
+        double* m_values;
+        MathJit* m_jit;
+        MathCompileCacheEntry* m_cacheEntry;
+        bool m_verified;
+        bool m_bound;
+        bool m_ownsCode;
+        bool m_ownsValues;
+};
+
+
+/**
+ * \brief The MathContext class executes a MathProgram. The context holds the
+ * variable values, a preallocated stack and the errors, so every thread can
+ * execute the same program with its own context without locking.
+ * The values of the variables are initialized with the values of the
+ * MathEvaluation, when the program was created.
+ **/
+class MathContext
+{
+    private:
+        MathContext() {}
+    public:
+        MathContext(const MathProgram* program);
+        virtual ~MathContext();
+
+        const MathProgram* GetProgram() const;
+
+        void SetVariable(const String& name, double value);
+        double GetVariable(const String& name) const;
+        MathVariableHandle GetVariableHandle(const String& name) const;
+        void SetVariable(MathVariableHandle handle, double value);
+        double GetVariable(MathVariableHandle handle) const;
+        void ResetVariables();
+
+        bool HasErrors() const;
+        String GetErrorMessage() const;
+
+        bool Execute();
+
+    private:
+        const MathProgram* m_program;
+        double* m_values;
+        double* m_stack;
+        StringArray* m_errors;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHPROGRAM_H_
+
+
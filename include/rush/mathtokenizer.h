@@ -49,45 +49,56 @@ enum class MathTokenType
 
 
 /**
- * \brief The MathToken class stores information of one token.
- * The token
+ * \brief The MathToken class stores information of one token. The token does
+ * not copy its content, it is a view (pointer and length) into the parsed
+ * statements, which must not be changed or deleted while the token is used.
  **/
 class MathToken
 {
     public:
         MathToken()
-            : m_type(MathTokenType::None), m_content(_T("")) {}
-        MathToken(MathTokenType type, const String& content)
-            : m_type(type), m_content(content) {}
+            : m_type(MathTokenType::None), m_text(NULL), m_length(0) {}
+        MathToken(MathTokenType type, const Char* text, size_t length)
+            : m_type(type), m_text(text), m_length(length) {}
         ~MathToken() {}
 
         inline MathTokenType GetType() const
         { return (m_type); }
 
-        inline const String& GetContent() const
-        { return (m_content); }
-
-        inline void SetType(MathTokenType type)
-        { m_type = type; }
-
-        inline void SetContent(const String& content)
-        { m_content = content; }
-
+        inline const Char* GetText() const
+        { return (m_text); }
+
+        inline size_t GetLength() const
+        { return (m_length); }
+
+        /**
+         * \brief Compares the content of the token with a zero terminated text.
+         * \param text Text.
+         * \return True, if the content is equal to the text; otherwise false.
+         **/
+        inline bool Equals(const Char* text) const
+        {
+            for (size_t i=0; i<m_length; ++i) {
+                if (text[i] != m_text[i]) return (false);
+            }
+            return (text[m_length] == 0);
+        }
+
+        String GetContent() const;
         String ToString() const;
 
     private:
         MathTokenType m_type;
-        String m_content;
+        const Char* m_text;
+        size_t m_length;
 };
 
 
 /**
- * \brief
- **/
-typedef ObjectArray<MathToken> MathTokenArray;
-
-/**
- * \brief
+ * \brief The MathTokenizer class splits mathematical statements into tokens.
+ * The characters are mapped with a character class table and drive a state
+ * machine. The tokens are stored in one contiguous array, which is reused by
+ * the next Parse() call, so parsing allocates no memory per token.
  * \todo Tokenizer can be send to src. Forward declarations needed in mathevaluation.h
  **/
 class MathTokenizer
@@ -97,16 +108,38 @@ class MathTokenizer
         virtual ~MathTokenizer();
 
         bool Parse(const String& statements, StringArray* errors);
-        MathTokenArray* GetTokens() const;
+        bool Parse(const Char* statements, size_t length, StringArray* errors, int firstLine = 0);
+
+        /**
+         * \brief Returns the tokens of the last parsed statements. The array
+         * is followed by one token of type None, so the token after the last
+         * token can always be read.
+         * \return Tokens.
+         **/
+        inline const MathToken* GetTokens() const
+        { return (m_tokens); }
+
+        /**
+         * \brief Counts the tokens of the last parsed statements.
+         * \return Number of tokens.
+         **/
+        inline size_t Count() const
+        { return (m_countTokens); }
 
     private:
-        int GetInputCode(Char input) const;
-        void DoAction(int action, Char input);
+        void DoAction(int action, size_t position);
+        void AddToken(MathTokenType type);
 
     private:
         int m_currentstate;
-        ObjectArray<MathToken>* m_tokens;
-        String m_currenttoken;
+        MathToken* m_tokens;
+        size_t m_countTokens;
+        size_t m_capacityTokens;
+        const Char* m_text;
+        size_t m_textLength;
+        size_t m_tokenStart;
+        size_t m_tokenLength;
+        bool m_tokenSplit;
 };
 
 
@@ -0,0 +1,69 @@
+/*
+ * mutex.h - Declaration of the Mutex and MutexLocker classes
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MUTEX_H_
+#define _RUSH_MUTEX_H_
+
+
+#include <rush/config.h>
+
+namespace rush {
+
+/**
+ * \brief The Mutex class synchronizes threads of the same process. The
+ * mutex is recursive, the same thread can lock it multible times.
+ * Uses a critical section on Windows and a pthread mutex on Linux.
+ **/
+class Mutex
+{
+    public:
+        Mutex();
+        ~Mutex();
+
+        void Lock();
+        void Unlock();
+
+    private:
+        Mutex(const Mutex& mutex) {}
+        Mutex& operator=(const Mutex& mutex) { return (*this); }
+
+    private:
+        void* m_handle;
+};
+
+
+/**
+ * \brief The MutexLocker class locks a mutex in the constructor and
+ * unlocks it in the destructor.
+ * \code {.cpp}
+ * {
+ *     MutexLocker locker(mutex);
+ *     // The mutex is locked until the end of the scope
+ * }
+ * \endcode
+ **/
+class MutexLocker
+{
+    public:
+        MutexLocker(Mutex& mutex) : m_mutex(mutex)
+        { m_mutex.Lock(); }
+
+        ~MutexLocker()
+        { m_mutex.Unlock(); }
+
+    private:
+        Mutex& m_mutex;
+};
+
+} // namespace rush
+
+#endif // _RUSH_MUTEX_H_
+
+
@@ -22,8 +22,12 @@
 #include <rush/list.h>
 #include <rush/log.h>
 #include <rush/macros.h>
+#include <rush/mathcompilecache.h>
 #include <rush/mathevaluation.h>
+#include <rush/mathexpression.h>
+#include <rush/mathprogram.h>
 #include <rush/memory.h>
+#include <rush/mutex.h>
 #include <rush/objectarray.h>
 #include <rush/objectdeque.h>
 #include <rush/objectqueue.h>
@@ -38,6 +42,7 @@
 #include <rush/string.h>
 #include <rush/stringarray.h>
 #include <rush/system.h>
+#include <rush/thread.h>
 #include <rush/vector.h>
 
 #endif  // _RUSH_INCLUDES_H_
@@ -29,7 +29,9 @@ class System
     public:
         static String GetExecutablePath();
         static size_t GetTicks();
+        static unsigned long long GetCycles();
         static void Delay(size_t milliSeconds);
+        static size_t GetProcessorCount();
 
 
 };
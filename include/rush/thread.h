@@ -0,0 +1,68 @@
+/*
+ * thread.h - Declaration of the Thread class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_THREAD_H_
+#define _RUSH_THREAD_H_
+
+
+#include <rush/config.h>
+
+namespace rush {
+
+/**
+ * \brief The Thread abstract class executes the Run() method in a new
+ * thread. Inherit from this class, implement Run() and call Start(). The
+ * thread must be joined with Wait() before the object is deleted.
+ * Uses a Windows thread on Windows and a pthread on Linux.
+ * \code {.cpp}
+ * class Worker : public Thread
+ * {
+ *     protected:
+ *         virtual void Run() { ... }
+ * };
+ *
+ * Worker worker;
+ * worker.Start();
+ * worker.Wait();
+ * \endcode
+ **/
+class Thread
+{
+    public:
+        Thread();
+        virtual ~Thread();
+
+        bool Start();
+        void Wait();
+        bool IsRunning() const;
+
+    protected:
+        /**
+         * \brief Is executed in the new thread, when the thread was started.
+         **/
+        virtual void Run() = 0;
+
+    private:
+        Thread(const Thread& thread) {}
+        Thread& operator=(const Thread& thread) { return (*this); }
+
+        #if defined _RUSH_WINDOWS_
+        static unsigned long __stdcall Entry(void* thread);
+        #else
+        static void* Entry(void* thread);
+        #endif
+
+    private:
+        void* m_handle;
+};
+
+} // namespace rush
+
+#endif // _RUSH_THREAD_H_
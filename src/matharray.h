@@ -0,0 +1,76 @@
+/*
+ * matharray.h - Declaration of the MathArray and MathReduction structs
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHARRAY_H_
+#define _RUSH_MATHARRAY_H_
+
+
+#include <rush/mathevaluation.h>
+
+
+namespace rush {
+
+
+/**
+ * \brief The MathArray struct holds the values of an array variable (see
+ * MathEvaluation::SetArray() and MathEvaluation::BindArray()).
+ **/
+struct MathArray
+{
+    /// \brief Values, either the own copy or the memory of the caller.
+    const double* Values;
+    /// \brief Number of values.
+    size_t Count;
+    /// \brief Own copy of the values or NULL.
+    double* Owned;
+    /// \brief Number of values, which fit into the own copy.
+    size_t Capacity;
+};
+
+
+/**
+ * \brief The MathReductionType enum describes the reduction of an array.
+ **/
+enum class MathReductionType
+{
+    /// \brief sum(a): Sum of the values.
+    Sum,
+    /// \brief mean(a): Arithmetic mean of the values.
+    Mean,
+    /// \brief min(a): Smallest value.
+    Min,
+    /// \brief max(a): Largest value.
+    Max,
+    /// \brief dot(a, b): Sum of the products of the values of two arrays.
+    Dot
+};
+
+
+/**
+ * \brief The MathReduction struct is one reduction used by the compiled code.
+ * The result is stored in a variable named like the call, e.g. "dot(a,b)",
+ * which is loaded by the code like any other variable.
+ **/
+struct MathReduction
+{
+    /// \brief Reduction type.
+    MathReductionType Type;
+    /// \brief Index of the array.
+    size_t First;
+    /// \brief Index of the second array of dot().
+    size_t Second;
+    /// \brief Index of the variable, which receives the result.
+    size_t Variable;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHARRAY_H_
@@ -0,0 +1,333 @@
+/*
+ * mathbatch.cpp - Implementation of the MathBatch, MathBatchQueue and MathBatchWorker classes
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#include "mathbatch.h"
+#include "mathkernels.h"
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+template <typename T>
+MathBatch<T>::MathBatch(const MathInstruction* code, size_t codeCount, size_t countTemporaries,
+                        MathFunction* const* functions, const double* values, size_t countVariables,
+                        const T* const* columns, size_t outputIndex,
+                        size_t maxDepth, size_t maxArgs, MathAccuracy accuracy)
+/**
+ * \brief Constructor, allocates the blocks for the stack and the variables.
+ * \param code Verified instructions.
+ * \param codeCount Number of instructions.
+ * \param countTemporaries Number of temporary values.
+ * \param functions Functions, which are called by the code.
+ * \param values Values of the variables without an input column.
+ * \param countVariables Number of variables.
+ * \param columns Input column of each variable or NULL, if the value is used for every row.
+ * \param outputIndex Index of the output variable.
+ * \param maxDepth Stack depth of the code, including the temporary values.
+ * \param maxArgs Maximum number of function arguments.
+ * \param accuracy Accuracy of the transcendental functions.
+ **/
+{
+    m_code = code;
+    m_codeCount = codeCount;
+    m_countTemporaries = countTemporaries;
+    m_functions = functions;
+    m_countVariables = countVariables;
+    m_columns = columns;
+    m_outputIndex = outputIndex;
+    m_accuracy = accuracy;
+    m_stack = new T[(maxDepth > 0 ? maxDepth : 1)*MathBlockSize];
+    m_storage = new T[(countVariables > 0 ? countVariables : 1)*MathBlockSize];
+    m_broadcast = new T[(countVariables > 0 ? countVariables : 1)*MathBlockSize];
+    m_sources = new const T*[countVariables > 0 ? countVariables : 1];
+    m_args = new double[maxArgs > 0 ? maxArgs : 1];
+    for (size_t v=0; v<countVariables; ++v)
+    {
+        MathKernelFill(m_broadcast + v*MathBlockSize, values[v], MathBlockSize);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+template <typename T>
+MathBatch<T>::~MathBatch()
+/**
+ * \brief Destructor, frees the blocks.
+ **/
+{
+    delete [] m_stack;
+    delete [] m_storage;
+    delete [] m_broadcast;
+    delete [] m_sources;
+    delete [] m_args;
+}
+
+
+//-----------------------------------------------------------------------------
+template <typename T>
+void MathBatch<T>::Execute(T* output, size_t first, size_t rows)
+/**
+ * \brief Executes the code for the given rows block by block, so each opcode
+ * runs over a whole block with vectorized (SSE2/AVX) kernels.
+ * \param output Output column (all rows), receives the values of the given rows.
+ * \param first Index of the first row.
+ * \param rows Number of rows.
+ **/
+{
+    size_t last = first + rows;
+    for (size_t row=first; row<last; row+=MathBlockSize)
+    {
+        size_t count = (last - row < MathBlockSize ? last - row : MathBlockSize);
+        for (size_t v=0; v<m_countVariables; ++v)
+        {
+            m_sources[v] = (m_columns[v] != NULL ? m_columns[v] + row : m_broadcast + v*MathBlockSize);
+        }
+
+        // The temporary values are stored in the blocks at the bottom of the stack
+        T* top = m_stack + m_countTemporaries*MathBlockSize;
+        for (size_t i=0; i<m_codeCount; ++i)
+        {
+            const MathInstruction& instruction = m_code[i];
+            switch (instruction.Type)
+            {
+                case MathOpcodeType::LoadConstant:
+                    MathKernelFill(top, instruction.Value, count);
+                    top += MathBlockSize;
+                    break;
+                case MathOpcodeType::LoadVariable:
+                    memcpy(top, m_sources[instruction.Index], count*sizeof(T));
+                    top += MathBlockSize;
+                    break;
+                case MathOpcodeType::SaveVariable:
+                    top -= MathBlockSize;
+                    memcpy(m_storage + instruction.Index*MathBlockSize, top, count*sizeof(T));
+                    m_sources[instruction.Index] = m_storage + instruction.Index*MathBlockSize;
+                    break;
+                case MathOpcodeType::CallFunction:
+                {
+                    MathFunction* function = m_functions[instruction.Index];
+                    size_t countArgs = function->GetArgs();
+                    top -= countArgs*MathBlockSize;
+                    for (size_t r=0; r<count; ++r)
+                    {
+                        for (size_t a=0; a<countArgs; ++a)
+                        {
+                            m_args[a] = top[a*MathBlockSize + r];
+                        }
+                        top[r] = (T)function->Evaluate(m_args, countArgs);
+                    }
+                    top += MathBlockSize;
+                    break;
+                }
+                case MathOpcodeType::Add:
+                    top -= MathBlockSize;
+                    MathKernelAdd(top - MathBlockSize, top, count);
+                    break;
+                case MathOpcodeType::Sub:
+                    top -= MathBlockSize;
+                    MathKernelSub(top - MathBlockSize, top, count);
+                    break;
+                case MathOpcodeType::Mul:
+                    top -= MathBlockSize;
+                    MathKernelMul(top - MathBlockSize, top, count);
+                    break;
+                case MathOpcodeType::Div:
+                    top -= MathBlockSize;
+                    MathKernelDiv(top - MathBlockSize, top, count);
+                    break;
+                case MathOpcodeType::Neg:
+                    MathKernelNeg(top - MathBlockSize, count);
+                    break;
+                case MathOpcodeType::Double:
+                    memcpy(top, top - MathBlockSize, count*sizeof(T));
+                    top += MathBlockSize;
+                    break;
+                case MathOpcodeType::LoadTemporary:
+                    memcpy(top, m_stack + instruction.Index*MathBlockSize, count*sizeof(T));
+                    top += MathBlockSize;
+                    break;
+                case MathOpcodeType::StoreTemporary:
+                    memcpy(m_stack + instruction.Index*MathBlockSize, top - MathBlockSize, count*sizeof(T));
+                    break;
+                case MathOpcodeType::Abs:
+                    MathKernelAbs(top - MathBlockSize, count);
+                    break;
+                case MathOpcodeType::Sqrt:
+                    MathKernelSqrt(top - MathBlockSize, count);
+                    break;
+                case MathOpcodeType::Exp:
+                    MathKernelExp(top - MathBlockSize, count, m_accuracy);
+                    break;
+                case MathOpcodeType::Ln:
+                    MathKernelLn(top - MathBlockSize, count, m_accuracy);
+                    break;
+                case MathOpcodeType::Log10:
+                    MathKernelApply<log10>(top - MathBlockSize, count);
+                    break;
+                case MathOpcodeType::Pow:
+                    top -= MathBlockSize;
+                    MathKernelPow(top - MathBlockSize, top, count, m_accuracy);
+                    break;
+                case MathOpcodeType::Mod:
+                    top -= MathBlockSize;
+                    MathKernelApply<fmod>(top - MathBlockSize, top, count);
+                    break;
+                case MathOpcodeType::Floor:
+                    MathKernelApply<floor>(top - MathBlockSize, count);
+                    break;
+                case MathOpcodeType::Ceil:
+                    MathKernelApply<ceil>(top - MathBlockSize, count);
+                    break;
+                case MathOpcodeType::Sin:
+                    MathKernelSin(top - MathBlockSize, count, m_accuracy);
+                    break;
+                case MathOpcodeType::Cos:
+                    MathKernelCos(top - MathBlockSize, count, m_accuracy);
+                    break;
+                case MathOpcodeType::Tan:
+                    MathKernelTan(top - MathBlockSize, count, m_accuracy);
+                    break;
+                case MathOpcodeType::Select:
+                    top -= 2*MathBlockSize;
+                    MathKernelSelect(top - MathBlockSize, top, top + MathBlockSize, count);
+                    break;
+                case MathOpcodeType::Less:
+                    top -= MathBlockSize;
+                    MathKernelCompare<MathOpcodeType::Less>(top - MathBlockSize, top, count);
+                    break;
+                case MathOpcodeType::LessEqual:
+                    top -= MathBlockSize;
+                    MathKernelCompare<MathOpcodeType::LessEqual>(top - MathBlockSize, top, count);
+                    break;
+                case MathOpcodeType::Greater:
+                    top -= MathBlockSize;
+                    MathKernelCompare<MathOpcodeType::Greater>(top - MathBlockSize, top, count);
+                    break;
+                case MathOpcodeType::GreaterEqual:
+                    top -= MathBlockSize;
+                    MathKernelCompare<MathOpcodeType::GreaterEqual>(top - MathBlockSize, top, count);
+                    break;
+                case MathOpcodeType::Equal:
+                    top -= MathBlockSize;
+                    MathKernelCompare<MathOpcodeType::Equal>(top - MathBlockSize, top, count);
+                    break;
+                case MathOpcodeType::NotEqual:
+                    top -= MathBlockSize;
+                    MathKernelCompare<MathOpcodeType::NotEqual>(top - MathBlockSize, top, count);
+                    break;
+                default:
+                    break;
+            }
+        }
+        memcpy(output + row, m_sources[m_outputIndex], count*sizeof(T));
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+MathBatchQueue::MathBatchQueue(size_t rows, size_t chunkSize)
+/**
+ * \brief Constructor, initializes the MathBatchQueue object.
+ * \param rows Number of rows.
+ * \param chunkSize Number of rows per chunk, is rounded up to a multible of MathBlockSize.
+ **/
+{
+    m_rows = rows;
+    m_chunkSize = (chunkSize + MathBlockSize - 1) / MathBlockSize * MathBlockSize;
+    if (m_chunkSize == 0) m_chunkSize = MathBlockSize;
+    m_next = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathBatchQueue::Take(size_t* first, size_t* count)
+/**
+ * \brief Takes the next chunk of rows.
+ * \param first Receives the index of the first row.
+ * \param count Receives the number of rows.
+ * \return True, if a chunk was taken; false, if all rows are taken.
+ **/
+{
+    MutexLocker locker(m_mutex);
+    if (m_next >= m_rows)
+    {
+        return (false);
+    }
+    *first = m_next;
+    *count = (m_rows - m_next < m_chunkSize ? m_rows - m_next : m_chunkSize);
+    m_next += *count;
+    return (true);
+}
+
+
+//-----------------------------------------------------------------------------
+template <typename T>
+MathBatchWorker<T>::MathBatchWorker(MathBatch<T>* batch, MathBatchQueue* queue, T* output)
+/**
+ * \brief Constructor, initializes the MathBatchWorker object.
+ * \param batch Execution context of this worker, is not deleted by the worker.
+ * \param queue Queue, which is shared by all workers.
+ * \param output Output column (all rows).
+ **/
+{
+    m_batch = batch;
+    m_queue = queue;
+    m_output = output;
+}
+
+
+//-----------------------------------------------------------------------------
+template <typename T>
+MathBatchWorker<T>::~MathBatchWorker()
+/**
+ * \brief Destructor, waits until the thread is finished.
+ **/
+{
+    this->Wait();
+}
+
+
+//-----------------------------------------------------------------------------
+template <typename T>
+void MathBatchWorker<T>::Work()
+/**
+ * \brief Executes chunks until the queue is empty. Can be called by the
+ * current thread as well.
+ **/
+{
+    size_t first = 0;
+    size_t count = 0;
+    while (m_queue->Take(&first, &count))
+    {
+        m_batch->Execute(m_output, first, count);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+template <typename T>
+void MathBatchWorker<T>::Run()
+/**
+ * \brief Executes the chunks in the new thread.
+ **/
+{
+    this->Work();
+}
+
+
+// The batches are executed with double and with float values
+template class MathBatch<double>;
+template class MathBatch<float>;
+template class MathBatchWorker<double>;
+template class MathBatchWorker<float>;
+
+
+} // namespace rush
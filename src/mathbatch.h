@@ -0,0 +1,124 @@
+/*
+ * mathbatch.h - Declaration of the MathBatch, MathBatchQueue and MathBatchWorker classes
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHBATCH_H_
+#define _RUSH_MATHBATCH_H_
+
+
+#include <rush/mathevaluation.h>
+#include <rush/mutex.h>
+#include <rush/thread.h>
+
+
+namespace rush {
+
+
+/**
+ * \brief Maximum number of rows of one chunk in MathEvaluation::ExecuteParallel().
+ **/
+const size_t MathParallelChunkSize = 16384;
+
+
+/**
+ * \brief The MathBatch class is the execution context of
+ * MathEvaluation::ExecuteBatch(). It owns the blocks of the stack and the
+ * variables, so every thread needs its own MathBatch, while the code and the
+ * input columns are shared read-only. The values are of type T (double or
+ * float), constants and variables without a column are rounded to T.
+ **/
+template <typename T>
+class MathBatch
+{
+    public:
+        MathBatch(const MathInstruction* code, size_t codeCount, size_t countTemporaries,
+                  MathFunction* const* functions, const double* values, size_t countVariables,
+                  const T* const* columns, size_t outputIndex,
+                  size_t maxDepth, size_t maxArgs, MathAccuracy accuracy);
+        ~MathBatch();
+
+        void Execute(T* output, size_t first, size_t rows);
+
+    private:
+        MathBatch(const MathBatch& batch) {}
+        MathBatch& operator=(const MathBatch& batch) { return (*this); }
+
+    private:
+        const MathInstruction* m_code;
+        size_t m_codeCount;
+        size_t m_countTemporaries;
+        MathFunction* const* m_functions;
+        size_t m_countVariables;
+        const T* const* m_columns;
+        size_t m_outputIndex;
+        MathAccuracy m_accuracy;
+        T* m_stack;
+        T* m_storage;
+        T* m_broadcast;
+        const T** m_sources;
+        double* m_args;
+};
+
+
+/**
+ * \brief The MathBatchQueue class hands out the chunks of rows to the
+ * workers of MathEvaluation::ExecuteParallel(). The chunks start at multibles
+ * of MathBlockSize, so the rows are processed in the same blocks as by a
+ * single thread.
+ **/
+class MathBatchQueue
+{
+    public:
+        MathBatchQueue(size_t rows, size_t chunkSize);
+
+        bool Take(size_t* first, size_t* count);
+
+        /**
+         * \brief Returns the number of chunks of all rows.
+         * \return Number of chunks.
+         **/
+        inline size_t GetChunkCount() const
+        { return ((m_rows + m_chunkSize - 1) / m_chunkSize); }
+
+    private:
+        Mutex m_mutex;
+        size_t m_rows;
+        size_t m_chunkSize;
+        size_t m_next;
+};
+
+
+/**
+ * \brief The MathBatchWorker class executes chunks of the MathBatchQueue
+ * with its own MathBatch, until the queue is empty. The output of a row is
+ * always written to the same position, so the order does not depend on the
+ * scheduling of the threads.
+ **/
+template <typename T>
+class MathBatchWorker : public Thread
+{
+    public:
+        MathBatchWorker(MathBatch<T>* batch, MathBatchQueue* queue, T* output);
+        virtual ~MathBatchWorker();
+
+        void Work();
+
+    protected:
+        virtual void Run();
+
+    private:
+        MathBatch<T>* m_batch;
+        MathBatchQueue* m_queue;
+        T* m_output;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHBATCH_H_
@@ -0,0 +1,433 @@
+/*
+ * mathcompilecache.cpp - Implementation of the MathCompileCache class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+#include <rush/mathcompilecache.h>
+#include "mathsymboltable.h"
+
+
+namespace rush {
+
+
+/**
+ * \brief The MathCompileCacheEntry struct is one compiled program of the
+ * MathCompileCache. The entry is in a bucket of the hash table and in the
+ * list of recently used entries. Removed entries, which are still acquired,
+ * are in the list of retired entries.
+ **/
+struct MathCompileCacheEntry
+{
+    /// \brief Normalized statements.
+    String Key;
+    /// \brief Hash of the normalized statements.
+    size_t Hash;
+    /// \brief Compiled program.
+    MathProgram* Program;
+    /// \brief Number of threads which acquired the program.
+    size_t References;
+    /// \brief True, if the entry is in the hash table; false if retired.
+    bool Cached;
+    /// \brief Next entry in the same bucket.
+    MathCompileCacheEntry* Next;
+    /// \brief More recently used entry.
+    MathCompileCacheEntry* Newer;
+    /// \brief Less recently used entry.
+    MathCompileCacheEntry* Older;
+};
+
+
+
+
+//-----------------------------------------------------------------------------
+MathCompileCache::MathCompileCache(size_t capacity)
+/**
+ * \brief Constructor, initializes the MathCompileCache object.
+ * \param capacity Maximum number of cached programs.
+ **/
+{
+    m_compiler = new MathEvaluation();
+    m_countBuckets = 16;
+    while (m_countBuckets < capacity)
+    {
+        m_countBuckets *= 2;
+    }
+    m_buckets = new MathCompileCacheEntry*[m_countBuckets];
+    for (size_t i=0; i<m_countBuckets; ++i)
+    {
+        m_buckets[i] = NULL;
+    }
+    m_newest = NULL;
+    m_oldest = NULL;
+    m_retired = NULL;
+    m_count = 0;
+    m_capacity = capacity;
+    m_hits = 0;
+    m_misses = 0;
+    m_evictions = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+MathCompileCache::~MathCompileCache()
+/**
+ * \brief Destructor, deletes all programs. All acquired programs must be
+ * released before.
+ **/
+{
+    this->Clear();
+    while (m_retired != NULL)
+    {
+        MathCompileCacheEntry* entry = m_retired;
+        m_retired = entry->Older;
+        delete entry->Program;
+        delete entry;
+    }
+    if (m_buckets != NULL) delete [] m_buckets;
+    if (m_compiler != NULL) delete m_compiler;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompileCache::SetFunction(MathFunction* function)
+/**
+ * \brief Sets a function for all statements compiled by this cache. This
+ * method can override existing functions, if their name is the same. All
+ * cached programs are removed.
+ * \param function Function.
+ **/
+{
+    MutexLocker locker(m_mutex);
+    m_compiler->SetFunction(function);
+    this->Clear();
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompileCache::SetJitEnabled(bool enabled)
+/**
+ * \brief Enables or disables native code for the compiled programs. All
+ * cached programs are removed.
+ * \param enabled True, to enable the JIT; otherwise false.
+ **/
+{
+    MutexLocker locker(m_mutex);
+    m_compiler->SetJitEnabled(enabled);
+    this->Clear();
+}
+
+
+//-----------------------------------------------------------------------------
+const MathProgram* MathCompileCache::Acquire(const String& statements, StringArray* errors)
+/**
+ * \brief Returns the compiled program of the given statements. The statements
+ * are only compiled, if they are not in the cache. The variables of the program
+ * are initialized with zero.
+ * \param statements Mathematical statements.
+ * \param errors Receives the compile errors (can be NULL).
+ * \return Program, which must be released with Release() or NULL, if the
+ * statements cannot be compiled.
+ **/
+{
+    String key = Normalize(statements);
+    size_t hash = MathSymbolTable::Hash(key);
+    MutexLocker locker(m_mutex);
+
+    // Use the cached program
+    MathCompileCacheEntry* entry = this->Find(key, hash);
+    if (entry != NULL)
+    {
+        m_hits++;
+        this->Unlink(entry);
+        this->Link(entry);
+        entry->References++;
+        return (entry->Program);
+    }
+
+    // Compile the statements
+    m_misses++;
+    m_compiler->ClearVariables();
+    bool compiled = m_compiler->Compile(key);
+    while (m_compiler->HasErrors())
+    {
+        String message = m_compiler->GetErrorMessage();
+        if (errors != NULL) errors->Add(message);
+    }
+    if (!compiled)
+    {
+        return (NULL);
+    }
+
+    // Remove the least recently used program
+    if (m_count >= m_capacity && m_oldest != NULL)
+    {
+        MathCompileCacheEntry* oldest = m_oldest;
+        this->Unlink(oldest);
+        this->Retire(oldest);
+        m_evictions++;
+    }
+
+    entry = new MathCompileCacheEntry();
+    entry->Key = key;
+    entry->Hash = hash;
+    entry->Program = m_compiler->CreateProgram();
+    entry->Program->m_cacheEntry = entry;
+    entry->References = 1;
+    entry->Cached = false;
+    entry->Next = NULL;
+    entry->Newer = NULL;
+    entry->Older = NULL;
+    if (m_capacity > 0) {
+        this->Link(entry);
+    } else {
+        this->Retire(entry);
+    }
+    return (entry->Program);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompileCache::Release(const MathProgram* program)
+/**
+ * \brief Gives back a program, which was returned by Acquire(). The program
+ * must not be used afterwards.
+ * \param program Program.
+ **/
+{
+    if (program == NULL || program->m_cacheEntry == NULL)
+    {
+        return;
+    }
+    MutexLocker locker(m_mutex);
+    MathCompileCacheEntry* entry = program->m_cacheEntry;
+    if (entry->References > 0)
+    {
+        entry->References--;
+    }
+    if (!entry->Cached && entry->References == 0)
+    {
+        // Remove from the retired entries
+        if (entry->Newer != NULL) entry->Newer->Older = entry->Older;
+        if (entry->Older != NULL) entry->Older->Newer = entry->Newer;
+        if (m_retired == entry) m_retired = entry->Older;
+        delete entry->Program;
+        delete entry;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompileCache::Clear()
+/**
+ * \brief Removes all programs from the cache. Acquired programs are deleted,
+ * when they are released.
+ **/
+{
+    MutexLocker locker(m_mutex);
+    while (m_oldest != NULL)
+    {
+        MathCompileCacheEntry* entry = m_oldest;
+        this->Unlink(entry);
+        this->Retire(entry);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathCompileCache::Count() const
+/**
+ * \brief Counts the cached programs.
+ * \return Number of cached programs.
+ **/
+{
+    MutexLocker locker(m_mutex);
+    return (m_count);
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathCompileCache::GetCapacity() const
+/**
+ * \brief Returns the maximum number of cached programs.
+ * \return Capacity.
+ **/
+{
+    return (m_capacity);
+}
+
+
+//-----------------------------------------------------------------------------
+MathCompileCacheStatistics MathCompileCache::GetStatistics() const
+/**
+ * \brief Returns the hits, misses and evictions since the cache was created
+ * or the statistics were reset.
+ * \return Statistics.
+ **/
+{
+    MutexLocker locker(m_mutex);
+    MathCompileCacheStatistics statistics;
+    statistics.Hits = m_hits;
+    statistics.Misses = m_misses;
+    statistics.Evictions = m_evictions;
+    statistics.Count = m_count;
+    statistics.Capacity = m_capacity;
+    return (statistics);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompileCache::ResetStatistics()
+/**
+ * \brief Sets the hits, misses and evictions to zero.
+ **/
+{
+    MutexLocker locker(m_mutex);
+    m_hits = 0;
+    m_misses = 0;
+    m_evictions = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+String MathCompileCache::Normalize(const String& statements)
+/**
+ * \brief Normalizes the statements, so statements which only differ in white
+ * spaces have the same key. White spaces are removed, except one space between
+ * two names or numbers and between two operator characters (including the
+ * characters of comparisons and the assignment), where the space changes the
+ * meaning of the statements, e.g. "x < = y" is no comparison.
+ * \param statements Mathematical statements.
+ * \return Normalized statements.
+ **/
+{
+    String result;
+    Char previous = 0;
+    bool space = false;
+    for (size_t i=0; i<statements.Length(); ++i)
+    {
+        Char input = statements[i];
+        if (input == ' ' || input == '\t' || input == '\r' || input == '\n')
+        {
+            space = true;
+            continue;
+        }
+        if (space && previous != 0)
+        {
+            bool previousName = ((previous >= 'a' && previous <= 'z') || (previous >= 'A' && previous <= 'Z') ||
+                                 (previous >= '0' && previous <= '9') || previous == '_' || previous == '.');
+            bool inputName = ((input >= 'a' && input <= 'z') || (input >= 'A' && input <= 'Z') ||
+                              (input >= '0' && input <= '9') || input == '_' || input == '.');
+            bool previousOperator = (previous == '+' || previous == '-' || previous == '*' || previous == '/' ||
+                                     previous == '<' || previous == '>' || previous == '!' || previous == '=');
+            bool inputOperator = (input == '+' || input == '-' || input == '*' || input == '/' ||
+                                  input == '<' || input == '>' || input == '!' || input == '=');
+            if ((previousName && inputName) || (previousOperator && inputOperator))
+            {
+                result.Append(' ');
+            }
+        }
+        result.Append(input);
+        previous = input;
+        space = false;
+    }
+    return (result);
+}
+
+
+//-----------------------------------------------------------------------------
+MathCompileCacheEntry* MathCompileCache::Find(const String& key, size_t hash) const
+/**
+ * \brief Searches the cached entry of the normalized statements.
+ * \param key Normalized statements.
+ * \param hash Hash of the normalized statements.
+ * \return Entry or NULL, if the statements are not cached.
+ **/
+{
+    MathCompileCacheEntry* entry = m_buckets[hash & (m_countBuckets-1)];
+    while (entry != NULL)
+    {
+        if (entry->Hash == hash && entry->Key == key)
+        {
+            return (entry);
+        }
+        entry = entry->Next;
+    }
+    return (NULL);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompileCache::Link(MathCompileCacheEntry* entry)
+/**
+ * \brief Inserts the entry into its bucket and as most recently used entry.
+ * \param entry Entry.
+ **/
+{
+    size_t bucket = entry->Hash & (m_countBuckets-1);
+    entry->Next = m_buckets[bucket];
+    m_buckets[bucket] = entry;
+
+    entry->Newer = NULL;
+    entry->Older = m_newest;
+    if (m_newest != NULL) m_newest->Newer = entry;
+    m_newest = entry;
+    if (m_oldest == NULL) m_oldest = entry;
+    entry->Cached = true;
+    m_count++;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompileCache::Unlink(MathCompileCacheEntry* entry)
+/**
+ * \brief Removes the entry from its bucket and from the recently used entries.
+ * \param entry Entry.
+ **/
+{
+    MathCompileCacheEntry** link = &m_buckets[entry->Hash & (m_countBuckets-1)];
+    while (*link != entry)
+    {
+        link = &(*link)->Next;
+    }
+    *link = entry->Next;
+    entry->Next = NULL;
+
+    if (entry->Newer != NULL) entry->Newer->Older = entry->Older;
+    else m_newest = entry->Older;
+    if (entry->Older != NULL) entry->Older->Newer = entry->Newer;
+    else m_oldest = entry->Newer;
+    entry->Newer = NULL;
+    entry->Older = NULL;
+    entry->Cached = false;
+    m_count--;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompileCache::Retire(MathCompileCacheEntry* entry)
+/**
+ * \brief Deletes an unlinked entry or keeps it in the retired entries, until
+ * the program is released.
+ * \param entry Entry.
+ **/
+{
+    if (entry->References == 0)
+    {
+        delete entry->Program;
+        delete entry;
+        return;
+    }
+    entry->Newer = NULL;
+    entry->Older = m_retired;
+    if (m_retired != NULL) m_retired->Newer = entry;
+    m_retired = entry;
+}
+
+
+} // namespace rush
+
+
@@ -0,0 +1,533 @@
+/*
+ * mathcompiler.cpp - Implementation of the MathCompiler class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#include "mathcompiler.h"
+#include "matharray.h"
+#include "mathsymboltable.h"
+#include <rush/parser.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+static double ParseConstant(const MathToken* token)
+/**
+ * \brief Parses the value of a constant token without creating a string.
+ * \param token Constant token.
+ * \return Value of the constant.
+ **/
+{
+    Char buffer[64];
+    if (token->GetLength() >= 64)
+    {
+        return (Parser::ParseDouble(token->GetContent()));
+    }
+    memcpy(buffer, token->GetText(), token->GetLength()*sizeof(Char));
+    buffer[token->GetLength()] = 0;
+    #ifdef _RUSH_UNICODE_
+    return (wcstod(buffer, NULL));
+    #else
+    return (strtod(buffer, NULL));
+    #endif
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+MathCompiler::MathCompiler(MathEvaluation* evaluation)
+/**
+ * \brief Constructor, initializes the MathCompiler object.
+ * \param evaluation Evaluation, which provides the variables and functions
+ * and receives the errors. New variables are added to the evaluation.
+ **/
+{
+    m_evaluation = evaluation;
+    m_errors = evaluation->m_errors;
+    m_operators = NULL;
+    m_countOperators = 0;
+    m_code = NULL;
+    m_countCode = 0;
+    m_assignment = -1;
+    m_previous = NULL;
+    m_expectOperand = true;
+}
+
+
+//-----------------------------------------------------------------------------
+MathCompiler::~MathCompiler()
+/**
+ * \brief Destructor, frees allocated memory.
+ **/
+{
+    if (m_operators != NULL) delete [] m_operators;
+    if (m_code != NULL) delete [] m_code;
+}
+
+
+//-----------------------------------------------------------------------------
+MathInstruction* MathCompiler::Compile(const MathToken* tokens, size_t count, size_t* newCount)
+/**
+ * \brief Compiles the tokens of one or more statements. Compiling stops at
+ * the first error.
+ * \param tokens Tokens, followed by a token of type None.
+ * \param count Number of tokens.
+ * \param newCount Receives the number of instructions.
+ * \return The instructions, which must be deleted by the caller or NULL, if
+ * the statements contain errors.
+ **/
+{
+    // A token creates at most one instruction or operator per character,
+    // so the operator stack and the code never have to grow.
+    size_t capacity = 1;
+    for (size_t i=0; i<count; ++i)
+    {
+        capacity += (tokens[i].GetLength() > 1 ? tokens[i].GetLength() : 1);
+    }
+    m_operators = new MathCompilerOperator[capacity];
+    m_countOperators = 0;
+    m_code = new MathInstruction[capacity];
+    m_countCode = 0;
+    m_assignment = -1;
+    m_previous = NULL;
+    m_expectOperand = true;
+
+    for (size_t i=0; i<count; ++i)
+    {
+        const MathToken* token = &tokens[i];
+        size_t reduction = (token->GetType() == MathTokenType::Function ? this->CompileReduction(token, count-i) : 0);
+        if (reduction > 0)
+        {
+            i += reduction-1;
+            m_previous = &tokens[i];
+            continue;
+        }
+        if (!this->CompileToken(token))
+        {
+            return (NULL);
+        }
+
+        // The bracket after the function name is part of the call
+        if (token->GetType() == MathTokenType::Function)
+        {
+            i += 1;
+            token = &tokens[i];
+        }
+        m_previous = token;
+    }
+    if (!this->EndStatement())
+    {
+        return (NULL);
+    }
+
+    MathInstruction* code = m_code;
+    *newCount = m_countCode;
+    m_code = NULL;
+    return (code);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathCompiler::CompileToken(const MathToken* token)
+/**
+ * \brief Compiles a single token.
+ * \param token Token.
+ * \return True, if the token was expected; otherwise false.
+ **/
+{
+    MathTokenType type = token->GetType();
+    if (type == MathTokenType::Assignment)
+    {
+        if (m_assignment >= 0 || !m_expectOperand || m_countOperators > 0 ||
+            (m_previous != NULL && m_previous->GetType() != MathTokenType::EndStatement))
+        {
+            m_errors->Add(String::Format(_T("Unexpected assignment '%s'."), token->GetContent().c_str()));
+            return (false);
+        }
+        m_assignment = m_evaluation->GetVariableIndex(token);
+        return (true);
+    }
+    else if (type == MathTokenType::Operator)
+    {
+        return (this->CompileOperator(token));
+    }
+    else if (type == MathTokenType::Comma)
+    {
+        if (m_expectOperand)
+        {
+            m_errors->Add(_T("Operand expected before ','."));
+            return (false);
+        }
+        this->Resolve(1);
+        if (m_countOperators == 0 || m_operators[m_countOperators-1].Instruction.Type != MathOpcodeType::CallFunction)
+        {
+            m_errors->Add(_T("Unexpected comma."));
+            return (false);
+        }
+        m_operators[m_countOperators-1].Args += 1;
+        m_expectOperand = true;
+        return (true);
+    }
+    else if (type == MathTokenType::Bracket && token->Equals(_T(")")))
+    {
+        return (this->CloseBracket());
+    }
+    else if (type == MathTokenType::EndStatement)
+    {
+        return (this->EndStatement());
+    }
+
+    // All other tokens start an operand
+    if (!m_expectOperand)
+    {
+        m_errors->Add(String::Format(_T("Operator expected before '%s'."), token->GetContent().c_str()));
+        return (false);
+    }
+    if (type == MathTokenType::Constant)
+    {
+        MathInstruction instruction;
+        instruction.Type = MathOpcodeType::LoadConstant;
+        instruction.Value = ParseConstant(token);
+        this->Emit(instruction);
+        m_expectOperand = false;
+    }
+    else if (type == MathTokenType::Variable)
+    {
+        int index = m_evaluation->GetVariableIndex(token);
+        if (index < 0)
+        {
+            m_errors->Add(String::Format(_T("Unknown variable name '%s'."), token->GetContent().c_str()));
+            return (false);
+        }
+        MathInstruction instruction;
+        instruction.Type = MathOpcodeType::LoadVariable;
+        instruction.Index = index;
+        this->Emit(instruction);
+        m_expectOperand = false;
+    }
+    else if (type == MathTokenType::Function)
+    {
+        int index = m_evaluation->GetFunctionIndex(token->GetText(), token->GetLength());
+        if (index < 0)
+        {
+            m_errors->Add(String::Format(_T("Unknown function name '%s'."), token->GetContent().c_str()));
+            return (false);
+        }
+        const MathToken* bracket = token + 1;
+        if (bracket->GetType() != MathTokenType::Bracket || !bracket->Equals(_T("(")))
+        {
+            m_errors->Add(_T("Bracket open expected after function name."));
+            return (false);
+        }
+        this->Push(MathOpcodeType::CallFunction, 0, index, token);
+    }
+    else if (type == MathTokenType::Bracket)
+    {
+        this->Push(MathOpcodeType::Nop, 0, 0, token);
+    }
+    else
+    {
+        m_errors->Add(_T("Internal error: Unexpected token type."));
+        return (false);
+    }
+    return (true);
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathCompiler::CompileReduction(const MathToken* token, size_t count)
+/**
+ * \brief Compiles a reduction of arrays (sum(a), mean(a), min(a), max(a) or
+ * dot(a, b)) into a load of the variable, which receives its result. Calls
+ * with other arguments than array names are compiled as function calls.
+ * \param token Function token.
+ * \param count Number of tokens from the function token to the end.
+ * \return Number of compiled tokens or zero, if the call is no reduction.
+ **/
+{
+    MathReductionType type = MathReductionType::Sum;
+    size_t args = 1;
+    if (token->Equals(_T("sum"))) {
+        type = MathReductionType::Sum;
+    } else if (token->Equals(_T("mean"))) {
+        type = MathReductionType::Mean;
+    } else if (token->Equals(_T("min"))) {
+        type = MathReductionType::Min;
+    } else if (token->Equals(_T("max"))) {
+        type = MathReductionType::Max;
+    } else if (token->Equals(_T("dot"))) {
+        type = MathReductionType::Dot;
+        args = 2;
+    } else {
+        return (0);
+    }
+
+    // The arguments are array names separated by commas: name ( a , b )
+    size_t length = 2*args + 2;
+    if (!m_expectOperand || count < length || token[1].GetType() != MathTokenType::Bracket ||
+        !token[1].Equals(_T("(")))
+    {
+        return (0);
+    }
+    int arrays[2] = { -1, -1 };
+    for (size_t a=0; a<args; ++a)
+    {
+        const MathToken* name = &token[2 + 2*a];
+        const MathToken* separator = &token[3 + 2*a];
+        if (name->GetType() != MathTokenType::Variable)
+        {
+            return (0);
+        }
+        arrays[a] = m_evaluation->m_arrayNames->Find(name->GetText(), name->GetLength());
+        bool last = (a+1 == args);
+        if (arrays[a] < 0 || separator->GetType() != (last ? MathTokenType::Bracket : MathTokenType::Comma) ||
+            (last && !separator->Equals(_T(")"))))
+        {
+            return (0);
+        }
+    }
+
+    MathInstruction instruction;
+    instruction.Type = MathOpcodeType::LoadVariable;
+    instruction.Index = m_evaluation->AddReduction(type, arrays[0], arrays[1] >= 0 ? arrays[1] : arrays[0]);
+    this->Emit(instruction);
+    m_expectOperand = false;
+    return (length);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathCompiler::CompileOperator(const MathToken* token)
+/**
+ * \brief Compiles an operator token. The first character is a binary operator,
+ * if an operand is in front of the token. All other characters are unary
+ * operators (e.g. "*-" or "--"). The comparisons "<=", ">=", "==" and "!="
+ * are binary operators with two characters.
+ * \param token Operator token.
+ * \return True, if the operator is valid; otherwise false.
+ **/
+{
+    if (m_expectOperand)
+    {
+        return (this->CompileUnary(token, 0));
+    }
+
+    MathOpcodeType type = MathOpcodeType::Nop;
+    int priority = 0;
+    size_t length = 1;
+    const Char* text = token->GetText();
+    Char first = (token->GetLength() > 0 ? text[0] : 0);
+    bool equal = (token->GetLength() > 1 && text[1] == '=');
+    if (first == '+') {
+        type = MathOpcodeType::Add;
+        priority = 2;
+    } else if (first == '-') {
+        type = MathOpcodeType::Sub;
+        priority = 2;
+    } else if (first == '*') {
+        type = MathOpcodeType::Mul;
+        priority = 3;
+    } else if (first == '/') {
+        type = MathOpcodeType::Div;
+        priority = 3;
+    } else if (first == '<') {
+        type = (equal ? MathOpcodeType::LessEqual : MathOpcodeType::Less);
+        priority = 1;
+    } else if (first == '>') {
+        type = (equal ? MathOpcodeType::GreaterEqual : MathOpcodeType::Greater);
+        priority = 1;
+    } else if (first == '=' && equal) {
+        type = MathOpcodeType::Equal;
+        priority = 1;
+    } else if (first == '!' && equal) {
+        type = MathOpcodeType::NotEqual;
+        priority = 1;
+    } else {
+        m_errors->Add(String::Format(_T("Unknown operator '%s'."), token->GetContent().c_str()));
+        return (false);
+    }
+    if (MathOpcode::IsComparison(type) && equal)
+    {
+        length = 2;
+    }
+
+    // Operators with the same priority are resolved first (left associative)
+    this->Resolve(priority);
+    this->Push(type, priority, 0, token);
+    m_expectOperand = true;
+    return (this->CompileUnary(token, length));
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathCompiler::CompileUnary(const MathToken* token, size_t start)
+/**
+ * \brief Compiles the unary operators of an operator token. Every minus
+ * negates the following operand, a plus does nothing.
+ * \param token Operator token.
+ * \param start Index of the first unary operator in the token.
+ * \return True, if all characters are unary operators; otherwise false.
+ **/
+{
+    const Char* text = token->GetText();
+    for (size_t i=start; i<token->GetLength(); ++i)
+    {
+        if (text[i] == '-') {
+            this->Push(MathOpcodeType::Neg, 4, 0, token);
+        } else if (text[i] != '+') {
+            m_errors->Add(String::Format(_T("Unexpected operator '%s'."), token->GetContent().c_str()));
+            return (false);
+        }
+    }
+    return (true);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathCompiler::CloseBracket()
+/**
+ * \brief Resolves the operators up to the opening bracket. If the bracket
+ * belongs to a function, the number of arguments is checked and the
+ * function is called.
+ * \return True, if the bracket was expected; otherwise false.
+ **/
+{
+    bool empty = false;
+    if (m_expectOperand)
+    {
+        // Only functions can be called without an argument
+        const MathCompilerOperator* top = (m_countOperators > 0 ? &m_operators[m_countOperators-1] : NULL);
+        empty = (top != NULL && top->Instruction.Type == MathOpcodeType::CallFunction &&
+                 m_previous == top->Token + 1);
+        if (!empty)
+        {
+            m_errors->Add(_T("Operand expected before ')'."));
+            return (false);
+        }
+    }
+
+    this->Resolve(1);
+    if (m_countOperators == 0)
+    {
+        m_errors->Add(_T("Unexpected closing bracket."));
+        return (false);
+    }
+    MathCompilerOperator* bracket = &m_operators[--m_countOperators];
+    if (bracket->Instruction.Type == MathOpcodeType::CallFunction)
+    {
+        MathFunction* function = m_evaluation->m_functions->Item(bracket->Instruction.Index);
+        size_t args = (empty ? 0 : bracket->Args + 1);
+        if (args != function->GetArgs())
+        {
+            m_errors->Add(String::Format(_T("Wrong number of arguments for function '%s'."),
+                                         function->GetName().c_str()));
+            return (false);
+        }
+        this->Emit(bracket->Instruction);
+    }
+    m_expectOperand = false;
+    return (true);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathCompiler::EndStatement()
+/**
+ * \brief Resolves all operators of the statement and saves the result into
+ * the assigned variable. Empty statements are ignored.
+ * \return True, if the statement is complete; otherwise false.
+ **/
+{
+    if (m_expectOperand)
+    {
+        bool empty = (m_assignment < 0 && m_countOperators == 0 &&
+                      (m_previous == NULL || m_previous->GetType() == MathTokenType::EndStatement));
+        if (empty)
+        {
+            return (true);
+        }
+        m_errors->Add(_T("Operand expected at the end of the statement."));
+        return (false);
+    }
+
+    this->Resolve(1);
+    if (m_countOperators > 0)
+    {
+        m_errors->Add(_T("Closing bracket is missing."));
+        return (false);
+    }
+    if (m_assignment >= 0)
+    {
+        MathInstruction instruction;
+        instruction.Type = MathOpcodeType::SaveVariable;
+        instruction.Index = m_assignment;
+        this->Emit(instruction);
+    }
+    m_assignment = -1;
+    m_expectOperand = true;
+    return (true);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompiler::Emit(const MathInstruction& instruction)
+/**
+ * \brief Appends an instruction to the code.
+ * \param instruction Instruction.
+ **/
+{
+    m_code[m_countCode++] = instruction;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompiler::Push(MathOpcodeType type, int priority, size_t index, const MathToken* token)
+/**
+ * \brief Pushes an operator, bracket or function call onto the operator stack.
+ * \param type Type of the instruction, which is emitted for the operator.
+ * \param priority Priority of the operator (0 for brackets and functions).
+ * \param index Function index.
+ * \param token Token of the operator.
+ **/
+{
+    MathCompilerOperator* entry = &m_operators[m_countOperators++];
+    entry->Instruction.Type = type;
+    entry->Instruction.Index = index;
+    entry->Priority = priority;
+    entry->Args = 0;
+    entry->Token = token;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathCompiler::Resolve(int priority)
+/**
+ * \brief Emits all operators on top of the stack with at least the given
+ * priority. Brackets and functions stop resolving.
+ * \param priority Minimum priority (1 to resolve all operators).
+ **/
+{
+    while (m_countOperators > 0)
+    {
+        const MathCompilerOperator& entry = m_operators[m_countOperators-1];
+        if (entry.Priority == 0 || entry.Priority < priority)
+        {
+            break;
+        }
+        this->Emit(entry.Instruction);
+        m_countOperators--;
+    }
+}
+
+
+} // namespace rush
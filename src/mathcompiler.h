@@ -0,0 +1,87 @@
+/*
+ * mathcompiler.h - Declaration of the MathCompiler class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHCOMPILER_H_
+#define _RUSH_MATHCOMPILER_H_
+
+
+#include <rush/mathevaluation.h>
+
+
+namespace rush {
+
+
+/**
+ * \brief The MathCompilerOperator struct is one entry of the operator stack
+ * of the MathCompiler. Brackets and function calls are entries without a
+ * priority, they are never removed by an operator.
+ **/
+struct MathCompilerOperator
+{
+    /// \brief Instruction, which is emitted when the operator is resolved.
+    MathInstruction Instruction;
+    /// \brief Priority of the operator (0 for brackets and functions).
+    int Priority;
+    /// \brief Number of completed arguments of a function call.
+    size_t Args;
+    /// \brief Token of the operator, bracket or function.
+    const MathToken* Token;
+};
+
+
+/**
+ * \brief The MathCompiler class translates the tokens of the MathTokenizer
+ * into flat instructions for the MathEvaluation. The tokens are read once
+ * from left to right (shunting-yard algorithm): operands are emitted at
+ * once, operators wait on a stack until an operator with a lower or the same
+ * priority, a closing bracket, a comma or the end of the statement follows.
+ * The priorities are Comparisons < Add/Sub < Mul/Div < Neg, all binary
+ * operators are left associative.
+ * Reductions of arrays (e.g. sum(a)) are compiled into loads of variables,
+ * which receive their results before the code is executed.
+ * The operator stack and the emitted code are allocated once per compile
+ * with a size calculated from the tokens, so compiling takes linear time
+ * and does not allocate per token.
+ **/
+class MathCompiler
+{
+    public:
+        MathCompiler(MathEvaluation* evaluation);
+        ~MathCompiler();
+
+        MathInstruction* Compile(const MathToken* tokens, size_t count, size_t* newCount);
+
+    private:
+        bool CompileToken(const MathToken* token);
+        size_t CompileReduction(const MathToken* token, size_t count);
+        bool CompileOperator(const MathToken* token);
+        bool CompileUnary(const MathToken* token, size_t start);
+        bool CloseBracket();
+        bool EndStatement();
+        void Emit(const MathInstruction& instruction);
+        void Push(MathOpcodeType type, int priority, size_t index, const MathToken* token);
+        void Resolve(int priority);
+
+    private:
+        MathEvaluation* m_evaluation;
+        StringArray* m_errors;
+        MathCompilerOperator* m_operators;
+        size_t m_countOperators;
+        MathInstruction* m_code;
+        size_t m_countCode;
+        int m_assignment;
+        const MathToken* m_previous;
+        bool m_expectOperand;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHCOMPILER_H_
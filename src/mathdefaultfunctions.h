@@ -21,7 +21,7 @@ namespace rush {
 class MathPiFunction : public MathFunction
 {
     public:
-        MathPiFunction() : MathFunction(_T("pi"), 0) {}
+        MathPiFunction() : MathFunction(_T("pi"), 0, true) {}
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -32,11 +32,14 @@ class MathPiFunction : public MathFunction
 class MathAbsFunction : public MathFunction
 {
     public:
-        MathAbsFunction() : MathFunction(_T("abs"), 1) {}
+        MathAbsFunction() : MathFunction(_T("abs"), 1, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Abs); }
 
         virtual double Evaluate(double* values, size_t num)
         {
-            return (values[0] < 0 ? -values[0] : values[0]);
+            return (fabs(values[0]));
         }
 };
 
@@ -44,7 +47,10 @@ class MathAbsFunction : public MathFunction
 class MathExpFunction : public MathFunction
 {
     public:
-        MathExpFunction() : MathFunction(_T("exp"), 1) {}
+        MathExpFunction() : MathFunction(_T("exp"), 1, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Exp); }
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -57,7 +63,10 @@ class MathExpFunction : public MathFunction
 class MathPowFunction : public MathFunction
 {
     public:
-        MathPowFunction() : MathFunction(_T("pow"), 2) {}
+        MathPowFunction() : MathFunction(_T("pow"), 2, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Pow); }
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -70,7 +79,10 @@ class MathPowFunction : public MathFunction
 class MathSqrtFunction : public MathFunction
 {
     public:
-        MathSqrtFunction() : MathFunction(_T("sqrt"), 1) {}
+        MathSqrtFunction() : MathFunction(_T("sqrt"), 1, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Sqrt); }
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -82,7 +94,7 @@ class MathSqrtFunction : public MathFunction
 class MathRootFunction : public MathFunction
 {
     public:
-        MathRootFunction() : MathFunction(_T("root"), 2) {}
+        MathRootFunction() : MathFunction(_T("root"), 2, true) {}
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -95,7 +107,10 @@ class MathRootFunction : public MathFunction
 class MathLnFunction : public MathFunction
 {
     public:
-        MathLnFunction() : MathFunction(_T("ln"), 1) {}
+        MathLnFunction() : MathFunction(_T("ln"), 1, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Ln); }
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -108,7 +123,10 @@ class MathLnFunction : public MathFunction
 class MathLog10Function : public MathFunction
 {
     public:
-        MathLog10Function() : MathFunction(_T("log10"), 1) {}
+        MathLog10Function() : MathFunction(_T("log10"), 1, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Log10); }
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -120,7 +138,7 @@ class MathLog10Function : public MathFunction
 class MathLogFunction : public MathFunction
 {
     public:
-        MathLogFunction() : MathFunction(_T("log"), 2) {}
+        MathLogFunction() : MathFunction(_T("log"), 2, true) {}
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -132,7 +150,7 @@ class MathLogFunction : public MathFunction
 class MathFactFunction : public MathFunction
 {
     public:
-        MathFactFunction() : MathFunction(_T("fact"), 1) {}
+        MathFactFunction() : MathFunction(_T("fact"), 1, true) {}
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -153,7 +171,10 @@ class MathFactFunction : public MathFunction
 class MathModFunction : public MathFunction
 {
     public:
-        MathModFunction() : MathFunction(_T("mod"), 2) {}
+        MathModFunction() : MathFunction(_T("mod"), 2, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Mod); }
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -165,7 +186,10 @@ class MathModFunction : public MathFunction
 class MathCeilFunction : public MathFunction
 {
     public:
-        MathCeilFunction() : MathFunction(_T("ceil"), 1) {}
+        MathCeilFunction() : MathFunction(_T("ceil"), 1, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Ceil); }
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -177,7 +201,10 @@ class MathCeilFunction : public MathFunction
 class MathFloorFunction : public MathFunction
 {
     public:
-        MathFloorFunction() : MathFunction(_T("floor"), 1) {}
+        MathFloorFunction() : MathFunction(_T("floor"), 1, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Floor); }
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -191,7 +218,7 @@ class MathFloorFunction : public MathFunction
 class MathFracFunction : public MathFunction
 {
     public:
-        MathFracFunction() : MathFunction(_T("frac"), 1) {}
+        MathFracFunction() : MathFunction(_T("frac"), 1, true) {}
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -205,7 +232,7 @@ class MathFracFunction : public MathFunction
 class MathIntFunction : public MathFunction
 {
     public:
-        MathIntFunction() : MathFunction(_T("int"), 1) {}
+        MathIntFunction() : MathFunction(_T("int"), 1, true) {}
 
         virtual double Evaluate(double* values, size_t num)
         {
@@ -220,7 +247,10 @@ class MathIntFunction : public MathFunction
 class MathSinFunction : public MathFunction
 {
     public:
-        MathSinFunction() : MathFunction(_T("sin"), 1) {}
+        MathSinFunction() : MathFunction(_T("sin"), 1, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Sin); }
 
         virtual double Evaluate(double* values, size_t num)
         { return (sin(values[0])); }
@@ -230,7 +260,10 @@ class MathSinFunction : public MathFunction
 class MathCosFunction : public MathFunction
 {
     public:
-        MathCosFunction() : MathFunction(_T("cos"), 1) {}
+        MathCosFunction() : MathFunction(_T("cos"), 1, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Cos); }
 
         virtual double Evaluate(double* values, size_t num)
         { return (cos(values[0])); }
@@ -241,13 +274,29 @@ class MathCosFunction : public MathFunction
 class MathTanFunction : public MathFunction
 {
     public:
-        MathTanFunction() : MathFunction(_T("tan"), 1) {}
+        MathTanFunction() : MathFunction(_T("tan"), 1, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Tan); }
 
         virtual double Evaluate(double* values, size_t num)
         { return (tan(values[0])); }
 };
 
 
+class MathSelectFunction : public MathFunction
+{
+    public:
+        MathSelectFunction() : MathFunction(_T("select"), 3, true) {}
+
+        virtual MathOpcodeType GetOpcode() const
+        { return (MathOpcodeType::Select); }
+
+        virtual double Evaluate(double* values, size_t num)
+        { return (values[0] != 0.0d ? values[1] : values[2]); }
+};
+
+
 
 
 } // namespace rush
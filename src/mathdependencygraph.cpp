@@ -0,0 +1,333 @@
+/*
+ * mathdependencygraph.cpp - Implementation of the MathDependencyGraph class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#include "mathdependencygraph.h"
+#include <string.h>
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+MathDependencyGraph::MathDependencyGraph(const MathProgram* program)
+/**
+ * \brief Constructor, splits the code of the program into statements and
+ * collects the dependencies between them.
+ * \param program Program, must not be deleted before the graph.
+ **/
+{
+    m_program = program;
+    m_countVariables = program->GetVariableCount();
+    m_countTemporaries = program->m_countTemporaries;
+    m_valid = false;
+    m_executed = 0;
+
+    // Split the code after every assignment, code after the last one is a statement as well
+    size_t countCode = program->m_codeCount;
+    const MathInstruction* code = program->m_code;
+    m_countStatements = 0;
+    for (size_t i=0; i<countCode; ++i)
+    {
+        if (code[i].Type == MathOpcodeType::SaveVariable || i+1 == countCode) m_countStatements++;
+    }
+    size_t statements = (m_countStatements > 0 ? m_countStatements : 1);
+    m_first = new size_t[statements];
+    m_count = new size_t[statements];
+    m_writes = new size_t[statements];
+    m_volatile = new bool[statements];
+    m_dirty = new bool[statements];
+
+    // Collect the pairs of variables or temporary values and the statements using them
+    size_t pairs = (countCode > 0 ? countCode : 1);
+    size_t* readKeys = new size_t[pairs];
+    size_t* readStatements = new size_t[pairs];
+    size_t* writeKeys = new size_t[pairs];
+    size_t* writeStatements = new size_t[pairs];
+    size_t* loadKeys = new size_t[pairs];
+    size_t* loadStatements = new size_t[pairs];
+    size_t* storeStatements = new size_t[pairs];
+    size_t* storeKeys = new size_t[pairs];
+    size_t countReads = 0;
+    size_t countWrites = 0;
+    size_t countLoads = 0;
+    size_t countStores = 0;
+    size_t statement = 0;
+    m_first[0] = 0;
+    m_writes[0] = (size_t)-1;
+    m_volatile[0] = false;
+    for (size_t i=0; i<countCode; ++i)
+    {
+        const MathInstruction& instruction = code[i];
+        if (instruction.Type == MathOpcodeType::LoadVariable) {
+            readKeys[countReads] = instruction.Index;
+            readStatements[countReads++] = statement;
+        } else if (instruction.Type == MathOpcodeType::SaveVariable) {
+            writeKeys[countWrites] = instruction.Index;
+            writeStatements[countWrites++] = statement;
+            m_writes[statement] = instruction.Index;
+        } else if (instruction.Type == MathOpcodeType::LoadTemporary) {
+            loadKeys[countLoads] = instruction.Index;
+            loadStatements[countLoads++] = statement;
+        } else if (instruction.Type == MathOpcodeType::StoreTemporary) {
+            storeStatements[countStores] = statement;
+            storeKeys[countStores++] = instruction.Index;
+        } else if (instruction.Type == MathOpcodeType::CallFunction) {
+            if (!program->m_functions[instruction.Index]->IsPure()) m_volatile[statement] = true;
+        }
+
+        // Close the statement
+        if (instruction.Type == MathOpcodeType::SaveVariable || i+1 == countCode)
+        {
+            m_count[statement] = i+1 - m_first[statement];
+            if (m_writes[statement] == (size_t)-1) m_volatile[statement] = true;
+            if (++statement < m_countStatements)
+            {
+                m_first[statement] = i+1;
+                m_writes[statement] = (size_t)-1;
+                m_volatile[statement] = false;
+            }
+        }
+    }
+    m_readers = this->CreateLists(readKeys, readStatements, countReads, m_countVariables, &m_readerStarts);
+    m_writers = this->CreateLists(writeKeys, writeStatements, countWrites, m_countVariables, &m_writerStarts);
+    m_loaders = this->CreateLists(loadKeys, loadStatements, countLoads, m_countTemporaries, &m_loaderStarts);
+    m_stores = this->CreateLists(storeStatements, storeKeys, countStores, m_countStatements, &m_storeStarts);
+    delete [] readKeys;
+    delete [] readStatements;
+    delete [] writeKeys;
+    delete [] writeStatements;
+    delete [] loadKeys;
+    delete [] loadStatements;
+    delete [] storeStatements;
+    delete [] storeKeys;
+
+    // Variables with several assignments or a read before the assignment depend on the position
+    for (size_t v=0; v<m_countVariables; ++v)
+    {
+        size_t writers = m_writerStarts[v+1] - m_writerStarts[v];
+        if (writers == 0) continue;
+        bool positional = (writers > 1);
+        if (m_readerStarts[v+1] > m_readerStarts[v] && m_readers[m_readerStarts[v]] <= m_writers[m_writerStarts[v]])
+        {
+            positional = true;
+        }
+        if (!positional) continue;
+        for (size_t i=m_readerStarts[v]; i<m_readerStarts[v+1]; ++i)
+        {
+            m_volatile[m_readers[i]] = true;
+        }
+        for (size_t i=m_writerStarts[v]; i<m_writerStarts[v+1]; ++i)
+        {
+            m_volatile[m_writers[i]] = true;
+        }
+    }
+
+    m_snapshot = new double[m_countVariables > 0 ? m_countVariables : 1];
+    m_temporaries = new double[m_countTemporaries > 0 ? m_countTemporaries : 1];
+}
+
+
+//-----------------------------------------------------------------------------
+MathDependencyGraph::~MathDependencyGraph()
+/**
+ * \brief Destructor, frees allocated memory.
+ **/
+{
+    delete [] m_first;
+    delete [] m_count;
+    delete [] m_writes;
+    delete [] m_volatile;
+    delete [] m_dirty;
+    delete [] m_readerStarts;
+    delete [] m_readers;
+    delete [] m_writerStarts;
+    delete [] m_writers;
+    delete [] m_loaderStarts;
+    delete [] m_loaders;
+    delete [] m_storeStarts;
+    delete [] m_stores;
+    delete [] m_snapshot;
+    delete [] m_temporaries;
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathDependencyGraph::Execute(double* values, double* stack, StringArray* errors)
+/**
+ * \brief Executes the statements, which are affected by the variables changed
+ * since the last execution. The first execution and the first execution after
+ * Invalidate() execute all statements.
+ * \param values Variable values, at least GetVariableCount() values of the program.
+ * \param stack Stack of the program, keeps the temporary values between the executions.
+ * \param errors Receives the errors.
+ * \return True, if executed without errors; otherwise false.
+ **/
+{
+    m_executed = 0;
+    if (!m_valid)
+    {
+        for (size_t s=0; s<m_countStatements; ++s)
+        {
+            m_dirty[s] = true;
+        }
+    }
+    else
+    {
+        // Variables changed from outside execute their readers and their assignments
+        for (size_t v=0; v<m_countVariables; ++v)
+        {
+            if (likely(IsSame(values[v], m_snapshot[v]))) continue;
+            for (size_t i=m_readerStarts[v]; i<m_readerStarts[v+1]; ++i)
+            {
+                m_dirty[m_readers[i]] = true;
+            }
+            for (size_t i=m_writerStarts[v]; i<m_writerStarts[v+1]; ++i)
+            {
+                m_dirty[m_writers[i]] = true;
+            }
+        }
+    }
+
+    for (size_t s=0; s<m_countStatements; ++s)
+    {
+        if (!m_dirty[s] && !m_volatile[s]) continue;
+        m_dirty[s] = false;
+
+        // Keep the old results, only changed results execute the dependent statements
+        size_t variable = m_writes[s];
+        double old = (variable != (size_t)-1 ? values[variable] : 0.0d);
+        for (size_t i=m_storeStarts[s]; i<m_storeStarts[s+1]; ++i)
+        {
+            m_temporaries[m_stores[i]] = stack[m_stores[i]];
+        }
+        if (!m_program->ExecuteRange(m_first[s], m_count[s], values, stack, errors))
+        {
+            m_valid = false;
+            return (false);
+        }
+        m_executed++;
+        if (variable != (size_t)-1 && (!m_valid || !IsSame(values[variable], old)))
+        {
+            this->MarkAfter(m_readerStarts, m_readers, variable, s);
+        }
+        for (size_t i=m_storeStarts[s]; i<m_storeStarts[s+1]; ++i)
+        {
+            size_t temporary = m_stores[i];
+            if (!m_valid || !IsSame(stack[temporary], m_temporaries[temporary]))
+            {
+                this->MarkAfter(m_loaderStarts, m_loaders, temporary, s);
+            }
+        }
+    }
+    memcpy(m_snapshot, values, m_countVariables*sizeof(double));
+    m_valid = true;
+    return (true);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathDependencyGraph::Invalidate()
+/**
+ * \brief Executes all statements by the next call of Execute(), e.g. after
+ * the variables or the temporary values were changed by other code.
+ **/
+{
+    m_valid = false;
+}
+
+
+//-----------------------------------------------------------------------------
+size_t* MathDependencyGraph::CreateLists(const size_t* keys, const size_t* statements, size_t count,
+                                         size_t countKeys, size_t** starts)
+/**
+ * \brief Groups pairs of keys and values by their key. The values of one key
+ * keep their order and duplicates in a row are removed.
+ * \param keys Keys of the pairs (e.g. variable index).
+ * \param statements Values of the pairs (e.g. statement index), sorted ascending per key.
+ * \param count Number of pairs.
+ * \param countKeys Number of keys, all keys are lower.
+ * \param starts Receives the start of the values per key, the values of key k
+ * are at starts[k] to starts[k+1]-1 (countKeys+1 entries).
+ * \return Values.
+ **/
+{
+    size_t* result = new size_t[count > 0 ? count : 1];
+    size_t* offsets = new size_t[countKeys+1];
+    for (size_t k=0; k<=countKeys; ++k)
+    {
+        offsets[k] = 0;
+    }
+    for (size_t i=0; i<count; ++i)
+    {
+        offsets[keys[i]+1]++;
+    }
+    for (size_t k=0; k<countKeys; ++k)
+    {
+        offsets[k+1] += offsets[k];
+    }
+
+    // Fill the lists and compact them without duplicates
+    size_t* fill = new size_t[countKeys > 0 ? countKeys : 1];
+    memcpy(fill, offsets, countKeys*sizeof(size_t));
+    for (size_t i=0; i<count; ++i)
+    {
+        size_t key = keys[i];
+        if (fill[key] > offsets[key] && result[fill[key]-1] == statements[i]) continue;
+        result[fill[key]++] = statements[i];
+    }
+    size_t position = 0;
+    *starts = new size_t[countKeys+1];
+    for (size_t k=0; k<countKeys; ++k)
+    {
+        (*starts)[k] = position;
+        for (size_t i=offsets[k]; i<fill[k]; ++i)
+        {
+            result[position++] = result[i];
+        }
+    }
+    (*starts)[countKeys] = position;
+    delete [] fill;
+    delete [] offsets;
+    return (result);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathDependencyGraph::MarkAfter(const size_t* starts, const size_t* list, size_t key, size_t statement)
+/**
+ * \brief Marks the statements of a key behind the given statement for execution.
+ * \param starts Start of the statements per key.
+ * \param list Statements.
+ * \param key Index of the variable or temporary value.
+ * \param statement Index of the executed statement.
+ **/
+{
+    for (size_t i=starts[key]; i<starts[key+1]; ++i)
+    {
+        if (list[i] > statement) m_dirty[list[i]] = true;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathDependencyGraph::IsSame(double a, double b)
+/**
+ * \brief Compares the bits of two values, so NaN is the same as NaN and
+ * 0.0 is not the same as -0.0.
+ * \param a First value.
+ * \param b Second value.
+ * \return True, if the values are the same; otherwise false.
+ **/
+{
+    return (memcmp(&a, &b, sizeof(double)) == 0);
+}
+
+
+} // namespace rush
@@ -0,0 +1,100 @@
+/*
+ * mathdependencygraph.h - Declaration of the MathDependencyGraph class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHDEPENDENCYGRAPH_H_
+#define _RUSH_MATHDEPENDENCYGRAPH_H_
+
+
+#include <rush/mathevaluation.h>
+
+
+namespace rush {
+
+
+/**
+ * \brief The MathDependencyGraph class re-executes only the statements of a
+ * program, which are affected by changed variables. The code is split into
+ * statements, every statement ends with the SaveVariable of its assignment.
+ * The graph knows which statements read and write each variable and which
+ * statements store and load each temporary value (common subexpression).
+ *
+ * A statement is executed, if a variable it reads was changed since the last
+ * execution. Variables, which were changed from outside, also execute the
+ * statements writing them, so computed variables are restored. The result of
+ * an executed statement is compared bitwise with the old value and only a
+ * changed value executes the statements reading it.
+ *
+ * Statements are always executed, if they call functions which are not pure,
+ * or if they read or write a variable with more than one assignment or with
+ * a read before its assignment (e.g. x = x+1), because the value of such a
+ * variable depends on the position in the code. So the variables are always
+ * the same as after executing the whole program.
+ **/
+class MathDependencyGraph
+{
+    public:
+        MathDependencyGraph(const MathProgram* program);
+        ~MathDependencyGraph();
+
+        bool Execute(double* values, double* stack, StringArray* errors);
+        void Invalidate();
+
+        /**
+         * \brief Returns the number of statements of the program.
+         * \return Number of statements.
+         **/
+        inline size_t GetStatementCount() const
+        { return (m_countStatements); }
+
+        /**
+         * \brief Returns the number of statements, which were executed by
+         * the last call of Execute().
+         * \return Number of statements.
+         **/
+        inline size_t GetExecutedCount() const
+        { return (m_executed); }
+
+    private:
+        MathDependencyGraph(const MathDependencyGraph& graph) {}
+        MathDependencyGraph& operator=(const MathDependencyGraph& graph) { return (*this); }
+
+        size_t* CreateLists(const size_t* keys, const size_t* statements, size_t count,
+                            size_t countKeys, size_t** starts);
+        void MarkAfter(const size_t* starts, const size_t* list, size_t key, size_t statement);
+        static bool IsSame(double a, double b);
+
+    private:
+        const MathProgram* m_program;
+        size_t m_countStatements;
+        size_t m_countVariables;
+        size_t m_countTemporaries;
+        size_t* m_first;
+        size_t* m_count;
+        size_t* m_writes;
+        bool* m_volatile;
+        bool* m_dirty;
+        size_t* m_readerStarts;
+        size_t* m_readers;
+        size_t* m_writerStarts;
+        size_t* m_writers;
+        size_t* m_loaderStarts;
+        size_t* m_loaders;
+        size_t* m_storeStarts;
+        size_t* m_stores;
+        double* m_snapshot;
+        double* m_temporaries;
+        bool m_valid;
+        size_t m_executed;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHDEPENDENCYGRAPH_H_
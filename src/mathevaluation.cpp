@@ -11,8 +11,20 @@
 #include <rush/console.h>
 #include <rush/parser.h>
 #include <rush/stack.h>
+#include <rush/system.h>
+#include "matharray.h"
+#include "mathbatch.h"
+#include "mathcompiler.h"
+#include "mathdependencygraph.h"
 #include "mathdefaultfunctions.h"
-#include "mathvariable.h"
+#include "mathimage.h"
+#include "mathjit.h"
+#include "mathkernels.h"
+#include "mathoptimizer.h"
+#include "mathpeephole.h"
+#include "mathstreamcompiler.h"
+#include "mathsymboltable.h"
+#include "mathverifier.h"
 
 
 namespace rush {
@@ -29,29 +41,54 @@ MathEvaluation::MathEvaluation()
  **/
 {
     m_functions = new ObjectArray<MathFunction>();
-    m_opcodes = new ObjectArray<MathOpcode>();
-    m_variables = new ObjectArray<MathVariable>();
+    m_functionNames = new MathSymbolTable();
+    m_retiredFunctions = new ObjectArray<MathFunction>();
+    m_variables = new MathSymbolTable();
+    m_valuesCapacity = 16;
+    m_values = new double[m_valuesCapacity];
+    m_bindings = new MathBinding[m_valuesCapacity];
+    m_countBindings = 0;
+    m_object = NULL;
+    m_arrayNames = new MathSymbolTable();
+    m_arrays = NULL;
+    m_arraysCapacity = 0;
+    m_reductions = NULL;
+    m_countReductions = 0;
+    m_reductionsCapacity = 0;
     m_errors = new StringArray();
+    m_code = NULL;
+    m_codeCount = 0;
+    m_stackDepth = 0;
+    m_countTemporaries = 0;
+    m_stack = new double[1];
+    m_program = NULL;
+    m_jitEnabled = false;
+    m_accuracy = MathAccuracy::Exact;
+    m_fusion = MathFusion::Superinstructions;
+    m_graph = NULL;
+    m_profile = NULL;
+    m_incremental = false;
 
     // Insert default functions
-    m_functions->Add(new MathPiFunction());
-    m_functions->Add(new MathAbsFunction());
-    m_functions->Add(new MathExpFunction());
-    m_functions->Add(new MathPowFunction());
-    m_functions->Add(new MathSqrtFunction());
-    m_functions->Add(new MathRootFunction());
-    m_functions->Add(new MathLnFunction());
-    m_functions->Add(new MathLog10Function());
-    m_functions->Add(new MathLogFunction());
-    m_functions->Add(new MathFactFunction());
-    m_functions->Add(new MathModFunction());
-    m_functions->Add(new MathCeilFunction());
-    m_functions->Add(new MathFloorFunction());
-    m_functions->Add(new MathFracFunction());
-    m_functions->Add(new MathIntFunction());
-    m_functions->Add(new MathSinFunction());
-    m_functions->Add(new MathCosFunction());
-    m_functions->Add(new MathTanFunction());
+    this->SetFunction(new MathPiFunction());
+    this->SetFunction(new MathAbsFunction());
+    this->SetFunction(new MathExpFunction());
+    this->SetFunction(new MathPowFunction());
+    this->SetFunction(new MathSqrtFunction());
+    this->SetFunction(new MathRootFunction());
+    this->SetFunction(new MathLnFunction());
+    this->SetFunction(new MathLog10Function());
+    this->SetFunction(new MathLogFunction());
+    this->SetFunction(new MathFactFunction());
+    this->SetFunction(new MathModFunction());
+    this->SetFunction(new MathCeilFunction());
+    this->SetFunction(new MathFloorFunction());
+    this->SetFunction(new MathFracFunction());
+    this->SetFunction(new MathIntFunction());
+    this->SetFunction(new MathSinFunction());
+    this->SetFunction(new MathCosFunction());
+    this->SetFunction(new MathTanFunction());
+    this->SetFunction(new MathSelectFunction());
 }
 
 
@@ -61,22 +98,70 @@ MathEvaluation::~MathEvaluation()
  * \brief Destructor, frees allocated memory
  **/
 {
+    if (m_graph != NULL)
+    {
+        delete m_graph;
+    }
+    if (m_profile != NULL)
+    {
+        delete m_profile;
+    }
+    if (m_program != NULL)
+    {
+        delete m_program;
+    }
     if (m_functions != NULL)
     {
         delete m_functions;
     }
-    if (m_opcodes != NULL)
+    if (m_functionNames != NULL)
+    {
+        delete m_functionNames;
+    }
+    if (m_retiredFunctions != NULL)
     {
-        delete m_opcodes;
+        delete m_retiredFunctions;
     }
     if (m_variables != NULL)
     {
         delete m_variables;
     }
+    if (m_values != NULL)
+    {
+        delete [] m_values;
+    }
+    if (m_bindings != NULL)
+    {
+        delete [] m_bindings;
+    }
+    if (m_arrays != NULL)
+    {
+        for (size_t i=0; i<m_arrayNames->Count(); ++i)
+        {
+            if (m_arrays[i].Owned != NULL) delete [] m_arrays[i].Owned;
+        }
+        delete [] m_arrays;
+    }
+    if (m_arrayNames != NULL)
+    {
+        delete m_arrayNames;
+    }
+    if (m_reductions != NULL)
+    {
+        delete [] m_reductions;
+    }
     if (m_errors != NULL)
     {
         delete m_errors;
     }
+    if (m_code != NULL)
+    {
+        delete [] m_code;
+    }
+    if (m_stack != NULL)
+    {
+        delete [] m_stack;
+    }
 }
 
 
@@ -85,32 +170,20 @@ void MathEvaluation::SetVariable(const String& name, double value)
 /**
  * \brief Sets the value of a variable in this instance. The variable
  * does not have to exist in the expression. The variable name is case-sensitive.
+ * The value of a bound variable is written into the bound memory.
  * \param name Variable name.
  * \param value Variable value.
  **/
 {
-    // Search for the variable
-    MathVariable* variable = NULL;
-    for (size_t i=0; i<m_variables->Count(); ++i)
-    {
-        if (m_variables->Item(i)->GetName() == name)
-        {
-            variable = m_variables->Item(i);
-            break;
-        }
-    }
-
-    if (variable == NULL)
+    int index = this->FindVariableIndex(name);
+    if (index < 0)
     {
         // Create the variable if it doesn't exist
-        variable = new MathVariable(name, value);
-        m_variables->Add(variable);
-    }
-    else
-    {
-        // Set the value
-        variable->SetValue(value);
+        index = this->AddVariable(name);
     }
+    double* bound = this->GetBoundValue(index);
+    if (unlikely(bound != NULL)) *bound = value;
+    m_values[index] = value;
 }
 
 
@@ -119,28 +192,77 @@ double MathEvaluation::GetVariable(const String& name) const
 /**
  * \brief Gets the value of a variable in this instance. An error is generated if
  * the requesting variable does not exist. The variable name is case-sensitive.
+ * The value of a bound variable is read from the bound memory.
  * \param name Variable name.
  * \return Variable value.
  **/
 {
     // Search for the variable
-    MathVariable* variable = NULL;
-    for (size_t i=0; i<m_variables->Count(); ++i)
-    {
-        if (m_variables->Item(i)->GetName() == name)
-        {
-            variable = m_variables->Item(i);
-            break;
-        }
-    }
+    int index = this->FindVariableIndex(name);
 
     // Handle undefined variable
-    if (variable == NULL)
+    if (index < 0)
     {
         m_errors->Add(String::Format(_T("Variable '%s' does not exist."), name.c_str()));
         return (0.0d);
     }
-    return (variable->GetValue());
+    double* bound = this->GetBoundValue(index);
+    return (unlikely(bound != NULL) ? *bound : m_values[index]);
+}
+
+
+//-----------------------------------------------------------------------------
+MathVariableHandle MathEvaluation::GetVariableHandle(const String& name)
+/**
+ * \brief Resolves the name of a variable into a handle, which can be used to
+ * set and get the variable without comparing strings. The variable is created,
+ * if it does not exist. The handle is valid until ClearVariables() is called.
+ * \param name Variable name.
+ * \return Variable handle.
+ **/
+{
+    MathVariableHandle handle;
+    handle.Index = this->GetVariableIndex(name);
+    return (handle);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::SetVariable(MathVariableHandle handle, double value)
+/**
+ * \brief Sets the value of a variable in this instance. An error is generated
+ * if the handle is invalid.
+ * \param handle Variable handle.
+ * \param value Variable value.
+ **/
+{
+    if (unlikely(handle.Index >= m_variables->Count()))
+    {
+        m_errors->Add(_T("Invalid variable handle."));
+        return;
+    }
+    double* bound = this->GetBoundValue(handle.Index);
+    if (unlikely(bound != NULL)) *bound = value;
+    m_values[handle.Index] = value;
+}
+
+
+//-----------------------------------------------------------------------------
+double MathEvaluation::GetVariable(MathVariableHandle handle) const
+/**
+ * \brief Gets the value of a variable in this instance. An error is generated
+ * if the handle is invalid.
+ * \param handle Variable handle.
+ * \return Variable value.
+ **/
+{
+    if (unlikely(handle.Index >= m_variables->Count()))
+    {
+        m_errors->Add(_T("Invalid variable handle."));
+        return (0.0d);
+    }
+    double* bound = this->GetBoundValue(handle.Index);
+    return (unlikely(bound != NULL) ? *bound : m_values[handle.Index]);
 }
 
 
@@ -148,10 +270,11 @@ double MathEvaluation::GetVariable(const String& name) const
 //-----------------------------------------------------------------------------
 void MathEvaluation::ClearVariables()
 /**
- * \brief Removes all variables from this class.
+ * \brief Removes all variables and their bindings from this class.
  **/
 {
     m_variables->Clear();
+    this->BindProgram();
 }
 
 
@@ -164,12 +287,147 @@ StringArray* MathEvaluation::GetVariableNames() const
  * \return StringArray with variable names (never null).
  **/
 {
-    StringArray* array = new StringArray(m_variables->Count());
-    for (size_t i=0; i<m_variables->Count(); ++i)
+    return (new StringArray(m_variables->GetNames()));
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::BindVariable(const String& name, double* address)
+/**
+ * \brief Binds a variable to a value in the memory of the caller. Execute()
+ * loads and saves the value directly at the address, SetVariable() and
+ * GetVariable() write and read it there. The variable is created, if it does
+ * not exist, and keeps its binding for all compiled code until it is unbound.
+ * \remarks Without copies the bound values are only accessed by the interpreter.
+ * The native code of the JIT and the incremental execution copy the bound values
+ * before and after each execution, the batches read them as constant values.
+ * \param name Variable name.
+ * \param address Address of the value, which must be valid while it is bound
+ * or NULL to unbind the variable.
+ **/
+{
+    int index = this->GetVariableIndex(name);
+    this->UnbindVariable(name);
+    if (address != NULL)
+    {
+        m_bindings[index].Address = address;
+        this->BindProgram();
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::BindMember(const String& name, size_t offset)
+/**
+ * \brief Binds a variable to a member of the object set with BindObject(),
+ * e.g. offsetof(Particle, x), so one compiled code can be executed for many
+ * objects of the same struct. The member must be of type double. While no
+ * object is set, the variable is not bound. See BindVariable() for details.
+ * \param name Variable name.
+ * \param offset Offset of the member in bytes.
+ **/
+{
+    int index = this->GetVariableIndex(name);
+    this->UnbindVariable(name);
+    m_bindings[index].Offset = offset;
+    this->BindProgram();
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::UnbindVariable(const String& name)
+/**
+ * \brief Removes the binding of a variable. The variable keeps the last value
+ * of the bound memory.
+ * \param name Variable name.
+ **/
+{
+    int index = this->FindVariableIndex(name);
+    if (index < 0 || (m_bindings[index].Address == NULL && m_bindings[index].Offset == (size_t)-1))
+    {
+        return;
+    }
+    double* bound = this->GetBoundValue(index);
+    if (bound != NULL) m_values[index] = *bound;
+    m_bindings[index].Address = NULL;
+    m_bindings[index].Offset = (size_t)-1;
+    this->BindProgram();
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::BindObject(void* object)
+/**
+ * \brief Sets the object, whose members are bound with BindMember(). Changing
+ * the object does not recompile anything, so it is cheap to execute the code
+ * for every element of an array.
+ * \param object Object, which must be valid while it is set, or NULL.
+ **/
+{
+    bool changed = ((m_object == NULL) != (object == NULL));
+    m_object = (char*)object;
+    if (changed)
+    {
+        this->BindProgram();
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+void* MathEvaluation::GetBoundObject() const
+/**
+ * \brief Returns the object, whose members are bound with BindMember().
+ * \return Object or NULL.
+ **/
+{
+    return (m_object);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::SetArray(const String& name, const double* values, size_t count)
+/**
+ * \brief Sets the values of an array variable, which are copied. The array
+ * must exist before the code using it is compiled, the values can be changed
+ * at any time. Execute() calculates each reduction of the array once with
+ * vectorized kernels before the code is executed. A program of CreateProgram()
+ * keeps the results at its creation time.
+ * \remarks Array names are separate from the variable names. The result of a
+ * reduction is stored in a variable named like the call, e.g. "sum(a)".
+ * \param name Array name.
+ * \param values Values.
+ * \param count Number of values.
+ **/
+{
+    int index = this->GetArrayIndex(name);
+    MathArray& array = m_arrays[index];
+    if (count > array.Capacity)
     {
-        array->Add(m_variables->Item(i)->GetName());
+        if (array.Owned != NULL) delete [] array.Owned;
+        array.Owned = new double[count];
+        array.Capacity = count;
     }
-    return (array);
+    if (count > 0) memcpy(array.Owned, values, count*sizeof(double));
+    array.Values = array.Owned;
+    array.Count = count;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::BindArray(const String& name, const double* values, size_t count)
+/**
+ * \brief Binds an array variable to values in the memory of the caller,
+ * which are read by every execution without copying them. See SetArray()
+ * for details.
+ * \param name Array name.
+ * \param values Values, which must be valid while they are bound.
+ * \param count Number of values.
+ **/
+{
+    int index = this->GetArrayIndex(name);
+    MathArray& array = m_arrays[index];
+    array.Values = values;
+    array.Count = count;
 }
 
 
@@ -177,7 +435,8 @@ StringArray* MathEvaluation::GetVariableNames() const
 void MathEvaluation::SetFunction(MathFunction* function)
 /**
  * \brief Sets the function to the evaluator. This method can override existing
- * functions, if their name is the same.
+ * functions, if their name is the same. Overridden functions are kept until this
+ * object is deleted, because created programs can still call them.
  * \param function Function.
  **/
 {
@@ -187,24 +446,17 @@ void MathEvaluation::SetFunction(MathFunction* function)
         return;
     }
 
-    // Check if function exists
-    int index = -1;
-    for (size_t i=0; i<m_functions->Count(); ++i)
-    {
-        if (m_functions->Item(i)->GetName() == function->GetName())
-        {
-            index = i;
-            break;
-        }
-    }
-
-    // Remove existing function
+    // Replace an existing function, the index of the function stays the same
+    int index = m_functionNames->Find(function->GetName());
     if (index >= 0)
     {
-        m_functions->Remove(index);
+        m_retiredFunctions->Add(m_functions->Item(index));
+        (*m_functions)[index] = function;
+        return;
     }
 
     // Add function
+    m_functionNames->Add(function->GetName());
     m_functions->Add(function);
 }
 
@@ -242,89 +494,217 @@ String MathEvaluation::GetErrorMessage() const
 
 
 //-----------------------------------------------------------------------------
-int FindClosingBracket(ObjectArray<MathToken>* tokens, int openingIndex)
+void MathEvaluation::SetJitEnabled(bool enabled)
 /**
- * \brief
+ * \brief Enables or disables the translation of the compiled code into native
+ * code. If the platform is not supported or the translation fails, the code
+ * is executed by the interpreter. The JIT is disabled by default.
+ * \param enabled True, to enable the JIT; otherwise false.
  **/
 {
-    int depth = 1;
-    for (size_t i=openingIndex+1; i<tokens->Count(); ++i)
+    m_jitEnabled = enabled;
+    if (m_graph != NULL)
     {
-        MathToken* token = tokens->Item(i);
-        if (token->GetType() == MathTokenType::Bracket)
-        {
-            if (token->GetContent() == _T("("))
-            {
-                depth += 1;
-            }
-            else if (token->GetContent() == _T(")"))
-            {
-                depth -= 1;
-                if (depth == 0) return (i);
-            }
-        }
+        delete m_graph;
+        m_graph = NULL;
+    }
+    if (m_program != NULL)
+    {
+        delete m_program;
+        m_program = this->CreateProgram();
+        this->BindProgram();
     }
-    return (-1);
 }
 
 
 //-----------------------------------------------------------------------------
-bool FindFunctionParts(ObjectArray<MathToken>* tokens, int openingIndex,
-                       size_t* argsIndices, size_t maxArgs)
+bool MathEvaluation::IsJitEnabled() const
 /**
- * \brief
+ * \brief Checks if the JIT is enabled.
+ * \return True, if the JIT is enabled; otherwise false.
+ **/
+{
+    return (m_jitEnabled);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::SetIncrementalEnabled(bool enabled)
+/**
+ * \brief Enables or disables the incremental execution. Execute() executes
+ * only the statements, which are affected by the variables changed since the
+ * last execution, instead of all statements. The variables have always the
+ * same values as after executing all statements. Statements which call
+ * functions, that are not pure, are always executed. The incremental execution
+ * uses the interpreter, also if the JIT is enabled. It is disabled by default.
+ * \param enabled True, to enable the incremental execution; otherwise false.
+ **/
+{
+    m_incremental = enabled;
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathEvaluation::IsIncrementalEnabled() const
+/**
+ * \brief Checks if the incremental execution is enabled.
+ * \return True, if the incremental execution is enabled; otherwise false.
+ **/
+{
+    return (m_incremental);
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathEvaluation::GetExecutedStatementCount() const
+/**
+ * \brief Returns the number of statements, which were executed by the last
+ * incremental execution.
+ * \return Number of statements or zero, if the incremental execution was not used.
+ **/
+{
+    return (m_graph != NULL ? m_graph->GetExecutedCount() : 0);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::SetProfilingEnabled(bool enabled)
+/**
+ * \brief Enables or disables the profiling. Execute() interprets the whole
+ * code and counts the executed opcodes, their cycles, the calls of each
+ * function and the maximum stack depth, see GetProfile(). The JIT and the
+ * incremental execution are not used while profiling. Without profiling
+ * the interpreter contains no profiling code. It is disabled by default.
+ * \param enabled True, to enable the profiling; otherwise false.
  **/
 {
-    size_t argsCounter = 0;
-    int depth = 0;
-    for (size_t i=openingIndex+1; i<tokens->Count(); ++i)
+    if (enabled && m_profile == NULL)
     {
-        MathToken* token = tokens->Item(i);
-        if (token->GetType() == MathTokenType::Bracket)
-        {
-            if (token->GetContent() == _T("("))
-            {
-                depth += 1;
-            }
-            else if (token->GetContent() == _T(")"))
-            {
-                depth -= 1;
-                if (depth < 0)
-                {
-                    // No arguments
-                    if (maxArgs == 0 && argsCounter == 0) {
-                        return (true);
-                    }
-                    // One or more arguments
-                    if (maxArgs-1 == argsCounter) {
-                        argsIndices[argsCounter] = i;
-                        return (true);
-                    } else {
-                        return (false);
-                    }
-                }
-            }
-        }
-        else if (token->GetType() == MathTokenType::Comma)
-        {
-            if (depth == 0)
-            {
-                argsIndices[argsCounter] = i;
-                argsCounter++;
-                if (argsCounter == maxArgs)
-                {
-                    return (false);
-                }
-            }
-        }
+        m_profile = new MathProfile();
+    }
+    else if (!enabled && m_profile != NULL)
+    {
+        delete m_profile;
+        m_profile = NULL;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathEvaluation::IsProfilingEnabled() const
+/**
+ * \brief Checks if the profiling is enabled.
+ * \return True, if the profiling is enabled; otherwise false.
+ **/
+{
+    return (m_profile != NULL);
+}
+
+
+//-----------------------------------------------------------------------------
+const MathProfile* MathEvaluation::GetProfile() const
+/**
+ * \brief Returns the profile of the executions since the code was compiled
+ * or the profile was reset.
+ * \return Profile or NULL, if the profiling is disabled.
+ **/
+{
+    return (m_profile);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::ResetProfile()
+/**
+ * \brief Sets all counters of the profile to zero.
+ **/
+{
+    if (m_profile != NULL) m_profile->Reset();
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::SetAccuracy(MathAccuracy accuracy)
+/**
+ * \brief Selects the accuracy of exp, ln, pow, sin, cos and tan in ExecuteBatch().
+ * The vectorized functions are faster than the math library, lanes with
+ * arguments out of their range are calculated by the math library. Execute()
+ * always uses the math library. The default is MathAccuracy::Exact.
+ * \param accuracy Accuracy.
+ **/
+{
+    m_accuracy = accuracy;
+}
+
+
+//-----------------------------------------------------------------------------
+MathAccuracy MathEvaluation::GetAccuracy() const
+/**
+ * \brief Returns the accuracy of the functions in ExecuteBatch().
+ * \return Accuracy.
+ **/
+{
+    return (m_accuracy);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::SetFusion(MathFusion fusion)
+/**
+ * \brief Selects which instruction sequences are combined into
+ * superinstructions, which the interpreter of Execute() and of the programs
+ * executes with fewer dispatches. The native code of the JIT, the batches and
+ * the incremental execution are not affected. The default is
+ * MathFusion::Superinstructions.
+ * \param fusion Combined sequences.
+ **/
+{
+    m_fusion = fusion;
+    if (m_graph != NULL)
+    {
+        delete m_graph;
+        m_graph = NULL;
+    }
+    if (m_program != NULL)
+    {
+        delete m_program;
+        m_program = this->CreateProgram();
+        this->BindProgram();
     }
-    return (false);
 }
 
 
+//-----------------------------------------------------------------------------
+MathFusion MathEvaluation::GetFusion() const
+/**
+ * \brief Returns which instruction sequences are combined into superinstructions.
+ * \return Combined sequences.
+ **/
+{
+    return (m_fusion);
+}
+
 
+//-----------------------------------------------------------------------------
+bool MathEvaluation::IsJitCompiled() const
+/**
+ * \brief Checks if the compiled code is executed as native code.
+ * \return True, if native code is executed; otherwise false.
+ **/
+{
+    return (m_program != NULL && m_program->IsJitCompiled());
+}
 
 
+//-----------------------------------------------------------------------------
+bool MathEvaluation::IsJitSupported()
+/**
+ * \brief Checks if the JIT supports this platform (x86-64 with System V ABI).
+ * \return True, if native code can be generated; otherwise false.
+ **/
+{
+    return (MathJit::IsSupported());
+}
 
 
 //-----------------------------------------------------------------------------
@@ -338,7 +718,7 @@ bool MathEvaluation::Compile(const String& statements)
  **/
 {
     // Clear old stuff
-    m_opcodes->Clear();
+    this->ClearCode();
 
     // Create tokens
     MathTokenizer tokenizer;
@@ -347,148 +727,498 @@ bool MathEvaluation::Compile(const String& statements)
         return (false);
     }
 
-    ObjectArray<MathToken>* tokens = tokenizer.GetTokens();
-    if (tokens->Count() > 0)
+    if (tokenizer.Count() > 0)
     {
-        MathOpcodeArray* opcodes = this->CompileStep(tokens, 0, tokens->Count()-1);
-        m_opcodes->AddRange(opcodes, true);
-        delete opcodes;
+        MathCompiler compiler(this);
+        m_code = compiler.Compile(tokenizer.GetTokens(), tokenizer.Count(), &m_codeCount);
+        if (m_code == NULL)
+        {
+            this->ClearCode();
+            return (false);
+        }
         this->OptimizeCode();
+        return (this->PrepareCode());
     }
     return (m_errors->Count() == 0);
 }
 
 
 //-----------------------------------------------------------------------------
-bool MathEvaluation::Execute()
+bool MathEvaluation::CompileStream(const Char* statements, size_t length)
 /**
- * \brief Executes the previously compiled intermediate language code.
- * You can execute the compiled statement multible times very fast, while
- * changing the variables.
+ * \brief Compiles the statements one by one like Compile(), so the tokens and
+ * the optimizer graph of only one statement exist at the same time. Common
+ * subexpressions are not shared between the statements.
+ * \param statements Mathematical statements separated by semicolons.
+ * \param length Number of characters.
  * \return True, if no errors available; otherwise false.
  **/
 {
-    Stack<double>* stack = new Stack<double>(128);
-    for (size_t i=0; i<m_opcodes->Count(); ++i)
+    this->ClearCode();
+    MathStreamCompiler compiler(this);
+    if (!compiler.Write(statements, length) || !compiler.Finish())
     {
-        MathOpcode* opcode = m_opcodes->Item(i);
-        if (opcode == NULL) {
-            m_errors->Add(_T("Trying to execute bad code."));
-            break;
-        }
-        if (opcode->GetType() == MathOpcodeType::Add)
-        {
-            if (stack->Count() < 2) {
-                m_errors->Add(_T("At least two values needed for an ADD operation."));
-            } else {
-                stack->Push(stack->Pop() + stack->Pop());
-            }
-        }
-        else if (opcode->GetType() == MathOpcodeType::CallFunction)
-        {
-            size_t index = opcode->GetIndex();
-            if (index >= m_functions->Count()) {
-                m_errors->Add(String::Format(_T("Cannot find function at index '%i', because it does not exist."), index));
-            } else {
-                MathFunction* function = m_functions->Item(index);
-                size_t countArgs = function->GetArgs();
-                if (stack->Count() < countArgs) {
-                    m_errors->Add(String::Format(_T("At least '%u' values needed for the CALL operation."), countArgs));
-                } else {
-                    double values[countArgs];
-                    for (int i=countArgs-1; i>=0; --i)
-                    {
-                        values[i] = stack->Pop();
-                    }
-                    stack->Push(function->Evaluate(values, countArgs));
-                }
-            }
-        }
-        else if (opcode->GetType() == MathOpcodeType::Div)
-        {
-            if (stack->Count() < 2) {
-                m_errors->Add(_T("At least two values needed for an DIV operation."));
-            } else {
-                double temp = stack->Pop();
-                stack->Push(stack->Pop() / temp);
-            }
-        }
-        else if (opcode->GetType() == MathOpcodeType::Double)
-        {
-            if (stack->Count() < 1) {
-                m_errors->Add(_T("At least one value needed for an DBL operation."));
-            } else {
-                double value = stack->Pop();
-                stack->Push(value);
-                stack->Push(value);
-            }
-        }
-        else if (opcode->GetType() == MathOpcodeType::LoadConstant)
-        {
-            stack->Push(opcode->GetValue());
-        }
-        else if (opcode->GetType() == MathOpcodeType::LoadVariable)
-        {
-            size_t index = opcode->GetIndex();
-            if (index >= m_variables->Count()) {
-                m_errors->Add(String::Format(_T("Cannot load variable at index '%i', because it does not exist."), index));
-            } else {
-                MathVariable* variable = m_variables->Item(index);
-                stack->Push(variable->GetValue());
-            }
-        }
-        else if (opcode->GetType() == MathOpcodeType::Mul)
-        {
-            if (stack->Count() < 2) {
-                m_errors->Add(_T("At least two values needed for an MUL operation."));
-            } else {
-                stack->Push(stack->Pop() * stack->Pop());
-            }
-        }
-        else if (opcode->GetType() == MathOpcodeType::Neg)
-        {
-            if (stack->Count() < 1) {
-                m_errors->Add(_T("At least one value needed for an NEG operation."));
-            } else {
-                stack->Push(-stack->Pop());
-            }
-        }
-        else if (opcode->GetType() == MathOpcodeType::Nop)
+        return (false);
+    }
+    m_code = compiler.DetachCode(&m_codeCount, &m_countTemporaries);
+    if (m_code == NULL)
+    {
+        return (m_errors->Count() == 0);
+    }
+    return (this->PrepareCode());
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathEvaluation::CompileFile(const String& fileName)
+/**
+ * \brief Compiles the statements of an ASCII file like CompileStream(). The
+ * file is read in parts, so it is never loaded completely.
+ * \param fileName Name of the file.
+ * \return True, if no errors available; otherwise false.
+ **/
+{
+    this->ClearCode();
+    MathStreamCompiler compiler(this);
+    if (!compiler.WriteFile(fileName) || !compiler.Finish())
+    {
+        return (false);
+    }
+    m_code = compiler.DetachCode(&m_codeCount, &m_countTemporaries);
+    if (m_code == NULL)
+    {
+        return (m_errors->Count() == 0);
+    }
+    return (this->PrepareCode());
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathEvaluation::Execute()
+/**
+ * \brief Executes the previously compiled intermediate language code.
+ * You can execute the compiled statement multible times very fast, while
+ * changing the variables.
+ * \return True, if no errors available; otherwise false.
+ **/
+{
+    if (m_program == NULL)
+    {
+        return (m_errors->Count() == 0);
+    }
+    if (unlikely(m_variables->Count() < m_program->GetVariableCount())) {
+        m_errors->Add(_T("Cannot execute the code, because variables do not exist."));
+        return (false);
+    }
+
+    // Only the interpreter accesses the bound memory, the other ways copy the values
+    bool copy = (m_countBindings > 0 && (!m_program->m_bound || (m_incremental && m_profile == NULL)));
+    if (unlikely(copy)) this->ReadBindings();
+    if (unlikely(m_countReductions > 0) && !this->ReduceArrays(m_values, m_errors))
+    {
+        return (false);
+    }
+    if (unlikely(m_profile != NULL)) {
+        if (m_graph != NULL) m_graph->Invalidate();
+        m_program->Profile(m_values, m_stack, m_errors, m_profile, m_object);
+    } else if (m_incremental) {
+        if (m_graph == NULL) m_graph = new MathDependencyGraph(m_program);
+        m_graph->Execute(m_values, m_stack, m_errors);
+    } else {
+        if (m_graph != NULL) m_graph->Invalidate();
+        m_program->Execute(m_values, m_stack, m_errors, m_object);
+    }
+    if (unlikely(copy)) this->WriteBindings();
+    return (m_errors->Count() == 0);
+}
+
+
+//-----------------------------------------------------------------------------
+MathProgram* MathEvaluation::CreateProgram() const
+/**
+ * \brief Creates a read-only copy of the compiled code, which can be executed
+ * by many threads at the same time, each with its own MathContext. The program
+ * keeps the current variable values as initial values and is not changed by
+ * compiling other code. If the JIT is enabled, the program contains native code.
+ * The reductions of arrays are calculated once here, so the program uses a
+ * snapshot of the arrays; later changes of the arrays do not affect it. If the
+ * arrays of dot() have different lengths, its result in the program is NaN and
+ * no error is reported; only Execute() of this object reports it.
+ * \remarks The program calls the functions of this object, so this object must
+ * not be deleted before the program. The returned program must be deleted after usage.
+ * \return Program (never null).
+ **/
+{
+    MathProgram* program = new MathProgram();
+    program->m_codeCount = m_codeCount;
+    program->m_code = new MathInstruction[m_codeCount > 0 ? m_codeCount : 1];
+    if (m_code != NULL)
+    {
+        memcpy(program->m_code, m_code, m_codeCount*sizeof(MathInstruction));
+    }
+    program->m_stackDepth = m_stackDepth;
+    program->m_countTemporaries = m_countTemporaries;
+    program->m_countFunctions = m_functions->Count();
+    program->m_functions = new MathFunction*[m_functions->Count() > 0 ? m_functions->Count() : 1];
+    for (size_t i=0; i<m_functions->Count(); ++i)
+    {
+        program->m_functions[i] = m_functions->Item(i);
+    }
+    *program->m_variables = *m_variables;
+    program->m_values = new double[m_variables->Count() > 0 ? m_variables->Count() : 1];
+    memcpy(program->m_values, m_values, m_variables->Count()*sizeof(double));
+    for (size_t i=0; i<m_variables->Count(); ++i)
+    {
+        double* bound = this->GetBoundValue(i);
+        if (bound != NULL) program->m_values[i] = *bound;
+    }
+    if (m_countReductions > 0) this->ReduceArrays(program->m_values, NULL);
+
+    // Verify the copy, which is executed, so the interpreter can skip all checks
+    MathVerifier verifier(program->m_functions, program->m_countFunctions, program->m_variables->Count(),
+                          program->m_countTemporaries, NULL);
+    program->m_verified = verifier.Verify(program->m_code, program->m_codeCount) &&
+                          verifier.GetStackDepth() <= program->m_stackDepth;
+    program->Combine(m_fusion);
+
+    // Translate verified code into native code, otherwise the interpreter will be used
+    if (program->m_verified && m_jitEnabled && MathJit::IsSupported() && m_code != NULL)
+    {
+        program->m_jit = new MathJit();
+        if (!program->m_jit->Compile(m_code, m_codeCount, m_countTemporaries, program->m_functions))
         {
+            delete program->m_jit;
+            program->m_jit = NULL;
         }
-        else if (opcode->GetType() == MathOpcodeType::SaveVariable)
+    }
+    return (program);
+}
+
+
+//-----------------------------------------------------------------------------
+MathProgram* MathEvaluation::LoadProgram(const void* image, size_t size) const
+/**
+ * \brief Loads a program from a binary image, which was written by
+ * MathProgram::SaveImage(). The image can be mapped into memory (mmap or
+ * MapViewOfFile), the instructions and the initial values are used in place
+ * without tokenizing, compiling or copying. The functions are found by their
+ * names in this object. Calls of intrinsics, whose function is overridden in
+ * this object, are replaced by calls of the function (this copies the
+ * instructions). The image is verified, so broken images cannot crash the
+ * interpreter. If the JIT is enabled, the program contains native code.
+ * \remarks The image and this object must not be deleted before the program.
+ * The image must be aligned to 16 bytes. The returned program must be deleted
+ * after usage.
+ * \code {.cpp}
+ * void* image = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+ * MathProgram* program = evaluation.LoadProgram(image, size);
+ * \endcode
+ * \param image Binary image.
+ * \param size Size of the image in bytes.
+ * \return Program or NULL, if the image cannot be loaded.
+ **/
+{
+    // Check the header, images of newer versions or other platforms are rejected
+    const char* data = (const char*)image;
+    MathImageHeader header;
+    if (data == NULL || size < sizeof(MathImageHeader) || (size_t)data % MathImageAlignment != 0)
+    {
+        m_errors->Add(_T("Cannot load the program, because the image is too small or not aligned."));
+        return (NULL);
+    }
+    memcpy(&header, data, sizeof(MathImageHeader));
+    if (memcmp(header.Magic, MathImageMagic, sizeof(header.Magic)) != 0)
+    {
+        m_errors->Add(_T("Cannot load the program, because the data is no program image."));
+        return (NULL);
+    }
+    if (header.Version < 1 || header.Version > MathImageVersion)
+    {
+        m_errors->Add(String::Format(_T("Cannot load the program, because the image version '%u' is not supported."), header.Version));
+        return (NULL);
+    }
+    if (header.ByteOrder != MathImageByteOrder || header.InstructionSize != sizeof(MathInstruction) ||
+        header.IndexSize != sizeof(size_t))
+    {
+        m_errors->Add(_T("Cannot load the program, because the image was saved on another platform."));
+        return (NULL);
+    }
+    if (header.ImageSize > size || header.CodeOffset % MathImageAlignment != 0 ||
+        header.ValuesOffset % MathImageAlignment != 0 || header.CodeOffset > header.ValuesOffset ||
+        header.ValuesOffset > header.NamesOffset || header.NamesOffset > header.ImageSize ||
+        header.CodeCount > (header.ValuesOffset - header.CodeOffset) / sizeof(MathInstruction) ||
+        header.CountVariables > (header.NamesOffset - header.ValuesOffset) / sizeof(double) ||
+        header.CountFunctions > header.ImageSize || header.CountTemporaries > header.StackDepth)
+    {
+        m_errors->Add(_T("Cannot load the program, because the image is broken."));
+        return (NULL);
+    }
+
+    MathProgram* program = new MathProgram();
+    program->m_code = (MathInstruction*)(data + header.CodeOffset);
+    program->m_ownsCode = false;
+    program->m_codeCount = header.CodeCount;
+    program->m_stackDepth = header.StackDepth;
+    program->m_countTemporaries = header.CountTemporaries;
+    program->m_values = (double*)(data + header.ValuesOffset);
+    program->m_ownsValues = false;
+    program->m_countFunctions = header.CountFunctions;
+    program->m_functions = new MathFunction*[header.CountFunctions > 0 ? header.CountFunctions : 1];
+
+    // Resolve the names, the code refers to the functions in the order of the image
+    const char* names = data + header.NamesOffset;
+    const char* end = data + header.ImageSize;
+    bool valid = true;
+    String name;
+    for (size_t i=0; i<header.CountVariables && valid; ++i)
+    {
+        valid = MathImageReadName(&names, end, &name) && program->m_variables->Add(name) == i;
+    }
+    for (size_t i=0; i<header.CountFunctions && valid; ++i)
+    {
+        unsigned int args = 0;
+        valid = MathImageReadNumber(&names, end, &args) && MathImageReadName(&names, end, &name);
+        int index = (valid ? this->GetFunctionIndex(name) : -1);
+        if (valid && (index < 0 || m_functions->Item(index)->GetArgs() != args))
         {
-            size_t index = opcode->GetIndex();
-            if (index >= m_variables->Count()) {
-                m_errors->Add(String::Format(_T("Cannot save variable at index '%i', because it does not exist."), index));
-            } else {
-                if (stack->Count() < 1) {
-                    m_errors->Add(_T("At least one value needed for an SAV operation."));
-                } else {
-                    MathVariable* variable = m_variables->Item(index);
-                    variable->SetValue(stack->Pop());
-                }
-            }
+            m_errors->Add(String::Format(_T("Cannot load the program, because function '%s' with %u arguments does not exist."),
+                                         name.c_str(), args));
+            delete program;
+            return (NULL);
         }
-        else if (opcode->GetType() == MathOpcodeType::Sub)
+        if (valid) program->m_functions[i] = m_functions->Item(index);
+    }
+    if (!valid)
+    {
+        m_errors->Add(_T("Cannot load the program, because the image is broken."));
+        delete program;
+        return (NULL);
+    }
+
+    // Call overridden functions instead of their intrinsics
+    for (size_t i=0; i<program->m_codeCount; ++i)
+    {
+        const MathInstruction& instruction = program->m_code[i];
+        if (MathOpcode::IsIntrinsic(instruction.Type) && instruction.Index < program->m_countFunctions &&
+            program->m_functions[instruction.Index]->GetOpcode() != instruction.Type)
         {
-            if (stack->Count() < 2) {
-                m_errors->Add(_T("At least two values needed for an SUB operation."));
-            } else {
-                double temp = stack->Pop();
-                stack->Push(stack->Pop() - temp);
+            if (!program->m_ownsCode)
+            {
+                MathInstruction* code = new MathInstruction[program->m_codeCount];
+                memcpy(code, program->m_code, program->m_codeCount*sizeof(MathInstruction));
+                program->m_code = code;
+                program->m_ownsCode = true;
             }
+            program->m_code[i].Type = MathOpcodeType::CallFunction;
         }
-        else
+    }
+
+    // Never execute a broken image
+    MathVerifier verifier(program->m_functions, program->m_countFunctions, program->m_variables->Count(),
+                          program->m_countTemporaries, m_errors);
+    if (!verifier.Verify(program->m_code, program->m_codeCount) || verifier.GetStackDepth() > program->m_stackDepth)
+    {
+        m_errors->Add(_T("Cannot load the program, because the code of the image is invalid."));
+        delete program;
+        return (NULL);
+    }
+    program->m_verified = true;
+    program->Combine(m_fusion);
+
+    // Translate into native code, otherwise the interpreter will be used
+    if (m_jitEnabled && MathJit::IsSupported() && program->m_codeCount > 0)
+    {
+        program->m_jit = new MathJit();
+        if (!program->m_jit->Compile(program->m_code, program->m_codeCount, program->m_countTemporaries,
+                                     program->m_functions))
         {
-            m_errors->Add(_T("Unknown opcode."));
+            delete program->m_jit;
+            program->m_jit = NULL;
         }
     }
-    delete stack;
-    return (m_errors->Count() == 0);
+    return (program);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathEvaluation::ExecuteBatch(const StringArray& inputNames, const double* const* inputs,
+                                  const String& outputName, double* output, size_t rows)
+/**
+ * \brief Executes the previously compiled code for many rows at once. The input
+ * values are given as columns, one column per variable, and the value of the
+ * output variable after executing each row is written into the output column.
+ * Variables without an input column use their current value for every row.
+ * The rows are processed in blocks, so each opcode runs over a whole block with
+ * vectorized (SSE2/AVX) kernels. The accuracy of the transcendental functions
+ * is selected with SetAccuracy(). The variables of this instance are not changed.
+ * \param inputNames Names of the input variables.
+ * \param inputs One column of row values per input variable.
+ * \param outputName Name of the output variable.
+ * \param output Column which receives the output values (row values).
+ * \param rows Number of rows.
+ * \return True, if no errors available; otherwise false.
+ **/
+{
+    return (this->ExecuteParallel(inputNames, inputs, outputName, output, rows, 1));
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathEvaluation::ExecuteParallel(const StringArray& inputNames, const double* const* inputs,
+                                     const String& outputName, double* output, size_t rows,
+                                     size_t maxThreads)
+/**
+ * \brief Executes the previously compiled code for many rows at once like
+ * ExecuteBatch(), but divides the rows into chunks, which are executed by a
+ * pool of worker threads. Every worker has its own stack and variable blocks,
+ * the code and the input columns are shared. The output of a row is always
+ * written to the same position and the chunks are processed in the same blocks
+ * as by ExecuteBatch(), so the output is identical for any number of threads.
+ * The current thread works on the chunks as well and the method returns after
+ * all rows are executed.
+ * \remarks Custom functions are called from multible threads at the same time
+ * and must be thread-safe (all predefined functions are).
+ * \param inputNames Names of the input variables.
+ * \param inputs One column of row values per input variable.
+ * \param outputName Name of the output variable.
+ * \param output Column which receives the output values (row values).
+ * \param rows Number of rows.
+ * \param maxThreads Maximum number of threads including the current thread,
+ * zero uses one thread per processor.
+ * \return True, if no errors available; otherwise false.
+ **/
+{
+    return (this->ExecuteColumns(inputNames, inputs, outputName, output, rows, maxThreads));
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathEvaluation::ExecuteBatch(const StringArray& inputNames, const float* const* inputs,
+                                  const String& outputName, float* output, size_t rows)
+/**
+ * \brief Executes the previously compiled code for many rows of single
+ * precision values like the double version of ExecuteBatch(). The arithmetic
+ * kernels process twice the values per vector register. Constants and
+ * variables without an input column are rounded to float, the transcendental
+ * functions and custom functions are calculated with double and rounded.
+ * \param inputNames Names of the input variables.
+ * \param inputs One column of row values per input variable.
+ * \param outputName Name of the output variable.
+ * \param output Column which receives the output values (row values).
+ * \param rows Number of rows.
+ * \return True, if no errors available; otherwise false.
+ **/
+{
+    return (this->ExecuteColumns(inputNames, inputs, outputName, output, rows, 1));
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathEvaluation::ExecuteParallel(const StringArray& inputNames, const float* const* inputs,
+                                     const String& outputName, float* output, size_t rows,
+                                     size_t maxThreads)
+/**
+ * \brief Executes the previously compiled code for many rows of single
+ * precision values with a pool of worker threads, see the double version of
+ * ExecuteParallel() and the float version of ExecuteBatch().
+ * \param inputNames Names of the input variables.
+ * \param inputs One column of row values per input variable.
+ * \param outputName Name of the output variable.
+ * \param output Column which receives the output values (row values).
+ * \param rows Number of rows.
+ * \param maxThreads Maximum number of threads including the current thread,
+ * zero uses one thread per processor.
+ * \return True, if no errors available; otherwise false.
+ **/
+{
+    return (this->ExecuteColumns(inputNames, inputs, outputName, output, rows, maxThreads));
 }
 
 
+//-----------------------------------------------------------------------------
+template <typename T>
+bool MathEvaluation::ExecuteColumns(const StringArray& inputNames, const T* const* inputs,
+                                    const String& outputName, T* output, size_t rows,
+                                    size_t maxThreads)
+/**
+ * \brief Implements ExecuteBatch() and ExecuteParallel() for columns of
+ * double or float values.
+ * \param inputNames Names of the input variables.
+ * \param inputs One column of row values per input variable.
+ * \param outputName Name of the output variable.
+ * \param output Column which receives the output values (row values).
+ * \param rows Number of rows.
+ * \param maxThreads Maximum number of threads including the current thread,
+ * zero uses one thread per processor.
+ * \return True, if no errors available; otherwise false.
+ **/
+{
+    // Resolve the output variable
+    int outputIndex = this->FindVariableIndex(outputName);
+    if (outputIndex < 0)
+    {
+        m_errors->Add(String::Format(_T("Variable '%s' does not exist."), outputName.c_str()));
+        return (false);
+    }
+
+    // Check the code once, instead of checking every opcode in every block
+    size_t countVariables = m_variables->Count();
+    this->ReadBindings();
+    if (!this->ReduceArrays(m_values, m_errors))
+    {
+        return (false);
+    }
+    size_t maxDepth = 0;
+    size_t maxArgs = 0;
+    if (!this->CheckCode(&maxDepth, &maxArgs))
+    {
+        return (false);
+    }
+
+    // Resolve the input columns, the other variables use their current value
+    const T** columns = new const T*[countVariables > 0 ? countVariables : 1];
+    for (size_t v=0; v<countVariables; ++v)
+    {
+        columns[v] = NULL;
+    }
+    for (size_t i=0; i<inputNames.Count(); ++i)
+    {
+        int index = this->FindVariableIndex(inputNames[i]);
+        if (index >= 0) columns[index] = inputs[i];
+    }
+
+    // Use several chunks per thread, so faster threads can take the chunks of slower ones
+    size_t countThreads = (maxThreads > 0 ? maxThreads : System::GetProcessorCount());
+    size_t chunkSize = MathParallelChunkSize;
+    if (rows / countThreads / 4 < chunkSize) chunkSize = rows / countThreads / 4;
+    MathBatchQueue queue(rows, chunkSize);
+    if (countThreads > queue.GetChunkCount()) countThreads = queue.GetChunkCount();
+    if (countThreads == 0) countThreads = 1;
+
+    // Start the workers, the first one runs in the current thread
+    MathBatch<T>** batches = new MathBatch<T>*[countThreads];
+    MathBatchWorker<T>** workers = new MathBatchWorker<T>*[countThreads];
+    for (size_t t=0; t<countThreads; ++t)
+    {
+        batches[t] = new MathBatch<T>(m_code, m_codeCount, m_countTemporaries, m_functions->m_array, m_values,
+                                      countVariables, columns, outputIndex, maxDepth, maxArgs, m_accuracy);
+        workers[t] = new MathBatchWorker<T>(batches[t], &queue, output);
+        if (t > 0) workers[t]->Start();
+    }
+    workers[0]->Work();
+    for (size_t t=0; t<countThreads; ++t)
+    {
+        workers[t]->Wait();
+        delete workers[t];
+        delete batches[t];
+    }
+
+    delete [] workers;
+    delete [] batches;
+    delete [] columns;
+    return (m_errors->Count() == 0);
+}
+
 
 #ifdef _RUSH_DEBUG_
 //-----------------------------------------------------------------------------
@@ -507,10 +1237,10 @@ String MathEvaluation::GetTokenizerText(const String& statements) const
     }
 
     // Rebuild text
-    MathTokenArray* tokens = tokenizer.GetTokens();
-    for (size_t i=0; i<tokens->Count(); ++i)
+    const MathToken* tokens = tokenizer.GetTokens();
+    for (size_t i=0; i<tokenizer.Count(); ++i)
     {
-        tokenizerText.AppendFormat(_T("%s "), tokens->Item(i)->ToString().c_str());
+        tokenizerText.AppendFormat(_T("%s "), tokens[i].ToString().c_str());
     }
     return (tokenizerText);
 }
@@ -525,525 +1255,520 @@ String MathEvaluation::GetOpcodeText() const
  **/
 {
     String opcodeText;
-    for (size_t i=0; i<m_opcodes->Count(); ++i)
+    for (size_t i=0; i<m_codeCount; ++i)
     {
-        MathOpcode* opcode = m_opcodes->Item(i);
-        if (opcode == NULL) {
-            opcodeText.Append((_T("NULL ")));
-            continue;
-        }
-        if (opcode->GetType() == MathOpcodeType::Add)
+        const MathInstruction& instruction = m_code[i];
+        if (instruction.Type == MathOpcodeType::Add)
         {
             opcodeText.Append(_T("ADD "));
         }
-        else if (opcode->GetType() == MathOpcodeType::CallFunction)
+        else if (instruction.Type == MathOpcodeType::CallFunction)
         {
             opcodeText.AppendFormat(_T("CALL '%s' "),
-                m_functions->Item(opcode->GetIndex())->GetName().c_str());
+                m_functions->Item(instruction.Index)->GetName().c_str());
         }
-        else if (opcode->GetType() == MathOpcodeType::Div)
+        else if (MathOpcode::IsIntrinsic(instruction.Type) || MathOpcode::IsComparison(instruction.Type))
+        {
+            opcodeText.AppendFormat(_T("%s "),
+                MathOpcode(instruction.Type, instruction.Index).ToString().c_str());
+        }
+        else if (instruction.Type == MathOpcodeType::Div)
         {
             opcodeText.AppendFormat(_T("DIV "));
         }
-        else if (opcode->GetType() == MathOpcodeType::Double)
+        else if (instruction.Type == MathOpcodeType::Double)
         {
             opcodeText.AppendFormat(_T("DBL "));
         }
-        else if (opcode->GetType() == MathOpcodeType::LoadConstant)
+        else if (instruction.Type == MathOpcodeType::LoadConstant)
         {
-            opcodeText.AppendFormat(_T("LDC '%1.2f' "), opcode->GetValue());
+            opcodeText.AppendFormat(_T("LDC '%1.2f' "), instruction.Value);
         }
-        else if (opcode->GetType() == MathOpcodeType::LoadVariable)
+        else if (instruction.Type == MathOpcodeType::LoadVariable)
         {
             opcodeText.AppendFormat(_T("LDV '%s' "),
-                m_variables->Item(opcode->GetIndex())->GetName().c_str());
+                m_variables->Item(instruction.Index).c_str());
         }
-        else if (opcode->GetType() == MathOpcodeType::Mul)
+        else if (instruction.Type == MathOpcodeType::Mul)
         {
             opcodeText.AppendFormat(_T("MUL "));
         }
-        else if (opcode->GetType() == MathOpcodeType::Neg)
+        else if (instruction.Type == MathOpcodeType::Neg)
         {
             opcodeText.AppendFormat(_T("NEG "));
         }
-        else if (opcode->GetType() == MathOpcodeType::Nop)
+        else if (instruction.Type == MathOpcodeType::LoadTemporary)
+        {
+            opcodeText.AppendFormat(_T("LDT '%u' "), instruction.Index);
+        }
+        else if (instruction.Type == MathOpcodeType::StoreTemporary)
+        {
+            opcodeText.AppendFormat(_T("STT '%u' "), instruction.Index);
+        }
+        else if (instruction.Type == MathOpcodeType::Nop)
         {
             opcodeText.AppendFormat(_T("NOP "));
         }
-        else if (opcode->GetType() == MathOpcodeType::SaveVariable)
+        else if (instruction.Type == MathOpcodeType::SaveVariable)
         {
             opcodeText.AppendFormat(_T("SAV '%s' "),
-                m_variables->Item(opcode->GetIndex())->GetName().c_str());
+                m_variables->Item(instruction.Index).c_str());
         }
-        else if (opcode->GetType() == MathOpcodeType::Sub)
+        else if (instruction.Type == MathOpcodeType::Sub)
         {
             opcodeText.AppendFormat(_T("SUB "));
         }
-        else if (opcode->GetType() == MathOpcodeType::Opcodes)
-        {
-            opcodeText.AppendFormat(_T("OPCODES '%u' "), opcode->GetArray()->Count());
-        }
     }
     return (opcodeText);
 }
-#endif
-
 
 
 //-----------------------------------------------------------------------------
-bool MathEvaluation::HasHigherPriority(MathOpcodeType a, MathOpcodeType b)
+String MathEvaluation::GetProfileText() const
 /**
- * \brief Compares two opcodes and returns true, if opcode b has a higher priority
- * than opcode a.
- * \param a Type of opcode a.
- * \param b Type of opcode b.
- * \return True, when opcode b has a higher priority than a; otherwise false.
+ * \brief Returns the profile as table, see MathProfile::ToString().
+ * \return Profile or an empty string, if the profiling is disabled.
  **/
 {
-    return (((a == MathOpcodeType::Add || a == MathOpcodeType::Sub) &&
-             (b == MathOpcodeType::Mul || b == MathOpcodeType::Div)) ||
-             (b == MathOpcodeType::Neg && a != MathOpcodeType::Neg));
+    if (m_profile == NULL)
+    {
+        return (_T(""));
+    }
+    return (m_profile->ToString());
 }
+#endif
 
 
 
 //-----------------------------------------------------------------------------
-void MathEvaluation::PopInput(MathOpcodeArray* code, MathOpcodeDeque* inputs)
+int MathEvaluation::GetVariableIndex(const String& name)
+/**
+ * \brief Returns the index of a variable. Automatically creates the
+ * variable if it does not exists.
+ * \param name Variable name.
+ * \return Variable index.
+ **/
 {
-    MathOpcode* opcode = inputs->Pop();
-    if (opcode == NULL)
+     // Search for the variable
+    int index = m_variables->Find(name);
+    if (index >= 0)
     {
-        m_errors->Add(_T("Internal error: Not enougth inputs available."));
+        return (index);
     }
-    else
-    {
-        if (opcode->GetType() == MathOpcodeType::Opcodes)
-        {
-            code->AddRange(opcode->GetArray(), true);
-            delete opcode;
-        }
-        else
-        {
-            code->Add(opcode);
-        }
-    }
-}
 
+    // Create the variable if it doesn't exist
+    return (this->AddVariable(name));
+}
 
 
 //-----------------------------------------------------------------------------
-void MathEvaluation::ResolveOperator(MathOpcodeArray* code, MathOpcodeDeque* operators, MathOpcodeDeque* inputs, bool checkPriority)
+int MathEvaluation::GetVariableIndex(const MathToken* token)
 /**
- * \brief Resolves the operators in the deque and writes the generated code sequenz into
- * the code array. Uses the input deque for the operands and differs the check of priority.
- * \param code Code array.
- * \param operators Operators deque.
- * \param inputs Inputs or operands deque.
- * \param checkPriority True, the enable Priority check; otherwise false.
+ * \brief Returns the index of the variable named by the token. Automatically
+ * creates the variable if it does not exists.
+ * \param token Variable or assignment token.
+ * \return Variable index.
  **/
 {
-    MathOpcode* opcode = operators->Pop();
-    if (opcode->GetType() == MathOpcodeType::Add ||
-        opcode->GetType() == MathOpcodeType::Sub ||
-        opcode->GetType() == MathOpcodeType::Mul ||
-        opcode->GetType() == MathOpcodeType::Div)
-    {
-        if (inputs->Count() < 2) {
-            m_errors->AddFormat(_T("Internal error: %s opcode needs two operands."), opcode->ToString().c_str());
-        } else {
-            this->PopInput(code, inputs);
-            this->PopInput(code, inputs);
-            inputs->Push(new MathOpcode(MathOpcodeType::Nop));
-        }
-    }
-    else if (opcode->GetType() == MathOpcodeType::SaveVariable)
-    {
-        if (inputs->Count() < 1) {
-            m_errors->Add(_T("Internal error: SAV opcode needs one operand."));
-        } else {
-            this->PopInput(code, inputs);
-        }
-    }
-    else if (opcode->GetType() == MathOpcodeType::Neg)
-    {
-        if (inputs->Count() < 1) {
-            m_errors->Add(_T("Internal error: NEG opcode needs one operand."));
-        } else {
-            this->PopInput(code, inputs);
-            inputs->Push(new MathOpcode(MathOpcodeType::Nop));
-        }
-    }
-    else if (opcode->GetType() == MathOpcodeType::Double)
-    {
-        if (inputs->Count() < 1) {
-            m_errors->Add(_T("Internal error: DBL opcode needs one operand."));
-        } else {
-            this->PopInput(code, inputs);
-            inputs->Push(new MathOpcode(MathOpcodeType::Nop));
-            inputs->Push(new MathOpcode(MathOpcodeType::Nop));
-        }
-    }
-    else if (opcode->GetType() == MathOpcodeType::CallFunction)
-    {
-        int functionIndex = opcode->GetIndex();
-        size_t args = m_functions->Item(functionIndex)->GetArgs();
-        if (inputs->Count() < args) {
-            m_errors->AddFormat(_T("Internal error: CALL opcode needs %u operands for the function."), args);
-        } else {
-            for (size_t i=0; i<args; ++i)
-            {
-                this->PopInput(code, inputs);
-            }
-            inputs->Push(new MathOpcode(MathOpcodeType::Nop));
-        }
-    }
-    else if (opcode->GetType() == MathOpcodeType::Nop)
-    {
-        Console::WriteLine(_T("NOP operator"));
-        code->Add(opcode);
-    }
-    else
+    int index = m_variables->Find(token->GetText(), token->GetLength());
+    if (index >= 0)
     {
-        Console::WriteLine(_T("Unexpected opcode: %s"), opcode->ToString().c_str());
+        return (index);
     }
+    return (this->AddVariable(token->GetContent()));
+}
+
 
-	// TODO : Move check to top of the method (allows diffrent types)
-    if (checkPriority)
+//-----------------------------------------------------------------------------
+int MathEvaluation::AddVariable(const String& name)
+/**
+ * \brief Adds a new variable with the value zero. The values of all
+ * variables are stored in one array, which grows if needed.
+ * \param name Variable name.
+ * \return Variable index.
+ **/
+{
+    if (m_variables->Count() == m_valuesCapacity)
     {
-        while (!operators->IsEmpty())
-        {
-            if (HasHigherPriority(opcode->GetType(), operators->Peek()->GetType()))
-            {
-                ResolveOperator(code, operators, inputs, false);
-            }
-            else
-            {
-                break;
-            }
-        }
+        double* values = new double[m_valuesCapacity*2];
+        memcpy(values, m_values, m_valuesCapacity*sizeof(double));
+        delete [] m_values;
+        m_values = values;
+        MathBinding* bindings = new MathBinding[m_valuesCapacity*2];
+        memcpy(bindings, m_bindings, m_valuesCapacity*sizeof(MathBinding));
+        delete [] m_bindings;
+        m_bindings = bindings;
+        m_valuesCapacity *= 2;
     }
-    code->Add(opcode);
+    m_values[m_variables->Count()] = 0.0d;
+    m_bindings[m_variables->Count()].Address = NULL;
+    m_bindings[m_variables->Count()].Offset = (size_t)-1;
+    return (m_variables->Add(name));
 }
 
 
+//-----------------------------------------------------------------------------
+int MathEvaluation::FindVariableIndex(const String& name) const
+/**
+ * \brief Returns the index of a variable or -1 if the variable does
+ * not exists.
+ * \param name Variable name.
+ * \return Variable index or -1 if the variable does not exist.
+ **/
+{
+    return (m_variables->Find(name));
+}
 
 
 //-----------------------------------------------------------------------------
-MathOpcodeArray* MathEvaluation::CompileStep(MathTokenArray* tokens, size_t startIndex, size_t endIndex)
+int MathEvaluation::GetFunctionIndex(const String& name) const
 /**
- * \brief Compiles a single statement or parts of a statement. Brackets and functions
- * depth resolving will be resolved by recursive calls of this method.
- * \param tokens Token array.
- * \param startIndex Start index in the token array.
- * \param endIndex End index in the token array.
+ * \brief Returns the index of a function or -1 if the function name
+ * does not exists.
+ * \param name Function name.
+ * \return Function index or -1 if the function does not exist.
  **/
 {
-    // Loop through statements
-    size_t indexToken = startIndex;
-    MathOpcodeArray* opcodes = new MathOpcodeArray();
-    ObjectDeque<MathOpcode>* operators = new ObjectDeque<MathOpcode>();
-    ObjectDeque<MathOpcode>* inputs = new ObjectDeque<MathOpcode>();
-    while (indexToken <= endIndex)
-    {
-        // Resolve assignment
-        MathToken* token = tokens->Item(indexToken);
-        MathOpcode* assignment = NULL;
-        if (token->GetType() == MathTokenType::Assignment) {
-            assignment = this->CreateOpcode(token);
-            indexToken += 1;
-        } else {
-            //m_errors->Add(String::Format(_T("Statements must begin with an assignment.")));
-        }
+    return (m_functionNames->Find(name));
+}
 
-        // Resolve the rest of the statement
-        token = tokens->Item(indexToken);
-        while (indexToken <= endIndex)
-        {
-            if (token->GetType() == MathTokenType::Bracket)
-            {
-                if (token->GetContent() == _T("("))
-                {
-                    // Search for closing bracket
-                    int indexOfClosing = FindClosingBracket(tokens, indexToken);
-                    if (indexOfClosing < 0)
-                    {
-                        m_errors->Add(_T("Closing bracket is missing."));
-                        indexToken++;
-                        break;
-                    }
-                    else
-                    {
-                        MathOpcodeArray* opcodes = this->CompileStep(tokens, indexToken+1, indexOfClosing-1);
-                        indexToken = indexOfClosing;
-                        inputs->PushFront(new MathOpcode(MathOpcodeType::Opcodes, opcodes));
-                    }
-                }
-                else
-                {
-                    m_errors->Add(_T("Unexpected closing bracket."));
-                }
-            }
-            else if (token->GetType() == MathTokenType::Function)
-            {
-                // Push call operator as opcode into operators
-                MathOpcodeArray* functionArray = new MathOpcodeArray();
-                MathOpcode* functionOpcode = this->CreateOpcode(token);
-                int functionIndex = this->GetFunctionIndex(token->GetContent());
-                if (functionIndex < 0) {
-                    indexToken += 1;
-                    break;
-                }
-
-                // Check if function is valid
-                indexToken += 1;
-                token = tokens->Item(indexToken);
-                if (token->GetType() != MathTokenType::Bracket || token->GetContent() != _T("("))
-                {
-                    m_errors->Add(_T("Bracket open expected after function name."));
-                }
-                else
-                {
-                    // Get the arguments count of the function
-                    size_t args = m_functions->Item(functionIndex)->GetArgs();
-
-                    // Find end bracket and commans of the function
-                    size_t argsIndices[args];
-                    if (!FindFunctionParts(tokens, indexToken, argsIndices, args))
-                    {
-                        m_errors->Add(String::Format(_T("Wrong number of arguments for function '%s'."),
-                            m_functions->Item(functionIndex)->GetName().c_str()));
-                        indexToken++;
-                        break;
-                    }
-
-                    if (args > 0)
-                    {
-                        MathOpcodeArray* opcodes = this->CompileStep(tokens, indexToken+1, argsIndices[0]-1);
-                        functionArray->AddRange(opcodes, true);
-                        delete opcodes;
-                        for (size_t i=1; i<args; ++i)
-                        {
-                            MathOpcodeArray* opcodes = this->CompileStep(tokens, argsIndices[i-1]+1, argsIndices[i]-1);
-                            functionArray->AddRange(opcodes, true);
-                            delete opcodes;
-                        }
-                        indexToken = argsIndices[args-1];
-                    }
-                    else
-                    {
-                        indexToken += 1;
-                    }
-                    functionArray->Add(functionOpcode);
-                    inputs->PushFront(new MathOpcode(MathOpcodeType::Opcodes, functionArray));
-                }
-            }
-            else if (token->GetType() == MathTokenType::Constant ||
-                     token->GetType() == MathTokenType::Variable)
-            {
-                inputs->PushFront(this->CreateOpcode(token));
-            }
-            else if (token->GetType() == MathTokenType::Operator)
-            {
-                // Check if negative operator should be used
-                MathToken* prevToken = tokens->Item(indexToken-1);
-                if ((prevToken->GetType() == MathTokenType::Operator) ||
-                    (prevToken->GetType() == MathTokenType::Assignment) ||
-                    (prevToken->GetType() == MathTokenType::Bracket && prevToken->GetContent() == _T("(")))
-                {
-                    operators->PushFront(new MathOpcode(MathOpcodeType::Neg));
-                }
-                else if (token->GetContent() == _T("+-") || token->GetContent() == _T("--") ||
-                         token->GetContent() == _T("*-") || token->GetContent() == _T("/-"))
-                {
-                    operators->PushFront(this->CreateOpcode(token));
-                    operators->PushFront(new MathOpcode(MathOpcodeType::Neg));
-                }
-                else
-                {
-                    operators->PushFront(this->CreateOpcode(token));
-                }
-            }
-            else if (token->GetType() == MathTokenType::EndStatement)
-            {
-                indexToken += 1;
-                break;
-            }
-            else
-            {
-                m_errors->Add(_T("Internal error: Unexpected token type."));
-            }
-            indexToken += 1;
-            token = tokens->Item(indexToken);
-        }
 
-        // Push the assignment operator
-        if (assignment != NULL)
-        {
-            operators->PushFront(assignment);
-        }
+//-----------------------------------------------------------------------------
+int MathEvaluation::GetFunctionIndex(const Char* name, size_t length) const
+/**
+ * \brief Returns the index of a function or -1 if the function name
+ * does not exists.
+ * \param name Function name (does not have to be zero terminated).
+ * \param length Length of the function name.
+ * \return Function index or -1 if the function does not exist.
+ **/
+{
+    return (m_functionNames->Find(name, length));
+}
 
-        // Create the stackbased code
-        while (!operators->IsEmpty())
-        {
-            ResolveOperator(opcodes, operators, inputs, true);
-        }
-        while (!inputs->IsEmpty())
-        {
-            this->PopInput(opcodes, inputs);
-        }
-    }
 
-    if (operators != NULL) delete operators;
-    if (inputs != NULL) delete inputs;
-    return (opcodes);
+//-----------------------------------------------------------------------------
+void MathEvaluation::OptimizeCode()
+/**
+ * \brief Optimizes the flat instructions with the MathOptimizer (constant
+ * folding, algebraic simplification, strength reduction and common
+ * subexpression elimination). The code stays unchanged, if it cannot be
+ * optimized.
+ **/
+{
+    MathOptimizer optimizer(m_functions);
+    size_t count = 0;
+    MathInstruction* code = optimizer.Optimize(m_code, m_codeCount, &count);
+    if (code != NULL)
+    {
+        delete [] m_code;
+        m_code = code;
+        m_codeCount = count;
+        m_countTemporaries = optimizer.GetTemporaryCount();
+    }
 }
 
 
+//-----------------------------------------------------------------------------
+bool MathEvaluation::PrepareCode()
+/**
+ * \brief Selects the intrinsics of the compiled code, checks it and creates
+ * the program and the stack.
+ * \return True, if no errors available; otherwise false.
+ **/
+{
+    this->SelectIntrinsics();
+    if (!this->CheckCode(&m_stackDepth, NULL))
+    {
+        this->ClearCode();
+        return (false);
+    }
+    delete [] m_stack;
+    m_stack = new double[m_stackDepth > 0 ? m_stackDepth : 1];
+    m_program = this->CreateProgram();
+    this->BindProgram();
+    return (m_errors->Count() == 0);
+}
 
 
 //-----------------------------------------------------------------------------
-int MathEvaluation::GetVariableIndex(const String& name) const
+void MathEvaluation::SelectIntrinsics()
 /**
- * \brief Returns the index of a variable. Automatically creates the
- * variable if it does not exists.
- * \param name Variable name.
- * \return Variable index.
+ * \brief Replaces the calls of default functions by their intrinsic opcodes,
+ * which are executed inline without the virtual call. The function index is
+ * kept in the instruction. Overridden default functions are still called.
  **/
 {
-     // Search for the variable
-    for (size_t i=0; i<m_variables->Count(); ++i)
+    for (size_t i=0; i<m_codeCount; ++i)
     {
-        if (m_variables->Item(i)->GetName() == name)
+        MathInstruction& instruction = m_code[i];
+        if (instruction.Type == MathOpcodeType::CallFunction && instruction.Index < m_functions->Count())
         {
-            return (i);
+            instruction.Type = m_functions->Item(instruction.Index)->GetOpcode();
         }
     }
+}
 
-    // Create the variable if it doesn't exist
-    m_variables->Add(new MathVariable(name, 0.0d));
-    return (m_variables->Count()-1);
+
+//-----------------------------------------------------------------------------
+bool MathEvaluation::CheckCode(size_t* maxDepth, size_t* maxArgs)
+/**
+ * \brief Checks the flat instructions with the MathVerifier for valid indices
+ * and calculates the exact stack depth which is needed to execute the code.
+ * An error is generated, if the code would take values from an empty stack
+ * or loads a temporary value before it was stored.
+ * \param maxDepth Receives the maximum stack depth, including the temporary values.
+ * \param maxArgs Receives the maximum number of function arguments (can be NULL).
+ * \return True, if the code is valid; otherwise false.
+ **/
+{
+    MathVerifier verifier(m_functions->m_array, m_functions->Count(), m_variables->Count(),
+                          m_countTemporaries, m_errors);
+    bool valid = verifier.Verify(m_code, m_codeCount);
+    *maxDepth = verifier.GetStackDepth();
+    if (maxArgs != NULL) *maxArgs = verifier.GetMaxArgs();
+    return (valid);
 }
 
 
+
 //-----------------------------------------------------------------------------
-int MathEvaluation::GetFunctionIndex(const String& name) const
+double* MathEvaluation::GetBoundValue(size_t index) const
 /**
- * \brief Returns the index of a function or -1 if the function name
- * does not exists.
- * \param name Function name.
- * \return Function index or -1 if the function does not exist.
+ * \brief Returns the memory of a bound variable.
+ * \param index Variable index.
+ * \return Address of the value or NULL, if the variable is not bound.
  **/
 {
-    for (size_t i=0; i<m_functions->Count(); ++i)
+    const MathBinding& binding = m_bindings[index];
+    if (binding.Address != NULL)
     {
-        if (m_functions->Item(i)->GetName() == name)
-        {
-            return (i);
-        }
+        return (binding.Address);
     }
-    return (-1);
+    if (binding.Offset != (size_t)-1 && m_object != NULL)
+    {
+        return ((double*)(m_object + binding.Offset));
+    }
+    return (NULL);
 }
 
 
 //-----------------------------------------------------------------------------
-MathOpcode* MathEvaluation::CreateOpcode(MathToken* token)
+void MathEvaluation::BindProgram()
 /**
- * \brief Creates an opcode from the given token. Tokens of type None,
- * Bracket and EndStatement will not create a opcode.
- * \param token Token.
- * \return Opcode.
+ * \brief Counts the bound variables and recreates the interpreted code of the
+ * program, so it accesses the bound memory instead of the variable values.
  **/
 {
-    if (token->GetType() == MathTokenType::Assignment)
+    m_countBindings = 0;
+    for (size_t i=0; i<m_variables->Count(); ++i)
     {
-        int index = this->GetVariableIndex(token->GetContent());
-        if (index < 0) {
-            m_errors->Add(String::Format(_T("Unknown variable name '%s'."), token->GetContent().c_str()));
-            return (new MathOpcode(MathOpcodeType::Nop));
-        }
-        return (new MathOpcode(MathOpcodeType::SaveVariable, (size_t)index));
+        if (this->GetBoundValue(i) != NULL) m_countBindings++;
     }
-    else if (token->GetType() == MathTokenType::Constant)
+    if (m_program == NULL || (m_countBindings == 0 && !m_program->m_bound))
     {
-        double value = Parser::ParseDouble(token->GetContent());
-        return (new MathOpcode(MathOpcodeType::LoadConstant, value));
+        return;
     }
-    else if (token->GetType() == MathTokenType::Function)
+    if (m_countBindings == 0)
     {
-        int index = this->GetFunctionIndex(token->GetContent());
-        if (index < 0) {
-            m_errors->Add(String::Format(_T("Unknown function name '%s'."), token->GetContent().c_str()));
-            return (new MathOpcode(MathOpcodeType::Nop));
-        }
-        return (new MathOpcode(MathOpcodeType::CallFunction, (size_t)index));
+        m_program->Combine(m_fusion);
+        return;
     }
-    else if (token->GetType() == MathTokenType::Operator)
+
+    // Members are only bound with an object, the offsets are added while executing
+    MathBinding* bindings = new MathBinding[m_variables->Count()];
+    for (size_t i=0; i<m_variables->Count(); ++i)
     {
-        if (token->GetContent().StartsWith(_T("+"))) {
-            return (new MathOpcode(MathOpcodeType::Add));
-        }
-        else if (token->GetContent().StartsWith(_T("-"))) {
-            return (new MathOpcode(MathOpcodeType::Sub));
-        }
-        else if (token->GetContent().StartsWith(_T("*"))) {
-            return (new MathOpcode(MathOpcodeType::Mul));
-        }
-        else if (token->GetContent().StartsWith(_T("/"))) {
-            return (new MathOpcode(MathOpcodeType::Div));
-        }
-        m_errors->Add(String::Format(_T("Unknown operator '%s'."), token->GetContent().c_str()));
-        return (new MathOpcode(MathOpcodeType::Nop));
+        bindings[i].Address = m_bindings[i].Address;
+        bindings[i].Offset = (m_object != NULL ? m_bindings[i].Offset : (size_t)-1);
     }
-    else if (token->GetType() == MathTokenType::Variable)
+    m_program->Combine(m_fusion, bindings, m_variables->Count());
+    delete [] bindings;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::ReadBindings()
+/**
+ * \brief Copies the values of the bound variables from the bound memory.
+ **/
+{
+    for (size_t i=0; i<m_variables->Count() && m_countBindings > 0; ++i)
     {
-        int index = this->GetVariableIndex(token->GetContent());
-        if (index < 0) {
-            m_errors->Add(String::Format(_T("Unknown variable name '%s'."), token->GetContent().c_str()));
-            return (new MathOpcode(MathOpcodeType::Nop));
-        }
-        return (new MathOpcode(MathOpcodeType::LoadVariable, (size_t)index));
+        double* bound = this->GetBoundValue(i);
+        if (bound != NULL) m_values[i] = *bound;
     }
-    else if (token->GetType() == MathTokenType::None)
+}
+
+
+//-----------------------------------------------------------------------------
+void MathEvaluation::WriteBindings()
+/**
+ * \brief Copies the values of the bound variables into the bound memory.
+ **/
+{
+    for (size_t i=0; i<m_variables->Count() && m_countBindings > 0; ++i)
     {
-        m_errors->Add(_T("Cannot convert token 'None' to opcode."));
+        double* bound = this->GetBoundValue(i);
+        if (bound != NULL) *bound = m_values[i];
     }
-    else if (token->GetType() == MathTokenType::EndStatement)
+}
+
+
+//-----------------------------------------------------------------------------
+int MathEvaluation::GetArrayIndex(const String& name)
+/**
+ * \brief Returns the index of an array. Automatically creates an empty array
+ * if it does not exists.
+ * \param name Array name.
+ * \return Array index.
+ **/
+{
+    int index = m_arrayNames->Find(name);
+    if (index >= 0)
     {
-        m_errors->Add(_T("Cannot convert token 'EndStatement' to opcode."));
+        return (index);
     }
-    else if (token->GetType() == MathTokenType::Bracket)
+    size_t count = m_arrayNames->Count();
+    if (count == m_arraysCapacity)
     {
-        m_errors->Add(_T("Cannot convert token 'Bracket' to opcode."));
+        m_arraysCapacity = (m_arraysCapacity > 0 ? m_arraysCapacity*2 : 4);
+        MathArray* arrays = new MathArray[m_arraysCapacity];
+        if (m_arrays != NULL)
+        {
+            memcpy(arrays, m_arrays, count*sizeof(MathArray));
+            delete [] m_arrays;
+        }
+        m_arrays = arrays;
     }
-    return (new MathOpcode(MathOpcodeType::Nop));
+    m_arrays[count].Values = NULL;
+    m_arrays[count].Count = 0;
+    m_arrays[count].Owned = NULL;
+    m_arrays[count].Capacity = 0;
+    return (m_arrayNames->Add(name));
 }
 
 
-
 //-----------------------------------------------------------------------------
-void MathEvaluation::OptimizeCode()
+size_t MathEvaluation::AddReduction(MathReductionType type, size_t first, size_t second)
 /**
- * \brief
+ * \brief Adds a reduction used by the compiled code. Equal reductions are
+ * calculated once.
+ * \param type Reduction type.
+ * \param first Index of the array.
+ * \param second Index of the second array of dot().
+ * \return Index of the variable, which receives the result.
  **/
 {
-    // Currently only optimization is the removing of the Nop OpCodes
-    for (size_t i=0; i<m_opcodes->Count(); ++i)
+    const Char* names[] = { _T("sum"), _T("mean"), _T("min"), _T("max"), _T("dot") };
+    String name = String::Format(_T("%s(%s"), names[(size_t)type], m_arrayNames->Item(first).c_str());
+    if (type == MathReductionType::Dot) name.AppendFormat(_T(",%s"), m_arrayNames->Item(second).c_str());
+    name.Append(_T(")"));
+    size_t variable = this->GetVariableIndex(name);
+    for (size_t i=0; i<m_countReductions; ++i)
+    {
+        if (m_reductions[i].Variable == variable) return (variable);
+    }
+
+    if (m_countReductions == m_reductionsCapacity)
     {
-        MathOpcode* opcode = m_opcodes->Item(i);
-        if (opcode->GetType() == MathOpcodeType::Nop)
+        m_reductionsCapacity = (m_reductionsCapacity > 0 ? m_reductionsCapacity*2 : 4);
+        MathReduction* reductions = new MathReduction[m_reductionsCapacity];
+        if (m_reductions != NULL)
         {
-            delete opcode;
-            (*m_opcodes)[i] = NULL;
+            memcpy(reductions, m_reductions, m_countReductions*sizeof(MathReduction));
+            delete [] m_reductions;
         }
+        m_reductions = reductions;
     }
-    m_opcodes->MoveUp();
+    MathReduction& reduction = m_reductions[m_countReductions++];
+    reduction.Type = type;
+    reduction.First = first;
+    reduction.Second = second;
+    reduction.Variable = variable;
+    return (variable);
+}
 
-    // TODO : Calculate the max stack - Don't reallocate stack in execution
-    // TODO : Calculate the constants - Example: a = 1+2; => a = 3;
-    // TODO : Reduction of mathoperators
+
+//-----------------------------------------------------------------------------
+bool MathEvaluation::ReduceArrays(double* values, StringArray* errors) const
+/**
+ * \brief Calculates the reductions used by the compiled code and stores the
+ * results in their variables. Mean, min and max of empty arrays are NaN,
+ * every reduction of an array with a NaN value is NaN.
+ * \param values Variable values, which receive the results.
+ * \param errors Receives the errors and stops at the first error. If it is
+ * null, the result of dot() with arrays of different lengths is NaN and the
+ * other reductions are calculated.
+ * \return True, if all reductions were calculated; otherwise false.
+ **/
+{
+    bool calculated = true;
+    for (size_t i=0; i<m_countReductions; ++i)
+    {
+        const MathReduction& reduction = m_reductions[i];
+        const MathArray& array = m_arrays[reduction.First];
+        double result = 0.0d;
+        if (reduction.Type == MathReductionType::Sum) {
+            result = MathKernelSum(array.Values, array.Count);
+        } else if (reduction.Type == MathReductionType::Mean) {
+            result = MathKernelSum(array.Values, array.Count) / (double)array.Count;
+        } else if (reduction.Type == MathReductionType::Dot) {
+            const MathArray& second = m_arrays[reduction.Second];
+            if (likely(second.Count == array.Count)) {
+                result = MathKernelDot(array.Values, second.Values, array.Count);
+            } else if (errors != NULL) {
+                errors->Add(String::Format(_T("Arrays '%s' and '%s' of dot() have different lengths."),
+                                           m_arrayNames->Item(reduction.First).c_str(),
+                                           m_arrayNames->Item(reduction.Second).c_str()));
+                return (false);
+            } else {
+                result = NAN;
+                calculated = false;
+            }
+        } else if (array.Count == 0) {
+            result = NAN;
+        } else if (reduction.Type == MathReductionType::Min) {
+            result = MathKernelMin(array.Values, array.Count);
+        } else {
+            result = MathKernelMax(array.Values, array.Count);
+        }
+        values[reduction.Variable] = result;
+    }
+    return (calculated);
 }
 
 
+//-----------------------------------------------------------------------------
+void MathEvaluation::ClearCode()
+/**
+ * \brief Removes the compiled code from this instance.
+ **/
+{
+    if (m_code != NULL)
+    {
+        delete [] m_code;
+        m_code = NULL;
+    }
+    m_codeCount = 0;
+    m_countTemporaries = 0;
+    m_countReductions = 0;
+    if (m_graph != NULL)
+    {
+        delete m_graph;
+        m_graph = NULL;
+    }
+    if (m_profile != NULL)
+    {
+        m_profile->Reset();
+    }
+    if (m_program != NULL)
+    {
+        delete m_program;
+        m_program = NULL;
+    }
+}
+
 
 } // namespace rush
 
@@ -0,0 +1,141 @@
+/*
+ * mathimage.h - Declaration of the binary image format of MathProgram
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHIMAGE_H_
+#define _RUSH_MATHIMAGE_H_
+
+
+#include <rush/mathopcode.h>
+#include <rush/string.h>
+#include <string.h>
+
+
+namespace rush {
+
+
+/// \brief Magic bytes at the begin of every image.
+const char MathImageMagic[8] = { 'R', 'U', 'S', 'H', 'M', 'A', 'T', 'H' };
+
+/// \brief Version of the images, which are written by MathProgram::SaveImage().
+const unsigned int MathImageVersion = 1;
+
+/// \brief Written in the byte order of the machine, detects images of other platforms.
+const unsigned int MathImageByteOrder = 0x01020304;
+
+/// \brief Alignment of the image and of all its sections.
+const size_t MathImageAlignment = 16;
+
+
+/**
+ * \brief The MathImageHeader struct is the begin of a binary image of a
+ * MathProgram. The image is written in the byte order and the type sizes of
+ * the machine, so the instructions and the initial values can be used in
+ * place. The header is followed by these sections, each aligned to
+ * MathImageAlignment:
+ * - Instructions: CodeCount MathInstruction structs, the padding bytes are zero.
+ * - Values: CountVariables initial values (double).
+ * - Names: for every variable the name and for every function the number of
+ *   arguments and the name. Numbers are unsigned int, a name is its length
+ *   (unsigned int) followed by the ASCII characters without termination.
+ *
+ * The numbers of MathOpcodeType and the layout of this header are part of
+ * the format. Changing them requires a new MathImageVersion, while images of
+ * older versions must still be loadable.
+ **/
+struct MathImageHeader
+{
+    /// \brief Magic bytes (MathImageMagic).
+    char Magic[8];
+    /// \brief Format version (MathImageVersion).
+    unsigned int Version;
+    /// \brief Byte order mark (MathImageByteOrder).
+    unsigned int ByteOrder;
+    /// \brief Size of MathInstruction in bytes.
+    unsigned int InstructionSize;
+    /// \brief Size of the instruction index (size_t) in bytes.
+    unsigned int IndexSize;
+    /// \brief Size of the whole image in bytes.
+    unsigned long long ImageSize;
+    /// \brief Number of instructions.
+    unsigned long long CodeCount;
+    /// \brief Stack depth, including the temporary values.
+    unsigned long long StackDepth;
+    /// \brief Number of temporary values.
+    unsigned long long CountTemporaries;
+    /// \brief Number of variables.
+    unsigned long long CountVariables;
+    /// \brief Number of functions.
+    unsigned long long CountFunctions;
+    /// \brief Offset of the instructions from the begin of the image.
+    unsigned long long CodeOffset;
+    /// \brief Offset of the initial values from the begin of the image.
+    unsigned long long ValuesOffset;
+    /// \brief Offset of the names from the begin of the image.
+    unsigned long long NamesOffset;
+};
+
+
+/**
+ * \brief Rounds an offset up to the next multible of MathImageAlignment.
+ * \param offset Offset in bytes.
+ * \return Aligned offset.
+ **/
+inline size_t MathImageAlign(size_t offset)
+{
+    return ((offset + MathImageAlignment - 1) / MathImageAlignment * MathImageAlignment);
+}
+
+
+/**
+ * \brief Reads a number of the names section.
+ * \param data Read position, is moved behind the number.
+ * \param end End of the image.
+ * \param number Receives the number.
+ * \return True, if the number was read; false, if the image ends.
+ **/
+inline bool MathImageReadNumber(const char** data, const char* end, unsigned int* number)
+{
+    if ((size_t)(end - *data) < sizeof(unsigned int))
+    {
+        return (false);
+    }
+    memcpy(number, *data, sizeof(unsigned int));
+    *data += sizeof(unsigned int);
+    return (true);
+}
+
+
+/**
+ * \brief Reads a name of the names section.
+ * \param data Read position, is moved behind the name.
+ * \param end End of the image.
+ * \param name Receives the name.
+ * \return True, if the name was read; false, if the image ends.
+ **/
+inline bool MathImageReadName(const char** data, const char* end, String* name)
+{
+    unsigned int length = 0;
+    if (!MathImageReadNumber(data, end, &length) || (size_t)(end - *data) < length)
+    {
+        return (false);
+    }
+    *name = String((Char)' ', length);
+    for (size_t c=0; c<length; ++c)
+    {
+        (*name)[c] = (Char)(*data)[c];
+    }
+    *data += length;
+    return (true);
+}
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHIMAGE_H_
@@ -0,0 +1,626 @@
+/*
+ * mathjit.cpp - Implementation of the MathJit class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2011-2012 - Steffen Ott
+ *
+ */
+
+
+#include "mathjit.h"
+#include <string.h>
+#include <math.h>
+
+#ifdef _RUSH_MATHJIT_SUPPORTED_
+    #include <sys/mman.h>
+#endif
+
+
+namespace rush {
+
+
+// Registers of the generated code
+const int JitRax = 0;
+const int JitRdx = 2;
+const int JitRbx = 3;
+const int JitRsi = 6;
+const int JitRdi = 7;
+const int JitR12 = 12;
+
+// Stack values 0 to JitRegisterSlots-1 are stored in xmm2 to xmm13,
+// xmm0 and xmm1 are scratch registers, xmm14 holds comparison masks.
+const size_t JitRegisterSlots = 12;
+const int JitFirstSlotRegister = 2;
+const int JitMaskRegister = 14;
+
+// SSE2 opcodes (prefix, opcode)
+const unsigned char JitMovsdLoad = 0x10;
+const unsigned char JitMovsdStore = 0x11;
+const unsigned char JitAddsd = 0x58;
+const unsigned char JitMulsd = 0x59;
+const unsigned char JitSubsd = 0x5C;
+const unsigned char JitDivsd = 0x5E;
+const unsigned char JitXorpd = 0x57;
+const unsigned char JitMovapd = 0x28;
+const unsigned char JitMovq = 0x6E;
+const unsigned char JitSqrtsd = 0x51;
+const unsigned char JitAndpd = 0x54;
+const unsigned char JitAndnpd = 0x55;
+const unsigned char JitOrpd = 0x56;
+const unsigned char JitCmpsd = 0xC2;
+
+// Predicates of cmpsd, the ordered ones are false for NaN
+const unsigned char JitCmpEqual = 0;
+const unsigned char JitCmpLess = 1;
+const unsigned char JitCmpLessEqual = 2;
+const unsigned char JitCmpNotEqual = 4;
+
+
+//-----------------------------------------------------------------------------
+double MathJitCallFunction(MathFunction* function, double* values, size_t num)
+/**
+ * \brief Called by the generated code to evaluate a function.
+ * \param function Function.
+ * \param values Arguments.
+ * \param num Number of arguments.
+ * \return Result of the function.
+ **/
+{
+    return (function->Evaluate(values, num));
+}
+
+
+//-----------------------------------------------------------------------------
+void* MathJitIntrinsic(MathOpcodeType type)
+/**
+ * \brief Returns the math library function, which the generated code calls
+ * for an intrinsic opcode.
+ * \param type Opcode type.
+ * \return Address of the function or NULL, if the opcode is not a call.
+ **/
+{
+    switch (type)
+    {
+        case MathOpcodeType::Exp:   return ((void*)(double (*)(double))&exp);
+        case MathOpcodeType::Ln:    return ((void*)(double (*)(double))&log);
+        case MathOpcodeType::Log10: return ((void*)(double (*)(double))&log10);
+        case MathOpcodeType::Pow:   return ((void*)(double (*)(double, double))&pow);
+        case MathOpcodeType::Mod:   return ((void*)(double (*)(double, double))&fmod);
+        case MathOpcodeType::Floor: return ((void*)(double (*)(double))&floor);
+        case MathOpcodeType::Ceil:  return ((void*)(double (*)(double))&ceil);
+        case MathOpcodeType::Sin:   return ((void*)(double (*)(double))&sin);
+        case MathOpcodeType::Cos:   return ((void*)(double (*)(double))&cos);
+        case MathOpcodeType::Tan:   return ((void*)(double (*)(double))&tan);
+        default:                    return (NULL);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+MathJit::MathJit()
+/**
+ * \brief Constructor, initializes the MathJit object.
+ **/
+{
+    m_buffer = NULL;
+    m_size = 0;
+    m_capacity = 0;
+    m_memory = NULL;
+    m_memorySize = 0;
+    m_function = NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+MathJit::~MathJit()
+/**
+ * \brief Destructor, frees the native code.
+ **/
+{
+    this->Clear();
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathJit::IsSupported()
+/**
+ * \brief Checks if native code can be generated for this platform.
+ * \return True, if the JIT is supported; otherwise false.
+ **/
+{
+    #ifdef _RUSH_MATHJIT_SUPPORTED_
+    return (true);
+    #else
+    return (false);
+    #endif
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathJit::Compile(const MathInstruction* code, size_t count, size_t temporaries,
+                      MathFunction* const* functions)
+/**
+ * \brief Generates native code for the given instructions. The code must be
+ * checked before (valid indices and no stack underflow).
+ * \param code Instructions.
+ * \param count Number of instructions.
+ * \param temporaries Number of temporary values at the bottom of the stack memory.
+ * \param functions Functions which are referenced by the code.
+ * \return True, if native code was generated; otherwise false.
+ **/
+{
+    this->Clear();
+    #ifndef _RUSH_MATHJIT_SUPPORTED_
+    return (false);
+    #else
+    m_capacity = 1024 + count*32;
+    m_buffer = new unsigned char[m_capacity];
+    m_size = 0;
+
+    // Prologue: rbx = values, r12 = stack memory after the temporary values,
+    // the stack pointer is aligned to 16 bytes for function calls.
+    this->EmitByte(0x53);                                           // push rbx
+    this->EmitByte(0x41); this->EmitByte(0x54);                     // push r12
+    this->EmitByte(0x48); this->EmitByte(0x83); this->EmitByte(0xEC); this->EmitByte(0x08); // sub rsp, 8
+    this->EmitByte(0x48); this->EmitByte(0x89); this->EmitByte(0xFB); // mov rbx, rdi
+    this->EmitByte(0x4C); this->EmitByte(0x8D); this->EmitByte(0xA6); // lea r12, [rsi + temporaries*8]
+    this->EmitInt32(temporaries*8);
+
+    size_t depth = 0;
+    for (size_t i=0; i<count; ++i)
+    {
+        // Make sure the instruction and the epilogue fit into the buffer
+        if (m_capacity - m_size < 128 + 2*JitRegisterSlots*16)
+        {
+            unsigned char* buffer = new unsigned char[m_capacity*2];
+            memcpy(buffer, m_buffer, m_size);
+            delete [] m_buffer;
+            m_buffer = buffer;
+            m_capacity *= 2;
+        }
+
+        const MathInstruction& instruction = code[i];
+        switch (instruction.Type)
+        {
+            case MathOpcodeType::LoadConstant:
+            {
+                long long bits;
+                memcpy(&bits, &instruction.Value, sizeof(bits));
+                this->EmitMoveImmediate(JitRax, bits);
+                // movq xmm0, rax
+                this->EmitByte(0x66); this->EmitByte(0x48); this->EmitByte(0x0F);
+                this->EmitByte(JitMovq); this->EmitByte(0xC0);
+                this->StoreSlot(depth, 0);
+                depth += 1;
+                break;
+            }
+            case MathOpcodeType::LoadVariable:
+                if (depth < JitRegisterSlots) {
+                    this->EmitSseMemory(0xF2, JitMovsdLoad, JitFirstSlotRegister+depth, JitRbx, instruction.Index*8);
+                } else {
+                    this->EmitSseMemory(0xF2, JitMovsdLoad, 0, JitRbx, instruction.Index*8);
+                    this->StoreSlot(depth, 0);
+                }
+                depth += 1;
+                break;
+            case MathOpcodeType::SaveVariable:
+            {
+                depth -= 1;
+                int reg = this->LoadSlot(depth, 0);
+                this->EmitSseMemory(0xF2, JitMovsdStore, reg, JitRbx, instruction.Index*8);
+                break;
+            }
+            case MathOpcodeType::CallFunction:
+            {
+                MathFunction* function = functions[instruction.Index];
+                size_t args = function->GetArgs();
+                void* native = function->GetNative();
+                if (native != NULL && args >= 1 && args <= 3)
+                {
+                    // The arguments are passed in xmm0 to xmm2, the first one is moved first,
+                    // because the slot registers start at xmm2
+                    this->Spill(depth-args);
+                    for (size_t a=0; a<args; ++a)
+                    {
+                        int reg = this->LoadSlot(depth-args+a, (int)a);
+                        if (reg != (int)a) this->EmitSse(0x66, JitMovapd, (int)a, reg);
+                    }
+                    this->EmitMoveImmediate(JitRax, (long long)native);
+                    this->EmitByte(0xFF); this->EmitByte(0xD0);         // call rax
+                    depth -= args;
+                    this->Reload(depth);
+                    this->StoreSlot(depth, 0);
+                    depth += 1;
+                    break;
+                }
+                this->Spill(depth);
+                depth -= args;
+                this->EmitMoveImmediate(JitRdi, (long long)function);
+                // lea rsi, [r12 + depth*8]
+                this->EmitByte(0x49); this->EmitByte(0x8D); this->EmitByte(0xB4); this->EmitByte(0x24);
+                this->EmitInt32(depth*8);
+                this->EmitMoveImmediate(JitRdx, (long long)args);
+                this->EmitMoveImmediate(JitRax, (long long)&MathJitCallFunction);
+                this->EmitByte(0xFF); this->EmitByte(0xD0);             // call rax
+                this->Reload(depth);
+                this->StoreSlot(depth, 0);
+                depth += 1;
+                break;
+            }
+            case MathOpcodeType::Add:
+            case MathOpcodeType::Sub:
+            case MathOpcodeType::Mul:
+            case MathOpcodeType::Div:
+            {
+                unsigned char opcode = JitAddsd;
+                if (instruction.Type == MathOpcodeType::Sub) opcode = JitSubsd;
+                if (instruction.Type == MathOpcodeType::Mul) opcode = JitMulsd;
+                if (instruction.Type == MathOpcodeType::Div) opcode = JitDivsd;
+                int a = this->LoadSlot(depth-2, 0);
+                if (depth-1 < JitRegisterSlots) {
+                    this->EmitSse(0xF2, opcode, a, JitFirstSlotRegister+depth-1);
+                } else {
+                    this->EmitSseMemory(0xF2, opcode, a, JitR12, (depth-1)*8);
+                }
+                this->StoreSlot(depth-2, a);
+                depth -= 1;
+                break;
+            }
+            case MathOpcodeType::Neg:
+            {
+                int a = this->LoadSlot(depth-1, 0);
+                this->EmitMoveImmediate(JitRax, (long long)0x8000000000000000ULL);
+                // movq xmm1, rax
+                this->EmitByte(0x66); this->EmitByte(0x48); this->EmitByte(0x0F);
+                this->EmitByte(JitMovq); this->EmitByte(0xC8);
+                this->EmitSse(0x66, JitXorpd, a, 1);
+                this->StoreSlot(depth-1, a);
+                break;
+            }
+            case MathOpcodeType::Double:
+            {
+                int a = this->LoadSlot(depth-1, 0);
+                this->StoreSlot(depth, a);
+                depth += 1;
+                break;
+            }
+            case MathOpcodeType::LoadTemporary:
+            {
+                int offset = ((int)instruction.Index - (int)temporaries)*8;
+                if (depth < JitRegisterSlots) {
+                    this->EmitSseMemory(0xF2, JitMovsdLoad, JitFirstSlotRegister+depth, JitR12, offset);
+                } else {
+                    this->EmitSseMemory(0xF2, JitMovsdLoad, 0, JitR12, offset);
+                    this->StoreSlot(depth, 0);
+                }
+                depth += 1;
+                break;
+            }
+            case MathOpcodeType::StoreTemporary:
+            {
+                int offset = ((int)instruction.Index - (int)temporaries)*8;
+                int reg = this->LoadSlot(depth-1, 0);
+                this->EmitSseMemory(0xF2, JitMovsdStore, reg, JitR12, offset);
+                break;
+            }
+            case MathOpcodeType::Abs:
+            {
+                int a = this->LoadSlot(depth-1, 0);
+                this->EmitMoveImmediate(JitRax, (long long)0x7FFFFFFFFFFFFFFFULL);
+                // movq xmm1, rax
+                this->EmitByte(0x66); this->EmitByte(0x48); this->EmitByte(0x0F);
+                this->EmitByte(JitMovq); this->EmitByte(0xC8);
+                this->EmitSse(0x66, JitAndpd, a, 1);
+                this->StoreSlot(depth-1, a);
+                break;
+            }
+            case MathOpcodeType::Sqrt:
+            {
+                int a = this->LoadSlot(depth-1, 0);
+                this->EmitSse(0xF2, JitSqrtsd, a, a);
+                this->StoreSlot(depth-1, a);
+                break;
+            }
+            case MathOpcodeType::Pow:
+            case MathOpcodeType::Mod:
+            {
+                // The arguments are passed in xmm0 and xmm1
+                this->Spill(depth-2);
+                int b = this->LoadSlot(depth-1, 1);
+                if (b != 1) this->EmitSse(0x66, JitMovapd, 1, b);
+                int a = this->LoadSlot(depth-2, 0);
+                if (a != 0) this->EmitSse(0x66, JitMovapd, 0, a);
+                this->EmitMoveImmediate(JitRax, (long long)MathJitIntrinsic(instruction.Type));
+                this->EmitByte(0xFF); this->EmitByte(0xD0);             // call rax
+                depth -= 1;
+                this->Reload(depth-1);
+                this->StoreSlot(depth-1, 0);
+                break;
+            }
+            case MathOpcodeType::Exp:
+            case MathOpcodeType::Ln:
+            case MathOpcodeType::Log10:
+            case MathOpcodeType::Floor:
+            case MathOpcodeType::Ceil:
+            case MathOpcodeType::Sin:
+            case MathOpcodeType::Cos:
+            case MathOpcodeType::Tan:
+            {
+                // The argument is passed in xmm0
+                this->Spill(depth-1);
+                int a = this->LoadSlot(depth-1, 0);
+                if (a != 0) this->EmitSse(0x66, JitMovapd, 0, a);
+                this->EmitMoveImmediate(JitRax, (long long)MathJitIntrinsic(instruction.Type));
+                this->EmitByte(0xFF); this->EmitByte(0xD0);             // call rax
+                this->Reload(depth-1);
+                this->StoreSlot(depth-1, 0);
+                break;
+            }
+            case MathOpcodeType::Less:
+            case MathOpcodeType::LessEqual:
+            case MathOpcodeType::Greater:
+            case MathOpcodeType::GreaterEqual:
+            case MathOpcodeType::Equal:
+            case MathOpcodeType::NotEqual:
+            {
+                // a > b is compared as b < a, the mask is and'ed with 1.0
+                unsigned char predicate = JitCmpLess;
+                if (instruction.Type == MathOpcodeType::LessEqual || instruction.Type == MathOpcodeType::GreaterEqual) predicate = JitCmpLessEqual;
+                if (instruction.Type == MathOpcodeType::Equal) predicate = JitCmpEqual;
+                if (instruction.Type == MathOpcodeType::NotEqual) predicate = JitCmpNotEqual;
+                bool swapped = (instruction.Type == MathOpcodeType::Greater || instruction.Type == MathOpcodeType::GreaterEqual);
+                int a = this->LoadSlot(depth-2, 0);
+                int b = this->LoadSlot(depth-1, 1);
+                int result = a;
+                if (swapped)
+                {
+                    this->EmitSse(0x66, JitMovapd, JitMaskRegister, b);
+                    result = JitMaskRegister;
+                    b = a;
+                }
+                this->EmitSse(0xF2, JitCmpsd, result, b);
+                this->EmitByte(predicate);
+                this->EmitMoveImmediate(JitRax, (long long)0x3FF0000000000000ULL);
+                // movq xmm1, rax
+                this->EmitByte(0x66); this->EmitByte(0x48); this->EmitByte(0x0F);
+                this->EmitByte(JitMovq); this->EmitByte(0xC8);
+                this->EmitSse(0x66, JitAndpd, result, 1);
+                this->StoreSlot(depth-2, result);
+                depth -= 1;
+                break;
+            }
+            case MathOpcodeType::Select:
+            {
+                // mask = (c != 0), result = (a & mask) | (b & ~mask)
+                int c = this->LoadSlot(depth-3, 0);
+                this->EmitSse(0x66, JitXorpd, JitMaskRegister, JitMaskRegister);
+                this->EmitSse(0xF2, JitCmpsd, JitMaskRegister, c);
+                this->EmitByte(JitCmpNotEqual);
+                int a = this->LoadSlot(depth-2, 0);
+                this->EmitSse(0x66, JitAndpd, a, JitMaskRegister);
+                int b = this->LoadSlot(depth-1, 1);
+                this->EmitSse(0x66, JitAndnpd, JitMaskRegister, b);
+                this->EmitSse(0x66, JitOrpd, a, JitMaskRegister);
+                this->StoreSlot(depth-3, a);
+                depth -= 2;
+                break;
+            }
+            case MathOpcodeType::Nop:
+                break;
+            default:
+                this->Clear();
+                return (false);
+        }
+    }
+
+    // Epilogue
+    this->EmitByte(0x48); this->EmitByte(0x83); this->EmitByte(0xC4); this->EmitByte(0x08); // add rsp, 8
+    this->EmitByte(0x41); this->EmitByte(0x5C);                     // pop r12
+    this->EmitByte(0x5B);                                           // pop rbx
+    this->EmitByte(0xC3);                                           // ret
+
+    // Copy the code into executable memory
+    m_memorySize = m_size;
+    m_memory = mmap(NULL, m_memorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (m_memory == MAP_FAILED)
+    {
+        m_memory = NULL;
+        this->Clear();
+        return (false);
+    }
+    memcpy(m_memory, m_buffer, m_size);
+    if (mprotect(m_memory, m_memorySize, PROT_READ | PROT_EXEC) != 0)
+    {
+        this->Clear();
+        return (false);
+    }
+    delete [] m_buffer;
+    m_buffer = NULL;
+    m_function = (MathJitFunction)m_memory;
+    return (true);
+    #endif
+}
+
+
+//-----------------------------------------------------------------------------
+void MathJit::Clear()
+/**
+ * \brief Frees the generated code.
+ **/
+{
+    if (m_buffer != NULL)
+    {
+        delete [] m_buffer;
+        m_buffer = NULL;
+    }
+    #ifdef _RUSH_MATHJIT_SUPPORTED_
+    if (m_memory != NULL)
+    {
+        munmap(m_memory, m_memorySize);
+    }
+    #endif
+    m_memory = NULL;
+    m_memorySize = 0;
+    m_function = NULL;
+    m_size = 0;
+    m_capacity = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathJit::EmitByte(unsigned char value)
+{
+    m_buffer[m_size++] = value;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathJit::EmitInt32(int value)
+{
+    memcpy(m_buffer + m_size, &value, 4);
+    m_size += 4;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathJit::EmitInt64(long long value)
+{
+    memcpy(m_buffer + m_size, &value, 8);
+    m_size += 8;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathJit::EmitSse(unsigned char prefix, unsigned char opcode, int reg, int rm)
+/**
+ * \brief Emits a SSE instruction with two xmm registers.
+ * \param prefix Mandatory prefix (0xF2 or 0x66).
+ * \param opcode Opcode after 0x0F.
+ * \param reg Destination register.
+ * \param rm Source register.
+ **/
+{
+    this->EmitByte(prefix);
+    if (reg >= 8 || rm >= 8)
+    {
+        this->EmitByte(0x40 | (reg >= 8 ? 0x04 : 0x00) | (rm >= 8 ? 0x01 : 0x00));
+    }
+    this->EmitByte(0x0F);
+    this->EmitByte(opcode);
+    this->EmitByte(0xC0 | ((reg & 7) << 3) | (rm & 7));
+}
+
+
+//-----------------------------------------------------------------------------
+void MathJit::EmitSseMemory(unsigned char prefix, unsigned char opcode, int reg, int base, int displacement)
+/**
+ * \brief Emits a SSE instruction with a xmm register and a memory operand.
+ * \param prefix Mandatory prefix (0xF2 or 0x66).
+ * \param opcode Opcode after 0x0F.
+ * \param reg Xmm register.
+ * \param base General purpose register with the base address.
+ * \param displacement Displacement to the base address.
+ **/
+{
+    this->EmitByte(prefix);
+    if (reg >= 8 || base >= 8)
+    {
+        this->EmitByte(0x40 | (reg >= 8 ? 0x04 : 0x00) | (base >= 8 ? 0x01 : 0x00));
+    }
+    this->EmitByte(0x0F);
+    this->EmitByte(opcode);
+    this->EmitByte(0x80 | ((reg & 7) << 3) | (base & 7));
+    if ((base & 7) == 4)
+    {
+        this->EmitByte(0x24); // SIB for rsp/r12 as base
+    }
+    this->EmitInt32(displacement);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathJit::EmitMoveImmediate(int reg, long long value)
+/**
+ * \brief Emits mov reg, imm64 for the registers rax to rdi.
+ * \param reg General purpose register.
+ * \param value Value.
+ **/
+{
+    this->EmitByte(0x48);
+    this->EmitByte(0xB8 + reg);
+    this->EmitInt64(value);
+}
+
+
+//-----------------------------------------------------------------------------
+int MathJit::LoadSlot(size_t slot, int scratch)
+/**
+ * \brief Returns the register which contains the stack value. Stack values
+ * in memory are loaded into the scratch register.
+ * \param slot Stack slot.
+ * \param scratch Scratch register.
+ * \return Register.
+ **/
+{
+    if (slot < JitRegisterSlots)
+    {
+        return (JitFirstSlotRegister + slot);
+    }
+    this->EmitSseMemory(0xF2, JitMovsdLoad, scratch, JitR12, slot*8);
+    return (scratch);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathJit::StoreSlot(size_t slot, int reg)
+/**
+ * \brief Moves the register into the stack value.
+ * \param slot Stack slot.
+ * \param reg Register.
+ **/
+{
+    if (slot < JitRegisterSlots)
+    {
+        if (reg != (int)(JitFirstSlotRegister + slot))
+        {
+            this->EmitSse(0x66, JitMovapd, JitFirstSlotRegister + slot, reg);
+        }
+    }
+    else
+    {
+        this->EmitSseMemory(0xF2, JitMovsdStore, reg, JitR12, slot*8);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+void MathJit::Spill(size_t count)
+/**
+ * \brief Stores the stack values in registers into the stack memory. Needed
+ * before function calls, because all xmm registers are volatile.
+ * \param count Number of stack values.
+ **/
+{
+    for (size_t i=0; i<count && i<JitRegisterSlots; ++i)
+    {
+        this->EmitSseMemory(0xF2, JitMovsdStore, JitFirstSlotRegister + i, JitR12, i*8);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+void MathJit::Reload(size_t count)
+/**
+ * \brief Loads the stack values from the stack memory into the registers.
+ * \param count Number of stack values.
+ **/
+{
+    for (size_t i=0; i<count && i<JitRegisterSlots; ++i)
+    {
+        this->EmitSseMemory(0xF2, JitMovsdLoad, JitFirstSlotRegister + i, JitR12, i*8);
+    }
+}
+
+
+} // namespace rush
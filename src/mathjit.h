@@ -0,0 +1,91 @@
+/*
+ * mathjit.h - Declaration of the MathJit class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2011-2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHJIT_H_
+#define _RUSH_MATHJIT_H_
+
+
+#include <rush/mathevaluation.h>
+
+
+// The JIT supports x86-64 with the System V calling convention (Linux, BSD, Mac OS X)
+#if (defined(__x86_64__) || defined(__amd64__)) && !defined(_WIN32)
+    #define _RUSH_MATHJIT_SUPPORTED_
+#endif
+
+
+namespace rush {
+
+
+/**
+ * \brief Signature of the native code generated by the MathJit class.
+ * The first argument are the variable values, the second argument is
+ * memory for the stack values which don't fit into registers.
+ **/
+typedef void (*MathJitFunction)(double* values, double* stack);
+
+
+/**
+ * \brief The MathJit class translates the flat instructions of a MathEvaluation
+ * into native x86-64 code. All calculations are done with SSE2 scalar double
+ * instructions, which give the same results as the interpreter. The first
+ * stack values are kept in the registers xmm2 to xmm13, deeper values are
+ * stored in the stack memory. Functions are called through a small helper
+ * with the arguments taken directly from the stack memory. The intrinsics
+ * sqrt and abs are single instructions, the other intrinsics call the math
+ * library directly. Comparisons and select are computed with masks (cmpsd,
+ * andpd, andnpd and orpd) without branches.
+ **/
+class MathJit
+{
+    public:
+        MathJit();
+        ~MathJit();
+
+        static bool IsSupported();
+
+        bool Compile(const MathInstruction* code, size_t count, size_t temporaries,
+                     MathFunction* const* functions);
+
+        /**
+         * \brief Executes the compiled native code.
+         * \param values Variable values.
+         * \param stack Stack memory, must have room for the temporary values and
+         * the full stack depth.
+         **/
+        inline void Execute(double* values, double* stack) const
+        { m_function(values, stack); }
+
+    private:
+        void Clear();
+        void EmitByte(unsigned char value);
+        void EmitInt32(int value);
+        void EmitInt64(long long value);
+        void EmitSse(unsigned char prefix, unsigned char opcode, int reg, int rm);
+        void EmitSseMemory(unsigned char prefix, unsigned char opcode, int reg, int base, int displacement);
+        void EmitMoveImmediate(int reg, long long value);
+        int LoadSlot(size_t slot, int scratch);
+        void StoreSlot(size_t slot, int reg);
+        void Spill(size_t count);
+        void Reload(size_t count);
+
+    private:
+        unsigned char* m_buffer;
+        size_t m_size;
+        size_t m_capacity;
+        void* m_memory;
+        size_t m_memorySize;
+        MathJitFunction m_function;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHJIT_H_
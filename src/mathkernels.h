@@ -0,0 +1,1357 @@
+/*
+ * mathkernels.h - Declaration and implementation of the vectorized math kernels
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2011-2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHKERNELS_H_
+#define _RUSH_MATHKERNELS_H_
+
+
+#include <stddef.h>
+#include <string.h>
+#include <math.h>
+#include <rush/buildinexpect.h>
+#include <rush/mathevaluation.h>
+#include "mathvector.h"
+#if defined(__AVX__)
+    #include <immintrin.h>
+#elif defined(__SSE2__)
+    #include <emmintrin.h>
+#endif
+
+
+namespace rush {
+
+
+/**
+ * \brief Number of rows which are processed by one opcode at once in
+ * MathEvaluation::ExecuteBatch().
+ **/
+const size_t MathBlockSize = 256;
+
+
+/**
+ * \brief Adds the values of b to the values of a (a[i] += b[i]).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelAdd(double* a, const double* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    for (; i+4<=count; i+=4)
+    {
+        _mm256_storeu_pd(a+i, _mm256_add_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i)));
+    }
+    #elif defined(__SSE2__)
+    for (; i+2<=count; i+=2)
+    {
+        _mm_storeu_pd(a+i, _mm_add_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] += b[i];
+    }
+}
+
+
+/**
+ * \brief Substracts the values of b from the values of a (a[i] -= b[i]).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelSub(double* a, const double* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    for (; i+4<=count; i+=4)
+    {
+        _mm256_storeu_pd(a+i, _mm256_sub_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i)));
+    }
+    #elif defined(__SSE2__)
+    for (; i+2<=count; i+=2)
+    {
+        _mm_storeu_pd(a+i, _mm_sub_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] -= b[i];
+    }
+}
+
+
+/**
+ * \brief Multiplies the values of a with the values of b (a[i] *= b[i]).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelMul(double* a, const double* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    for (; i+4<=count; i+=4)
+    {
+        _mm256_storeu_pd(a+i, _mm256_mul_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i)));
+    }
+    #elif defined(__SSE2__)
+    for (; i+2<=count; i+=2)
+    {
+        _mm_storeu_pd(a+i, _mm_mul_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] *= b[i];
+    }
+}
+
+
+/**
+ * \brief Divides the values of a by the values of b (a[i] /= b[i]).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelDiv(double* a, const double* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    for (; i+4<=count; i+=4)
+    {
+        _mm256_storeu_pd(a+i, _mm256_div_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i)));
+    }
+    #elif defined(__SSE2__)
+    for (; i+2<=count; i+=2)
+    {
+        _mm_storeu_pd(a+i, _mm_div_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] /= b[i];
+    }
+}
+
+
+/**
+ * \brief Negates the values of a (a[i] = -a[i]).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelNeg(double* a, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    for (; i+4<=count; i+=4)
+    {
+        _mm256_storeu_pd(a+i, _mm256_xor_pd(_mm256_loadu_pd(a+i), sign));
+    }
+    #elif defined(__SSE2__)
+    const __m128d sign = _mm_set1_pd(-0.0);
+    for (; i+2<=count; i+=2)
+    {
+        _mm_storeu_pd(a+i, _mm_xor_pd(_mm_loadu_pd(a+i), sign));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] = -a[i];
+    }
+}
+
+
+/**
+ * \brief Replaces the values of a by their absolute values (a[i] = |a[i]|).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelAbs(double* a, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    for (; i+4<=count; i+=4)
+    {
+        _mm256_storeu_pd(a+i, _mm256_andnot_pd(sign, _mm256_loadu_pd(a+i)));
+    }
+    #elif defined(__SSE2__)
+    const __m128d sign = _mm_set1_pd(-0.0);
+    for (; i+2<=count; i+=2)
+    {
+        _mm_storeu_pd(a+i, _mm_andnot_pd(sign, _mm_loadu_pd(a+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] = fabs(a[i]);
+    }
+}
+
+
+/**
+ * \brief Replaces the values of a by their square roots (a[i] = sqrt(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelSqrt(double* a, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    for (; i+4<=count; i+=4)
+    {
+        _mm256_storeu_pd(a+i, _mm256_sqrt_pd(_mm256_loadu_pd(a+i)));
+    }
+    #elif defined(__SSE2__)
+    for (; i+2<=count; i+=2)
+    {
+        _mm_storeu_pd(a+i, _mm_sqrt_pd(_mm_loadu_pd(a+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] = sqrt(a[i]);
+    }
+}
+
+
+/**
+ * \brief Applies a math library function to the values of a (a[i] = f(a[i])).
+ * The function is a template argument, so it is called directly.
+ * \param a Destination and operand.
+ * \param count Number of values.
+ **/
+template <double (*Function)(double)>
+inline void MathKernelApply(double* a, size_t count)
+{
+    for (size_t i=0; i<count; ++i)
+    {
+        a[i] = Function(a[i]);
+    }
+}
+
+
+/**
+ * \brief Applies a math library function with two arguments to the values of
+ * a and b (a[i] = f(a[i], b[i])).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+template <double (*Function)(double, double)>
+inline void MathKernelApply(double* a, const double* b, size_t count)
+{
+    for (size_t i=0; i<count; ++i)
+    {
+        a[i] = Function(a[i], b[i]);
+    }
+}
+
+
+#ifdef _RUSH_MATHVECTOR_SUPPORTED_
+
+/**
+ * \brief Applies a vectorized function to the values of a (a[i] = f(a[i])).
+ * The last values are padded to a whole vector. The lanes, which the vectorized
+ * function cannot calculate, are calculated by the math library function.
+ * \param a Destination and operand.
+ * \param count Number of values.
+ **/
+template <MathVector (*Vector)(MathVector, MathVectorInt*), double (*Function)(double)>
+inline void MathKernelVector(double* a, size_t count)
+{
+    for (size_t i=0; i<count; i+=MathVectorSize)
+    {
+        // Whole vectors are loaded and stored at once, only the last one is padded
+        size_t n = (count - i < MathVectorSize ? count - i : MathVectorSize);
+        MathVector x = MathVectorSet(1.0);
+        if (likely(n == MathVectorSize)) memcpy(&x, a+i, sizeof(MathVector));
+        else memcpy(&x, a+i, n*sizeof(double));
+        MathVectorInt fallback;
+        MathVector y = Vector(x, &fallback);
+        if (unlikely(MathVectorAny(fallback)))
+        {
+            for (size_t j=0; j<n; ++j)
+            {
+                if (fallback[j]) y[j] = Function(x[j]);
+            }
+        }
+        if (likely(n == MathVectorSize)) memcpy(a+i, &y, sizeof(MathVector));
+        else memcpy(a+i, &y, n*sizeof(double));
+    }
+}
+
+
+/**
+ * \brief Applies a vectorized function with two arguments to the values of
+ * a and b (a[i] = f(a[i], b[i])).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+template <MathVector (*Vector)(MathVector, MathVector, MathVectorInt*), double (*Function)(double, double)>
+inline void MathKernelVector(double* a, const double* b, size_t count)
+{
+    for (size_t i=0; i<count; i+=MathVectorSize)
+    {
+        size_t n = (count - i < MathVectorSize ? count - i : MathVectorSize);
+        MathVector x = MathVectorSet(1.0);
+        MathVector z = MathVectorSet(1.0);
+        if (likely(n == MathVectorSize))
+        {
+            memcpy(&x, a+i, sizeof(MathVector));
+            memcpy(&z, b+i, sizeof(MathVector));
+        }
+        else
+        {
+            memcpy(&x, a+i, n*sizeof(double));
+            memcpy(&z, b+i, n*sizeof(double));
+        }
+        MathVectorInt fallback;
+        MathVector y = Vector(x, z, &fallback);
+        if (unlikely(MathVectorAny(fallback)))
+        {
+            for (size_t j=0; j<n; ++j)
+            {
+                if (fallback[j]) y[j] = Function(x[j], z[j]);
+            }
+        }
+        if (likely(n == MathVectorSize)) memcpy(a+i, &y, sizeof(MathVector));
+        else memcpy(a+i, &y, n*sizeof(double));
+    }
+}
+
+#endif // _RUSH_MATHVECTOR_SUPPORTED_
+
+
+/**
+ * \brief Replaces the values of a by e^x (a[i] = exp(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelExp(double* a, size_t count, MathAccuracy accuracy)
+{
+    #ifdef _RUSH_MATHVECTOR_SUPPORTED_
+    if (accuracy == MathAccuracy::Precise)
+    {
+        MathKernelVector<MathVectorExp, exp>(a, count);
+        return;
+    }
+    if (accuracy == MathAccuracy::Fast)
+    {
+        MathKernelVector<MathVectorExpFast, exp>(a, count);
+        return;
+    }
+    #endif
+    MathKernelApply<exp>(a, count);
+}
+
+
+/**
+ * \brief Replaces the values of a by the natural logarithmus (a[i] = ln(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelLn(double* a, size_t count, MathAccuracy accuracy)
+{
+    #ifdef _RUSH_MATHVECTOR_SUPPORTED_
+    if (accuracy == MathAccuracy::Precise)
+    {
+        MathKernelVector<MathVectorLn, log>(a, count);
+        return;
+    }
+    if (accuracy == MathAccuracy::Fast)
+    {
+        MathKernelVector<MathVectorLnFast, log>(a, count);
+        return;
+    }
+    #endif
+    MathKernelApply<log>(a, count);
+}
+
+
+/**
+ * \brief Replaces the values of a by the sinus (a[i] = sin(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelSin(double* a, size_t count, MathAccuracy accuracy)
+{
+    #ifdef _RUSH_MATHVECTOR_SUPPORTED_
+    if (accuracy == MathAccuracy::Precise)
+    {
+        MathKernelVector<MathVectorSin, sin>(a, count);
+        return;
+    }
+    if (accuracy == MathAccuracy::Fast)
+    {
+        MathKernelVector<MathVectorSinFast, sin>(a, count);
+        return;
+    }
+    #endif
+    MathKernelApply<sin>(a, count);
+}
+
+
+/**
+ * \brief Replaces the values of a by the cosinus (a[i] = cos(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelCos(double* a, size_t count, MathAccuracy accuracy)
+{
+    #ifdef _RUSH_MATHVECTOR_SUPPORTED_
+    if (accuracy == MathAccuracy::Precise)
+    {
+        MathKernelVector<MathVectorCos, cos>(a, count);
+        return;
+    }
+    if (accuracy == MathAccuracy::Fast)
+    {
+        MathKernelVector<MathVectorCosFast, cos>(a, count);
+        return;
+    }
+    #endif
+    MathKernelApply<cos>(a, count);
+}
+
+
+/**
+ * \brief Replaces the values of a by the tangens (a[i] = tan(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelTan(double* a, size_t count, MathAccuracy accuracy)
+{
+    #ifdef _RUSH_MATHVECTOR_SUPPORTED_
+    if (accuracy == MathAccuracy::Precise)
+    {
+        MathKernelVector<MathVectorTan, tan>(a, count);
+        return;
+    }
+    if (accuracy == MathAccuracy::Fast)
+    {
+        MathKernelVector<MathVectorTanFast, tan>(a, count);
+        return;
+    }
+    #endif
+    MathKernelApply<tan>(a, count);
+}
+
+
+/**
+ * \brief Replaces the values of a by the powers a^b (a[i] = pow(a[i], b[i])).
+ * \param a Destination and base.
+ * \param b Exponent.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelPow(double* a, const double* b, size_t count, MathAccuracy accuracy)
+{
+    #ifdef _RUSH_MATHVECTOR_SUPPORTED_
+    // The double-double arithmetic of the precise function is only faster
+    // than the math library with four lanes (AVX)
+    if (accuracy == MathAccuracy::Precise && MathVectorSize >= 4)
+    {
+        MathKernelVector<MathVectorPow, pow>(a, b, count);
+        return;
+    }
+    if (accuracy == MathAccuracy::Fast)
+    {
+        MathKernelVector<MathVectorPowFast, pow>(a, b, count);
+        return;
+    }
+    #endif
+    MathKernelApply<pow>(a, b, count);
+}
+
+
+/**
+ * \brief Sets all values of a to the given value.
+ * \param a Destination.
+ * \param value Value, is rounded to the type of the destination.
+ * \param count Number of values.
+ **/
+template <typename T>
+inline void MathKernelFill(T* a, double value, size_t count)
+{
+    T filled = (T)value;
+    for (size_t i=0; i<count; ++i)
+    {
+        a[i] = filled;
+    }
+}
+
+
+//------------------------------------------------- Reduction kernels
+// The reductions use two vector accumulators to hide the latency of the
+// additions, so the sums are added in another order than a plain loop.
+
+/**
+ * \brief Adds up the values of a.
+ * \param a Values.
+ * \param count Number of values.
+ * \return Sum, zero for no values.
+ **/
+inline double MathKernelSum(const double* a, size_t count)
+{
+    size_t i = 0;
+    double sum = 0.0d;
+    #if defined(__AVX__)
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+    for (; i+8<=count; i+=8)
+    {
+        sum0 = _mm256_add_pd(sum0, _mm256_loadu_pd(a+i));
+        sum1 = _mm256_add_pd(sum1, _mm256_loadu_pd(a+i+4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(sum0, sum1));
+    sum = (lanes[0]+lanes[1])+(lanes[2]+lanes[3]);
+    #elif defined(__SSE2__)
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+    for (; i+4<=count; i+=4)
+    {
+        sum0 = _mm_add_pd(sum0, _mm_loadu_pd(a+i));
+        sum1 = _mm_add_pd(sum1, _mm_loadu_pd(a+i+2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+    sum = lanes[0]+lanes[1];
+    #endif
+    for (; i<count; ++i)
+    {
+        sum += a[i];
+    }
+    return (sum);
+}
+
+
+/**
+ * \brief Multiplies the values of a with the values of b and adds up the products.
+ * \param a Left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ * \return Dot product, zero for no values.
+ **/
+inline double MathKernelDot(const double* a, const double* b, size_t count)
+{
+    size_t i = 0;
+    double sum = 0.0d;
+    #if defined(__AVX__)
+    __m256d sum0 = _mm256_setzero_pd();
+    __m256d sum1 = _mm256_setzero_pd();
+    for (; i+8<=count; i+=8)
+    {
+        sum0 = _mm256_add_pd(sum0, _mm256_mul_pd(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i)));
+        sum1 = _mm256_add_pd(sum1, _mm256_mul_pd(_mm256_loadu_pd(a+i+4), _mm256_loadu_pd(b+i+4)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(sum0, sum1));
+    sum = (lanes[0]+lanes[1])+(lanes[2]+lanes[3]);
+    #elif defined(__SSE2__)
+    __m128d sum0 = _mm_setzero_pd();
+    __m128d sum1 = _mm_setzero_pd();
+    for (; i+4<=count; i+=4)
+    {
+        sum0 = _mm_add_pd(sum0, _mm_mul_pd(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i)));
+        sum1 = _mm_add_pd(sum1, _mm_mul_pd(_mm_loadu_pd(a+i+2), _mm_loadu_pd(b+i+2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(sum0, sum1));
+    sum = lanes[0]+lanes[1];
+    #endif
+    for (; i<count; ++i)
+    {
+        sum += a[i]*b[i];
+    }
+    return (sum);
+}
+
+
+/**
+ * \brief Returns the smallest value of a. NaN values are propagated like
+ * by the other reductions, in every position.
+ * \param a Values.
+ * \param count Number of values, at least one.
+ * \return Minimum, NaN if a value is NaN.
+ **/
+inline double MathKernelMin(const double* a, size_t count)
+{
+    size_t i = 1;
+    double result = a[0];
+    #if defined(__AVX__)
+    if (count >= 4)
+    {
+        // The instruction ignores NaN in its first operand, so a mask collects them
+        __m256d min0 = _mm256_loadu_pd(a);
+        __m256d min1 = min0;
+        __m256d nan = _mm256_cmp_pd(min0, min0, _CMP_UNORD_Q);
+        for (i=4; i+8<=count; i+=8)
+        {
+            __m256d x0 = _mm256_loadu_pd(a+i);
+            __m256d x1 = _mm256_loadu_pd(a+i+4);
+            min0 = _mm256_min_pd(x0, min0);
+            min1 = _mm256_min_pd(x1, min1);
+            nan = _mm256_or_pd(nan, _mm256_cmp_pd(x0, x1, _CMP_UNORD_Q));
+        }
+        if (_mm256_movemask_pd(nan) != 0) return (NAN);
+        double lanes[4];
+        _mm256_storeu_pd(lanes, _mm256_min_pd(min0, min1));
+        result = lanes[0];
+        for (size_t l=1; l<4; ++l)
+        {
+            result = (lanes[l] < result ? lanes[l] : result);
+        }
+    }
+    #elif defined(__SSE2__)
+    if (count >= 2)
+    {
+        __m128d min0 = _mm_loadu_pd(a);
+        __m128d min1 = min0;
+        __m128d nan = _mm_cmpunord_pd(min0, min0);
+        for (i=2; i+4<=count; i+=4)
+        {
+            __m128d x0 = _mm_loadu_pd(a+i);
+            __m128d x1 = _mm_loadu_pd(a+i+2);
+            min0 = _mm_min_pd(x0, min0);
+            min1 = _mm_min_pd(x1, min1);
+            nan = _mm_or_pd(nan, _mm_cmpunord_pd(x0, x1));
+        }
+        if (_mm_movemask_pd(nan) != 0) return (NAN);
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_min_pd(min0, min1));
+        result = (lanes[1] < lanes[0] ? lanes[1] : lanes[0]);
+    }
+    #endif
+    for (; i<count && result == result; ++i)
+    {
+        result = (a[i] < result || a[i] != a[i] ? a[i] : result);
+    }
+    return (result);
+}
+
+
+/**
+ * \brief Returns the largest value of a. NaN values are propagated like
+ * by the other reductions, in every position.
+ * \param a Values.
+ * \param count Number of values, at least one.
+ * \return Maximum, NaN if a value is NaN.
+ **/
+inline double MathKernelMax(const double* a, size_t count)
+{
+    size_t i = 1;
+    double result = a[0];
+    #if defined(__AVX__)
+    if (count >= 4)
+    {
+        // The instruction ignores NaN in its first operand, so a mask collects them
+        __m256d max0 = _mm256_loadu_pd(a);
+        __m256d max1 = max0;
+        __m256d nan = _mm256_cmp_pd(max0, max0, _CMP_UNORD_Q);
+        for (i=4; i+8<=count; i+=8)
+        {
+            __m256d x0 = _mm256_loadu_pd(a+i);
+            __m256d x1 = _mm256_loadu_pd(a+i+4);
+            max0 = _mm256_max_pd(x0, max0);
+            max1 = _mm256_max_pd(x1, max1);
+            nan = _mm256_or_pd(nan, _mm256_cmp_pd(x0, x1, _CMP_UNORD_Q));
+        }
+        if (_mm256_movemask_pd(nan) != 0) return (NAN);
+        double lanes[4];
+        _mm256_storeu_pd(lanes, _mm256_max_pd(max0, max1));
+        result = lanes[0];
+        for (size_t l=1; l<4; ++l)
+        {
+            result = (lanes[l] > result ? lanes[l] : result);
+        }
+    }
+    #elif defined(__SSE2__)
+    if (count >= 2)
+    {
+        __m128d max0 = _mm_loadu_pd(a);
+        __m128d max1 = max0;
+        __m128d nan = _mm_cmpunord_pd(max0, max0);
+        for (i=2; i+4<=count; i+=4)
+        {
+            __m128d x0 = _mm_loadu_pd(a+i);
+            __m128d x1 = _mm_loadu_pd(a+i+2);
+            max0 = _mm_max_pd(x0, max0);
+            max1 = _mm_max_pd(x1, max1);
+            nan = _mm_or_pd(nan, _mm_cmpunord_pd(x0, x1));
+        }
+        if (_mm_movemask_pd(nan) != 0) return (NAN);
+        double lanes[2];
+        _mm_storeu_pd(lanes, _mm_max_pd(max0, max1));
+        result = (lanes[1] > lanes[0] ? lanes[1] : lanes[0]);
+    }
+    #endif
+    for (; i<count && result == result; ++i)
+    {
+        result = (a[i] > result || a[i] != a[i] ? a[i] : result);
+    }
+    return (result);
+}
+
+
+//------------------------------------------------- Comparison kernels
+// The comparisons and select(c, a, b) use masks with all bits set or cleared
+// per lane instead of branches, so piecewise formulas run without
+// mispredicted branches. The kernels exist for double and float values.
+
+/**
+ * \brief Compares two values, the comparison is a template argument.
+ * \param a Left operand.
+ * \param b Right operand.
+ * \return 1, if the comparison is true; otherwise 0.
+ **/
+template <MathOpcodeType Type, typename T>
+inline T MathCompare(T a, T b)
+{
+    bool result = (Type == MathOpcodeType::Less ? a < b :
+                   Type == MathOpcodeType::LessEqual ? a <= b :
+                   Type == MathOpcodeType::Greater ? a > b :
+                   Type == MathOpcodeType::GreaterEqual ? a >= b :
+                   Type == MathOpcodeType::Equal ? a == b : a != b);
+    return ((T)result);
+}
+
+
+/**
+ * \brief Selects a, if the condition is not zero, otherwise b. The value is
+ * selected with a mask instead of a branch, a NaN condition selects a.
+ * \param condition Condition.
+ * \param a Value, if the condition is true.
+ * \param b Value, if the condition is false.
+ * \return Selected value.
+ **/
+inline double MathSelect(double condition, double a, double b)
+{
+    unsigned long long mask = 0ULL - (unsigned long long)(condition != 0.0d);
+    unsigned long long bitsA, bitsB;
+    memcpy(&bitsA, &a, sizeof(a));
+    memcpy(&bitsB, &b, sizeof(b));
+    bitsA = (bitsA & mask) | (bitsB & ~mask);
+    memcpy(&a, &bitsA, sizeof(a));
+    return (a);
+}
+
+
+/**
+ * \brief Selects a, if the condition is not zero, otherwise b. The value is
+ * selected with a mask instead of a branch, a NaN condition selects a.
+ * \param condition Condition.
+ * \param a Value, if the condition is true.
+ * \param b Value, if the condition is false.
+ * \return Selected value.
+ **/
+inline float MathSelect(float condition, float a, float b)
+{
+    unsigned int mask = 0U - (unsigned int)(condition != 0.0f);
+    unsigned int bitsA, bitsB;
+    memcpy(&bitsA, &a, sizeof(a));
+    memcpy(&bitsB, &b, sizeof(b));
+    bitsA = (bitsA & mask) | (bitsB & ~mask);
+    memcpy(&a, &bitsA, sizeof(a));
+    return (a);
+}
+
+
+#if defined(__AVX__)
+/**
+ * \brief Compares the lanes of two vectors, the comparison is a template
+ * argument. Only != is true for NaN, like the comparison of scalars.
+ * \param a Left operand.
+ * \param b Right operand.
+ * \return Mask with all bits set in the lanes, where the comparison is true.
+ **/
+template <MathOpcodeType Type>
+inline __m256d MathCompareMask(__m256d a, __m256d b)
+{
+    switch (Type)
+    {
+        case MathOpcodeType::Less: return (_mm256_cmp_pd(a, b, _CMP_LT_OQ));
+        case MathOpcodeType::LessEqual: return (_mm256_cmp_pd(a, b, _CMP_LE_OQ));
+        case MathOpcodeType::Greater: return (_mm256_cmp_pd(a, b, _CMP_GT_OQ));
+        case MathOpcodeType::GreaterEqual: return (_mm256_cmp_pd(a, b, _CMP_GE_OQ));
+        case MathOpcodeType::Equal: return (_mm256_cmp_pd(a, b, _CMP_EQ_OQ));
+        default: return (_mm256_cmp_pd(a, b, _CMP_NEQ_UQ));
+    }
+}
+
+
+/**
+ * \brief Compares the lanes of two vectors, the comparison is a template
+ * argument. Only != is true for NaN, like the comparison of scalars.
+ * \param a Left operand.
+ * \param b Right operand.
+ * \return Mask with all bits set in the lanes, where the comparison is true.
+ **/
+template <MathOpcodeType Type>
+inline __m256 MathCompareMask(__m256 a, __m256 b)
+{
+    switch (Type)
+    {
+        case MathOpcodeType::Less: return (_mm256_cmp_ps(a, b, _CMP_LT_OQ));
+        case MathOpcodeType::LessEqual: return (_mm256_cmp_ps(a, b, _CMP_LE_OQ));
+        case MathOpcodeType::Greater: return (_mm256_cmp_ps(a, b, _CMP_GT_OQ));
+        case MathOpcodeType::GreaterEqual: return (_mm256_cmp_ps(a, b, _CMP_GE_OQ));
+        case MathOpcodeType::Equal: return (_mm256_cmp_ps(a, b, _CMP_EQ_OQ));
+        default: return (_mm256_cmp_ps(a, b, _CMP_NEQ_UQ));
+    }
+}
+#elif defined(__SSE2__)
+/**
+ * \brief Compares the lanes of two vectors, the comparison is a template
+ * argument. Only != is true for NaN, like the comparison of scalars.
+ * \param a Left operand.
+ * \param b Right operand.
+ * \return Mask with all bits set in the lanes, where the comparison is true.
+ **/
+template <MathOpcodeType Type>
+inline __m128d MathCompareMask(__m128d a, __m128d b)
+{
+    switch (Type)
+    {
+        case MathOpcodeType::Less: return (_mm_cmplt_pd(a, b));
+        case MathOpcodeType::LessEqual: return (_mm_cmple_pd(a, b));
+        case MathOpcodeType::Greater: return (_mm_cmpgt_pd(a, b));
+        case MathOpcodeType::GreaterEqual: return (_mm_cmpge_pd(a, b));
+        case MathOpcodeType::Equal: return (_mm_cmpeq_pd(a, b));
+        default: return (_mm_cmpneq_pd(a, b));
+    }
+}
+
+
+/**
+ * \brief Compares the lanes of two vectors, the comparison is a template
+ * argument. Only != is true for NaN, like the comparison of scalars.
+ * \param a Left operand.
+ * \param b Right operand.
+ * \return Mask with all bits set in the lanes, where the comparison is true.
+ **/
+template <MathOpcodeType Type>
+inline __m128 MathCompareMask(__m128 a, __m128 b)
+{
+    switch (Type)
+    {
+        case MathOpcodeType::Less: return (_mm_cmplt_ps(a, b));
+        case MathOpcodeType::LessEqual: return (_mm_cmple_ps(a, b));
+        case MathOpcodeType::Greater: return (_mm_cmpgt_ps(a, b));
+        case MathOpcodeType::GreaterEqual: return (_mm_cmpge_ps(a, b));
+        case MathOpcodeType::Equal: return (_mm_cmpeq_ps(a, b));
+        default: return (_mm_cmpneq_ps(a, b));
+    }
+}
+#endif
+
+
+/**
+ * \brief Compares the values of a with the values of b and replaces them by
+ * 1, if the comparison is true, otherwise by 0 (e.g. a[i] = a[i] < b[i]).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+template <MathOpcodeType Type>
+inline void MathKernelCompare(double* a, const double* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    const __m256d one = _mm256_set1_pd(1.0);
+    for (; i+4<=count; i+=4)
+    {
+        __m256d mask = MathCompareMask<Type>(_mm256_loadu_pd(a+i), _mm256_loadu_pd(b+i));
+        _mm256_storeu_pd(a+i, _mm256_and_pd(mask, one));
+    }
+    #elif defined(__SSE2__)
+    const __m128d one = _mm_set1_pd(1.0);
+    for (; i+2<=count; i+=2)
+    {
+        __m128d mask = MathCompareMask<Type>(_mm_loadu_pd(a+i), _mm_loadu_pd(b+i));
+        _mm_storeu_pd(a+i, _mm_and_pd(mask, one));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] = MathCompare<Type>(a[i], b[i]);
+    }
+}
+
+
+/**
+ * \brief Compares the values of a with the values of b and replaces them by
+ * 1, if the comparison is true, otherwise by 0 (e.g. a[i] = a[i] < b[i]).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+template <MathOpcodeType Type>
+inline void MathKernelCompare(float* a, const float* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    const __m256 one = _mm256_set1_ps(1.0f);
+    for (; i+8<=count; i+=8)
+    {
+        __m256 mask = MathCompareMask<Type>(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i));
+        _mm256_storeu_ps(a+i, _mm256_and_ps(mask, one));
+    }
+    #elif defined(__SSE2__)
+    const __m128 one = _mm_set1_ps(1.0f);
+    for (; i+4<=count; i+=4)
+    {
+        __m128 mask = MathCompareMask<Type>(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i));
+        _mm_storeu_ps(a+i, _mm_and_ps(mask, one));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] = MathCompare<Type>(a[i], b[i]);
+    }
+}
+
+
+/**
+ * \brief Replaces the conditions by the values of a, where the condition is
+ * not zero, otherwise by the values of b (c[i] = select(c[i], a[i], b[i])).
+ * \param c Destination and conditions.
+ * \param a Values for true conditions.
+ * \param b Values for false conditions.
+ * \param count Number of values.
+ **/
+inline void MathKernelSelect(double* c, const double* a, const double* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    const __m256d zero = _mm256_setzero_pd();
+    for (; i+4<=count; i+=4)
+    {
+        __m256d mask = _mm256_cmp_pd(_mm256_loadu_pd(c+i), zero, _CMP_NEQ_UQ);
+        _mm256_storeu_pd(c+i, _mm256_blendv_pd(_mm256_loadu_pd(b+i), _mm256_loadu_pd(a+i), mask));
+    }
+    #elif defined(__SSE2__)
+    const __m128d zero = _mm_setzero_pd();
+    for (; i+2<=count; i+=2)
+    {
+        __m128d mask = _mm_cmpneq_pd(_mm_loadu_pd(c+i), zero);
+        _mm_storeu_pd(c+i, _mm_or_pd(_mm_and_pd(mask, _mm_loadu_pd(a+i)), _mm_andnot_pd(mask, _mm_loadu_pd(b+i))));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        c[i] = MathSelect(c[i], a[i], b[i]);
+    }
+}
+
+
+/**
+ * \brief Replaces the conditions by the values of a, where the condition is
+ * not zero, otherwise by the values of b (c[i] = select(c[i], a[i], b[i])).
+ * \param c Destination and conditions.
+ * \param a Values for true conditions.
+ * \param b Values for false conditions.
+ * \param count Number of values.
+ **/
+inline void MathKernelSelect(float* c, const float* a, const float* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    const __m256 zero = _mm256_setzero_ps();
+    for (; i+8<=count; i+=8)
+    {
+        __m256 mask = _mm256_cmp_ps(_mm256_loadu_ps(c+i), zero, _CMP_NEQ_UQ);
+        _mm256_storeu_ps(c+i, _mm256_blendv_ps(_mm256_loadu_ps(b+i), _mm256_loadu_ps(a+i), mask));
+    }
+    #elif defined(__SSE2__)
+    const __m128 zero = _mm_setzero_ps();
+    for (; i+4<=count; i+=4)
+    {
+        __m128 mask = _mm_cmpneq_ps(_mm_loadu_ps(c+i), zero);
+        _mm_storeu_ps(c+i, _mm_or_ps(_mm_and_ps(mask, _mm_loadu_ps(a+i)), _mm_andnot_ps(mask, _mm_loadu_ps(b+i))));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        c[i] = MathSelect(c[i], a[i], b[i]);
+    }
+}
+
+
+//------------------------------------------------- Single precision kernels
+// Arithmetic runs with twice the lanes of the double kernels. The
+// transcendental functions widen the values to double and use the double
+// kernels, so the results are the double results rounded to float.
+
+/**
+ * \brief Adds the values of b to the values of a (a[i] += b[i]).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelAdd(float* a, const float* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    for (; i+8<=count; i+=8)
+    {
+        _mm256_storeu_ps(a+i, _mm256_add_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)));
+    }
+    #elif defined(__SSE2__)
+    for (; i+4<=count; i+=4)
+    {
+        _mm_storeu_ps(a+i, _mm_add_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] += b[i];
+    }
+}
+
+
+/**
+ * \brief Substracts the values of b from the values of a (a[i] -= b[i]).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelSub(float* a, const float* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    for (; i+8<=count; i+=8)
+    {
+        _mm256_storeu_ps(a+i, _mm256_sub_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)));
+    }
+    #elif defined(__SSE2__)
+    for (; i+4<=count; i+=4)
+    {
+        _mm_storeu_ps(a+i, _mm_sub_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] -= b[i];
+    }
+}
+
+
+/**
+ * \brief Multiplies the values of a with the values of b (a[i] *= b[i]).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelMul(float* a, const float* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    for (; i+8<=count; i+=8)
+    {
+        _mm256_storeu_ps(a+i, _mm256_mul_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)));
+    }
+    #elif defined(__SSE2__)
+    for (; i+4<=count; i+=4)
+    {
+        _mm_storeu_ps(a+i, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] *= b[i];
+    }
+}
+
+
+/**
+ * \brief Divides the values of a by the values of b (a[i] /= b[i]).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelDiv(float* a, const float* b, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    for (; i+8<=count; i+=8)
+    {
+        _mm256_storeu_ps(a+i, _mm256_div_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)));
+    }
+    #elif defined(__SSE2__)
+    for (; i+4<=count; i+=4)
+    {
+        _mm_storeu_ps(a+i, _mm_div_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] /= b[i];
+    }
+}
+
+
+/**
+ * \brief Negates the values of a (a[i] = -a[i]).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelNeg(float* a, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    for (; i+8<=count; i+=8)
+    {
+        _mm256_storeu_ps(a+i, _mm256_xor_ps(_mm256_loadu_ps(a+i), sign));
+    }
+    #elif defined(__SSE2__)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (; i+4<=count; i+=4)
+    {
+        _mm_storeu_ps(a+i, _mm_xor_ps(_mm_loadu_ps(a+i), sign));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] = -a[i];
+    }
+}
+
+
+/**
+ * \brief Replaces the values of a by their absolute values (a[i] = |a[i]|).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelAbs(float* a, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    const __m256 sign = _mm256_set1_ps(-0.0f);
+    for (; i+8<=count; i+=8)
+    {
+        _mm256_storeu_ps(a+i, _mm256_andnot_ps(sign, _mm256_loadu_ps(a+i)));
+    }
+    #elif defined(__SSE2__)
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    for (; i+4<=count; i+=4)
+    {
+        _mm_storeu_ps(a+i, _mm_andnot_ps(sign, _mm_loadu_ps(a+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] = fabsf(a[i]);
+    }
+}
+
+
+/**
+ * \brief Replaces the values of a by their square roots (a[i] = sqrt(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ **/
+inline void MathKernelSqrt(float* a, size_t count)
+{
+    size_t i = 0;
+    #if defined(__AVX__)
+    for (; i+8<=count; i+=8)
+    {
+        _mm256_storeu_ps(a+i, _mm256_sqrt_ps(_mm256_loadu_ps(a+i)));
+    }
+    #elif defined(__SSE2__)
+    for (; i+4<=count; i+=4)
+    {
+        _mm_storeu_ps(a+i, _mm_sqrt_ps(_mm_loadu_ps(a+i)));
+    }
+    #endif
+    for (; i<count; ++i)
+    {
+        a[i] = sqrtf(a[i]);
+    }
+}
+
+
+/**
+ * \brief Applies a double math library function to the values of a
+ * (a[i] = f(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ **/
+template <double (*Function)(double)>
+inline void MathKernelApply(float* a, size_t count)
+{
+    for (size_t i=0; i<count; ++i)
+    {
+        a[i] = (float)Function(a[i]);
+    }
+}
+
+
+/**
+ * \brief Applies a double math library function with two arguments to the
+ * values of a and b (a[i] = f(a[i], b[i])).
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ **/
+template <double (*Function)(double, double)>
+inline void MathKernelApply(float* a, const float* b, size_t count)
+{
+    for (size_t i=0; i<count; ++i)
+    {
+        a[i] = (float)Function(a[i], b[i]);
+    }
+}
+
+
+/**
+ * \brief Applies a double kernel to the values of a. The values are widened
+ * block by block into a buffer on the stack.
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+template <void (*Kernel)(double*, size_t, MathAccuracy)>
+inline void MathKernelWiden(float* a, size_t count, MathAccuracy accuracy)
+{
+    double wide[MathBlockSize];
+    for (size_t i=0; i<count; i+=MathBlockSize)
+    {
+        size_t n = (count - i < MathBlockSize ? count - i : MathBlockSize);
+        for (size_t j=0; j<n; ++j)
+        {
+            wide[j] = a[i+j];
+        }
+        Kernel(wide, n, accuracy);
+        for (size_t j=0; j<n; ++j)
+        {
+            a[i+j] = (float)wide[j];
+        }
+    }
+}
+
+
+/**
+ * \brief Applies a double kernel with two arguments to the values of a and b.
+ * \param a Destination and left operand.
+ * \param b Right operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+template <void (*Kernel)(double*, const double*, size_t, MathAccuracy)>
+inline void MathKernelWiden(float* a, const float* b, size_t count, MathAccuracy accuracy)
+{
+    double wide[MathBlockSize];
+    double wideB[MathBlockSize];
+    for (size_t i=0; i<count; i+=MathBlockSize)
+    {
+        size_t n = (count - i < MathBlockSize ? count - i : MathBlockSize);
+        for (size_t j=0; j<n; ++j)
+        {
+            wide[j] = a[i+j];
+            wideB[j] = b[i+j];
+        }
+        Kernel(wide, wideB, n, accuracy);
+        for (size_t j=0; j<n; ++j)
+        {
+            a[i+j] = (float)wide[j];
+        }
+    }
+}
+
+
+/**
+ * \brief Replaces the values of a by e^x (a[i] = exp(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelExp(float* a, size_t count, MathAccuracy accuracy)
+{
+    MathKernelWiden<MathKernelExp>(a, count, accuracy);
+}
+
+
+/**
+ * \brief Replaces the values of a by the natural logarithmus (a[i] = ln(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelLn(float* a, size_t count, MathAccuracy accuracy)
+{
+    MathKernelWiden<MathKernelLn>(a, count, accuracy);
+}
+
+
+/**
+ * \brief Replaces the values of a by the sinus (a[i] = sin(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelSin(float* a, size_t count, MathAccuracy accuracy)
+{
+    MathKernelWiden<MathKernelSin>(a, count, accuracy);
+}
+
+
+/**
+ * \brief Replaces the values of a by the cosinus (a[i] = cos(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelCos(float* a, size_t count, MathAccuracy accuracy)
+{
+    MathKernelWiden<MathKernelCos>(a, count, accuracy);
+}
+
+
+/**
+ * \brief Replaces the values of a by the tangens (a[i] = tan(a[i])).
+ * \param a Destination and operand.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelTan(float* a, size_t count, MathAccuracy accuracy)
+{
+    MathKernelWiden<MathKernelTan>(a, count, accuracy);
+}
+
+
+/**
+ * \brief Replaces the values of a by the powers a^b (a[i] = pow(a[i], b[i])).
+ * \param a Destination and base.
+ * \param b Exponent.
+ * \param count Number of values.
+ * \param accuracy Math library or vectorized functions.
+ **/
+inline void MathKernelPow(float* a, const float* b, size_t count, MathAccuracy accuracy)
+{
+    MathKernelWiden<MathKernelPow>(a, b, count, accuracy);
+}
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHKERNELS_H_
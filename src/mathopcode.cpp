@@ -100,6 +100,97 @@ MathOpcode::~MathOpcode()
 }
 
 
+//-----------------------------------------------------------------------------
+bool MathOpcode::IsIntrinsic(MathOpcodeType type)
+/**
+ * \brief Checks if the opcode type is the intrinsic of a default function,
+ * which is executed inline instead of calling the function.
+ * \param type Opcode type.
+ * \return True, if the type is an intrinsic; otherwise false.
+ **/
+{
+    return ((type >= MathOpcodeType::Abs && type <= MathOpcodeType::Tan) || type == MathOpcodeType::Select);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathOpcode::IsComparison(MathOpcodeType type)
+/**
+ * \brief Checks if the opcode type compares two values and pushes 1 or 0.
+ * \param type Opcode type.
+ * \return True, if the type is a comparison; otherwise false.
+ **/
+{
+    return (type >= MathOpcodeType::Less && type <= MathOpcodeType::NotEqual);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathOpcode::IsSuperinstruction(MathOpcodeType type)
+/**
+ * \brief Checks if the opcode type is a superinstruction, which combines a
+ * sequence of instructions. Superinstructions are only executed by the
+ * interpreter and never stored in images.
+ * \param type Opcode type.
+ * \return True, if the type is a superinstruction; otherwise false.
+ **/
+{
+    return (type >= MathOpcodeType::AddVariable && type <= MathOpcodeType::MulConstantAdd);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathOpcode::IsBound(MathOpcodeType type)
+/**
+ * \brief Checks if the opcode type loads or saves a variable, which is bound
+ * to memory of the caller (see MathEvaluation::BindVariable()). Like the
+ * superinstructions, these are only executed by the interpreter.
+ * \param type Opcode type.
+ * \return True, if the type accesses bound memory; otherwise false.
+ **/
+{
+    return (type >= MathOpcodeType::LoadAddress && type <= MathOpcodeType::SaveMember);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathOpcode::IsNativeCall(MathOpcodeType type)
+/**
+ * \brief Checks if the opcode type calls a native function directly. These
+ * are only executed by the interpreter.
+ * \param type Opcode type.
+ * \return True, if the type is a direct call; otherwise false.
+ **/
+{
+    return (type >= MathOpcodeType::CallNative1 && type <= MathOpcodeType::CallNative3);
+}
+
+
+//-----------------------------------------------------------------------------
+const Char* MathOpcode::GetMnemonic(MathOpcodeType type)
+/**
+ * \brief Returns the short name of an opcode type, e.g. "ADD".
+ * \param type Opcode type.
+ * \return Short name, "ERR" for unknown types.
+ **/
+{
+    // NOTE: Must be in the same order as MathOpcodeType
+    static const Char* names[] = {
+        _T("LDC"), _T("LDV"), _T("SAV"), _T("CALL"), _T("ADD"), _T("SUB"), _T("MUL"), _T("DIV"),
+        _T("NEG"), _T("DBL"), _T("LDT"), _T("STT"),
+        _T("ABS"), _T("SQRT"), _T("EXP"), _T("LN"), _T("LOG10"), _T("POW"),
+        _T("MOD"), _T("FLOOR"), _T("CEIL"), _T("SIN"), _T("COS"), _T("TAN"),
+        _T("NOP"), _T("LT"), _T("LE"), _T("GT"), _T("GE"), _T("EQ"), _T("NE"), _T("SEL"), _T("ADDV"), _T("SUBV"), _T("MULV"), _T("DIVV"), _T("ADDC"), _T("MULC"), _T("DIVC"),
+        _T("FMA"), _T("FMAV"), _T("FMAC"), _T("LDA"), _T("SAA"), _T("LDM"), _T("SAM"),
+        _T("CALL1"), _T("CALL2"), _T("CALL3"), _T("OPCODES") };
+    if ((size_t)type > (size_t)MathOpcodeType::Opcodes)
+    {
+        return (_T("ERR"));
+    }
+    return (names[(int)type]);
+}
+
+
 //-----------------------------------------------------------------------------
 String MathOpcode::ToString() const
 /**
@@ -123,6 +214,14 @@ String MathOpcode::ToString() const
     {
         return (_T("DBL"));
     }
+    else if (m_type == MathOpcodeType::LoadTemporary)
+    {
+        return (String::Format(_T("LDT '%u'"), m_data.Index));
+    }
+    else if (m_type == MathOpcodeType::StoreTemporary)
+    {
+        return (String::Format(_T("STT '%u'"), m_data.Index));
+    }
     else if (m_type == MathOpcodeType::LoadConstant)
     {
         return (String::Format(_T("LDC '%1.2f'"), m_data.Value));
@@ -151,6 +250,35 @@ String MathOpcode::ToString() const
     {
         return (_T("SUB"));
     }
+    else if (IsIntrinsic(m_type) || IsComparison(m_type))
+    {
+        return (GetMnemonic(m_type));
+    }
+    else if ((m_type >= MathOpcodeType::AddVariable && m_type <= MathOpcodeType::DivVariable) ||
+             m_type == MathOpcodeType::MulVariableAdd)
+    {
+        return (String::Format(_T("%s '%u'"), GetMnemonic(m_type), m_data.Index));
+    }
+    else if (m_type >= MathOpcodeType::AddConstant && m_type <= MathOpcodeType::DivConstant)
+    {
+        return (String::Format(_T("%s '%1.2f'"), GetMnemonic(m_type), m_data.Value));
+    }
+    else if (m_type == MathOpcodeType::MulConstantAdd)
+    {
+        return (String::Format(_T("FMAC '%1.2f'"), m_data.Value));
+    }
+    else if (m_type == MathOpcodeType::MulAdd)
+    {
+        return (_T("FMA"));
+    }
+    else if (m_type == MathOpcodeType::LoadMember || m_type == MathOpcodeType::SaveMember)
+    {
+        return (String::Format(_T("%s '%u'"), GetMnemonic(m_type), m_data.Index));
+    }
+    else if (IsBound(m_type) || IsNativeCall(m_type))
+    {
+        return (GetMnemonic(m_type));
+    }
     else if (m_type == MathOpcodeType::Opcodes)
     {
         if (m_data.Array != NULL) {
@@ -0,0 +1,604 @@
+/*
+ * mathoptimizer.cpp - Implementation of the MathOptimizer class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2011-2012 - Steffen Ott
+ *
+ */
+
+
+#include "mathoptimizer.h"
+#include <math.h>
+#include <string.h>
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+MathOptimizer::MathOptimizer(ObjectArray<MathFunction>* functions)
+/**
+ * \brief Constructor, initializes the MathOptimizer object.
+ * \param functions Functions which are referenced by the code.
+ **/
+{
+    m_functions = functions;
+    m_nodes = NULL;
+    m_countNodes = 0;
+    m_args = NULL;
+    m_countArgs = 0;
+    m_stack = NULL;
+    m_countStack = 0;
+    m_countRooted = 0;
+    m_roots = NULL;
+    m_countRoots = 0;
+    m_buckets = NULL;
+    m_countBuckets = 0;
+    m_versions = NULL;
+    m_countVersions = 0;
+    m_values = NULL;
+    m_code = NULL;
+    m_countCode = 0;
+    m_countTemporaries = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+MathOptimizer::~MathOptimizer()
+/**
+ * \brief Destructor, frees allocated memory.
+ **/
+{
+    if (m_nodes != NULL) delete [] m_nodes;
+    if (m_args != NULL) delete [] m_args;
+    if (m_stack != NULL) delete [] m_stack;
+    if (m_roots != NULL) delete [] m_roots;
+    if (m_buckets != NULL) delete [] m_buckets;
+    if (m_versions != NULL) delete [] m_versions;
+    if (m_values != NULL) delete [] m_values;
+    if (m_code != NULL) delete [] m_code;
+}
+
+
+//-----------------------------------------------------------------------------
+MathInstruction* MathOptimizer::Optimize(const MathInstruction* code, size_t count, size_t* newCount)
+/**
+ * \brief Optimizes the given code. The whole program is rebuild into one graph
+ * of nodes, in which equal pure nodes are shared. The values below a
+ * SaveVariable instruction and the SaveVariable itself are the roots of the
+ * graph. The roots are emitted in order, so the statements are kept in order.
+ * Pure values which are left on the stack after the last instruction are
+ * removed.
+ * \param code Instructions to optimize.
+ * \param count Number of instructions.
+ * \param newCount Receives the number of instructions of the optimized code.
+ * \return The optimized code, which must be deleted by the caller or NULL, if
+ * the code is malformed or uses values of an earlier statement and cannot be
+ * optimized.
+ **/
+{
+    // Every instruction creates at most one node and pushes at most two values.
+    // A node is emitted once with at most two extra instructions (Double and
+    // StoreTemporary), every further use is one instruction. The arguments of a
+    // folded function call are values of the stack, they are copied to m_values.
+    m_nodes = new MathNode[count+1];
+    m_countNodes = 0;
+    m_args = new MathNode*[2*count+1];
+    m_countArgs = 0;
+    m_stack = new MathNode*[2*count+1];
+    m_countStack = 0;
+    m_countRooted = 0;
+    m_roots = new MathNode*[count+1];
+    m_countRoots = 0;
+    m_values = new double[2*count+1];
+    m_code = new MathInstruction[4*count+1];
+    m_countCode = 0;
+    m_countTemporaries = 0;
+
+    m_countBuckets = 16;
+    while (m_countBuckets < 2*count)
+    {
+        m_countBuckets *= 2;
+    }
+    m_buckets = new MathNode*[m_countBuckets];
+    for (size_t i=0; i<m_countBuckets; ++i)
+    {
+        m_buckets[i] = NULL;
+    }
+
+    // Every assignment starts a new version of the variable
+    m_countVersions = 0;
+    for (size_t i=0; i<count; ++i)
+    {
+        if ((code[i].Type == MathOpcodeType::LoadVariable || code[i].Type == MathOpcodeType::SaveVariable) &&
+            code[i].Index >= m_countVersions)
+        {
+            m_countVersions = code[i].Index + 1;
+        }
+    }
+    m_versions = new size_t[m_countVersions+1];
+    for (size_t i=0; i<m_countVersions; ++i)
+    {
+        m_versions[i] = 0;
+    }
+
+    for (size_t i=0; i<count; ++i)
+    {
+        const MathInstruction& instruction = code[i];
+        MathNode* node = NULL;
+        switch (instruction.Type)
+        {
+            case MathOpcodeType::LoadConstant:
+                node = this->CreateNode(instruction, 0);
+                break;
+            case MathOpcodeType::LoadVariable:
+                node = this->CreateNode(instruction, 0);
+                node->Version = m_versions[instruction.Index];
+                break;
+            case MathOpcodeType::SaveVariable:
+                node = this->CreateNode(instruction, 1);
+                if (node == NULL) return (NULL);
+                // Statement boundary: everything below must be computed before
+                // and the following reads see a new version of the variable.
+                this->AddRoots();
+                node->Pure = false;
+                m_roots[m_countRoots++] = node;
+                m_versions[instruction.Index]++;
+                continue;
+            case MathOpcodeType::CallFunction:
+                if (instruction.Index >= m_functions->Count()) return (NULL);
+                node = this->CreateNode(instruction, m_functions->Item(instruction.Index)->GetArgs());
+                if (node != NULL && !m_functions->Item(instruction.Index)->IsPure()) {
+                    node->Pure = false;
+                }
+                break;
+            case MathOpcodeType::Add:
+            case MathOpcodeType::Sub:
+            case MathOpcodeType::Mul:
+            case MathOpcodeType::Div:
+            case MathOpcodeType::Less:
+            case MathOpcodeType::LessEqual:
+            case MathOpcodeType::Greater:
+            case MathOpcodeType::GreaterEqual:
+            case MathOpcodeType::Equal:
+            case MathOpcodeType::NotEqual:
+                node = this->CreateNode(instruction, 2);
+                break;
+            case MathOpcodeType::Neg:
+                node = this->CreateNode(instruction, 1);
+                break;
+            case MathOpcodeType::Double:
+                if (m_countStack == 0) return (NULL);
+                // The duplicated value is the same node
+                m_stack[m_countStack] = m_stack[m_countStack-1];
+                m_countStack++;
+                continue;
+            case MathOpcodeType::Nop:
+                continue;
+            default:
+                return (NULL);
+        }
+        if (node == NULL) return (NULL);
+        m_stack[m_countStack++] = this->Share(this->Simplify(node));
+    }
+
+    // Values which are left on the stack are never used, the pure ones
+    // don't have to be computed at all.
+    size_t countUsed = m_countRooted;
+    for (size_t i=m_countRooted; i<m_countStack; ++i)
+    {
+        if (!m_stack[i]->Pure) m_stack[countUsed++] = m_stack[i];
+    }
+    m_countStack = countUsed;
+    this->AddRoots();
+
+    // Values which are used more than once are kept in temporary values
+    for (size_t i=0; i<m_countRoots; ++i)
+    {
+        this->Reference(m_roots[i]);
+    }
+    for (size_t i=0; i<m_countRoots; ++i)
+    {
+        this->Emit(m_roots[i]);
+    }
+
+    MathInstruction* result = m_code;
+    *newCount = m_countCode;
+    m_code = NULL;
+    return (result);
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathOptimizer::GetTemporaryCount() const
+/**
+ * \brief Returns the number of temporary values of the optimized code. They
+ * are addressed by LoadTemporary and StoreTemporary.
+ * \return Number of temporary values.
+ **/
+{
+    return (m_countTemporaries);
+}
+
+
+//-----------------------------------------------------------------------------
+MathNode* MathOptimizer::CreateNode(const MathInstruction& instruction, size_t args)
+/**
+ * \brief Creates a new node and pops its arguments from the node stack.
+ * Values which an earlier statement left on the stack cannot be arguments.
+ * \param instruction Instruction of the node.
+ * \param args Number of arguments.
+ * \return The new node or NULL, if not enougth arguments are on the stack.
+ **/
+{
+    if (m_countStack < m_countRooted + args) return (NULL);
+    MathNode* node = &m_nodes[m_countNodes++];
+    node->Instruction = instruction;
+    node->Args = &m_args[m_countArgs];
+    node->Count = args;
+    node->Pure = true;
+    node->Emitted = false;
+    node->References = 0;
+    node->Temporary = -1;
+    node->Version = 0;
+    node->Hash = 0;
+    node->Next = NULL;
+    m_countStack -= args;
+    for (size_t i=0; i<args; ++i)
+    {
+        node->Args[i] = m_stack[m_countStack+i];
+        node->Pure = node->Pure && node->Args[i]->Pure;
+    }
+    m_countArgs += args;
+    return (node);
+}
+
+
+//-----------------------------------------------------------------------------
+MathNode* MathOptimizer::Simplify(MathNode* node)
+/**
+ * \brief Applies constant folding, algebraic simplification and strength
+ * reduction to the node. The arguments of the node are already simplified.
+ * \param node Node.
+ * \return The simplified node or one of its arguments, which replaces it.
+ **/
+{
+    this->Fold(node);
+
+    MathNode** args = node->Args;
+    switch (node->Instruction.Type)
+    {
+        case MathOpcodeType::Add:
+            // Only x+(-0) is x for every x, because -0+0 is +0
+            if (this->IsConstant(args[0], 0.0d) && signbit(args[0]->Instruction.Value)) {
+                return (args[1]);
+            } else if (this->IsConstant(args[1], 0.0d) && signbit(args[1]->Instruction.Value)) {
+                return (args[0]);
+            }
+            break;
+        case MathOpcodeType::Sub:
+            if (this->IsConstant(args[1], 0.0d) && !signbit(args[1]->Instruction.Value)) {
+                return (args[0]);
+            }
+            break;
+        case MathOpcodeType::Mul:
+            if (this->IsConstant(args[1], 1.0d)) {
+                return (args[0]);
+            } else if (this->IsConstant(args[0], 1.0d)) {
+                return (args[1]);
+            } else if ((this->IsConstant(args[1], 0.0d) && args[0]->Pure) ||
+                       (this->IsConstant(args[0], 0.0d) && args[1]->Pure)) {
+                node->Instruction.Type = MathOpcodeType::LoadConstant;
+                node->Instruction.Value = 0.0d;
+                node->Count = 0;
+                node->Pure = true;
+            } else if (this->IsConstant(args[1], -1.0d)) {
+                node->Instruction.Type = MathOpcodeType::Neg;
+                node->Count = 1;
+                return (this->Simplify(node));
+            }
+            break;
+        case MathOpcodeType::Div:
+            if (this->IsConstant(args[1], 1.0d)) {
+                return (args[0]);
+            }
+            break;
+        case MathOpcodeType::Neg:
+            if (args[0]->Instruction.Type == MathOpcodeType::Neg) {
+                return (args[0]->Args[0]);
+            }
+            break;
+        case MathOpcodeType::CallFunction:
+            if (m_functions->Item(node->Instruction.Index)->GetOpcode() == MathOpcodeType::Pow)
+            {
+                if (this->IsConstant(args[1], 2.0d)) {
+                    // pow(x,2) => x*x, the value of x is duplicated on the stack
+                    node->Instruction.Type = MathOpcodeType::Mul;
+                    node->Instruction.Index = 0;
+                    args[1] = args[0];
+                } else if (this->IsConstant(args[1], 1.0d)) {
+                    return (args[0]);
+                }
+            }
+            else if (m_functions->Item(node->Instruction.Index)->GetOpcode() == MathOpcodeType::Select &&
+                     args[0]->Instruction.Type == MathOpcodeType::LoadConstant)
+            {
+                // select(c, a, b) with a constant condition => a or b
+                bool condition = (args[0]->Instruction.Value != 0.0d);
+                if (args[condition ? 2 : 1]->Pure) return (args[condition ? 1 : 2]);
+            }
+            break;
+        default:
+            break;
+    }
+    return (node);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathOptimizer::Fold(MathNode* node)
+/**
+ * \brief Replaces the node with a constant, if all arguments are constants and
+ * the operation is pure.
+ * \param node Node.
+ **/
+{
+    if (!node->Pure) return;
+    if (node->Count == 0 && node->Instruction.Type != MathOpcodeType::CallFunction) return;
+    for (size_t i=0; i<node->Count; ++i)
+    {
+        if (node->Args[i]->Instruction.Type != MathOpcodeType::LoadConstant) return;
+    }
+
+    double value = 0.0d;
+    MathNode** args = node->Args;
+    switch (node->Instruction.Type)
+    {
+        case MathOpcodeType::Add:
+            value = args[0]->Instruction.Value + args[1]->Instruction.Value;
+            break;
+        case MathOpcodeType::Sub:
+            value = args[0]->Instruction.Value - args[1]->Instruction.Value;
+            break;
+        case MathOpcodeType::Mul:
+            value = args[0]->Instruction.Value * args[1]->Instruction.Value;
+            break;
+        case MathOpcodeType::Div:
+            value = args[0]->Instruction.Value / args[1]->Instruction.Value;
+            break;
+        case MathOpcodeType::Neg:
+            value = -args[0]->Instruction.Value;
+            break;
+        case MathOpcodeType::Less:
+            value = (double)(args[0]->Instruction.Value < args[1]->Instruction.Value);
+            break;
+        case MathOpcodeType::LessEqual:
+            value = (double)(args[0]->Instruction.Value <= args[1]->Instruction.Value);
+            break;
+        case MathOpcodeType::Greater:
+            value = (double)(args[0]->Instruction.Value > args[1]->Instruction.Value);
+            break;
+        case MathOpcodeType::GreaterEqual:
+            value = (double)(args[0]->Instruction.Value >= args[1]->Instruction.Value);
+            break;
+        case MathOpcodeType::Equal:
+            value = (double)(args[0]->Instruction.Value == args[1]->Instruction.Value);
+            break;
+        case MathOpcodeType::NotEqual:
+            value = (double)(args[0]->Instruction.Value != args[1]->Instruction.Value);
+            break;
+        case MathOpcodeType::CallFunction:
+        {
+            for (size_t i=0; i<node->Count; ++i)
+            {
+                m_values[i] = args[i]->Instruction.Value;
+            }
+            value = m_functions->Item(node->Instruction.Index)->Evaluate(m_values, node->Count);
+            break;
+        }
+        default:
+            return;
+    }
+    node->Instruction.Type = MathOpcodeType::LoadConstant;
+    node->Instruction.Value = value;
+    node->Count = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+MathNode* MathOptimizer::Share(MathNode* node)
+/**
+ * \brief Searches a node, which is equal to the given node. Only pure nodes
+ * are shared, because they give the same result wherever they are computed.
+ * \param node Simplified node.
+ * \return The equal node or the given node, which can be found from now on.
+ **/
+{
+    if (!node->Pure) return (node);
+
+    size_t hash = (size_t)node->Instruction.Type;
+    switch (node->Instruction.Type)
+    {
+        case MathOpcodeType::LoadConstant:
+        {
+            unsigned long long bits;
+            memcpy(&bits, &node->Instruction.Value, sizeof(bits));
+            hash = hash*31 + (size_t)(bits ^ (bits >> 32));
+            break;
+        }
+        case MathOpcodeType::LoadVariable:
+            hash = (hash*31 + node->Instruction.Index)*31 + node->Version;
+            break;
+        case MathOpcodeType::CallFunction:
+            hash = hash*31 + node->Instruction.Index;
+            break;
+        default:
+            break;
+    }
+    for (size_t i=0; i<node->Count; ++i)
+    {
+        hash = hash*31 + (size_t)(node->Args[i] - m_nodes);
+    }
+    hash ^= (hash >> 16);
+
+    MathNode** bucket = &m_buckets[hash & (m_countBuckets-1)];
+    for (MathNode* other = *bucket; other != NULL; other = other->Next)
+    {
+        if (other->Hash == hash && this->IsEqual(node, other))
+        {
+            return (other);
+        }
+    }
+    node->Hash = hash;
+    node->Next = *bucket;
+    *bucket = node;
+    return (node);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathOptimizer::IsEqual(const MathNode* node, const MathNode* other) const
+/**
+ * \brief Compares two nodes. The arguments must be the same nodes.
+ * \param node Node.
+ * \param other Other node.
+ * \return True, if both nodes compute the same value; otherwise false.
+ **/
+{
+    if (node->Instruction.Type != other->Instruction.Type || node->Count != other->Count)
+    {
+        return (false);
+    }
+    switch (node->Instruction.Type)
+    {
+        case MathOpcodeType::LoadConstant:
+            if (memcmp(&node->Instruction.Value, &other->Instruction.Value, sizeof(double)) != 0) return (false);
+            break;
+        case MathOpcodeType::LoadVariable:
+            if (node->Instruction.Index != other->Instruction.Index || node->Version != other->Version) return (false);
+            break;
+        case MathOpcodeType::CallFunction:
+            if (node->Instruction.Index != other->Instruction.Index) return (false);
+            break;
+        default:
+            break;
+    }
+    for (size_t i=0; i<node->Count; ++i)
+    {
+        if (node->Args[i] != other->Args[i]) return (false);
+    }
+    return (true);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathOptimizer::AddRoots()
+/**
+ * \brief Adds the values on the node stack, which are not yet roots, to the
+ * roots. They are computed before the following roots and stay on the stack.
+ **/
+{
+    for (size_t i=m_countRooted; i<m_countStack; ++i)
+    {
+        m_roots[m_countRoots++] = m_stack[i];
+    }
+    m_countRooted = m_countStack;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathOptimizer::Reference(MathNode* node)
+/**
+ * \brief Counts the use of a node and the uses of its arguments, when the
+ * node is used the first time.
+ * \param node Node.
+ **/
+{
+    node->References++;
+    if (node->References > 1) return;
+    if (node->Count == 2 && node->Args[0] == node->Args[1])
+    {
+        // Computed once and duplicated on the stack
+        this->Reference(node->Args[0]);
+        return;
+    }
+    for (size_t i=0; i<node->Count; ++i)
+    {
+        this->Reference(node->Args[i]);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+void MathOptimizer::Emit(MathNode* node)
+/**
+ * \brief Emits the code of a node and its arguments. A node which is used
+ * more than once stores its result into a temporary value, the following
+ * uses load the temporary value. Constants and variables are loaded again.
+ * \param node Node.
+ **/
+{
+    if (node->Emitted)
+    {
+        if (node->Temporary >= 0) {
+            this->EmitInstruction(MathOpcodeType::LoadTemporary, node->Temporary);
+        } else {
+            m_code[m_countCode++] = node->Instruction;
+        }
+        return;
+    }
+    if (node->Count == 2 && node->Args[0] == node->Args[1])
+    {
+        this->Emit(node->Args[0]);
+        this->EmitInstruction(MathOpcodeType::Double, 0);
+    }
+    else
+    {
+        for (size_t i=0; i<node->Count; ++i)
+        {
+            this->Emit(node->Args[i]);
+        }
+    }
+    m_code[m_countCode++] = node->Instruction;
+    node->Emitted = true;
+
+    bool leaf = (node->Instruction.Type == MathOpcodeType::LoadConstant ||
+                 node->Instruction.Type == MathOpcodeType::LoadVariable);
+    if (node->References > 1 && !leaf)
+    {
+        node->Temporary = m_countTemporaries++;
+        this->EmitInstruction(MathOpcodeType::StoreTemporary, node->Temporary);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+void MathOptimizer::EmitInstruction(MathOpcodeType type, size_t index)
+/**
+ * \brief Emits an instruction which is not part of a node.
+ * \param type Opcode type.
+ * \param index Index of the instruction.
+ **/
+{
+    MathInstruction instruction;
+    instruction.Type = type;
+    instruction.Index = index;
+    m_code[m_countCode++] = instruction;
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathOptimizer::IsConstant(MathNode* node, double value) const
+/**
+ * \brief Checks if the node is a constant with the given value.
+ * \param node Node.
+ * \param value Value.
+ * \return True, if the node is the constant; otherwise false.
+ **/
+{
+    return (node->Instruction.Type == MathOpcodeType::LoadConstant && node->Instruction.Value == value);
+}
+
+
+} // namespace rush
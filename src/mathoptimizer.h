@@ -0,0 +1,111 @@
+/*
+ * mathoptimizer.h - Declaration of the MathOptimizer class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2011-2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHOPTIMIZER_H_
+#define _RUSH_MATHOPTIMIZER_H_
+
+
+#include <rush/mathevaluation.h>
+
+
+namespace rush {
+
+
+/**
+ * \brief The MathNode struct is one node of the expression trees, which the
+ * MathOptimizer rebuilds from the flat instructions.
+ **/
+struct MathNode
+{
+    /// \brief Instruction of this node.
+    MathInstruction Instruction;
+    /// \brief Argument nodes (operands) of the instruction.
+    MathNode** Args;
+    /// \brief Number of arguments.
+    size_t Count;
+    /// \brief True, if the node can be removed or moved without changing the result.
+    bool Pure;
+    /// \brief True, if the code of the node is already emitted.
+    bool Emitted;
+    /// \brief Number of uses of the node's value in the program.
+    size_t References;
+    /// \brief Temporary value which keeps the result or -1.
+    int Temporary;
+    /// \brief Assignment count of the variable for LoadVariable nodes.
+    size_t Version;
+    /// \brief Hash of the node for the search of equal nodes.
+    size_t Hash;
+    /// \brief Next node in the same bucket.
+    MathNode* Next;
+};
+
+
+/**
+ * \brief The MathOptimizer class rewrites compiled MathEvaluation code. The
+ * instructions are rebuild into expression trees, which will be optimized
+ * and emitted again. The following passes are done:
+ * - Constant folding of operators and pure functions (1+2 => 3, sqrt(2), pi())
+ * - Algebraic simplification (x*1, x+(-0), x-0, x/1, x*0, --x)
+ * - Strength reduction (pow(x,2) => x*x, pow(x,1) => x)
+ * - Removal of unused values, which are left on the stack
+ * - Common subexpression elimination over all statements: pure nodes are
+ *   shared (hash-consing), a shared result is computed once and kept in a
+ *   temporary value. A variable read before and after an assignment is not
+ *   the same node.
+ * \remarks x*0 is only reduced to 0 when x is pure, that means the IEEE results
+ * for x being infinite or NaN are not kept. x+0 and x-(-0) are not reduced,
+ * because they are +0 for x being -0.
+ **/
+class MathOptimizer
+{
+    public:
+        MathOptimizer(ObjectArray<MathFunction>* functions);
+        ~MathOptimizer();
+
+        MathInstruction* Optimize(const MathInstruction* code, size_t count, size_t* newCount);
+        size_t GetTemporaryCount() const;
+
+    private:
+        MathNode* CreateNode(const MathInstruction& instruction, size_t args);
+        MathNode* Simplify(MathNode* node);
+        void Fold(MathNode* node);
+        MathNode* Share(MathNode* node);
+        bool IsEqual(const MathNode* node, const MathNode* other) const;
+        void AddRoots();
+        void Reference(MathNode* node);
+        void Emit(MathNode* node);
+        void EmitInstruction(MathOpcodeType type, size_t index);
+        bool IsConstant(MathNode* node, double value) const;
+
+    private:
+        ObjectArray<MathFunction>* m_functions;
+        MathNode* m_nodes;
+        size_t m_countNodes;
+        MathNode** m_args;
+        size_t m_countArgs;
+        MathNode** m_stack;
+        size_t m_countStack;
+        size_t m_countRooted;
+        MathNode** m_roots;
+        size_t m_countRoots;
+        MathNode** m_buckets;
+        size_t m_countBuckets;
+        size_t* m_versions;
+        size_t m_countVersions;
+        double* m_values;
+        MathInstruction* m_code;
+        size_t m_countCode;
+        size_t m_countTemporaries;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHOPTIMIZER_H_
@@ -0,0 +1,155 @@
+/*
+ * mathpeephole.cpp - Implementation of the MathPeephole class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#include "mathpeephole.h"
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+MathPeephole::MathPeephole(MathFusion fusion, MathFunction* const* functions, size_t countFunctions,
+                           const MathBinding* bindings, size_t countBindings)
+/**
+ * \brief Constructor, initializes the MathPeephole object.
+ * \param fusion Selects the combined sequences.
+ * \param functions Functions of the code.
+ * \param countFunctions Number of functions.
+ * \param bindings Binding of every variable or NULL, if no variable is bound.
+ * The array must not be deleted before Combine() returns.
+ * \param countBindings Number of bindings, variables with a higher index are not bound.
+ **/
+{
+    m_fusion = fusion;
+    m_functions = functions;
+    m_countFunctions = countFunctions;
+    m_bindings = bindings;
+    m_countBindings = countBindings;
+}
+
+
+//-----------------------------------------------------------------------------
+MathInstruction* MathPeephole::Combine(const MathInstruction* code, size_t count, size_t* newCount) const
+/**
+ * \brief Combines the sequences of the given code into superinstructions.
+ * \param code Verified instructions.
+ * \param count Number of instructions.
+ * \param newCount Receives the number of combined instructions.
+ * \return Combined code, which must be deleted by the caller.
+ **/
+{
+    MathInstruction* result = new MathInstruction[count > 0 ? count : 1];
+    size_t size = 0;
+    for (size_t i=0; i<count; ++i)
+    {
+        MathInstruction instruction = code[i];
+        this->Bind(&instruction);
+        if (m_fusion != MathFusion::None) this->CallNative(&instruction);
+        MathOpcodeType type = instruction.Type;
+        MathInstruction* last = (size > 0 ? &result[size-1] : NULL);
+        bool arithmetic = (type == MathOpcodeType::Add || type == MathOpcodeType::Sub ||
+                           type == MathOpcodeType::Mul || type == MathOpcodeType::Div);
+        if (last != NULL && arithmetic && m_fusion != MathFusion::None)
+        {
+            // The loaded value is the right operand, the left one is already on the stack
+            if (last->Type == MathOpcodeType::LoadVariable)
+            {
+                if (type == MathOpcodeType::Add) last->Type = MathOpcodeType::AddVariable;
+                if (type == MathOpcodeType::Sub) last->Type = MathOpcodeType::SubVariable;
+                if (type == MathOpcodeType::Mul) last->Type = MathOpcodeType::MulVariable;
+                if (type == MathOpcodeType::Div) last->Type = MathOpcodeType::DivVariable;
+                continue;
+            }
+            if (last->Type == MathOpcodeType::LoadConstant)
+            {
+                // NOTE: a-c is defined as a+(-c), also for zeros and infinite values
+                if (type == MathOpcodeType::Add) last->Type = MathOpcodeType::AddConstant;
+                if (type == MathOpcodeType::Sub) last->Type = MathOpcodeType::AddConstant;
+                if (type == MathOpcodeType::Sub) last->Value = -last->Value;
+                if (type == MathOpcodeType::Mul) last->Type = MathOpcodeType::MulConstant;
+                if (type == MathOpcodeType::Div) last->Type = MathOpcodeType::DivConstant;
+                continue;
+            }
+            if (type == MathOpcodeType::Add && m_fusion == MathFusion::MultiplyAdd)
+            {
+                if (last->Type == MathOpcodeType::Mul)
+                {
+                    last->Type = MathOpcodeType::MulAdd;
+                    continue;
+                }
+                if (last->Type == MathOpcodeType::MulVariable)
+                {
+                    last->Type = MathOpcodeType::MulVariableAdd;
+                    continue;
+                }
+                if (last->Type == MathOpcodeType::MulConstant)
+                {
+                    last->Type = MathOpcodeType::MulConstantAdd;
+                    continue;
+                }
+            }
+        }
+        result[size++] = instruction;
+    }
+    *newCount = size;
+    return (result);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathPeephole::Bind(MathInstruction* instruction) const
+/**
+ * \brief Replaces the load or save of a bound variable by the access of its memory.
+ * \param instruction Instruction, which is changed.
+ **/
+{
+    bool load = (instruction->Type == MathOpcodeType::LoadVariable);
+    if ((!load && instruction->Type != MathOpcodeType::SaveVariable) || instruction->Index >= m_countBindings)
+    {
+        return;
+    }
+    const MathBinding& binding = m_bindings[instruction->Index];
+    if (binding.Address != NULL)
+    {
+        instruction->Type = (load ? MathOpcodeType::LoadAddress : MathOpcodeType::SaveAddress);
+        instruction->Address = binding.Address;
+    }
+    else if (binding.Offset != (size_t)-1)
+    {
+        instruction->Type = (load ? MathOpcodeType::LoadMember : MathOpcodeType::SaveMember);
+        instruction->Index = binding.Offset;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+void MathPeephole::CallNative(MathInstruction* instruction) const
+/**
+ * \brief Replaces the call of a function, which has a native function with
+ * one to three arguments, by the direct call of the native function.
+ * \param instruction Instruction, which is changed.
+ **/
+{
+    if (instruction->Type != MathOpcodeType::CallFunction || instruction->Index >= m_countFunctions)
+    {
+        return;
+    }
+    MathFunction* function = m_functions[instruction->Index];
+    void* native = function->GetNative();
+    if (native == NULL || function->GetArgs() < 1 || function->GetArgs() > 3)
+    {
+        return;
+    }
+    instruction->Type = (MathOpcodeType)((size_t)MathOpcodeType::CallNative1 + function->GetArgs() - 1);
+    instruction->Native = native;
+}
+
+
+} // namespace rush
@@ -0,0 +1,74 @@
+/*
+ * mathpeephole.h - Declaration of the MathPeephole class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHPEEPHOLE_H_
+#define _RUSH_MATHPEEPHOLE_H_
+
+
+#include <rush/mathevaluation.h>
+
+
+namespace rush {
+
+
+/**
+ * \brief The MathBinding struct is the memory of the caller, which holds the
+ * value of a variable (see MathEvaluation::BindVariable()).
+ **/
+struct MathBinding
+{
+    /// \brief Address of the value or NULL, if the variable is not bound to an address.
+    double* Address;
+    /// \brief Offset of the value in the bound object in bytes or (size_t)-1, if
+    /// the variable is not bound to a member.
+    size_t Offset;
+};
+
+
+/**
+ * \brief The MathPeephole class combines frequent sequences of verified
+ * instructions into superinstructions, so the interpreter dispatches fewer
+ * instructions. The sequences are found by looking at the last emitted
+ * instruction, so combined instructions can be combined again:
+ * - LoadVariable, Add/Sub/Mul/Div => AddVariable/SubVariable/MulVariable/DivVariable
+ * - LoadConstant, Add/Sub/Mul/Div => AddConstant (negated for Sub)/MulConstant/DivConstant
+ * - Mul, Add => MulAdd (only with MathFusion::MultiplyAdd)
+ * - MulVariable/MulConstant, Add => MulVariableAdd/MulConstantAdd (only with MathFusion::MultiplyAdd)
+ * - CallFunction of a native function with one to three arguments => CallNative1 to CallNative3
+ *
+ * The combined code has the same stack effects and the same results, only
+ * the multiply-add rounds once instead of twice. Loads and saves of bound
+ * variables are replaced by LoadAddress/SaveAddress or LoadMember/SaveMember
+ * before, so they are not combined.
+ **/
+class MathPeephole
+{
+    public:
+        MathPeephole(MathFusion fusion, MathFunction* const* functions, size_t countFunctions,
+                     const MathBinding* bindings = NULL, size_t countBindings = 0);
+
+        MathInstruction* Combine(const MathInstruction* code, size_t count, size_t* newCount) const;
+
+    private:
+        void Bind(MathInstruction* instruction) const;
+        void CallNative(MathInstruction* instruction) const;
+
+    private:
+        MathFusion m_fusion;
+        MathFunction* const* m_functions;
+        size_t m_countFunctions;
+        const MathBinding* m_bindings;
+        size_t m_countBindings;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHPEEPHOLE_H_
@@ -0,0 +1,188 @@
+/*
+ * mathprofile.cpp - Implementation of the MathProfile class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+#include <rush/mathprofile.h>
+#include <rush/mathevaluation.h>
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+MathProfile::MathProfile()
+/**
+ * \brief Constructor, initializes an empty MathProfile object.
+ **/
+{
+    m_functions = NULL;
+    m_countFunctions = 0;
+    this->Reset();
+}
+
+
+//-----------------------------------------------------------------------------
+MathProfile::~MathProfile()
+/**
+ * \brief Destructor, frees allocated memory.
+ **/
+{
+    if (m_functions != NULL) delete [] m_functions;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathProfile::Reset()
+/**
+ * \brief Sets all counters to zero and forgets the functions.
+ **/
+{
+    for (size_t i=0; i<MathProfileOpcodeCount; ++i)
+    {
+        m_opcodes[i].Count = 0;
+        m_opcodes[i].Cycles = 0;
+    }
+    if (m_functions != NULL) delete [] m_functions;
+    m_functions = NULL;
+    m_countFunctions = 0;
+    m_executions = 0;
+    m_cycles = 0;
+    m_maxStackDepth = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+const MathOpcodeProfile& MathProfile::GetOpcode(MathOpcodeType type) const
+/**
+ * \brief Returns the counters of an opcode type.
+ * \param type Opcode type.
+ * \return Counters.
+ **/
+{
+    return (m_opcodes[(size_t)type < MathProfileOpcodeCount ? (size_t)type : (size_t)MathOpcodeType::Nop]);
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathProfile::GetFunctionCount() const
+/**
+ * \brief Returns the number of functions, the program was able to call.
+ * \return Number of functions.
+ **/
+{
+    return (m_countFunctions);
+}
+
+
+//-----------------------------------------------------------------------------
+const MathFunctionProfile& MathProfile::GetFunction(size_t index) const
+/**
+ * \brief Returns the counters of a function.
+ * \param index Index of the function, lower than GetFunctionCount().
+ * \return Counters.
+ **/
+{
+    return (m_functions[index]);
+}
+
+
+//-----------------------------------------------------------------------------
+unsigned long long MathProfile::GetExecutions() const
+/**
+ * \brief Returns the number of profiled executions.
+ * \return Number of executions.
+ **/
+{
+    return (m_executions);
+}
+
+
+//-----------------------------------------------------------------------------
+unsigned long long MathProfile::GetCycles() const
+/**
+ * \brief Returns the cycles of all profiled executions, including the
+ * overhead of the measurement.
+ * \return Cycles (see System::GetCycles()).
+ **/
+{
+    return (m_cycles);
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathProfile::GetMaxStackDepth() const
+/**
+ * \brief Returns the maximum stack depth reached, including the temporary values.
+ * \return Stack depth.
+ **/
+{
+    return (m_maxStackDepth);
+}
+
+
+//-----------------------------------------------------------------------------
+String MathProfile::ToString() const
+/**
+ * \brief Returns the report as table. Opcodes and functions, which were
+ * never executed, are skipped.
+ * \return Report.
+ **/
+{
+    String text = String::Format(_T("Executions: %llu, cycles: %llu, max. stack depth: %u\n"),
+                                 m_executions, m_cycles, (unsigned int)m_maxStackDepth);
+    text.Append(_T("Opcode           Count          Cycles   Cycles/Op\n"));
+    for (size_t i=0; i<MathProfileOpcodeCount; ++i)
+    {
+        const MathOpcodeProfile& opcode = m_opcodes[i];
+        if (opcode.Count == 0) continue;
+        text.AppendFormat(_T("%-8s %12llu %15llu %11.1f\n"), MathOpcode::GetMnemonic((MathOpcodeType)i),
+                          opcode.Count, opcode.Cycles, (double)opcode.Cycles / (double)opcode.Count);
+    }
+    text.Append(_T("Function         Calls          Cycles Cycles/Call\n"));
+    for (size_t i=0; i<m_countFunctions; ++i)
+    {
+        const MathFunctionProfile& function = m_functions[i];
+        if (function.Calls == 0) continue;
+        text.AppendFormat(_T("%-8s %12llu %15llu %11.1f\n"), function.Name.c_str(),
+                          function.Calls, function.Cycles, (double)function.Cycles / (double)function.Calls);
+    }
+    return (text);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathProfile::Prepare(MathFunction* const* functions, size_t count)
+/**
+ * \brief Creates the counters of functions added since the last execution.
+ * \param functions Functions of the program.
+ * \param count Number of functions.
+ **/
+{
+    if (count <= m_countFunctions)
+    {
+        return;
+    }
+    MathFunctionProfile* profiles = new MathFunctionProfile[count];
+    for (size_t i=0; i<count; ++i)
+    {
+        if (i < m_countFunctions)
+        {
+            profiles[i] = m_functions[i];
+            continue;
+        }
+        profiles[i].Name = functions[i]->GetName();
+        profiles[i].Calls = 0;
+        profiles[i].Cycles = 0;
+    }
+    if (m_functions != NULL) delete [] m_functions;
+    m_functions = profiles;
+    m_countFunctions = count;
+}
+
+
+} // namespace rush
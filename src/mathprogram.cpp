@@ -0,0 +1,931 @@
+/*
+ * mathprogram.cpp - Implementation of the MathProgram and MathContext classes
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+#include <rush/mathprogram.h>
+#include <rush/mathevaluation.h>
+#include <rush/mathprofile.h>
+#include <rush/system.h>
+#include "mathimage.h"
+#include "mathjit.h"
+#include "mathkernels.h"
+#include "mathpeephole.h"
+#include "mathsymboltable.h"
+#include <math.h>
+#include <string.h>
+
+
+namespace rush {
+
+
+
+//-----------------------------------------------------------------------------
+MathProgram::MathProgram()
+/**
+ * \brief Constructor, initializes the MathProgram object.
+ **/
+{
+    m_code = NULL;
+    m_codeCount = 0;
+    m_combined = NULL;
+    m_combinedCount = 0;
+    m_stackDepth = 0;
+    m_countTemporaries = 0;
+    m_functions = NULL;
+    m_countFunctions = 0;
+    m_variables = new MathSymbolTable();
+    m_values = NULL;
+    m_jit = NULL;
+    m_cacheEntry = NULL;
+    m_verified = false;
+    m_bound = false;
+    m_ownsCode = true;
+    m_ownsValues = true;
+}
+
+
+//-----------------------------------------------------------------------------
+MathProgram::~MathProgram()
+/**
+ * \brief Destructor, frees allocated memory.
+ **/
+{
+    if (m_code != NULL && m_ownsCode) delete [] m_code;
+    if (m_combined != NULL) delete [] m_combined;
+    if (m_functions != NULL) delete [] m_functions;
+    if (m_variables != NULL) delete m_variables;
+    if (m_values != NULL && m_ownsValues) delete [] m_values;
+    if (m_jit != NULL) delete m_jit;
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathProgram::GetVariableCount() const
+/**
+ * \brief Returns the number of variables used by the program.
+ * \return Variable count.
+ **/
+{
+    return (m_variables->Count());
+}
+
+
+//-----------------------------------------------------------------------------
+const String& MathProgram::GetVariableName(size_t index) const
+/**
+ * \brief Returns the name of a variable.
+ * \param index Variable index.
+ * \return Variable name.
+ **/
+{
+    return (m_variables->Item(index));
+}
+
+
+//-----------------------------------------------------------------------------
+int MathProgram::FindVariableIndex(const String& name) const
+/**
+ * \brief Returns the index of a variable or -1 if the variable does
+ * not exists.
+ * \param name Variable name.
+ * \return Variable index or -1 if the variable does not exist.
+ **/
+{
+    return (m_variables->Find(name));
+}
+
+
+//-----------------------------------------------------------------------------
+double MathProgram::GetInitialValue(size_t index) const
+/**
+ * \brief Returns the value of a variable, when the program was created.
+ * \param index Variable index.
+ * \return Initial variable value.
+ **/
+{
+    return (m_values[index]);
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathProgram::GetStackDepth() const
+/**
+ * \brief Returns the number of stack values, which are needed to execute
+ * the program. The temporary values of common subexpressions are stored at
+ * the bottom of the stack and are included.
+ * \return Stack depth.
+ **/
+{
+    return (m_stackDepth);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathProgram::IsJitCompiled() const
+/**
+ * \brief Checks if the program is executed as native code.
+ * \return True, if native code is executed; otherwise false.
+ **/
+{
+    return (m_jit != NULL);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathProgram::IsVerified() const
+/**
+ * \brief Checks if the program passed the verification, when it was created.
+ * Verified programs are interpreted without any checks per instruction.
+ * \return True, if the program is verified; otherwise false.
+ **/
+{
+    return (m_verified);
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathProgram::GetImageSize() const
+/**
+ * \brief Returns the size of the binary image, which is written by SaveImage().
+ * \return Size in bytes.
+ **/
+{
+    size_t size = MathImageAlign(sizeof(MathImageHeader));
+    size += MathImageAlign(m_codeCount*sizeof(MathInstruction));
+    size += MathImageAlign(m_variables->Count()*sizeof(double));
+    for (size_t i=0; i<m_variables->Count(); ++i)
+    {
+        size += sizeof(unsigned int) + m_variables->Item(i).Length();
+    }
+    size_t* map = new size_t[m_countFunctions > 0 ? m_countFunctions : 1];
+    this->MapFunctions(map);
+    for (size_t i=0; i<m_countFunctions; ++i)
+    {
+        if (map[i] != (size_t)-1) size += 2*sizeof(unsigned int) + m_functions[i]->GetName().Length();
+    }
+    delete [] map;
+    return (MathImageAlign(size));
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathProgram::SaveImage(void* image, size_t size) const
+/**
+ * \brief Writes the program as binary image, which contains the instructions,
+ * the initial values and the names of the variables and functions. The image
+ * can be stored in a file and loaded with MathEvaluation::LoadProgram(), which
+ * skips the tokenizer, the compiler and the optimizer. Only the functions,
+ * which are called by the code, are written. The same image is always written
+ * for the same program. The native code is not saved.
+ * \remarks The image can only be loaded on machines with the same byte order
+ * and type sizes.
+ * \param image Memory, which receives the image (at least GetImageSize() bytes).
+ * \param size Size of the memory in bytes.
+ * \return True, if the image was written; false, if the memory is too small
+ * or a name contains non ASCII characters.
+ **/
+{
+    size_t imageSize = this->GetImageSize();
+    if (image == NULL || size < imageSize)
+    {
+        return (false);
+    }
+    char* data = (char*)image;
+    memset(data, 0, imageSize);
+
+    size_t* map = new size_t[m_countFunctions > 0 ? m_countFunctions : 1];
+    size_t countFunctions = this->MapFunctions(map);
+
+    MathImageHeader header;
+    memset(&header, 0, sizeof(MathImageHeader));
+    memcpy(header.Magic, MathImageMagic, sizeof(header.Magic));
+    header.Version = MathImageVersion;
+    header.ByteOrder = MathImageByteOrder;
+    header.InstructionSize = sizeof(MathInstruction);
+    header.IndexSize = sizeof(size_t);
+    header.ImageSize = imageSize;
+    header.CodeCount = m_codeCount;
+    header.StackDepth = m_stackDepth;
+    header.CountTemporaries = m_countTemporaries;
+    header.CountVariables = m_variables->Count();
+    header.CountFunctions = countFunctions;
+    header.CodeOffset = MathImageAlign(sizeof(MathImageHeader));
+    header.ValuesOffset = header.CodeOffset + MathImageAlign(m_codeCount*sizeof(MathInstruction));
+    header.NamesOffset = header.ValuesOffset + MathImageAlign(m_variables->Count()*sizeof(double));
+    memcpy(data, &header, sizeof(MathImageHeader));
+
+    // Copy the fields one by one, so the padding bytes stay zero
+    MathInstruction* code = (MathInstruction*)(data + header.CodeOffset);
+    for (size_t i=0; i<m_codeCount; ++i)
+    {
+        code[i].Type = m_code[i].Type;
+        if (m_code[i].Type == MathOpcodeType::LoadConstant) code[i].Value = m_code[i].Value;
+        else if (this->IsCall(m_code[i])) code[i].Index = (m_code[i].Index < m_countFunctions ? map[m_code[i].Index] : (size_t)-1);
+        else code[i].Index = m_code[i].Index;
+    }
+    memcpy(data + header.ValuesOffset, m_values, m_variables->Count()*sizeof(double));
+
+    // Write the names as ASCII, the functions in the order of their new index
+    MathFunction** functions = new MathFunction*[countFunctions > 0 ? countFunctions : 1];
+    for (size_t i=0; i<m_countFunctions; ++i)
+    {
+        if (map[i] != (size_t)-1) functions[map[i]] = m_functions[i];
+    }
+    bool valid = true;
+    char* names = data + header.NamesOffset;
+    for (size_t i=0; i<m_variables->Count() + countFunctions && valid; ++i)
+    {
+        const String& name = (i < m_variables->Count() ? m_variables->Item(i) :
+                              functions[i - m_variables->Count()]->GetName());
+        if (i >= m_variables->Count())
+        {
+            unsigned int args = (unsigned int)functions[i - m_variables->Count()]->GetArgs();
+            memcpy(names, &args, sizeof(unsigned int));
+            names += sizeof(unsigned int);
+        }
+        unsigned int length = (unsigned int)name.Length();
+        memcpy(names, &length, sizeof(unsigned int));
+        names += sizeof(unsigned int);
+        for (size_t c=0; c<length && valid; ++c)
+        {
+            valid = ((unsigned int)name[c] <= 127);
+            *names++ = (char)name[c];
+        }
+    }
+    delete [] functions;
+    delete [] map;
+    return (valid);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathProgram::Combine(MathFusion fusion, const MathBinding* bindings, size_t countBindings)
+/**
+ * \brief Creates the code with superinstructions, which is executed by the
+ * interpreter instead of the verified code. The images, the native code and
+ * the incremental execution use the verified code.
+ * \param fusion Selects the combined sequences, MathFusion::None removes the
+ * combined code, if no variable is bound.
+ * \param bindings Binding of every variable or NULL, the bound variables are
+ * accessed in the memory of the caller (only without native code).
+ * \param countBindings Number of bindings.
+ **/
+{
+    if (m_combined != NULL)
+    {
+        delete [] m_combined;
+        m_combined = NULL;
+        m_combinedCount = 0;
+    }
+    m_bound = (bindings != NULL && m_verified && m_jit == NULL);
+    if (m_verified && (fusion != MathFusion::None || m_bound))
+    {
+        MathPeephole peephole(fusion, m_functions, m_countFunctions,
+                              (m_bound ? bindings : NULL), (m_bound ? countBindings : 0));
+        m_combined = peephole.Combine(m_code, m_codeCount, &m_combinedCount);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathProgram::IsCall(const MathInstruction& instruction)
+/**
+ * \brief Checks if the instruction calls a function or an intrinsic, whose
+ * index refers to a function.
+ * \param instruction Instruction.
+ * \return True, if the index of the instruction is a function index; otherwise false.
+ **/
+{
+    return (instruction.Type == MathOpcodeType::CallFunction || MathOpcode::IsIntrinsic(instruction.Type));
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathProgram::MapFunctions(size_t* map) const
+/**
+ * \brief Numbers the functions, which are called by the code, in the order of
+ * their first call.
+ * \param map Receives the new index of every function or (size_t)-1, if the
+ * function is not called.
+ * \return Number of called functions.
+ **/
+{
+    size_t count = 0;
+    for (size_t i=0; i<m_countFunctions; ++i)
+    {
+        map[i] = (size_t)-1;
+    }
+    for (size_t i=0; i<m_codeCount; ++i)
+    {
+        if (this->IsCall(m_code[i]) && m_code[i].Index < m_countFunctions && map[m_code[i].Index] == (size_t)-1)
+        {
+            map[m_code[i].Index] = count++;
+        }
+    }
+    return (count);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathProgram::Execute(double* values, double* stack, StringArray* errors, char* object) const
+/**
+ * \brief Executes the program. The program itself is not changed, so this
+ * method can be called from multible threads with different values and stacks.
+ * If the native code is available, it is executed instead, otherwise the
+ * code with superinstructions is interpreted, if it was created.
+ * \param values Variable values, at least GetVariableCount() values.
+ * \param stack Stack, at least GetStackDepth() values.
+ * \param errors Receives the errors.
+ * \param object Object of the variables bound to members, see Combine().
+ * \return True, if executed without errors; otherwise false.
+ **/
+{
+    if (m_jit != NULL)
+    {
+        m_jit->Execute(values, stack);
+        return (true);
+    }
+    if (likely(m_combined != NULL))
+    {
+        return (this->Interpret<false, false>(m_combined, m_combinedCount, values, stack, object, errors, NULL));
+    }
+    if (likely(m_verified))
+    {
+        return (this->Interpret<false, false>(m_code, m_codeCount, values, stack, object, errors, NULL));
+    }
+    return (this->Interpret<true, false>(m_code, m_codeCount, values, stack, object, errors, NULL));
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathProgram::ExecuteRange(size_t first, size_t count, double* values, double* stack, StringArray* errors) const
+/**
+ * \brief Interprets a part of the program, which starts and ends with an
+ * empty stack, e.g. a single statement. The temporary values at the bottom
+ * of the stack are kept from former executions. The native code is not used.
+ * \param first Index of the first instruction.
+ * \param count Number of instructions.
+ * \param values Variable values, at least GetVariableCount() values.
+ * \param stack Stack, at least GetStackDepth() values.
+ * \param errors Receives the errors.
+ * \return True, if executed without errors; otherwise false.
+ **/
+{
+    if (likely(m_verified))
+    {
+        return (this->Interpret<false, false>(m_code + first, count, values, stack, NULL, errors, NULL));
+    }
+    return (this->Interpret<true, false>(m_code + first, count, values, stack, NULL, errors, NULL));
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathProgram::Profile(double* values, double* stack, StringArray* errors, MathProfile* profile,
+                          char* object) const
+/**
+ * \brief Interprets the program like Execute() and adds the executed opcodes,
+ * the function calls, their cycles and the stack depth to the profile. The
+ * native code is not used, so the profile shows the interpreted instructions.
+ * \param values Variable values, at least GetVariableCount() values.
+ * \param stack Stack, at least GetStackDepth() values.
+ * \param errors Receives the errors.
+ * \param profile Receives the counters.
+ * \param object Object of the variables bound to members, see Combine().
+ * \return True, if executed without errors; otherwise false.
+ **/
+{
+    profile->Prepare(m_functions, m_countFunctions);
+    unsigned long long start = System::GetCycles();
+    bool result;
+    if (m_combined != NULL) {
+        result = this->Interpret<false, true>(m_combined, m_combinedCount, values, stack, object, errors, profile);
+    } else if (likely(m_verified)) {
+        result = this->Interpret<false, true>(m_code, m_codeCount, values, stack, object, errors, profile);
+    } else {
+        result = this->Interpret<true, true>(m_code, m_codeCount, values, stack, object, errors, profile);
+    }
+    profile->m_cycles += System::GetCycles() - start;
+    profile->m_executions++;
+    return (result);
+}
+
+
+//-----------------------------------------------------------------------------
+template <bool checked, bool profiled>
+bool MathProgram::Interpret(const MathInstruction* code, size_t count, double* values, double* stack,
+                            char* object, StringArray* errors, MathProfile* profile) const
+/**
+ * \brief Interprets flat instructions of the program.
+ * \remarks The flat instruction array is walked with a threaded dispatch
+ * (computed goto) when compiled with GCC, otherwise with a switch statement.
+ * Without checks, the code must be verified: the indices and the stack depth
+ * are not checked per instruction. The profiling code is only compiled into
+ * the profiled instances, it measures the cycles from one dispatch to the next.
+ * \param code First instruction.
+ * \param count Number of instructions.
+ * \param values Variable values, at least GetVariableCount() values.
+ * \param stack Stack, at least GetStackDepth() values.
+ * \param object Object of the variables bound to members.
+ * \param errors Receives the errors.
+ * \param profile Receives the counters of the profiled instances, otherwise unused.
+ * \return True, if executed without errors; otherwise false.
+ **/
+{
+    const MathInstruction* ip = code;
+    const MathInstruction* end = code + count;
+    double* base = stack + m_countTemporaries;
+    double* top = base;
+    size_t countVariables = m_variables->Count();
+    double temp;
+    unsigned long long cycles = (profiled ? System::GetCycles() : 0);
+
+    // Counts the current instruction, removed by the compiler from the instances without profiling
+    #define RUSH_MATH_PROFILE() \
+        if (profiled) { \
+            unsigned long long now = System::GetCycles(); \
+            MathOpcodeProfile& counter = profile->m_opcodes[(size_t)ip->Type]; \
+            counter.Count++; \
+            counter.Cycles += now - cycles; \
+            cycles = now; \
+            if ((size_t)(top - stack) > profile->m_maxStackDepth) profile->m_maxStackDepth = top - stack; \
+        }
+
+    // The checks are removed by the compiler from the unchecked instance
+    #define RUSH_MATH_CHECK(condition, message) \
+        if (checked && unlikely(condition)) { \
+            errors->Add(message); \
+            return (false); \
+        }
+
+    #ifdef __GNUC__
+    // NOTE: Must be in the same order as MathOpcodeType
+    static void* dispatchTable[] = {
+        &&LoadConstant, &&LoadVariable, &&SaveVariable, &&CallFunction,
+        &&Add, &&Sub, &&Mul, &&Div, &&Neg, &&Double, &&LoadTemporary, &&StoreTemporary,
+        &&Abs, &&Sqrt, &&Exp, &&Ln, &&Log10, &&Pow, &&Mod, &&Floor, &&Ceil, &&Sin, &&Cos, &&Tan,
+        &&Nop, &&Less, &&LessEqual, &&Greater, &&GreaterEqual, &&Equal, &&NotEqual, &&Select,
+        &&AddVariable, &&SubVariable, &&MulVariable, &&DivVariable,
+        &&AddConstant, &&MulConstant, &&DivConstant, &&MulAdd, &&MulVariableAdd, &&MulConstantAdd,
+        &&LoadAddress, &&SaveAddress, &&LoadMember, &&SaveMember,
+        &&CallNative1, &&CallNative2, &&CallNative3, &&Opcodes };
+    #define RUSH_MATH_CASE(type) type:
+    #define RUSH_MATH_DISPATCH() \
+        if (checked && unlikely((size_t)ip->Type > (size_t)MathOpcodeType::Opcodes)) goto Opcodes; \
+        goto *dispatchTable[(int)ip->Type]
+    #define RUSH_MATH_NEXT() \
+        RUSH_MATH_PROFILE() \
+        if (unlikely(++ip == end)) return (true); \
+        RUSH_MATH_DISPATCH()
+    if (ip == end) return (true);
+    RUSH_MATH_DISPATCH();
+    #else
+    #define RUSH_MATH_CASE(type) case MathOpcodeType::type:
+    #define RUSH_MATH_NEXT() RUSH_MATH_PROFILE() break
+    for (; ip != end; ++ip)
+    {
+    switch (ip->Type)
+    {
+    #endif
+
+    RUSH_MATH_CASE(LoadConstant)
+        *top++ = ip->Value;
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(LoadVariable)
+        RUSH_MATH_CHECK(ip->Index >= countVariables,
+            String::Format(_T("Cannot load variable at index '%i', because it does not exist."), ip->Index));
+        *top++ = values[ip->Index];
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(SaveVariable)
+        RUSH_MATH_CHECK(ip->Index >= countVariables,
+            String::Format(_T("Cannot save variable at index '%i', because it does not exist."), ip->Index));
+        RUSH_MATH_CHECK(top - base < 1, _T("At least one value needed for an SAV operation."));
+        values[ip->Index] = *--top;
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(CallFunction)
+        RUSH_MATH_CHECK(ip->Index >= m_countFunctions,
+            String::Format(_T("Cannot find function at index '%i', because it does not exist."), ip->Index));
+        {
+            MathFunction* function = m_functions[ip->Index];
+            size_t countArgs = function->GetArgs();
+            RUSH_MATH_CHECK((size_t)(top - base) < countArgs,
+                String::Format(_T("At least '%u' values needed for the CALL operation."), countArgs));
+            // NOTE: The arguments are already in order on the stack
+            top -= countArgs;
+            if (profiled) {
+                unsigned long long start = System::GetCycles();
+                *top = function->Evaluate(top, countArgs);
+                MathFunctionProfile& counter = profile->m_functions[ip->Index];
+                counter.Calls++;
+                counter.Cycles += System::GetCycles() - start;
+            } else {
+                *top = function->Evaluate(top, countArgs);
+            }
+            top++;
+        }
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(Add)
+        RUSH_MATH_CHECK(top - base < 2, _T("At least two values needed for an ADD operation."));
+        top--;
+        top[-1] += top[0];
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(Sub)
+        RUSH_MATH_CHECK(top - base < 2, _T("At least two values needed for an SUB operation."));
+        top--;
+        top[-1] -= top[0];
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(Mul)
+        RUSH_MATH_CHECK(top - base < 2, _T("At least two values needed for an MUL operation."));
+        top--;
+        top[-1] *= top[0];
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(Div)
+        RUSH_MATH_CHECK(top - base < 2, _T("At least two values needed for an DIV operation."));
+        top--;
+        top[-1] /= top[0];
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(Neg)
+        RUSH_MATH_CHECK(top - base < 1, _T("At least one value needed for an NEG operation."));
+        top[-1] = -top[-1];
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(Double)
+        RUSH_MATH_CHECK(top - base < 1, _T("At least one value needed for an DBL operation."));
+        temp = top[-1];
+        *top++ = temp;
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(LoadTemporary)
+        RUSH_MATH_CHECK(ip->Index >= m_countTemporaries,
+            String::Format(_T("Cannot load temporary value at index '%i', because it does not exist."), ip->Index));
+        *top++ = stack[ip->Index];
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(StoreTemporary)
+        RUSH_MATH_CHECK(ip->Index >= m_countTemporaries,
+            String::Format(_T("Cannot store temporary value at index '%i', because it does not exist."), ip->Index));
+        RUSH_MATH_CHECK(top - base < 1, _T("At least one value needed for an STT operation."));
+        stack[ip->Index] = top[-1];
+        RUSH_MATH_NEXT();
+
+    // Intrinsics of the default functions, executed without the virtual call
+    #define RUSH_MATH_UNARY(type, name, function) \
+    RUSH_MATH_CASE(type) \
+        RUSH_MATH_CHECK(top - base < 1, _T("At least one value needed for an ") _T(name) _T(" operation.")); \
+        top[-1] = function(top[-1]); \
+        RUSH_MATH_NEXT();
+    #define RUSH_MATH_BINARY(type, name, function) \
+    RUSH_MATH_CASE(type) \
+        RUSH_MATH_CHECK(top - base < 2, _T("At least two values needed for an ") _T(name) _T(" operation.")); \
+        top--; \
+        top[-1] = function(top[-1], top[0]); \
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_UNARY(Abs, "ABS", fabs)
+    RUSH_MATH_UNARY(Sqrt, "SQRT", sqrt)
+    RUSH_MATH_UNARY(Exp, "EXP", exp)
+    RUSH_MATH_UNARY(Ln, "LN", log)
+    RUSH_MATH_UNARY(Log10, "LOG10", log10)
+    RUSH_MATH_BINARY(Pow, "POW", pow)
+    RUSH_MATH_BINARY(Mod, "MOD", fmod)
+    RUSH_MATH_UNARY(Floor, "FLOOR", floor)
+    RUSH_MATH_UNARY(Ceil, "CEIL", ceil)
+    RUSH_MATH_UNARY(Sin, "SIN", sin)
+    RUSH_MATH_UNARY(Cos, "COS", cos)
+    RUSH_MATH_UNARY(Tan, "TAN", tan)
+    #undef RUSH_MATH_UNARY
+    #undef RUSH_MATH_BINARY
+
+    RUSH_MATH_CASE(Nop)
+        RUSH_MATH_NEXT();
+
+    // Comparisons and select without branches, the comparisons push 1 or 0
+    #define RUSH_MATH_COMPARE(type, name, operation) \
+    RUSH_MATH_CASE(type) \
+        RUSH_MATH_CHECK(top - base < 2, _T("At least two values needed for an ") _T(name) _T(" operation.")); \
+        top--; \
+        top[-1] = (double)(top[-1] operation top[0]); \
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_COMPARE(Less, "LT", <)
+    RUSH_MATH_COMPARE(LessEqual, "LE", <=)
+    RUSH_MATH_COMPARE(Greater, "GT", >)
+    RUSH_MATH_COMPARE(GreaterEqual, "GE", >=)
+    RUSH_MATH_COMPARE(Equal, "EQ", ==)
+    RUSH_MATH_COMPARE(NotEqual, "NE", !=)
+    #undef RUSH_MATH_COMPARE
+
+    RUSH_MATH_CASE(Select)
+        RUSH_MATH_CHECK(top - base < 3, _T("At least three values needed for an SEL operation."));
+        top -= 2;
+        top[-1] = MathSelect(top[-1], top[0], top[1]);
+        RUSH_MATH_NEXT();
+
+    // Superinstructions, the right operand is a variable or a constant
+    #define RUSH_MATH_VARIABLE(type, name, operation) \
+    RUSH_MATH_CASE(type) \
+        RUSH_MATH_CHECK(ip->Index >= countVariables, \
+            String::Format(_T("Cannot load variable at index '%i', because it does not exist."), ip->Index)); \
+        RUSH_MATH_CHECK(top - base < 1, _T("At least one value needed for an ") _T(name) _T(" operation.")); \
+        top[-1] operation values[ip->Index]; \
+        RUSH_MATH_NEXT();
+    #define RUSH_MATH_CONSTANT(type, name, operation) \
+    RUSH_MATH_CASE(type) \
+        RUSH_MATH_CHECK(top - base < 1, _T("At least one value needed for an ") _T(name) _T(" operation.")); \
+        top[-1] operation ip->Value; \
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_VARIABLE(AddVariable, "ADDV", +=)
+    RUSH_MATH_VARIABLE(SubVariable, "SUBV", -=)
+    RUSH_MATH_VARIABLE(MulVariable, "MULV", *=)
+    RUSH_MATH_VARIABLE(DivVariable, "DIVV", /=)
+    RUSH_MATH_CONSTANT(AddConstant, "ADDC", +=)
+    RUSH_MATH_CONSTANT(MulConstant, "MULC", *=)
+    RUSH_MATH_CONSTANT(DivConstant, "DIVC", /=)
+    #undef RUSH_MATH_VARIABLE
+    #undef RUSH_MATH_CONSTANT
+
+    RUSH_MATH_CASE(MulAdd)
+        RUSH_MATH_CHECK(top - base < 3, _T("At least three values needed for an FMA operation."));
+        top -= 2;
+        top[-1] = fma(top[0], top[1], top[-1]);
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(MulVariableAdd)
+        RUSH_MATH_CHECK(ip->Index >= countVariables,
+            String::Format(_T("Cannot load variable at index '%i', because it does not exist."), ip->Index));
+        RUSH_MATH_CHECK(top - base < 2, _T("At least two values needed for an FMAV operation."));
+        top--;
+        top[-1] = fma(top[0], values[ip->Index], top[-1]);
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(MulConstantAdd)
+        RUSH_MATH_CHECK(top - base < 2, _T("At least two values needed for an FMAC operation."));
+        top--;
+        top[-1] = fma(top[0], ip->Value, top[-1]);
+        RUSH_MATH_NEXT();
+
+    // Variables bound to the memory of the caller
+    RUSH_MATH_CASE(LoadAddress)
+        *top++ = *ip->Address;
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(SaveAddress)
+        RUSH_MATH_CHECK(top - base < 1, _T("At least one value needed for an SAA operation."));
+        *ip->Address = *--top;
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(LoadMember)
+        *top++ = *(double*)(object + ip->Index);
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(SaveMember)
+        RUSH_MATH_CHECK(top - base < 1, _T("At least one value needed for an SAM operation."));
+        *(double*)(object + ip->Index) = *--top;
+        RUSH_MATH_NEXT();
+
+    // Direct calls of native functions, the arguments are passed by value
+    RUSH_MATH_CASE(CallNative1)
+        RUSH_MATH_CHECK(top - base < 1, _T("At least one value needed for an CALL1 operation."));
+        top[-1] = ((double (*)(double))ip->Native)(top[-1]);
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(CallNative2)
+        RUSH_MATH_CHECK(top - base < 2, _T("At least two values needed for an CALL2 operation."));
+        top--;
+        top[-1] = ((double (*)(double, double))ip->Native)(top[-1], top[0]);
+        RUSH_MATH_NEXT();
+
+    RUSH_MATH_CASE(CallNative3)
+        RUSH_MATH_CHECK(top - base < 3, _T("At least three values needed for an CALL3 operation."));
+        top -= 2;
+        top[-1] = ((double (*)(double, double, double))ip->Native)(top[-1], top[0], top[1]);
+        RUSH_MATH_NEXT();
+
+    #ifdef __GNUC__
+    RUSH_MATH_CASE(Opcodes)
+    #else
+    default:
+    #endif
+        errors->Add(_T("Unknown opcode."));
+        return (false);
+
+    #ifndef __GNUC__
+    }
+    }
+    return (true);
+    #endif
+    #undef RUSH_MATH_CHECK
+    #undef RUSH_MATH_PROFILE
+    #undef RUSH_MATH_CASE
+    #undef RUSH_MATH_DISPATCH
+    #undef RUSH_MATH_NEXT
+}
+
+
+
+
+//-----------------------------------------------------------------------------
+MathContext::MathContext(const MathProgram* program)
+/**
+ * \brief Constructor, initializes the MathContext object for the given program.
+ * The program must not be deleted before the context.
+ * \param program Program to execute.
+ **/
+{
+    size_t countVariables = program->GetVariableCount();
+    m_program = program;
+    m_values = new double[countVariables > 0 ? countVariables : 1];
+    m_stack = new double[program->GetStackDepth() > 0 ? program->GetStackDepth() : 1];
+    m_errors = new StringArray();
+    this->ResetVariables();
+}
+
+
+//-----------------------------------------------------------------------------
+MathContext::~MathContext()
+/**
+ * \brief Destructor, frees allocated memory.
+ **/
+{
+    if (m_values != NULL) delete [] m_values;
+    if (m_stack != NULL) delete [] m_stack;
+    if (m_errors != NULL) delete m_errors;
+}
+
+
+//-----------------------------------------------------------------------------
+const MathProgram* MathContext::GetProgram() const
+/**
+ * \brief Returns the program executed by this context.
+ * \return Program.
+ **/
+{
+    return (m_program);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathContext::SetVariable(const String& name, double value)
+/**
+ * \brief Sets the value of a variable in this context. An error is generated
+ * if the program does not use the variable. The variable name is case-sensitive.
+ * \param name Variable name.
+ * \param value Variable value.
+ **/
+{
+    int index = m_program->FindVariableIndex(name);
+    if (index < 0)
+    {
+        m_errors->Add(String::Format(_T("Variable '%s' does not exist."), name.c_str()));
+        return;
+    }
+    m_values[index] = value;
+}
+
+
+//-----------------------------------------------------------------------------
+double MathContext::GetVariable(const String& name) const
+/**
+ * \brief Gets the value of a variable in this context. An error is generated
+ * if the program does not use the variable. The variable name is case-sensitive.
+ * \param name Variable name.
+ * \return Variable value.
+ **/
+{
+    int index = m_program->FindVariableIndex(name);
+    if (index < 0)
+    {
+        m_errors->Add(String::Format(_T("Variable '%s' does not exist."), name.c_str()));
+        return (0.0d);
+    }
+    return (m_values[index]);
+}
+
+
+//-----------------------------------------------------------------------------
+MathVariableHandle MathContext::GetVariableHandle(const String& name) const
+/**
+ * \brief Resolves the name of a variable into a handle, which can be used to
+ * set and get the variable quickly. An error is generated if the program does
+ * not use the variable, the handle is not valid then (see IsValid()).
+ * \param name Variable name.
+ * \return Variable handle.
+ **/
+{
+    MathVariableHandle handle;
+    handle.Index = (size_t)m_program->FindVariableIndex(name);
+    if (handle.Index >= m_program->GetVariableCount())
+    {
+        m_errors->Add(String::Format(_T("Variable '%s' does not exist."), name.c_str()));
+    }
+    return (handle);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathContext::SetVariable(MathVariableHandle handle, double value)
+/**
+ * \brief Sets the value of a variable in this context. An error is generated
+ * if the handle is invalid.
+ * \param handle Variable handle.
+ * \param value Variable value.
+ **/
+{
+    if (unlikely(handle.Index >= m_program->GetVariableCount()))
+    {
+        m_errors->Add(_T("Invalid variable handle."));
+        return;
+    }
+    m_values[handle.Index] = value;
+}
+
+
+//-----------------------------------------------------------------------------
+double MathContext::GetVariable(MathVariableHandle handle) const
+/**
+ * \brief Gets the value of a variable in this context. An error is generated
+ * if the handle is invalid.
+ * \param handle Variable handle.
+ * \return Variable value.
+ **/
+{
+    if (unlikely(handle.Index >= m_program->GetVariableCount()))
+    {
+        m_errors->Add(_T("Invalid variable handle."));
+        return (0.0d);
+    }
+    return (m_values[handle.Index]);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathContext::ResetVariables()
+/**
+ * \brief Sets all variables back to their initial values.
+ **/
+{
+    for (size_t i=0; i<m_program->GetVariableCount(); ++i)
+    {
+        m_values[i] = m_program->GetInitialValue(i);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathContext::HasErrors() const
+/**
+ * \brief Checks if errors are stored within this context.
+ * \return True, if contains errors; otherwise false.
+ **/
+{
+    return (m_errors->Count() != 0);
+}
+
+
+//-----------------------------------------------------------------------------
+String MathContext::GetErrorMessage() const
+/**
+ * \brief Returns the oldest error message and removes it from the errors
+ * list. This method returns a empty string, if there are no more errors.
+ * \return Oldest error message or a empty string.
+ **/
+{
+    if (m_errors->Count() > 0)
+    {
+        String message = m_errors->Item(0);
+        m_errors->Remove(0);
+        return (message);
+    }
+    return (_T(""));
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathContext::Execute()
+/**
+ * \brief Executes the program with the variables of this context.
+ * \return True, if no errors available; otherwise false.
+ **/
+{
+    m_program->Execute(m_values, m_stack, m_errors);
+    return (m_errors->Count() == 0);
+}
+
+
+
+} // namespace rush
+
+
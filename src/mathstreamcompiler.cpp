@@ -0,0 +1,327 @@
+/*
+ * mathstreamcompiler.cpp - Implementation of the MathStreamCompiler class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#include "mathstreamcompiler.h"
+#include "mathcompiler.h"
+#include "mathoptimizer.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+MathStreamCompiler::MathStreamCompiler(MathEvaluation* evaluation)
+/**
+ * \brief Constructor, initializes the MathStreamCompiler object.
+ * \param evaluation Evaluation, which provides the variables and functions
+ * and receives the errors. New variables are added to the evaluation.
+ **/
+{
+    m_evaluation = evaluation;
+    m_pending = NULL;
+    m_countPending = 0;
+    m_capacityPending = 0;
+    m_code = NULL;
+    m_countCode = 0;
+    m_capacityCode = 0;
+    m_countTemporaries = 0;
+    m_line = 0;
+    m_failed = false;
+}
+
+
+//-----------------------------------------------------------------------------
+MathStreamCompiler::~MathStreamCompiler()
+/**
+ * \brief Destructor, frees allocated memory.
+ **/
+{
+    if (m_pending != NULL) delete [] m_pending;
+    if (m_code != NULL) delete [] m_code;
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathStreamCompiler::Write(const Char* text, size_t length)
+/**
+ * \brief Compiles the statements, which are completed by the given part.
+ * Statements inside the part are compiled in place, only the statement at
+ * the begin and the one at the end of the part are copied.
+ * \param text Part of the statements.
+ * \param length Number of characters.
+ * \return True, if no errors occured; otherwise false.
+ **/
+{
+    if (m_failed)
+    {
+        return (false);
+    }
+    size_t start = 0;
+    for (size_t i=0; i<length; ++i)
+    {
+        if (text[i] != ';') continue;
+        bool valid;
+        if (m_countPending > 0) {
+            this->Keep(text + start, i+1 - start);
+            valid = this->CompileStatement(m_pending, m_countPending);
+            m_countPending = 0;
+        } else {
+            valid = this->CompileStatement(text + start, i+1 - start);
+        }
+        if (!valid)
+        {
+            m_failed = true;
+            return (false);
+        }
+        start = i+1;
+    }
+    this->Keep(text + start, length - start);
+    return (true);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathStreamCompiler::WriteFile(const String& fileName)
+/**
+ * \brief Reads the statements of an ASCII file in parts of MathStreamChunkSize
+ * characters and compiles them.
+ * \param fileName Name of the file.
+ * \return True, if no errors occured; otherwise false.
+ **/
+{
+    #ifdef _RUSH_UNICODE_
+    char name[512];
+    wcstombs(name, fileName.c_str(), 512);
+    FILE* file = fopen(name, "rb");
+    #else
+    FILE* file = fopen(fileName.c_str(), "rb");
+    #endif
+    if (file == NULL)
+    {
+        m_evaluation->m_errors->Add(String::Format(_T("Cannot open the file '%s'."), fileName.c_str()));
+        m_failed = true;
+        return (false);
+    }
+
+    char* bytes = new char[MathStreamChunkSize];
+    #ifdef _RUSH_UNICODE_
+    Char* chunk = new Char[MathStreamChunkSize];
+    #endif
+    bool valid = true;
+    size_t read = 0;
+    while (valid && (read = fread(bytes, 1, MathStreamChunkSize, file)) > 0)
+    {
+        #ifdef _RUSH_UNICODE_
+        for (size_t i=0; i<read; ++i)
+        {
+            chunk[i] = (Char)(unsigned char)bytes[i];
+        }
+        valid = this->Write(chunk, read);
+        #else
+        valid = this->Write(bytes, read);
+        #endif
+    }
+    if (valid && ferror(file))
+    {
+        m_evaluation->m_errors->Add(String::Format(_T("Cannot read the file '%s'."), fileName.c_str()));
+        m_failed = true;
+        valid = false;
+    }
+    #ifdef _RUSH_UNICODE_
+    delete [] chunk;
+    #endif
+    delete [] bytes;
+    fclose(file);
+    return (valid);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathStreamCompiler::Finish()
+/**
+ * \brief Compiles the last statement, which does not need to end with a
+ * semicolon.
+ * \return True, if no errors occured in all parts; otherwise false.
+ **/
+{
+    if (m_failed)
+    {
+        return (false);
+    }
+    bool valid = this->CompileStatement(m_pending, m_countPending);
+    m_countPending = 0;
+    m_failed = !valid;
+    return (valid);
+}
+
+
+//-----------------------------------------------------------------------------
+MathInstruction* MathStreamCompiler::DetachCode(size_t* count, size_t* countTemporaries)
+/**
+ * \brief Returns the code of all compiled statements, which is no longer
+ * owned by this object.
+ * \param count Receives the number of instructions.
+ * \param countTemporaries Receives the number of temporary values.
+ * \return Instructions, which must be deleted by the caller or NULL, if no
+ * statement was compiled.
+ **/
+{
+    MathInstruction* code = m_code;
+    *count = m_countCode;
+    *countTemporaries = m_countTemporaries;
+    m_code = NULL;
+    m_countCode = 0;
+    m_capacityCode = 0;
+    m_countTemporaries = 0;
+    return (code);
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathStreamCompiler::CompileStatement(const Char* text, size_t length)
+/**
+ * \brief Tokenizes, compiles and optimizes one statement and appends its code.
+ * The code stays unoptimized, if it cannot be optimized.
+ * \param text Statement including the semicolon.
+ * \param length Number of characters.
+ * \return True, if no errors occured; otherwise false.
+ **/
+{
+    if (!m_tokenizer.Parse(text, length, m_evaluation->m_errors, m_line))
+    {
+        return (false);
+    }
+    for (size_t i=0; i<length; ++i)
+    {
+        if (text[i] == '\n') m_line++;
+    }
+    if (m_tokenizer.Count() == 0)
+    {
+        return (true);
+    }
+
+    MathCompiler compiler(m_evaluation);
+    size_t count = 0;
+    MathInstruction* code = compiler.Compile(m_tokenizer.GetTokens(), m_tokenizer.Count(), &count);
+    if (code == NULL)
+    {
+        return (false);
+    }
+
+    // The optimizer keeps a version per variable index, so the variables of
+    // the statement are numbered from zero while it is optimized
+    size_t* variables = new size_t[count];
+    this->NumberVariables(code, count, variables);
+    MathOptimizer optimizer(m_evaluation->m_functions);
+    size_t countOptimized = 0;
+    MathInstruction* optimized = optimizer.Optimize(code, count, &countOptimized);
+    if (optimized != NULL)
+    {
+        delete [] code;
+        code = optimized;
+        count = countOptimized;
+        if (optimizer.GetTemporaryCount() > m_countTemporaries) m_countTemporaries = optimizer.GetTemporaryCount();
+    }
+    for (size_t i=0; i<count; ++i)
+    {
+        if (code[i].Type == MathOpcodeType::LoadVariable || code[i].Type == MathOpcodeType::SaveVariable)
+        {
+            code[i].Index = variables[code[i].Index];
+        }
+    }
+    delete [] variables;
+    this->Append(code, count);
+    delete [] code;
+    return (true);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathStreamCompiler::NumberVariables(MathInstruction* code, size_t count, size_t* variables)
+/**
+ * \brief Replaces the variable indices of a statement by local indices.
+ * \param code Instructions of the statement.
+ * \param count Number of instructions.
+ * \param variables Receives the variable index per local index, at least
+ * count entries.
+ **/
+{
+    size_t countVariables = 0;
+    for (size_t i=0; i<count; ++i)
+    {
+        if (code[i].Type != MathOpcodeType::LoadVariable && code[i].Type != MathOpcodeType::SaveVariable) continue;
+        size_t local = 0;
+        while (local < countVariables && variables[local] != code[i].Index) local++;
+        if (local == countVariables) variables[countVariables++] = code[i].Index;
+        code[i].Index = local;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+void MathStreamCompiler::Keep(const Char* text, size_t length)
+/**
+ * \brief Appends characters to the incomplete statement.
+ * \param text Characters.
+ * \param length Number of characters.
+ **/
+{
+    if (length == 0)
+    {
+        return;
+    }
+    if (m_countPending + length > m_capacityPending)
+    {
+        size_t capacity = (m_capacityPending > 0 ? m_capacityPending : 256);
+        while (capacity < m_countPending + length) capacity *= 2;
+        Char* pending = new Char[capacity];
+        if (m_pending != NULL)
+        {
+            memcpy(pending, m_pending, m_countPending*sizeof(Char));
+            delete [] m_pending;
+        }
+        m_pending = pending;
+        m_capacityPending = capacity;
+    }
+    memcpy(m_pending + m_countPending, text, length*sizeof(Char));
+    m_countPending += length;
+}
+
+
+//-----------------------------------------------------------------------------
+void MathStreamCompiler::Append(const MathInstruction* code, size_t count)
+/**
+ * \brief Appends the code of a statement to the result.
+ * \param code Instructions.
+ * \param count Number of instructions.
+ **/
+{
+    if (m_countCode + count > m_capacityCode)
+    {
+        size_t capacity = (m_capacityCode > 0 ? m_capacityCode : 256);
+        while (capacity < m_countCode + count) capacity *= 2;
+        MathInstruction* result = new MathInstruction[capacity];
+        if (m_code != NULL)
+        {
+            memcpy(result, m_code, m_countCode*sizeof(MathInstruction));
+            delete [] m_code;
+        }
+        m_code = result;
+        m_capacityCode = capacity;
+    }
+    memcpy(m_code + m_countCode, code, count*sizeof(MathInstruction));
+    m_countCode += count;
+}
+
+
+} // namespace rush
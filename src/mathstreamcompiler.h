@@ -0,0 +1,74 @@
+/*
+ * mathstreamcompiler.h - Declaration of the MathStreamCompiler class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHSTREAMCOMPILER_H_
+#define _RUSH_MATHSTREAMCOMPILER_H_
+
+
+#include <rush/mathevaluation.h>
+#include <rush/mathtokenizer.h>
+
+
+namespace rush {
+
+
+/// \brief Number of characters, which are read from a file at once.
+const size_t MathStreamChunkSize = 65536;
+
+
+/**
+ * \brief The MathStreamCompiler class compiles statements, which are written
+ * in parts of any size, e.g. read from a file. Every complete statement is
+ * tokenized, compiled and optimized on its own and its code is appended to
+ * the result, so only the tokens and the nodes of one statement exist at
+ * the same time. The characters of a statement, which is not complete at the
+ * end of a part, are kept until the next part.
+ * \remarks Common subexpressions are only shared inside a statement, the
+ * temporary values are reused by the following statements.
+ **/
+class MathStreamCompiler
+{
+    public:
+        MathStreamCompiler(MathEvaluation* evaluation);
+        ~MathStreamCompiler();
+
+        bool Write(const Char* text, size_t length);
+        bool WriteFile(const String& fileName);
+        bool Finish();
+
+        MathInstruction* DetachCode(size_t* count, size_t* countTemporaries);
+
+    private:
+        MathStreamCompiler(const MathStreamCompiler& compiler) {}
+        MathStreamCompiler& operator=(const MathStreamCompiler& compiler) { return (*this); }
+
+        bool CompileStatement(const Char* text, size_t length);
+        void NumberVariables(MathInstruction* code, size_t count, size_t* variables);
+        void Keep(const Char* text, size_t length);
+        void Append(const MathInstruction* code, size_t count);
+
+    private:
+        MathEvaluation* m_evaluation;
+        MathTokenizer m_tokenizer;
+        Char* m_pending;
+        size_t m_countPending;
+        size_t m_capacityPending;
+        MathInstruction* m_code;
+        size_t m_countCode;
+        size_t m_capacityCode;
+        size_t m_countTemporaries;
+        int m_line;
+        bool m_failed;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHSTREAMCOMPILER_H_
@@ -0,0 +1,242 @@
+/*
+ * mathsymboltable.cpp - Implementation of the MathSymbolTable class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#include "mathsymboltable.h"
+#include <string.h>
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+MathSymbolTable::MathSymbolTable()
+/**
+ * \brief Constructor, initializes the MathSymbolTable object.
+ **/
+{
+    m_names = new StringArray();
+    m_hashesCapacity = 8;
+    m_hashes = new size_t[m_hashesCapacity];
+    m_slots = NULL;
+    m_capacity = 0;
+    this->Rehash(16);
+}
+
+
+//-----------------------------------------------------------------------------
+MathSymbolTable::MathSymbolTable(const MathSymbolTable& table)
+/**
+ * \brief Copy constructor, copies the symbols of the given table.
+ * \param table Table to copy.
+ **/
+{
+    m_names = new StringArray();
+    m_hashesCapacity = 0;
+    m_hashes = NULL;
+    m_slots = NULL;
+    m_capacity = 0;
+    *this = table;
+}
+
+
+//-----------------------------------------------------------------------------
+MathSymbolTable::~MathSymbolTable()
+/**
+ * \brief Destructor, frees allocated memory.
+ **/
+{
+    if (m_names != NULL) delete m_names;
+    if (m_hashes != NULL) delete [] m_hashes;
+    if (m_slots != NULL) delete [] m_slots;
+}
+
+
+//-----------------------------------------------------------------------------
+MathSymbolTable& MathSymbolTable::operator=(const MathSymbolTable& table)
+/**
+ * \brief Copies the symbols of the given table into this table.
+ * \param table Table to copy.
+ * \return This table.
+ **/
+{
+    if (this == &table) return (*this);
+    *m_names = *table.m_names;
+    if (m_hashes != NULL) delete [] m_hashes;
+    m_hashesCapacity = table.m_hashesCapacity;
+    m_hashes = new size_t[m_hashesCapacity];
+    memcpy(m_hashes, table.m_hashes, table.Count()*sizeof(size_t));
+    if (m_slots != NULL) delete [] m_slots;
+    m_capacity = table.m_capacity;
+    m_slots = new int[m_capacity];
+    memcpy(m_slots, table.m_slots, m_capacity*sizeof(int));
+    return (*this);
+}
+
+
+//-----------------------------------------------------------------------------
+int MathSymbolTable::Find(const String& name) const
+/**
+ * \brief Returns the index of a symbol or -1 if the symbol does not exists.
+ * The names are only compared, if their hashes are equal.
+ * \param name Symbol name.
+ * \return Symbol index or -1 if the symbol does not exist.
+ **/
+{
+    return (this->Find(name.c_str(), name.Length()));
+}
+
+
+//-----------------------------------------------------------------------------
+int MathSymbolTable::Find(const Char* name, size_t length) const
+/**
+ * \brief Returns the index of a symbol or -1 if the symbol does not exists.
+ * The name does not have to be zero terminated, e.g. a token of the statements.
+ * \param name Symbol name.
+ * \param length Length of the name.
+ * \return Symbol index or -1 if the symbol does not exist.
+ **/
+{
+    size_t hash = Hash(name, length);
+    size_t mask = m_capacity - 1;
+    for (size_t slot = hash & mask; m_slots[slot] >= 0; slot = (slot + 1) & mask)
+    {
+        int index = m_slots[slot];
+        if (m_hashes[index] == hash)
+        {
+            const String& other = m_names->Item(index);
+            if (other.Length() == length && memcmp(other.c_str(), name, length*sizeof(Char)) == 0)
+            {
+                return (index);
+            }
+        }
+    }
+    return (-1);
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathSymbolTable::Add(const String& name)
+/**
+ * \brief Adds a symbol to the table. If the symbol already exists, the
+ * existing index is returned.
+ * \param name Symbol name.
+ * \return Symbol index.
+ **/
+{
+    int existing = this->Find(name);
+    if (existing >= 0) return (existing);
+
+    // Keep the table at most half full
+    size_t index = m_names->Count();
+    if (2*(index+1) > m_capacity)
+    {
+        this->Rehash(2*m_capacity);
+    }
+    if (index == m_hashesCapacity)
+    {
+        size_t* hashes = new size_t[2*m_hashesCapacity];
+        memcpy(hashes, m_hashes, m_hashesCapacity*sizeof(size_t));
+        delete [] m_hashes;
+        m_hashes = hashes;
+        m_hashesCapacity *= 2;
+    }
+
+    size_t hash = Hash(name);
+    size_t mask = m_capacity - 1;
+    size_t slot = hash & mask;
+    while (m_slots[slot] >= 0)
+    {
+        slot = (slot + 1) & mask;
+    }
+    m_slots[slot] = index;
+    m_hashes[index] = hash;
+    m_names->Add(name);
+    return (index);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathSymbolTable::Clear()
+/**
+ * \brief Removes all symbols from the table.
+ **/
+{
+    m_names->Clear();
+    for (size_t i=0; i<m_capacity; ++i)
+    {
+        m_slots[i] = -1;
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathSymbolTable::Hash(const String& name)
+/**
+ * \brief Calculates the hash of a name (Jenkins one-at-a-time hash).
+ * \param name Symbol name.
+ * \return Hash value.
+ **/
+{
+    return (Hash(name.c_str(), name.Length()));
+}
+
+
+//-----------------------------------------------------------------------------
+size_t MathSymbolTable::Hash(const Char* name, size_t length)
+/**
+ * \brief Calculates the hash of a name (Jenkins one-at-a-time hash).
+ * \param name Symbol name.
+ * \param length Length of the name.
+ * \return Hash value.
+ **/
+{
+    size_t hash = 0;
+    for (size_t i=0; i<length; ++i)
+    {
+        hash += (size_t)name[i];
+        hash += (hash << 10);
+        hash ^= (hash >> 6);
+    }
+    hash += (hash << 3);
+    hash ^= (hash >> 11);
+    hash += (hash << 15);
+    return (hash);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathSymbolTable::Rehash(size_t capacity)
+/**
+ * \brief Resizes the hash table and inserts all symbols again.
+ * \param capacity New number of slots, must be a power of two.
+ **/
+{
+    if (m_slots != NULL) delete [] m_slots;
+    m_capacity = capacity;
+    m_slots = new int[m_capacity];
+    for (size_t i=0; i<m_capacity; ++i)
+    {
+        m_slots[i] = -1;
+    }
+
+    size_t mask = m_capacity - 1;
+    for (size_t index=0; index<m_names->Count(); ++index)
+    {
+        size_t slot = m_hashes[index] & mask;
+        while (m_slots[slot] >= 0)
+        {
+            slot = (slot + 1) & mask;
+        }
+        m_slots[slot] = index;
+    }
+}
+
+
+} // namespace rush
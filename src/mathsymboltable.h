@@ -0,0 +1,82 @@
+/*
+ * mathsymboltable.h - Declaration of the MathSymbolTable class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHSYMBOLTABLE_H_
+#define _RUSH_MATHSYMBOLTABLE_H_
+
+
+#include <rush/config.h>
+#include <rush/string.h>
+#include <rush/stringarray.h>
+
+
+namespace rush {
+
+
+/**
+ * \brief The MathSymbolTable class maps the names of variables or functions
+ * to their index. The names are stored in order of their index and found
+ * with a hash table (open addressing with linear probing), so a lookup does
+ * not depend on the number of symbols. Symbols cannot be removed one by one.
+ **/
+class MathSymbolTable
+{
+    public:
+        MathSymbolTable();
+        MathSymbolTable(const MathSymbolTable& table);
+        ~MathSymbolTable();
+
+        MathSymbolTable& operator=(const MathSymbolTable& table);
+
+        int Find(const String& name) const;
+        int Find(const Char* name, size_t length) const;
+        size_t Add(const String& name);
+        void Clear();
+
+        /**
+         * \brief Returns the name of a symbol.
+         * \param index Symbol index.
+         * \return Symbol name.
+         **/
+        inline const String& Item(size_t index) const
+        { return (m_names->Item(index)); }
+
+        /**
+         * \brief Returns the names of all symbols in order of their index.
+         * \return Symbol names.
+         **/
+        inline const StringArray& GetNames() const
+        { return (*m_names); }
+
+        /**
+         * \brief Counts the symbols in this table.
+         * \return Number of symbols.
+         **/
+        inline size_t Count() const
+        { return (m_names->Count()); }
+
+        static size_t Hash(const String& name);
+        static size_t Hash(const Char* name, size_t length);
+
+    private:
+        void Rehash(size_t capacity);
+
+    private:
+        StringArray* m_names;
+        size_t* m_hashes;
+        size_t m_hashesCapacity;
+        int* m_slots;
+        size_t m_capacity;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHSYMBOLTABLE_H_
@@ -11,6 +11,7 @@
 
 #include <rush/mathtokenizer.h>
 #include <rush/console.h>
+#include <string.h>
 
 namespace rush {
 
@@ -24,7 +25,7 @@ const int stateMatrix[10][6] = {
     { -1,  1,  1,  1,  1, -1 },  // 4
     { -1,  1,  1,  1,  1,  1 },  // 5
     { -1,  4,  4,  4,  4,  4 },  // 6
-    {  1, -1, -1, -1, -1, -1 },  // 7
+    {  1,  4,  4,  4,  4,  4 },  // 7
     { -1,  0,  0,  0, -1,  0 },  // 8
     { -1,  1,  1, -1, -1,  1 }}; // 9
 
@@ -38,46 +39,71 @@ const int actionMatrix[10][6] = {
     {  0, 11, 12, 12, 13,  0 },  // 4
     {  0, 11, 14, 14, 13, 15 },  // 5
     {  0,  1, 16, 16,  1, 19 },  // 6
-    {  6,  0,  0,  0,  0,  0 },  // 7
+    {  6,  1, 16, 16,  1, 19 },  // 7
     {  0, 17, 18, 18,  0, 20 },  // 8
     {  0, 21, 22,  0,  0, 23 }}; // 9
 
 
+//-----------------------------------------------------------------------------
+// Input codes of the characters: 0 = letter or underscore, 1 = digit,
+// 2 = white space, 3 = point, 4 = bracket open, 5 = bracket close,
+// 6 = operator, 7 = assignment or part of a comparison, 8 = end statement,
+// 9 = comma, -1 = invalid
+const signed char inputCodes[256] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, -1,  2,  2, -1, -1,  2, -1, -1,  // 0x00
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  // 0x10
+     2,  6, -1, -1, -1, -1, -1, -1,  4,  5,  6,  6,  9,  6,  3,  6,  // 0x20
+     1,  1,  1,  1,  1,  1,  1,  1,  1,  1, -1,  8,  6,  7,  6, -1,  // 0x30
+    -1,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 0x40
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1, -1, -1, -1,  0,  // 0x50
+    -1,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 0x60
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0, -1, -1, -1, -1, -1,  // 0x70
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  // 0x80
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  // 0x90
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  // 0xA0
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  // 0xB0
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  // 0xC0
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  // 0xD0
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,  // 0xE0
+    -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1 }; // 0xF0
+
+
 
 //-----------------------------------------------------------------------------
-String MathToken::ToString() const
+String MathToken::GetContent() const
+/**
+ * \brief Copies the content of the token into a new string.
+ * \return Content of the token.
+ **/
 {
-    if (m_type == MathTokenType::Assignment)
-    {
-        return (String::Format(_T("%s="), m_content.c_str()));
-    }
-    else if (m_type == MathTokenType::Bracket)
+    String content(m_length+1);
+    for (size_t i=0; i<m_length; ++i)
     {
-        return (m_content.c_str());
+        content.Append(m_text[i]);
     }
-    else if (m_type == MathTokenType::Constant)
+    return (content);
+}
+
+
+//-----------------------------------------------------------------------------
+String MathToken::ToString() const
+{
+    if (m_type == MathTokenType::Assignment)
     {
-        return (m_content.c_str());
+        return (String::Format(_T("%s="), this->GetContent().c_str()));
     }
     else if (m_type == MathTokenType::EndStatement)
     {
-        return (m_content.c_str());
-    }
-    else if (m_type == MathTokenType::Function)
-    {
-        return (m_content.c_str());
-    }
-    else if (m_type == MathTokenType::Operator)
-    {
-        return (m_content.c_str());
-    }
-    else if (m_type == MathTokenType::Variable)
-    {
-        return (m_content.c_str());
+        return (_T(";"));
     }
-    else if (m_type == MathTokenType::Comma)
+    else if (m_type == MathTokenType::Bracket ||
+             m_type == MathTokenType::Constant ||
+             m_type == MathTokenType::Function ||
+             m_type == MathTokenType::Operator ||
+             m_type == MathTokenType::Variable ||
+             m_type == MathTokenType::Comma)
     {
-        return (m_content.c_str());
+        return (this->GetContent());
     }
     return (_T("Unknown token type"));
 }
@@ -86,8 +112,14 @@ String MathToken::ToString() const
 MathTokenizer::MathTokenizer()
 {
     m_currentstate = 0;
-    m_tokens = new MathTokenArray();
-    m_currenttoken = _T("");
+    m_capacityTokens = 64;
+    m_tokens = new MathToken[m_capacityTokens];
+    m_countTokens = 0;
+    m_text = NULL;
+    m_textLength = 0;
+    m_tokenStart = 0;
+    m_tokenLength = 0;
+    m_tokenSplit = false;
 }
 
 
@@ -96,95 +128,119 @@ MathTokenizer::~MathTokenizer()
 {
     if (m_tokens != NULL)
     {
-        delete m_tokens;
+        delete [] m_tokens;
     }
 }
 
 
 //-----------------------------------------------------------------------------
 bool MathTokenizer::Parse(const String& statements, StringArray* errors)
+/**
+ * \brief Splits the statements into tokens. The tokens refer to the
+ * statements, which must not be changed or deleted while the tokens are used.
+ * \param statements Mathematical statements.
+ * \param errors Receives the errors.
+ * \return True, if no errors occured; otherwise false.
+ **/
+{
+    return (this->Parse(statements.c_str(), statements.Length(), errors));
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathTokenizer::Parse(const Char* statements, size_t length, StringArray* errors, int firstLine)
+/**
+ * \brief Splits the statements into tokens. The tokens refer to the
+ * statements, which must not be changed or deleted while the tokens are used.
+ * \param statements Mathematical statements, which need no termination.
+ * \param length Number of characters.
+ * \param errors Receives the errors.
+ * \param firstLine Line number of the first character, used in the errors.
+ * \return True, if no errors occured; otherwise false.
+ **/
 {
     m_currentstate = 0;
-    m_tokens->Clear();
-    m_currenttoken.Clear();
-    int line = 0;
-    int column = 0;
+    m_text = statements;
+    m_textLength = length;
+    m_tokenStart = 0;
+    m_tokenLength = 0;
+    m_tokenSplit = false;
+    m_countTokens = 0;
+
+    // The tokens grow by doubling in AddToken(), the capacity is kept for the
+    // next statements, instead of reserving one token per character.
+    m_tokens[0] = MathToken();
 
-    for (size_t i=0; i<statements.Length(); ++i)
+    int line = firstLine;
+    int column = 0;
+    for (size_t i=0; i<m_textLength; ++i)
     {
-        int inputCode = this->GetInputCode(statements[i]);
-        if (inputCode == '\n') {
+        Char input = m_text[i];
+        int inputCode = ((size_t)input < 256 ? inputCodes[(size_t)input] : -1);
+        if (input == '\n') {
             column = 0;
             line += 1;
         }
         if (inputCode < 0) {
             errors->Add(String::Format(_T("Unexpected character '%c' in line '%i' at column '%i'."),
-                                       statements[i], line, column));
+                                       input, line, column));
             return (false);
         }
-        this->DoAction(actionMatrix[inputCode][m_currentstate], statements[i]);
+        this->DoAction(actionMatrix[inputCode][m_currentstate], i);
         m_currentstate = stateMatrix[inputCode][m_currentstate];
-        if (m_currentstate < 0)
+        if (m_currentstate < 0 || m_tokenSplit)
         {
             errors->Add(String::Format(_T("Unexpected character '%c' in line '%i' at column '%i'."),
-                                       statements[i], line, column));
+                                       input, line, column));
             return (false);
         }
         column += 1;
     }
-    this->DoAction(actionMatrix[2][m_currentstate], '_');
-    this->DoAction(actionMatrix[8][m_currentstate], ';');
+    this->DoAction(actionMatrix[2][m_currentstate], m_textLength);
+    this->DoAction(actionMatrix[8][m_currentstate], m_textLength);
     return (true);
 }
 
 
 //-----------------------------------------------------------------------------
-MathTokenArray* MathTokenizer::GetTokens() const
-{
-    return (m_tokens);
-}
-
-
-
-//-----------------------------------------------------------------------------
-int MathTokenizer::GetInputCode(Char input) const
+void MathTokenizer::AddToken(MathTokenType type)
+/**
+ * \brief Adds the current token with the given type and starts a new token.
+ * Empty constants, which are created at the end of the statements, are ignored.
+ * \param type Token type.
+ **/
 {
-    if ((input >= 'a' && input <= 'z') || (input >= 'A' && input <= 'Z') || input == '_') {
-        return (0);
-    }
-    else if (input >= '0' && input <= '9') {
-        return (1);
-    }
-    else if (input == ' ' || input == '\t' || input == '\r' || input == '\n') {
-        return (2);
-    }
-    else if (input == '.') {
-        return (3);
-    }
-    else if (input == '(') {
-        return (4);
-    }
-    else if (input == ')') {
-        return (5);
-    }
-    else if (input == '+' || input == '-' || input == '*' || input == '/') {
-        return (6);
-    }
-    else if (input == '=') {
-        return (7);
-    }
-    else if (input == ';') {
-        return (8);
+    if (type == MathTokenType::Constant && m_tokenLength == 0)
+    {
+        return;
     }
-    else if (input == ',') {
-        return (9);
+
+    // Keep room for the terminating None token
+    if (unlikely(m_countTokens + 2 > m_capacityTokens))
+    {
+        MathToken* tokens = new MathToken[2*m_capacityTokens];
+        for (size_t i=0; i<m_countTokens; ++i)
+        {
+            tokens[i] = m_tokens[i];
+        }
+        delete [] m_tokens;
+        m_tokens = tokens;
+        m_capacityTokens *= 2;
     }
-    return (-1);
+    m_tokens[m_countTokens++] = MathToken(type, m_text + m_tokenStart, m_tokenLength);
+    m_tokens[m_countTokens] = MathToken();
+    m_tokenLength = 0;
 }
 
 
 //-----------------------------------------------------------------------------
-void MathTokenizer::DoAction(int action, Char input)
+void MathTokenizer::DoAction(int action, size_t position)
+/**
+ * \brief Executes an action of the state machine.
+ * \param action Action.
+ * \param position Position of the input character, the characters after the
+ * end of the statements (end of the last statement) are not added to a token.
+ **/
 {
     if (action == 0)
     {
@@ -192,125 +248,124 @@ void MathTokenizer::DoAction(int action, Char input)
     }
     else if (action == 1)
     {
-        m_currenttoken.Append(input);
+        if (m_tokenLength == 0) {
+            m_tokenStart = position;
+        } else if (m_tokenStart + m_tokenLength != position) {
+            // Characters of one token must not be separated by white spaces
+            m_tokenSplit = (position < m_textLength);
+            return;
+        }
+        if (position < m_textLength) m_tokenLength++;
     }
     else if (action == 2)
     {
-        m_tokens->Add(new MathToken(MathTokenType::Function, m_currenttoken));
-        m_currenttoken.Clear();
+        this->AddToken(MathTokenType::Function);
     }
     else if (action == 3)
     {
-        m_tokens->Add(new MathToken(MathTokenType::Variable, m_currenttoken));
-        m_currenttoken.Clear();
+        this->AddToken(MathTokenType::Variable);
     }
     else if (action == 4)
     {
-        m_tokens->Add(new MathToken(MathTokenType::Constant, m_currenttoken));
-        m_currenttoken.Clear();
+        this->AddToken(MathTokenType::Constant);
     }
     else if (action == 5)
     {
-        m_tokens->Add(new MathToken(MathTokenType::Operator, m_currenttoken));
-        m_currenttoken.Clear();
+        this->AddToken(MathTokenType::Operator);
     }
     else if (action == 6)
     {
-        m_tokens->Add(new MathToken(MathTokenType::Assignment, m_currenttoken));
-        m_currenttoken.Clear();
+        this->AddToken(MathTokenType::Assignment);
     }
     else if (action == 7)
     {
-        m_tokens->Add(new MathToken(MathTokenType::Bracket, m_currenttoken));
-        m_currenttoken.Clear();
+        this->AddToken(MathTokenType::Bracket);
     }
     else if (action == 8)
     {
-        m_tokens->Add(new MathToken(MathTokenType::EndStatement, m_currenttoken));
-        m_currenttoken.Clear();
+        this->AddToken(MathTokenType::EndStatement);
     }
     else if (action == 9)
     {
-        m_tokens->Add(new MathToken(MathTokenType::Comma, m_currenttoken));
-        m_currenttoken.Clear();
+        this->AddToken(MathTokenType::Comma);
     }
     else if (action == 10)
     {
-        this->DoAction(5, '\0');
-        this->DoAction(1, input);
+        this->DoAction(5, position);
+        this->DoAction(1, position);
     }
     else if (action == 11)
     {
-        this->DoAction(1, input);
-        this->DoAction(7, '\0');
+        this->DoAction(1, position);
+        this->DoAction(7, position);
     }
     else if (action == 12)
     {
-        this->DoAction(2, '\0');
-        this->DoAction(1, input);
-        this->DoAction(7, '\0');
+        this->DoAction(2, position);
+        this->DoAction(1, position);
+        this->DoAction(7, position);
     }
     else if (action == 13)
     {
-        this->DoAction(5, '\0');
-        this->DoAction(1, input);
-        this->DoAction(7, '\0');
+        this->DoAction(5, position);
+        this->DoAction(1, position);
+        this->DoAction(7, position);
     }
     else if (action == 14)
     {
-        this->DoAction(3, '\0');
-        this->DoAction(1, input);
-        this->DoAction(7, '\0');
+        this->DoAction(3, position);
+        this->DoAction(1, position);
+        this->DoAction(7, position);
     }
     else if (action == 15)
     {
-        this->DoAction(4, '\0');
-        this->DoAction(1, input);
-        this->DoAction(7, '\0');
+        this->DoAction(4, position);
+        this->DoAction(1, position);
+        this->DoAction(7, position);
     }
     else if (action == 16)
     {
-        this->DoAction(3, '\0');
-        this->DoAction(1, input);
+        this->DoAction(3, position);
+        this->DoAction(1, position);
     }
     else if (action == 17)
     {
-        this->DoAction(1, input);
-        this->DoAction(8, '\0');
+        this->DoAction(1, position);
+        this->DoAction(8, position);
     }
     else if (action == 18)
     {
-        this->DoAction(3, '\0');
-        this->DoAction(1, input);
-        this->DoAction(8, '\0');
+        this->DoAction(3, position);
+        this->DoAction(1, position);
+        this->DoAction(8, position);
     }
     else if (action == 19)
     {
-        this->DoAction(4, '\0');
-        this->DoAction(1, input);
+        this->DoAction(4, position);
+        this->DoAction(1, position);
     }
     else if (action == 20)
     {
-        this->DoAction(4, '\0');
-        this->DoAction(1, input);
-        this->DoAction(8, '\0');
+        this->DoAction(4, position);
+        this->DoAction(1, position);
+        this->DoAction(8, position);
     }
     else if (action == 21)
     {
-        this->DoAction(1, input);
-        this->DoAction(9, '\0');
+        this->DoAction(1, position);
+        this->DoAction(9, position);
     }
     else if (action == 22)
     {
-        this->DoAction(3, '\0');
-        this->DoAction(1, input);
-        this->DoAction(9, '\0');
+        this->DoAction(3, position);
+        this->DoAction(1, position);
+        this->DoAction(9, position);
     }
     else if (action == 23)
     {
-        this->DoAction(4, '\0');
-        this->DoAction(1, input);
-        this->DoAction(9, '\0');
+        this->DoAction(4, position);
+        this->DoAction(1, position);
+        this->DoAction(9, position);
     }
     else
     {
@@ -0,0 +1,674 @@
+/*
+ * mathvector.h - Declaration and implementation of the vectorized transcendental functions
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHVECTOR_H_
+#define _RUSH_MATHVECTOR_H_
+
+
+#include <stddef.h>
+#include <math.h>
+
+
+// The vector functions need the vector extensions of GCC (and compatible compilers),
+// which map to AVX/AVX2 or SSE2 instructions depending on the target.
+#ifdef __GNUC__
+    #define _RUSH_MATHVECTOR_SUPPORTED_
+#endif
+
+
+namespace rush {
+
+
+#ifdef _RUSH_MATHVECTOR_SUPPORTED_
+
+#if defined(__AVX__)
+    /// \brief Number of values in a MathVector (one AVX register).
+    const size_t MathVectorSize = 4;
+#else
+    /// \brief Number of values in a MathVector (one SSE2 register).
+    const size_t MathVectorSize = 2;
+#endif
+
+/**
+ * \brief Double values, which fill one vector register.
+ **/
+typedef double MathVector __attribute__((vector_size(MathVectorSize*8)));
+
+/**
+ * \brief 64 bit integers for masks and for the bits of a MathVector.
+ * Comparisons of MathVector values return -1 (true) or 0 (false) per lane.
+ **/
+typedef long long MathVectorInt __attribute__((vector_size(MathVectorSize*8)));
+
+/**
+ * \brief Unsigned 64 bit integers, which wrap around instead of overflowing.
+ * Lanes out of range of the fast functions are calculated with this type, until
+ * their results are replaced by the fallback.
+ **/
+typedef unsigned long long MathVectorUInt __attribute__((vector_size(MathVectorSize*8)));
+
+// 1.5 * 2^52: adding and subtracting rounds to an integer, the low bits of the sum are the integer
+const double MathVectorShift = 6755399441055744.0;
+
+// ln(2) split into a part with trailing zeros (exact products) and the rest
+const double MathVectorLn2Hi = 6.93147180369123816490e-01;
+const double MathVectorLn2Lo = 1.90821492927058770002e-10;
+const double MathVectorInvLn2 = 1.44269504088896338700e+00;
+
+// pi/2 split into two 33 bit parts and the rest, 2/pi
+const double MathVectorPio2Hi = 1.57079632673412561417e+00;
+const double MathVectorPio2Mid = 6.07710050630396597660e-11;
+const double MathVectorPio2Lo = 2.02226624879595063154e-21;
+const double MathVectorPio2Tail = 6.07710050650619224932e-11;
+const double MathVectorTwoOverPi = 6.36619772367581382433e-01;
+
+
+//-----------------------------------------------------------------------------
+/**
+ * \brief Returns a vector with the same value in all lanes.
+ * \param value Value.
+ * \return Vector.
+ **/
+inline MathVector MathVectorSet(double value)
+{
+    MathVector result;
+    for (size_t i=0; i<MathVectorSize; ++i)
+    {
+        result[i] = value;
+    }
+    return (result);
+}
+
+
+/**
+ * \brief Returns a vector with the same integer in all lanes.
+ * \param value Value.
+ * \return Vector.
+ **/
+inline MathVectorInt MathVectorSetInt(long long value)
+{
+    MathVectorInt result;
+    for (size_t i=0; i<MathVectorSize; ++i)
+    {
+        result[i] = value;
+    }
+    return (result);
+}
+
+
+/**
+ * \brief Selects the lanes of a where the mask is set, otherwise of b.
+ * \param mask Mask (-1 or 0 per lane).
+ * \param a Values for set lanes.
+ * \param b Values for other lanes.
+ * \return Vector.
+ **/
+inline MathVector MathVectorSelect(MathVectorInt mask, MathVector a, MathVector b)
+{
+    return ((MathVector)((mask & (MathVectorInt)a) | (~mask & (MathVectorInt)b)));
+}
+
+
+/**
+ * \brief Returns the absolute values.
+ * \param x Values.
+ * \return Absolute values.
+ **/
+inline MathVector MathVectorAbs(MathVector x)
+{
+    return ((MathVector)((MathVectorInt)x & MathVectorSetInt(0x7FFFFFFFFFFFFFFFLL)));
+}
+
+
+/**
+ * \brief Checks if any lane of the mask is set.
+ * \param mask Mask.
+ * \return True, if at least one lane is set; otherwise false.
+ **/
+inline bool MathVectorAny(MathVectorInt mask)
+{
+    long long any = 0;
+    for (size_t i=0; i<MathVectorSize; ++i)
+    {
+        any |= mask[i];
+    }
+    return (any != 0);
+}
+
+
+/**
+ * \brief Rounds to the nearest integer, the integer is returned as double
+ * and as 64 bit integer. Only valid for values below 2^51.
+ * \param x Values.
+ * \param integer Receives the integer values.
+ * \return Rounded values.
+ **/
+inline MathVector MathVectorRound(MathVector x, MathVectorInt* integer)
+{
+    MathVector shifted = x + MathVectorSet(MathVectorShift);
+    *integer = (MathVectorInt)((MathVectorUInt)shifted - (MathVectorUInt)MathVectorSet(MathVectorShift));
+    return (shifted - MathVectorSet(MathVectorShift));
+}
+
+
+/**
+ * \brief Converts small integers (below 2^51) into doubles.
+ * \param n Integers.
+ * \return Doubles.
+ **/
+inline MathVector MathVectorFromInt(MathVectorInt n)
+{
+    return ((MathVector)((MathVectorUInt)n + (MathVectorUInt)MathVectorSet(MathVectorShift)) - MathVectorSet(MathVectorShift));
+}
+
+
+/**
+ * \brief Multiplies the values by 2^n. The result and 2^n must be normal numbers.
+ * \param x Values.
+ * \param n Exponents.
+ * \return x * 2^n.
+ **/
+inline MathVector MathVectorScale(MathVector x, MathVectorInt n)
+{
+    return (x * (MathVector)(((MathVectorUInt)n + (MathVectorUInt)MathVectorSetInt(1023)) << 52));
+}
+
+
+/**
+ * \brief Adds two values and returns the exact rounding error (two sum).
+ * \param a First value.
+ * \param b Second value.
+ * \param error Receives the rounding error, a + b == sum + error.
+ * \return Rounded sum.
+ **/
+inline MathVector MathVectorTwoSum(MathVector a, MathVector b, MathVector* error)
+{
+    MathVector sum = a + b;
+    MathVector bb = sum - a;
+    *error = (a - (sum - bb)) + (b - bb);
+    return (sum);
+}
+
+
+/**
+ * \brief Multiplies two values and returns the exact rounding error (Dekker's
+ * product without FMA). The values must be below 2^995.
+ * \param a First value.
+ * \param b Second value.
+ * \param error Receives the rounding error, a * b == product + error.
+ * \return Rounded product.
+ **/
+inline MathVector MathVectorTwoProduct(MathVector a, MathVector b, MathVector* error)
+{
+    const MathVector split = MathVectorSet(134217729.0); // 2^27 + 1
+    MathVector product = a * b;
+    MathVector ta = split * a;
+    MathVector aHi = ta - (ta - a);
+    MathVector aLo = a - aHi;
+    MathVector tb = split * b;
+    MathVector bHi = tb - (tb - b);
+    MathVector bLo = b - bHi;
+    *error = ((aHi*bHi - product) + aHi*bLo + aLo*bHi) + aLo*bLo;
+    return (product);
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * \brief e^r for |r| <= ln(2)/2 (Taylor polynomial of degree 13).
+ **/
+inline MathVector MathVectorExpKernel(MathVector r)
+{
+    MathVector p = MathVectorSet(1.6059043836821614599e-10);       // 1/13!
+    p = p*r + MathVectorSet(2.0876756987868098979e-09);            // 1/12!
+    p = p*r + MathVectorSet(2.5052108385441718775e-08);            // 1/11!
+    p = p*r + MathVectorSet(2.7557319223985890653e-07);            // 1/10!
+    p = p*r + MathVectorSet(2.7557319223985892511e-06);            // 1/9!
+    p = p*r + MathVectorSet(2.4801587301587301566e-05);            // 1/8!
+    p = p*r + MathVectorSet(1.9841269841269841253e-04);            // 1/7!
+    p = p*r + MathVectorSet(1.3888888888888889419e-03);            // 1/6!
+    p = p*r + MathVectorSet(8.3333333333333332177e-03);            // 1/5!
+    p = p*r + MathVectorSet(4.1666666666666664354e-02);            // 1/4!
+    p = p*r + MathVectorSet(1.6666666666666665741e-01);            // 1/3!
+    p = p*r + MathVectorSet(0.5);
+    p = p*r + MathVectorSet(1.0);
+    return (p*r + MathVectorSet(1.0));
+}
+
+
+/**
+ * \brief Calculates e^x, max. error 1 ULP.
+ * \param x Values.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (|x| >= 708, NaN).
+ * \return e^x.
+ **/
+inline MathVector MathVectorExp(MathVector x, MathVectorInt* fallback)
+{
+    *fallback = ~(MathVectorAbs(x) < MathVectorSet(708.0));
+    MathVectorInt n;
+    MathVector k = MathVectorRound(x * MathVectorSet(MathVectorInvLn2), &n);
+    MathVector r = (x - k*MathVectorSet(MathVectorLn2Hi)) - k*MathVectorSet(MathVectorLn2Lo);
+    return (MathVectorScale(MathVectorExpKernel(r), n));
+}
+
+
+/**
+ * \brief Calculates e^x with a polynomial of degree 8, max. error 2e6 ULP
+ * (2e-10 relative).
+ * \param x Values.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (|x| >= 708, NaN).
+ * \return e^x.
+ **/
+inline MathVector MathVectorExpFast(MathVector x, MathVectorInt* fallback)
+{
+    *fallback = ~(MathVectorAbs(x) < MathVectorSet(708.0));
+    MathVectorInt n;
+    MathVector k = MathVectorRound(x * MathVectorSet(MathVectorInvLn2), &n);
+    MathVector r = x - k*MathVectorSet(6.93147180559945286227e-01);
+    MathVector p = MathVectorSet(2.4801587301587301566e-05);
+    p = p*r + MathVectorSet(1.9841269841269841253e-04);
+    p = p*r + MathVectorSet(1.3888888888888889419e-03);
+    p = p*r + MathVectorSet(8.3333333333333332177e-03);
+    p = p*r + MathVectorSet(4.1666666666666664354e-02);
+    p = p*r + MathVectorSet(1.6666666666666665741e-01);
+    p = p*r + MathVectorSet(0.5);
+    p = p*r + MathVectorSet(1.0);
+    return (MathVectorScale(p*r + MathVectorSet(1.0), n));
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * \brief Splits positive normal values into x = m * 2^e with m in [sqrt(2)/2, sqrt(2)).
+ * \param x Values.
+ * \param e Receives the exponents as doubles.
+ * \return Mantissas.
+ **/
+inline MathVector MathVectorFrexp(MathVector x, MathVector* e)
+{
+    MathVectorInt bits = (MathVectorInt)x;
+    MathVectorInt exponent = (bits >> 52) - MathVectorSetInt(1023);
+    MathVector m = (MathVector)((bits & MathVectorSetInt(0x000FFFFFFFFFFFFFLL)) | (MathVectorInt)MathVectorSet(1.0));
+    MathVectorInt big = (m > MathVectorSet(1.41421356237309504880));
+    m = MathVectorSelect(big, m * MathVectorSet(0.5), m);
+    *e = MathVectorFromInt(exponent - big);
+    return (m);
+}
+
+
+/**
+ * \brief Calculates the natural logarithmus, max. error 1 ULP.
+ * \param x Values.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (x <= 0, subnormal, infinite, NaN).
+ * \return ln(x).
+ **/
+inline MathVector MathVectorLn(MathVector x, MathVectorInt* fallback)
+{
+    *fallback = ~((x >= MathVectorSet(2.2250738585072014e-308)) & (x <= MathVectorSet(1.7976931348623157e308)));
+    MathVector e;
+    MathVector f = MathVectorFrexp(x, &e) - MathVectorSet(1.0);
+    MathVector s = f / (MathVectorSet(2.0) + f);
+    MathVector z = s*s;
+    MathVector r = MathVectorSet(1.479819860511658591e-01);
+    r = r*z + MathVectorSet(1.531383769920937332e-01);
+    r = r*z + MathVectorSet(1.818357216161805012e-01);
+    r = r*z + MathVectorSet(2.222219843214978396e-01);
+    r = r*z + MathVectorSet(2.857142874366239149e-01);
+    r = r*z + MathVectorSet(3.999999999940941908e-01);
+    r = r*z + MathVectorSet(6.666666666666735130e-01);
+    r = r*z;
+    MathVector hfsq = MathVectorSet(0.5)*f*f;
+    return (e*MathVectorSet(MathVectorLn2Hi) -
+            ((hfsq - (s*(hfsq + r) + e*MathVectorSet(MathVectorLn2Lo))) - f));
+}
+
+
+/**
+ * \brief Calculates the natural logarithmus with a shorter series, max. error
+ * 1.3e7 ULP (1.5e-9 relative).
+ * \param x Values.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (x <= 0, subnormal, infinite, NaN).
+ * \return ln(x).
+ **/
+inline MathVector MathVectorLnFast(MathVector x, MathVectorInt* fallback)
+{
+    *fallback = ~((x >= MathVectorSet(2.2250738585072014e-308)) & (x <= MathVectorSet(1.7976931348623157e308)));
+    MathVector e;
+    MathVector m = MathVectorFrexp(x, &e);
+    MathVector s = (m - MathVectorSet(1.0)) / (m + MathVectorSet(1.0));
+    MathVector z = s*s;
+    MathVector r = MathVectorSet(2.0/9.0);
+    r = r*z + MathVectorSet(2.0/7.0);
+    r = r*z + MathVectorSet(2.0/5.0);
+    r = r*z + MathVectorSet(2.0/3.0);
+    r = r*z + MathVectorSet(2.0);
+    return (e*MathVectorSet(6.93147180559945286227e-01) + s*r);
+}
+
+
+/**
+ * \brief Calculates the natural logarithmus as unevaluated sum of two doubles
+ * (about 100 bits), used by MathVectorPow(). The series of atanh is evaluated
+ * with the first terms in double-double arithmetic.
+ * \param x Positive normal values.
+ * \param low Receives the low part of the result.
+ * \return High part of ln(x).
+ **/
+inline MathVector MathVectorLnExtended(MathVector x, MathVector* low)
+{
+    MathVector e;
+    MathVector m = MathVectorFrexp(x, &e);
+
+    // s = (m-1)/(m+1) as double-double, m-1 is exact
+    MathVector numerator = m - MathVectorSet(1.0);
+    MathVector denominatorLo;
+    MathVector denominator = MathVectorTwoSum(m, MathVectorSet(1.0), &denominatorLo);
+    MathVector s = numerator / denominator;
+    MathVector productLo;
+    MathVector product = MathVectorTwoProduct(s, denominator, &productLo);
+    MathVector sLo = (((numerator - product) - productLo) - s*denominatorLo) / denominator;
+
+    // ln(m) = 2s + 2/3 s^3 + s^5 * (2/5 + 2/7 s^2 + ...)
+    MathVector z = s*s;
+    MathVector r = MathVectorSet(2.0/23.0);
+    r = r*z + MathVectorSet(2.0/21.0);
+    r = r*z + MathVectorSet(2.0/19.0);
+    r = r*z + MathVectorSet(2.0/17.0);
+    r = r*z + MathVectorSet(2.0/15.0);
+    r = r*z + MathVectorSet(2.0/13.0);
+    r = r*z + MathVectorSet(2.0/11.0);
+    r = r*z + MathVectorSet(2.0/9.0);
+    r = r*z + MathVectorSet(2.0/7.0);
+    r = r*z + MathVectorSet(2.0/5.0);
+    MathVector zLo;
+    MathVector zHi = MathVectorTwoProduct(s, s, &zLo);
+    zLo = zLo + MathVectorSet(2.0)*s*sLo;
+    MathVector cubeLo;
+    MathVector cube = MathVectorTwoProduct(s, zHi, &cubeLo);
+    cubeLo = cubeLo + s*zLo + sLo*zHi;
+    MathVector thirdLo;
+    MathVector third = MathVectorTwoProduct(cube, MathVectorSet(6.66666666666666629659e-01), &thirdLo);
+    thirdLo = thirdLo + cube*MathVectorSet(3.70074341541718826e-17) + cubeLo*MathVectorSet(6.66666666666666629659e-01);
+
+    // e*ln(2) + 2s + 2/3 s^3 + rest, summed from the largest part
+    MathVector errorLo;
+    MathVector hi = MathVectorTwoSum(e*MathVectorSet(MathVectorLn2Hi), MathVectorSet(2.0)*s, &errorLo);
+    MathVector lo = errorLo + e*MathVectorSet(MathVectorLn2Lo) + MathVectorSet(2.0)*sLo;
+    MathVector sum = MathVectorTwoSum(hi, third, &errorLo);
+    lo = lo + errorLo + thirdLo + cube*z*r;
+    hi = sum + lo;
+    *low = lo - (hi - sum);
+    return (hi);
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * \brief Calculates a^b for positive a, max. error 1 ULP. The logarithmus and
+ * the product b*ln(a) are calculated in double-double arithmetic, so the
+ * error does not grow with the size of b*ln(a).
+ * \param a Bases.
+ * \param b Exponents.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (a <= 0, subnormal a, infinite or NaN values, results near the
+ * double range or |b| >= 2^900).
+ * \return a^b.
+ **/
+inline MathVector MathVectorPow(MathVector a, MathVector b, MathVectorInt* fallback)
+{
+    MathVectorInt valid = (a >= MathVectorSet(2.2250738585072014e-308)) & (a <= MathVectorSet(1.7976931348623157e308)) &
+                          (MathVectorAbs(b) < MathVectorSet(8.452712498170644e270));
+    MathVector lnLo;
+    MathVector lnHi = MathVectorLnExtended(a, &lnLo);
+    MathVector tLo;
+    MathVector t = MathVectorTwoProduct(b, lnHi, &tLo);
+    tLo = tLo + b*lnLo;
+    *fallback = ~(valid & (MathVectorAbs(t) < MathVectorSet(708.0)));
+
+    // e^(t + tLo) = 2^n * e^r
+    MathVectorInt n;
+    MathVector k = MathVectorRound(t * MathVectorSet(MathVectorInvLn2), &n);
+    MathVector r = ((t - k*MathVectorSet(MathVectorLn2Hi)) - k*MathVectorSet(MathVectorLn2Lo)) + tLo;
+    return (MathVectorScale(MathVectorExpKernel(r), n));
+}
+
+
+/**
+ * \brief Calculates a^b = e^(b*ln(a)) for positive a with the fast functions.
+ * The relative error is about (1 + |b*ln(a)|) * 1.5e-9.
+ * \param a Bases.
+ * \param b Exponents.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (a <= 0, subnormal a, infinite or NaN values, results near the
+ * double range).
+ * \return a^b.
+ **/
+inline MathVector MathVectorPowFast(MathVector a, MathVector b, MathVectorInt* fallback)
+{
+    MathVectorInt lnFallback;
+    MathVectorInt expFallback;
+    MathVector result = MathVectorExpFast(b * MathVectorLnFast(a, &lnFallback), &expFallback);
+    *fallback = lnFallback | expFallback;
+    return (result);
+}
+
+
+//-----------------------------------------------------------------------------
+/**
+ * \brief Reduces x to r = x - k*pi/2 with |r| <= pi/4 (Cody-Waite with three
+ * parts of pi/2, exact for |x| < 2^19).
+ * \param x Values.
+ * \param k Receives the multiples of pi/2.
+ * \return Reduced values.
+ **/
+inline MathVector MathVectorReduce(MathVector x, MathVectorInt* k)
+{
+    MathVector kd = MathVectorRound(x * MathVectorSet(MathVectorTwoOverPi), k);
+    return (((x - kd*MathVectorSet(MathVectorPio2Hi)) - kd*MathVectorSet(MathVectorPio2Mid)) -
+            kd*MathVectorSet(MathVectorPio2Lo));
+}
+
+
+/**
+ * \brief sin(r) for |r| <= pi/4 (minimax polynomial of fdlibm).
+ **/
+inline MathVector MathVectorSinKernel(MathVector r)
+{
+    MathVector z = r*r;
+    MathVector p = MathVectorSet(1.58969099521155010221e-10);
+    p = p*z + MathVectorSet(-2.50507602534068634195e-08);
+    p = p*z + MathVectorSet(2.75573137070700676789e-06);
+    p = p*z + MathVectorSet(-1.98412698298579493134e-04);
+    p = p*z + MathVectorSet(8.33333333332248946124e-03);
+    p = p*z + MathVectorSet(-1.66666666666666324348e-01);
+    return (r + r*z*p);
+}
+
+
+/**
+ * \brief cos(r) for |r| <= pi/4 (minimax polynomial of fdlibm).
+ **/
+inline MathVector MathVectorCosKernel(MathVector r)
+{
+    MathVector z = r*r;
+    MathVector p = MathVectorSet(-1.13596475577881948265e-11);
+    p = p*z + MathVectorSet(2.08757232129817482790e-09);
+    p = p*z + MathVectorSet(-2.75573143513906633035e-07);
+    p = p*z + MathVectorSet(2.48015872894767294178e-05);
+    p = p*z + MathVectorSet(-1.38888888888741095749e-03);
+    p = p*z + MathVectorSet(4.16666666666666019037e-02);
+    MathVector hz = MathVectorSet(0.5)*z;
+    MathVector w = MathVectorSet(1.0) - hz;
+    return (w + (((MathVectorSet(1.0) - w) - hz) + z*z*p));
+}
+
+
+/**
+ * \brief sin(r) for |r| <= pi/4 (Taylor polynomial of degree 11).
+ **/
+inline MathVector MathVectorSinKernelFast(MathVector r)
+{
+    MathVector z = r*r;
+    MathVector p = MathVectorSet(-2.5052108385441718775e-08);
+    p = p*z + MathVectorSet(2.7557319223985890653e-06);
+    p = p*z + MathVectorSet(-1.9841269841269841253e-04);
+    p = p*z + MathVectorSet(8.3333333333333332177e-03);
+    p = p*z + MathVectorSet(-1.6666666666666665741e-01);
+    return (r + r*z*p);
+}
+
+
+/**
+ * \brief cos(r) for |r| <= pi/4 (Taylor polynomial of degree 10).
+ **/
+inline MathVector MathVectorCosKernelFast(MathVector r)
+{
+    MathVector z = r*r;
+    MathVector p = MathVectorSet(-2.7557319223985890653e-07);
+    p = p*z + MathVectorSet(2.4801587301587301566e-05);
+    p = p*z + MathVectorSet(-1.3888888888888889419e-03);
+    p = p*z + MathVectorSet(4.1666666666666664354e-02);
+    p = p*z + MathVectorSet(-0.5);
+    return (MathVectorSet(1.0) + z*p);
+}
+
+
+/**
+ * \brief Selects sin or cos of the reduced value and the sign by the quadrant.
+ * \param s sin(r).
+ * \param c cos(r).
+ * \param k Quadrant, sin(x) for k, cos(x) for k+1.
+ * \return Result.
+ **/
+inline MathVector MathVectorQuadrant(MathVector s, MathVector c, MathVectorInt k)
+{
+    MathVectorInt odd = ((k & MathVectorSetInt(1)) != MathVectorSetInt(0));
+    MathVector result = MathVectorSelect(odd, c, s);
+    return ((MathVector)((MathVectorInt)result ^ ((k & MathVectorSetInt(2)) << 62)));
+}
+
+
+/**
+ * \brief Calculates the sinus, max. error 1 ULP (2 ULP for |x| > 1e5).
+ * \param x Values.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (|x| >= 2^19, infinite, NaN).
+ * \return sin(x).
+ **/
+inline MathVector MathVectorSin(MathVector x, MathVectorInt* fallback)
+{
+    *fallback = ~(MathVectorAbs(x) < MathVectorSet(524288.0));
+    MathVectorInt k;
+    MathVector r = MathVectorReduce(x, &k);
+    return (MathVectorQuadrant(MathVectorSinKernel(r), MathVectorCosKernel(r), k));
+}
+
+
+/**
+ * \brief Calculates the cosinus, max. error 1 ULP (2 ULP for |x| > 1e5).
+ * \param x Values.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (|x| >= 2^19, infinite, NaN).
+ * \return cos(x).
+ **/
+inline MathVector MathVectorCos(MathVector x, MathVectorInt* fallback)
+{
+    *fallback = ~(MathVectorAbs(x) < MathVectorSet(524288.0));
+    MathVectorInt k;
+    MathVector r = MathVectorReduce(x, &k);
+    return (MathVectorQuadrant(MathVectorSinKernel(r), MathVectorCosKernel(r), k + MathVectorSetInt(1)));
+}
+
+
+/**
+ * \brief Calculates the tangens as quotient of sinus and cosinus, max. error 3 ULP.
+ * \param x Values.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (|x| >= 2^19, infinite, NaN).
+ * \return tan(x).
+ **/
+inline MathVector MathVectorTan(MathVector x, MathVectorInt* fallback)
+{
+    *fallback = ~(MathVectorAbs(x) < MathVectorSet(524288.0));
+    MathVectorInt k;
+    MathVector r = MathVectorReduce(x, &k);
+    MathVector s = MathVectorSinKernel(r);
+    MathVector c = MathVectorCosKernel(r);
+    MathVectorInt odd = ((k & MathVectorSetInt(1)) != MathVectorSetInt(0));
+    return (MathVectorSelect(odd, -c / s, s / c));
+}
+
+
+/**
+ * \brief Calculates the sinus with shorter polynomials, max. error 1.1e6 ULP
+ * (1.2e-10 relative).
+ * \param x Values.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (|x| >= 2^19, infinite, NaN).
+ * \return sin(x).
+ **/
+inline MathVector MathVectorSinFast(MathVector x, MathVectorInt* fallback)
+{
+    *fallback = ~(MathVectorAbs(x) < MathVectorSet(524288.0));
+    MathVectorInt k;
+    MathVector kd = MathVectorRound(x * MathVectorSet(MathVectorTwoOverPi), &k);
+    MathVector r = (x - kd*MathVectorSet(MathVectorPio2Hi)) - kd*MathVectorSet(MathVectorPio2Tail);
+    return (MathVectorQuadrant(MathVectorSinKernelFast(r), MathVectorCosKernelFast(r), k));
+}
+
+
+/**
+ * \brief Calculates the cosinus with shorter polynomials, max. error 1.1e6 ULP
+ * (1.2e-10 relative).
+ * \param x Values.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (|x| >= 2^19, infinite, NaN).
+ * \return cos(x).
+ **/
+inline MathVector MathVectorCosFast(MathVector x, MathVectorInt* fallback)
+{
+    *fallback = ~(MathVectorAbs(x) < MathVectorSet(524288.0));
+    MathVectorInt k;
+    MathVector kd = MathVectorRound(x * MathVectorSet(MathVectorTwoOverPi), &k);
+    MathVector r = (x - kd*MathVectorSet(MathVectorPio2Hi)) - kd*MathVectorSet(MathVectorPio2Tail);
+    return (MathVectorQuadrant(MathVectorSinKernelFast(r), MathVectorCosKernelFast(r), k + MathVectorSetInt(1)));
+}
+
+
+/**
+ * \brief Calculates the tangens with shorter polynomials, max. error 1.4e6 ULP
+ * (1.6e-10 relative).
+ * \param x Values.
+ * \param fallback Receives the lanes, which must be calculated by the math
+ * library (|x| >= 2^19, infinite, NaN).
+ * \return tan(x).
+ **/
+inline MathVector MathVectorTanFast(MathVector x, MathVectorInt* fallback)
+{
+    *fallback = ~(MathVectorAbs(x) < MathVectorSet(524288.0));
+    MathVectorInt k;
+    MathVector kd = MathVectorRound(x * MathVectorSet(MathVectorTwoOverPi), &k);
+    MathVector r = (x - kd*MathVectorSet(MathVectorPio2Hi)) - kd*MathVectorSet(MathVectorPio2Tail);
+    MathVector s = MathVectorSinKernelFast(r);
+    MathVector c = MathVectorCosKernelFast(r);
+    MathVectorInt odd = ((k & MathVectorSetInt(1)) != MathVectorSetInt(0));
+    return (MathVectorSelect(odd, -c / s, s / c));
+}
+
+#endif // _RUSH_MATHVECTOR_SUPPORTED_
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHVECTOR_H_
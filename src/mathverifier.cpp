@@ -0,0 +1,140 @@
+/*
+ * mathverifier.cpp - Implementation of the MathVerifier class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#include "mathverifier.h"
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+MathVerifier::MathVerifier(MathFunction* const* functions, size_t countFunctions,
+                           size_t countVariables, size_t countTemporaries, StringArray* errors)
+/**
+ * \brief Constructor, initializes the MathVerifier object.
+ * \param functions Functions, which can be called by the code.
+ * \param countFunctions Number of functions.
+ * \param countVariables Number of variables.
+ * \param countTemporaries Number of temporary values.
+ * \param errors Receives the errors (can be NULL).
+ **/
+{
+    m_functions = functions;
+    m_countFunctions = countFunctions;
+    m_countVariables = countVariables;
+    m_countTemporaries = countTemporaries;
+    m_errors = errors;
+    m_stackDepth = 0;
+    m_maxArgs = 0;
+}
+
+
+//-----------------------------------------------------------------------------
+bool MathVerifier::Verify(const MathInstruction* code, size_t count)
+/**
+ * \brief Verifies the code and calculates the stack depth. The verification
+ * stops at the first error.
+ * \param code Instructions.
+ * \param count Number of instructions.
+ * \return True, if the code is valid; otherwise false.
+ **/
+{
+    size_t depth = 0;
+    m_stackDepth = 0;
+    m_maxArgs = 0;
+    bool* stored = new bool[m_countTemporaries > 0 ? m_countTemporaries : 1];
+    for (size_t i=0; i<m_countTemporaries; ++i)
+    {
+        stored[i] = false;
+    }
+    bool valid = true;
+    for (size_t i=0; i<count && valid; ++i)
+    {
+        const MathInstruction& instruction = code[i];
+        size_t pops = 0;
+        size_t pushes = 0;
+        if (instruction.Type == MathOpcodeType::LoadConstant) {
+            pushes = 1;
+        } else if (instruction.Type == MathOpcodeType::LoadVariable) {
+            if (instruction.Index >= m_countVariables) {
+                this->AddError(String::Format(_T("Cannot load variable at index '%i', because it does not exist."), instruction.Index));
+                valid = false;
+            }
+            pushes = 1;
+        } else if (instruction.Type == MathOpcodeType::SaveVariable) {
+            if (instruction.Index >= m_countVariables) {
+                this->AddError(String::Format(_T("Cannot save variable at index '%i', because it does not exist."), instruction.Index));
+                valid = false;
+            }
+            pops = 1;
+        } else if (instruction.Type == MathOpcodeType::CallFunction || MathOpcode::IsIntrinsic(instruction.Type)) {
+            if (instruction.Index >= m_countFunctions) {
+                this->AddError(String::Format(_T("Cannot find function at index '%i', because it does not exist."), instruction.Index));
+                valid = false;
+            } else {
+                pops = m_functions[instruction.Index]->GetArgs();
+            }
+            pushes = 1;
+            if (pops > m_maxArgs) m_maxArgs = pops;
+        } else if (instruction.Type == MathOpcodeType::Add || instruction.Type == MathOpcodeType::Sub ||
+                   instruction.Type == MathOpcodeType::Mul || instruction.Type == MathOpcodeType::Div ||
+                   MathOpcode::IsComparison(instruction.Type)) {
+            pops = 2;
+            pushes = 1;
+        } else if (instruction.Type == MathOpcodeType::Neg) {
+            pops = 1;
+            pushes = 1;
+        } else if (instruction.Type == MathOpcodeType::Double) {
+            pops = 1;
+            pushes = 2;
+        } else if (instruction.Type == MathOpcodeType::LoadTemporary) {
+            if (instruction.Index >= m_countTemporaries || !stored[instruction.Index]) {
+                this->AddError(String::Format(_T("Cannot load temporary value at index '%i', because it is not stored."), instruction.Index));
+                valid = false;
+            }
+            pushes = 1;
+        } else if (instruction.Type == MathOpcodeType::StoreTemporary) {
+            if (instruction.Index >= m_countTemporaries) {
+                this->AddError(String::Format(_T("Cannot store temporary value at index '%i', because it does not exist."), instruction.Index));
+                valid = false;
+            } else {
+                stored[instruction.Index] = true;
+            }
+            pops = 1;
+            pushes = 1;
+        } else if (instruction.Type != MathOpcodeType::Nop) {
+            this->AddError(_T("Unknown opcode."));
+            valid = false;
+        }
+        if (valid && depth < pops) {
+            this->AddError(_T("Not enougth values on the stack."));
+            valid = false;
+        }
+        depth = depth - pops + pushes;
+        if (depth > m_stackDepth) m_stackDepth = depth;
+    }
+    delete [] stored;
+    m_stackDepth += m_countTemporaries;
+    return (valid);
+}
+
+
+//-----------------------------------------------------------------------------
+void MathVerifier::AddError(const String& message)
+/**
+ * \brief Adds an error message, if the errors are collected.
+ * \param message Error message.
+ **/
+{
+    if (m_errors != NULL) m_errors->Add(message);
+}
+
+
+} // namespace rush
@@ -0,0 +1,69 @@
+/*
+ * mathverifier.h - Declaration of the MathVerifier class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+#ifndef _RUSH_MATHVERIFIER_H_
+#define _RUSH_MATHVERIFIER_H_
+
+
+#include <rush/mathevaluation.h>
+
+
+namespace rush {
+
+
+/**
+ * \brief The MathVerifier class proves once, that flat instructions can be
+ * executed without any checks: all opcodes are known, all indices of
+ * variables, functions and temporary values exist, temporary values are
+ * stored before they are loaded and no instruction takes values from an
+ * empty stack. The exact stack depth is calculated on the way, so a stack
+ * of this size can never overflow.
+ **/
+class MathVerifier
+{
+    public:
+        MathVerifier(MathFunction* const* functions, size_t countFunctions,
+                     size_t countVariables, size_t countTemporaries, StringArray* errors);
+
+        bool Verify(const MathInstruction* code, size_t count);
+
+        /**
+         * \brief Returns the stack depth of the last verified code, including
+         * the temporary values.
+         * \return Stack depth.
+         **/
+        inline size_t GetStackDepth() const
+        { return (m_stackDepth); }
+
+        /**
+         * \brief Returns the maximum number of function arguments of the last
+         * verified code.
+         * \return Number of arguments.
+         **/
+        inline size_t GetMaxArgs() const
+        { return (m_maxArgs); }
+
+    private:
+        void AddError(const String& message);
+
+    private:
+        MathFunction* const* m_functions;
+        size_t m_countFunctions;
+        size_t m_countVariables;
+        size_t m_countTemporaries;
+        StringArray* m_errors;
+        size_t m_stackDepth;
+        size_t m_maxArgs;
+};
+
+
+} // namespace rush
+
+#endif // _RUSH_MATHVERIFIER_H_
@@ -0,0 +1,98 @@
+/*
+ * mutex.cpp - Implementation of Mutex class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+
+#include <rush/mutex.h>
+
+
+#if defined _RUSH_WINDOWS_
+    #include <windows.h>
+#elif defined _RUSH_LINUX_
+    #include <pthread.h>
+#else
+    #warning Not implemented.
+#endif
+
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+Mutex::Mutex()
+/**
+ * \brief Constructor, initializes the Mutex object.
+ **/
+{
+    #if defined _RUSH_WINDOWS_
+    CRITICAL_SECTION* section = new CRITICAL_SECTION;
+    InitializeCriticalSection(section);
+    m_handle = section;
+    #elif defined _RUSH_LINUX_
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    pthread_mutexattr_settype(&attributes, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_t* mutex = new pthread_mutex_t;
+    pthread_mutex_init(mutex, &attributes);
+    pthread_mutexattr_destroy(&attributes);
+    m_handle = mutex;
+    #else
+    m_handle = NULL;
+    #endif
+}
+
+
+//-----------------------------------------------------------------------------
+Mutex::~Mutex()
+/**
+ * \brief Destructor, frees the mutex. The mutex must not be locked.
+ **/
+{
+    #if defined _RUSH_WINDOWS_
+    DeleteCriticalSection((CRITICAL_SECTION*)m_handle);
+    delete (CRITICAL_SECTION*)m_handle;
+    #elif defined _RUSH_LINUX_
+    pthread_mutex_destroy((pthread_mutex_t*)m_handle);
+    delete (pthread_mutex_t*)m_handle;
+    #endif
+}
+
+
+//-----------------------------------------------------------------------------
+void Mutex::Lock()
+/**
+ * \brief Locks the mutex, waits until other threads unlocked it.
+ **/
+{
+    #if defined _RUSH_WINDOWS_
+    EnterCriticalSection((CRITICAL_SECTION*)m_handle);
+    #elif defined _RUSH_LINUX_
+    pthread_mutex_lock((pthread_mutex_t*)m_handle);
+    #endif
+}
+
+
+//-----------------------------------------------------------------------------
+void Mutex::Unlock()
+/**
+ * \brief Unlocks the mutex.
+ **/
+{
+    #if defined _RUSH_WINDOWS_
+    LeaveCriticalSection((CRITICAL_SECTION*)m_handle);
+    #elif defined _RUSH_LINUX_
+    pthread_mutex_unlock((pthread_mutex_t*)m_handle);
+    #endif
+}
+
+
+} // namespace rush
+
+
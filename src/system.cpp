@@ -12,8 +12,11 @@
 #include <rush/system.h>
 
 
-#ifdef _RUSH_WINDOWS_
+#if defined _RUSH_WINDOWS_
     #include <windows.h>
+#elif defined _RUSH_LINUX_
+    #include <time.h>
+    #include <unistd.h>
 #else
     #warning Not implemented.
 #endif
@@ -63,8 +66,39 @@ size_t System::GetTicks()
  * \return Ticks.
  **/
 {
-    #ifdef _RUSH_WINDOWS_
+    #if defined _RUSH_WINDOWS_
     return (GetTickCount());
+    #elif defined _RUSH_LINUX_
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((size_t)now.tv_sec*1000 + (size_t)now.tv_nsec/1000000);
+    #endif
+    return (0);
+}
+
+
+//-----------------------------------------------------------------------------
+unsigned long long System::GetCycles()
+/**
+ * \brief Returns a high resolution counter for measuring short durations.
+ * On x86 processors this is the time stamp counter (cycles), otherwise the
+ * performance counter of Windows or the monotonic clock in nanoseconds.
+ * \remarks Only the difference between two values of the same thread is meaningful.
+ * \return Counter value.
+ **/
+{
+    #if defined __GNUC__ && (defined __i386__ || defined __x86_64__)
+    unsigned int low, high;
+    __asm__ __volatile__ ("rdtsc" : "=a" (low), "=d" (high));
+    return (((unsigned long long)high << 32) | low);
+    #elif defined _RUSH_WINDOWS_
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return ((unsigned long long)counter.QuadPart);
+    #elif defined _RUSH_LINUX_
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return ((unsigned long long)now.tv_sec*1000000000ULL + (unsigned long long)now.tv_nsec);
     #endif
     return (0);
 }
@@ -78,9 +112,31 @@ void System::Delay(size_t milliSeconds)
  * \param milliSeconds The delay time in milliseconds.
  **/
 {
-    #ifdef _RUSH_WINDOWS_
+    #if defined _RUSH_WINDOWS_
     Sleep(milliSeconds);
+    #elif defined _RUSH_LINUX_
+    usleep(milliSeconds*1000);
+    #endif
+}
+
+
+//-----------------------------------------------------------------------------
+size_t System::GetProcessorCount()
+/**
+ * \brief Returns the number of logical processors, which are online.
+ * \return Number of processors (at least one).
+ **/
+{
+    size_t count = 1;
+    #if defined _RUSH_WINDOWS_
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    count = info.dwNumberOfProcessors;
+    #elif defined _RUSH_LINUX_
+    long online = sysconf(_SC_NPROCESSORS_ONLN);
+    if (online > 0) count = (size_t)online;
     #endif
+    return (count > 0 ? count : 1);
 }
 
 
@@ -0,0 +1,128 @@
+/*
+ * thread.cpp - Implementation of Thread class
+ *
+ * This file is part of the rush utility library.
+ * Licenced unter the terms of Lesser GPL v3.0 (see licence.txt).
+ * Copyright 2012 - Steffen Ott
+ *
+ */
+
+
+
+#include <rush/thread.h>
+
+
+#if defined _RUSH_WINDOWS_
+    #include <windows.h>
+#elif defined _RUSH_LINUX_
+    #include <pthread.h>
+#else
+    #warning Not implemented.
+#endif
+
+
+
+namespace rush {
+
+
+//-----------------------------------------------------------------------------
+Thread::Thread()
+/**
+ * \brief Constructor, initializes the Thread object. The thread is not started.
+ **/
+{
+    m_handle = NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+Thread::~Thread()
+/**
+ * \brief Destructor, waits until the thread is finished.
+ * \remarks Derived classes must call Wait() in their destructor, because
+ * Run() cannot be executed anymore after the derived object was destroyed.
+ **/
+{
+    this->Wait();
+}
+
+
+//-----------------------------------------------------------------------------
+bool Thread::Start()
+/**
+ * \brief Starts the thread, which executes Run(). A running thread is not
+ * started again.
+ * \return True, if the thread was started; otherwise false.
+ **/
+{
+    if (m_handle != NULL)
+    {
+        return (false);
+    }
+    #if defined _RUSH_WINDOWS_
+    m_handle = CreateThread(NULL, 0, &Thread::Entry, this, 0, NULL);
+    #elif defined _RUSH_LINUX_
+    pthread_t* thread = new pthread_t;
+    if (pthread_create(thread, NULL, &Thread::Entry, this) != 0)
+    {
+        delete thread;
+        thread = NULL;
+    }
+    m_handle = thread;
+    #endif
+    return (m_handle != NULL);
+}
+
+
+//-----------------------------------------------------------------------------
+void Thread::Wait()
+/**
+ * \brief Waits until the thread is finished. Returns immediately, if the
+ * thread was not started.
+ **/
+{
+    if (m_handle == NULL)
+    {
+        return;
+    }
+    #if defined _RUSH_WINDOWS_
+    WaitForSingleObject((HANDLE)m_handle, INFINITE);
+    CloseHandle((HANDLE)m_handle);
+    #elif defined _RUSH_LINUX_
+    pthread_join(*(pthread_t*)m_handle, NULL);
+    delete (pthread_t*)m_handle;
+    #endif
+    m_handle = NULL;
+}
+
+
+//-----------------------------------------------------------------------------
+bool Thread::IsRunning() const
+/**
+ * \brief Checks if the thread was started and not yet joined with Wait().
+ * \return True, if the thread is running; otherwise false.
+ **/
+{
+    return (m_handle != NULL);
+}
+
+
+#if defined _RUSH_WINDOWS_
+//-----------------------------------------------------------------------------
+unsigned long __stdcall Thread::Entry(void* thread)
+#else
+//-----------------------------------------------------------------------------
+void* Thread::Entry(void* thread)
+#endif
+/**
+ * \brief Entry point of the new thread, executes Run().
+ * \param thread Thread object.
+ * \return Always zero.
+ **/
+{
+    ((Thread*)thread)->Run();
+    return (0);
+}
+
+
+} // namespace rush
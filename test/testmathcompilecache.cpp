@@ -0,0 +1,99 @@
+/*
+ * testmathcompilecache.cpp - Implementation of UnitTest::TestMathCompileCache method
+ *
+ * This file is part of the rush utility library.
+ * Licensed under the terms of Lesser GPL v3.0 (see license.txt).
+ * Copyright 2011-2012 - Steffen Ott
+ *
+ */
+
+
+
+
+#include "unittest.h"
+#include <rush/mathcompilecache.h>
+
+
+
+//-----------------------------------------------------------------------------
+double TestMathCacheExecute(const rush::MathProgram* program, double x)
+{
+    rush::MathContext context(program);
+    context.SetVariable(_T("x"), x);
+    context.Execute();
+    return (context.GetVariable(_T("result")));
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathCacheNormalize(UnitTest* test, const rush::String& statements, const rush::String& expected)
+{
+    rush::String normalized = rush::MathCompileCache::Normalize(statements);
+    test->Assert(rush::String::Format(_T("Normalize: '%s'"), statements.c_str()), normalized != expected);
+}
+
+
+
+//-----------------------------------------------------------------------------
+void UnitTest::TestMathCompileCache()
+{
+    this->BeginTest(_T("MathCompileCache"));
+
+    // Normalization
+    TestMathCacheNormalize(this, _T(" result = x * 2 "), _T("result=x*2"));
+    TestMathCacheNormalize(this, _T("result = sin (x)\n"), _T("result=sin(x)"));
+    TestMathCacheNormalize(this, _T("result = 1 - -x"), _T("result=1- -x"));
+    TestMathCacheNormalize(this, _T("result = a b"), _T("result=a b"));
+    TestMathCacheNormalize(this, _T("result = x <= y"), _T("result=x<=y"));
+    TestMathCacheNormalize(this, _T("result = x < = y"), _T("result=x< =y"));
+
+    // Hits and misses
+    rush::MathCompileCache cache(2);
+    const rush::MathProgram* first = cache.Acquire(_T("result = x*2"));
+    const rush::MathProgram* second = cache.Acquire(_T("result=x * 2"));
+    rush::MathCompileCacheStatistics statistics = cache.GetStatistics();
+    this->Assert(_T("Same program for equal statements"), first == NULL || first != second);
+    this->Assert(_T("One miss, one hit"), statistics.Misses != 1 || statistics.Hits != 1 || statistics.Count != 1);
+    this->Assert(_T("Cached program result"), TestMathCacheExecute(second, 4.0d) != 8.0d);
+    cache.Release(first);
+    cache.Release(second);
+
+    // Least recently used program is evicted
+    first = cache.Acquire(_T("result = x*2"));
+    const rush::MathProgram* third = cache.Acquire(_T("result = x+1"));
+    cache.Release(third);
+    cache.Release(cache.Acquire(_T("result = x*2")));
+    const rush::MathProgram* fourth = cache.Acquire(_T("result = x-1"));
+    statistics = cache.GetStatistics();
+    this->Assert(_T("Evicts the least recently used"), statistics.Evictions != 1 || statistics.Count != 2);
+    cache.Release(cache.Acquire(_T("result = x*2")));
+    this->Assert(_T("Keeps the recently used"), cache.GetStatistics().Hits != statistics.Hits+1);
+
+    // Acquired programs stay valid after being removed
+    cache.Clear();
+    this->Assert(_T("Clear removes all programs"), cache.Count() != 0);
+    this->Assert(_T("Removed program still usable"), TestMathCacheExecute(first, 1.0d) != 2.0d ||
+                                                     TestMathCacheExecute(fourth, 1.0d) != 0.0d);
+    cache.Release(first);
+    cache.Release(fourth);
+
+    // Errors are not cached
+    rush::StringArray errors;
+    this->Assert(_T("Compile errors"), cache.Acquire(_T("result = unknown(x)"), &errors) != NULL ||
+                                       errors.Count() == 0 || cache.Count() != 0);
+
+    // Separated comparison characters are no comparison
+    const rush::Char* separated[] = { _T("result = x < = y"), _T("result = x ! = y"),
+                                      _T("result = x = = y"), _T("result = x > = y") };
+    for (size_t i=0; i<sizeof(separated)/sizeof(separated[0]); ++i)
+    {
+        errors.Clear();
+        this->Assert(rush::String::Format(_T("Compile errors: '%s'"), separated[i]),
+                     cache.Acquire(separated[i], &errors) != NULL || errors.Count() == 0);
+    }
+    const rush::MathProgram* comparison = cache.Acquire(_T("result = x <= y"));
+    this->Assert(_T("Comparison is cached"), comparison == NULL || cache.Count() != 1);
+    cache.Release(comparison);
+
+    this->EndTest();
+}
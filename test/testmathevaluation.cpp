@@ -12,7 +12,9 @@
 
 #include "unittest.h"
 #include <rush/mathevaluation.h>
+#include <stddef.h>
 #include <stdlib.h>
+#include <string.h>
 #include <math.h>
 
 
@@ -29,8 +31,8 @@ void TestSpeed()
     ticks = rush::System::GetTicks();
     for (size_t i=0; i<num; ++i)
     {
-        double s=10;
-        double t=33;
+        volatile double s=10;
+        volatile double t=33;
         double u=22+s*76/t*sin(12);
         u += 1;
     }
@@ -51,13 +53,1549 @@ void TestSpeed()
     }
     rushTime = (float)(rush::System::GetTicks() - ticks);
 
-    printf("MathEvaluator - speed comparison: C++ = %1.1fms rush = %1.1fms\n",
-           stdTime, rushTime);
+    printf("MathEvaluator - speed comparison: C++ = %1.1fms rush = %1.1fms (%1.1fns per Execute)\n",
+           stdTime, rushTime, rushTime*1000000.0f/num);
 }
 
 
 
 
+//-----------------------------------------------------------------------------
+void TestMathOpcodes(UnitTest* test, const rush::String& code, const rush::String& expected)
+{
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 3.0d);
+    eval.Compile(code);
+    rush::String opcodes = eval.GetOpcodeText();
+    if (opcodes != expected)
+    {
+        rush::Console::WriteLine(_T("OpCodes: %s (Expected: %s)"), opcodes.c_str(), expected.c_str());
+    }
+    test->Assert(rush::String::Format(_T("Opcodes: %s"), code.c_str()), opcodes != expected);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestTokenizerSpeed()
+{
+    size_t ticks = 0;
+    size_t num = 100;
+    rush::String code;
+    for (size_t i=0; i<10000; ++i)
+    {
+        code.AppendFormat(_T("value = (x%u+1.5)*sin(y%u)-z/2.25;\n"), i % 100, i % 50);
+    }
+
+    rush::MathTokenizer tokenizer;
+    rush::StringArray errors;
+    size_t count = 0;
+    ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        tokenizer.Parse(code, &errors);
+        count += tokenizer.Count();
+    }
+    float time = (float)(rush::System::GetTicks() - ticks);
+
+    printf("MathTokenizer - speed: %u chars, %u tokens, %1.1fms per Parse\n",
+           (unsigned int)code.Length(), (unsigned int)(count/num), time/num);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestCompileSpeed()
+{
+    size_t ticks = 0;
+    size_t num = 100000;
+    rush::String code;
+    for (size_t i=0; i<num; ++i)
+    {
+        code.AppendFormat(_T("value = (x%u+1.5)*sin(y%u)-pow(z, 2)/(2.25+x%u);\n"), i % 100, i % 50, i % 10);
+    }
+
+    rush::MathEvaluation eval;
+    ticks = rush::System::GetTicks();
+    bool compiled = eval.Compile(code);
+    float time = (float)(rush::System::GetTicks() - ticks);
+
+    printf("MathEvaluator - compile speed: %u statements in %1.1fms (%s)\n",
+           (unsigned int)num, time, compiled ? "ok" : "errors");
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathTokens(UnitTest* test, const rush::String& code, const rush::String& expected)
+{
+    rush::MathEvaluation eval;
+    rush::String tokens = eval.GetTokenizerText(code);
+    if (tokens != expected)
+    {
+        rush::Console::WriteLine(_T("Tokens: %s (Expected: %s)"), tokens.c_str(), expected.c_str());
+    }
+    test->Assert(rush::String::Format(_T("Tokens: %s"), code.c_str()), tokens != expected);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalError(UnitTest* test, const rush::String& code)
+{
+    rush::MathEvaluation eval;
+    bool compiled = eval.Compile(code);
+    test->Assert(rush::String::Format(_T("Error: %s"), code.c_str()), compiled || !eval.HasErrors());
+}
+
+
+//-----------------------------------------------------------------------------
+void TestBatchSpeed()
+{
+    float rowTime = 0.0f;
+    float batchTime = 0.0f;
+    size_t ticks = 0;
+    size_t num = 4000000;
+    double* xs = new double[num];
+    double* ys = new double[num];
+    double* results = new double[num];
+    for (size_t i=0; i<num; ++i)
+    {
+        xs[i] = (double)i;
+        ys[i] = 1.0d + (double)(i % 100);
+    }
+
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.SetVariable(_T("y"), 0.0d);
+    eval.Compile(_T("result = 22+x*76/y-(x+y)*0.5"));
+
+    //----------------------------------------------
+    ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        eval.SetVariable(_T("x"), xs[i]);
+        eval.SetVariable(_T("y"), ys[i]);
+        eval.Execute();
+        results[i] = eval.GetVariable(_T("result"));
+    }
+    rowTime = (float)(rush::System::GetTicks() - ticks);
+
+    //----------------------------------------------
+    rush::StringArray names;
+    names.Add(_T("x"));
+    names.Add(_T("y"));
+    const double* columns[] = { xs, ys };
+    ticks = rush::System::GetTicks();
+    eval.ExecuteBatch(names, columns, _T("result"), results, num);
+    batchTime = (float)(rush::System::GetTicks() - ticks);
+
+    printf("MathEvaluator - batch comparison: rows = %1.1fms batch = %1.1fms\n",
+           rowTime, batchTime);
+    delete [] xs;
+    delete [] ys;
+    delete [] results;
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalBatch(UnitTest* test, const rush::String& code)
+{
+    const size_t rows = 1000;
+    double xs[rows];
+    double ys[rows];
+    double results[rows];
+    for (size_t i=0; i<rows; ++i)
+    {
+        xs[i] = 0.25d * i - 17.0d;
+        ys[i] = 1.0d + (i % 7);
+    }
+
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.SetVariable(_T("y"), 0.0d);
+    eval.SetVariable(_T("z"), 3.0d);
+    eval.Compile(code);
+
+    rush::StringArray names;
+    names.Add(_T("x"));
+    names.Add(_T("y"));
+    const double* columns[] = { xs, ys };
+    bool failed = !eval.ExecuteBatch(names, columns, _T("result"), results, rows);
+    for (size_t i=0; i<rows && !failed; ++i)
+    {
+        eval.SetVariable(_T("x"), xs[i]);
+        eval.SetVariable(_T("y"), ys[i]);
+        eval.Execute();
+        failed = (eval.GetVariable(_T("result")) != results[i]);
+    }
+    test->Assert(rush::String::Format(_T("Batch: %s"), code.c_str()), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestBatchFloatSpeed()
+{
+    size_t num = 4000000;
+    double* xs = new double[num];
+    double* ys = new double[num];
+    double* results = new double[num];
+    float* xsFloat = new float[num];
+    float* ysFloat = new float[num];
+    float* resultsFloat = new float[num];
+    for (size_t i=0; i<num; ++i)
+    {
+        xs[i] = 0.001d * (double)(i % 10000);
+        ys[i] = 1.0d + (double)(i % 100);
+        xsFloat[i] = (float)xs[i];
+        ysFloat[i] = (float)ys[i];
+    }
+
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.SetVariable(_T("y"), 0.0d);
+    eval.Compile(_T("result = 22+x*76/y-(x+y)*0.5+sqrt(x*x+y*y)"));
+    rush::StringArray names;
+    names.Add(_T("x"));
+    names.Add(_T("y"));
+
+    //----------------------------------------------
+    const double* columns[] = { xs, ys };
+    size_t ticks = rush::System::GetTicks();
+    eval.ExecuteBatch(names, columns, _T("result"), results, num);
+    float doubleTime = (float)(rush::System::GetTicks() - ticks);
+
+    //----------------------------------------------
+    const float* columnsFloat[] = { xsFloat, ysFloat };
+    ticks = rush::System::GetTicks();
+    eval.ExecuteBatch(names, columnsFloat, _T("result"), resultsFloat, num);
+    float floatTime = (float)(rush::System::GetTicks() - ticks);
+
+    printf("MathEvaluator - float comparison: double = %1.1fms float = %1.1fms\n",
+           doubleTime, floatTime);
+    delete [] xs;
+    delete [] ys;
+    delete [] results;
+    delete [] xsFloat;
+    delete [] ysFloat;
+    delete [] resultsFloat;
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalBatchFloat(UnitTest* test, const rush::String& code, rush::MathAccuracy accuracy)
+{
+    const size_t rows = 1000;
+    float xs[rows];
+    float ys[rows];
+    float results[rows];
+    float parallel[rows];
+    for (size_t i=0; i<rows; ++i)
+    {
+        xs[i] = 0.25f * i - 17.0f;
+        ys[i] = 1.0f + (i % 7);
+    }
+
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.SetVariable(_T("y"), 0.0d);
+    eval.SetVariable(_T("z"), 3.0d);
+    eval.SetAccuracy(accuracy);
+    eval.Compile(code);
+
+    // Float rounding of every operation, compared with the double execution
+    rush::StringArray names;
+    names.Add(_T("x"));
+    names.Add(_T("y"));
+    const float* columns[] = { xs, ys };
+    bool failed = !eval.ExecuteBatch(names, columns, _T("result"), results, rows);
+    failed = failed || !eval.ExecuteParallel(names, columns, _T("result"), parallel, rows, 3);
+    failed = failed || memcmp(results, parallel, sizeof(results)) != 0;
+    for (size_t i=0; i<rows && !failed; ++i)
+    {
+        eval.SetVariable(_T("x"), xs[i]);
+        eval.SetVariable(_T("y"), ys[i]);
+        eval.Execute();
+        double expected = eval.GetVariable(_T("result"));
+        failed = (fabs(results[i] - expected) > 1e-5 * (1.0d + fabs(expected)));
+    }
+    test->Assert(rush::String::Format(_T("Batch float: %s"), code.c_str()), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestVectorSpeed()
+{
+    size_t num = 4000000;
+    double* xs = new double[num];
+    double* results = new double[num];
+    for (size_t i=0; i<num; ++i)
+    {
+        xs[i] = 0.001d * (double)(i % 10000) + 0.5d;
+    }
+
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.Compile(_T("result = exp(-x)*sin(x)+ln(x)*cos(x)+pow(x, 1.5)"));
+    rush::StringArray names;
+    names.Add(_T("x"));
+    const double* columns[] = { xs };
+
+    //----------------------------------------------
+    float times[3];
+    const rush::MathAccuracy accuracies[] = { rush::MathAccuracy::Exact, rush::MathAccuracy::Precise, rush::MathAccuracy::Fast };
+    for (size_t i=0; i<3; ++i)
+    {
+        eval.SetAccuracy(accuracies[i]);
+        size_t ticks = rush::System::GetTicks();
+        eval.ExecuteBatch(names, columns, _T("result"), results, num);
+        times[i] = (float)(rush::System::GetTicks() - ticks);
+    }
+
+    printf("MathEvaluator - vector comparison: exact = %1.1fms precise = %1.1fms fast = %1.1fms\n",
+           times[0], times[1], times[2]);
+    delete [] xs;
+    delete [] results;
+}
+
+
+//-----------------------------------------------------------------------------
+void TestParallelSpeed()
+{
+    size_t num = 40000000;
+    double* xs = new double[num];
+    double* results = new double[num];
+    for (size_t i=0; i<num; ++i)
+    {
+        xs[i] = 0.001d * (double)(i % 10000) + 0.5d;
+    }
+
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.Compile(_T("result = exp(-x)*sin(x)+ln(x)*cos(x)+pow(x, 1.5)"));
+    rush::StringArray names;
+    names.Add(_T("x"));
+    const double* columns[] = { xs };
+
+    //----------------------------------------------
+    size_t processors = rush::System::GetProcessorCount();
+    float single = 0.0f;
+    for (size_t threads=1; threads<=processors; threads*=2)
+    {
+        size_t ticks = rush::System::GetTicks();
+        eval.ExecuteParallel(names, columns, _T("result"), results, num, threads);
+        float time = (float)(rush::System::GetTicks() - ticks);
+        if (threads == 1) single = time;
+        printf("MathEvaluator - parallel comparison: threads = %i time = %1.1fms speedup = %1.2f\n",
+               (int)threads, time, single / (time > 0.0f ? time : 1.0f));
+    }
+    delete [] xs;
+    delete [] results;
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalParallel(UnitTest* test, const rush::String& code, size_t rows, size_t threads)
+{
+    double* xs = new double[rows > 0 ? rows : 1];
+    double* ys = new double[rows > 0 ? rows : 1];
+    double* expected = new double[rows > 0 ? rows : 1];
+    double* results = new double[rows > 0 ? rows : 1];
+    for (size_t i=0; i<rows; ++i)
+    {
+        xs[i] = 0.001d * i - 17.0d;
+        ys[i] = 1.0d + (i % 7);
+        results[i] = 0.0d;
+    }
+
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.SetVariable(_T("y"), 0.0d);
+    eval.SetVariable(_T("z"), 3.0d);
+    eval.SetAccuracy(rush::MathAccuracy::Fast);
+    eval.Compile(code);
+
+    // The output must be identical to the single threaded batch
+    rush::StringArray names;
+    names.Add(_T("x"));
+    names.Add(_T("y"));
+    const double* columns[] = { xs, ys };
+    bool failed = !eval.ExecuteBatch(names, columns, _T("result"), expected, rows);
+    failed = failed || !eval.ExecuteParallel(names, columns, _T("result"), results, rows, threads);
+    failed = failed || (rows > 0 && memcmp(expected, results, rows*sizeof(double)) != 0);
+    test->Assert(rush::String::Format(_T("Parallel (%i rows, %i threads): %s"), (int)rows, (int)threads, code.c_str()), failed);
+    delete [] xs;
+    delete [] ys;
+    delete [] expected;
+    delete [] results;
+}
+
+
+//-----------------------------------------------------------------------------
+double MathUlpDistance(double a, double b)
+{
+    if (isnan(a) || isnan(b)) return (isnan(a) && isnan(b) ? 0.0d : HUGE_VAL);
+    long long ia;
+    long long ib;
+    memcpy(&ia, &a, sizeof(double));
+    memcpy(&ib, &b, sizeof(double));
+    // Map the sign-magnitude bits to ordered integers, so the distance is the number of doubles in between
+    if (ia < 0) ia = (long long)0x8000000000000000ULL - ia;
+    if (ib < 0) ib = (long long)0x8000000000000000ULL - ib;
+    return (ia > ib ? (double)(ia - ib) : (double)(ib - ia));
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalAccuracy(UnitTest* test, const rush::String& code, rush::MathAccuracy accuracy,
+                          double range, double maxUlp)
+{
+    // Special values, logarithmic samples over the whole range and linear samples around zero
+    const double specials[] = { 0.0d, -0.0d, 1.0d, -1.0d, 0.5d, 2.0d, 4.9e-324, -4.9e-324, 2.2e-308,
+                                708.5d, -708.5d, 710.0d, -746.0d, 524288.0d, 1e300, HUGE_VAL, -HUGE_VAL, NAN };
+    const size_t countSpecials = sizeof(specials) / sizeof(double);
+    const size_t rows = 20000;
+    double* xs = new double[rows];
+    double* ys = new double[rows];
+    double* results = new double[rows];
+    for (size_t i=0; i<rows; ++i)
+    {
+        double t = (double)i / (double)rows;
+        if (i < countSpecials) xs[i] = specials[i];
+        else if (i % 2 == 0) xs[i] = (i % 4 == 0 ? 1.0d : -1.0d) * exp(log(range) * (2.0d*t - 1.0d));
+        else xs[i] = (2.0d*t - 1.0d) * (range < 50.0d ? range : 50.0d);
+        ys[i] = 0.37d * (double)(i % 11) - 1.85d;
+    }
+
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.SetVariable(_T("y"), 0.0d);
+    eval.Compile(code);
+    eval.SetAccuracy(accuracy);
+
+    rush::StringArray names;
+    names.Add(_T("x"));
+    names.Add(_T("y"));
+    const double* columns[] = { xs, ys };
+    bool failed = !eval.ExecuteBatch(names, columns, _T("result"), results, rows);
+    double ulp = 0.0d;
+    for (size_t i=0; i<rows && !failed; ++i)
+    {
+        eval.SetVariable(_T("x"), xs[i]);
+        eval.SetVariable(_T("y"), ys[i]);
+        eval.Execute();
+        double distance = MathUlpDistance(eval.GetVariable(_T("result")), results[i]);
+        if (distance > ulp) ulp = distance;
+    }
+    failed = failed || ulp > maxUlp;
+    test->Assert(rush::String::Format(_T("Accuracy: %s (%1.0f ULP)"), code.c_str(), ulp), failed);
+    delete [] xs;
+    delete [] ys;
+    delete [] results;
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalProgram(UnitTest* test, const rush::String& code, double x, double expected)
+{
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.SetVariable(_T("y"), 2.0d);
+    eval.Compile(code);
+    rush::MathProgram* program = eval.CreateProgram();
+
+    // The program is not changed by compiling other code
+    eval.Compile(_T("result = y"));
+
+    rush::MathContext first(program);
+    rush::MathContext second(program);
+    first.SetVariable(_T("x"), x);
+    second.SetVariable(_T("x"), -x);
+    first.Execute();
+    second.Execute();
+    second.ResetVariables();
+    second.SetVariable(_T("x"), x);
+    second.Execute();
+    bool failed = (!program->IsVerified() || first.HasErrors() || second.HasErrors() ||
+                   first.GetVariable(_T("result")) != expected ||
+                   second.GetVariable(_T("result")) != expected);
+    delete program;
+    test->Assert(rush::String::Format(_T("Program: %s"), code.c_str()), failed);
+}
+
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalHandles(UnitTest* test, size_t count)
+{
+    rush::MathEvaluation eval;
+    rush::String code = _T("result = 0");
+    for (size_t i=0; i<count; ++i)
+    {
+        code.AppendFormat(_T("+v%u"), i);
+    }
+    eval.Compile(code);
+
+    // Set the variables by handle and get them by name
+    double expected = 0.0d;
+    for (size_t i=0; i<count; ++i)
+    {
+        rush::MathVariableHandle handle = eval.GetVariableHandle(rush::String::Format(_T("v%u"), i));
+        eval.SetVariable(handle, (double)i);
+        expected += (double)i;
+    }
+    eval.Execute();
+    bool failed = (eval.GetVariable(eval.GetVariableHandle(_T("result"))) != expected ||
+                   eval.GetVariable(rush::String::Format(_T("v%u"), count-1)) != (double)(count-1));
+
+    // Same with a context
+    rush::MathProgram* program = eval.CreateProgram();
+    rush::MathContext context(program);
+    rush::MathVariableHandle first = context.GetVariableHandle(_T("v0"));
+    context.SetVariable(first, 1000.0d);
+    context.Execute();
+    failed = failed || (context.GetVariable(_T("result")) != expected + 1000.0d) || context.HasErrors();
+    failed = failed || !first.IsValid() || context.GetVariableHandle(_T("unknown")).IsValid();
+    failed = failed || !context.HasErrors();
+    delete program;
+
+    test->Assert(rush::String::Format(_T("Handles: %u variables"), count), failed);
+}
+
+
+
+//-----------------------------------------------------------------------------
+class TestMathSinOverride : public rush::MathFunction
+{
+    public:
+        TestMathSinOverride() : rush::MathFunction(_T("sin"), 1, false) {}
+
+        virtual double Evaluate(double* values, size_t num)
+        { return (values[0] + 42.0d); }
+};
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalOverride(UnitTest* test)
+{
+    // An overridden default function is called instead of the intrinsic
+    rush::MathEvaluation eval;
+    eval.SetFunction(new TestMathSinOverride());
+    eval.SetVariable(_T("x"), 1.0d);
+    eval.Compile(_T("result = sin(x)+cos(0)"));
+    eval.Execute();
+    test->Assert(_T("Overridden intrinsic"), eval.GetVariable(_T("result")) != 44.0d);
+}
+
+
+//-----------------------------------------------------------------------------
+class TestMathHypotFunction : public rush::MathFunction
+{
+    public:
+        TestMathHypotFunction() : rush::MathFunction(_T("hyp"), 2, true) {}
+
+        virtual double Evaluate(double* values, size_t num)
+        { return (sqrt(values[0]*values[0] + values[1]*values[1])); }
+};
+
+
+//-----------------------------------------------------------------------------
+double TestMathHypot(double a, double b)
+{
+    return (sqrt(a*a + b*b));
+}
+
+
+//-----------------------------------------------------------------------------
+struct TestMathWeight
+{
+    double Factor;
+
+    double operator()(double a, double b, double c, double d) const
+    { return (Factor * (a + 2*b + 3*c + 4*d)); }
+};
+
+
+//-----------------------------------------------------------------------------
+void TestCallableSpeed()
+{
+    const size_t num = 1000000;
+    rush::String code = _T("result = hyp(x, y)+hyp(y, x)+hyp(x+1, y-1)");
+    for (size_t i=0; i<4; ++i)
+    {
+        rush::MathEvaluation eval;
+        if (i % 2 == 0) eval.SetFunction(new TestMathHypotFunction());
+        else eval.SetFunction(_T("hyp"), &TestMathHypot, true);
+        eval.SetJitEnabled(i >= 2);
+        eval.SetVariable(_T("x"), 3.0d);
+        eval.SetVariable(_T("y"), 4.0d);
+        eval.Compile(code);
+        size_t ticks = rush::System::GetTicks();
+        for (size_t r=0; r<num; ++r)
+        {
+            eval.Execute();
+        }
+        float time = (float)(rush::System::GetTicks() - ticks);
+        printf("MathEvaluator - function comparison: %s %s = %1.1fms\n", (i >= 2 ? "jit" : "interpreter"),
+               (i % 2 == 0 ? "virtual" : "native"), time);
+    }
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalCallable(UnitTest* test, rush::MathFusion fusion, bool jit)
+{
+    size_t calls = 0;
+    rush::MathEvaluation eval;
+    eval.SetFusion(fusion);
+    eval.SetJitEnabled(jit);
+    eval.SetFunction(_T("hyp"), &TestMathHypot, true);
+    eval.SetFunction(_T("lerp"), [](double a, double b, double t) { return (a + (b-a)*t); }, true);
+    eval.SetFunction(_T("half"), [](double a) { return (a*0.5d); });
+    eval.SetFunction(_T("answer"), []() { return (42.0d); }, true);
+    eval.SetFunction(_T("count"), [&calls](double a, double b) { calls++; return (a+b); }, true);
+    TestMathWeight weight = { 2.0d };
+    eval.SetFunction(_T("weight"), weight);
+    eval.SetVariable(_T("x"), 3.0d);
+    eval.SetVariable(_T("y"), 4.0d);
+
+    // The pure call with constant arguments is evaluated once while compiling
+    bool failed = !eval.Compile(_T("result = hyp(x, y)+lerp(x, y, 0.5)*half(y)+answer()+count(1, 2)*weight(x, y, 1, 0)"));
+    for (size_t i=0; i<3; ++i)
+    {
+        failed = failed || !eval.Execute();
+    }
+    double expected = 5.0d + 3.5d*2.0d + 42.0d + 3.0d*2.0d*(3.0d+8.0d+3.0d);
+    failed = failed || eval.GetVariable(_T("result")) != expected || calls != 1;
+
+    // Impure calls are executed every time
+    failed = failed || !eval.Compile(_T("result = half(x)+count(x, 1)")) || !eval.Execute() || !eval.Execute();
+    failed = failed || eval.GetVariable(_T("result")) != 5.5d || calls != 3;
+    test->Assert(rush::String::Format(_T("Callable functions: fusion %i, jit %i"), (int)fusion, (int)jit), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalNativeCall(UnitTest* test)
+{
+    // Only function pointers and lambdas without captures are called directly
+    double offset = 1.0d;
+    rush::MathEvaluation eval;
+    eval.SetFunction(_T("hyp"), &TestMathHypot);
+    eval.SetFunction(_T("shift"), [offset](double a) { return (a+offset); });
+    eval.SetProfilingEnabled(true);
+    eval.SetVariable(_T("x"), 3.0d);
+    eval.Compile(_T("result = hyp(x, 4)+shift(x)"));
+    eval.Execute();
+    const rush::MathProfile* profile = eval.GetProfile();
+    bool failed = eval.GetVariable(_T("result")) != 9.0d;
+    failed = failed || profile->GetOpcode(rush::MathOpcodeType::CallNative2).Count != 1;
+    failed = failed || profile->GetOpcode(rush::MathOpcodeType::CallFunction).Count != 1;
+    test->Assert(_T("Native calls"), failed);
+
+    // Other signatures than double are converted by Evaluate()
+    rush::MathEvaluation converted;
+    converted.SetFunction(_T("half"), [](float a) { return (a*0.5f); });
+    converted.SetFunction(_T("twice"), [](int a) { return (a*2); });
+    converted.SetProfilingEnabled(true);
+    converted.SetVariable(_T("x"), 3.0d);
+    converted.Compile(_T("a = half(x); b = twice(x)"));
+    converted.Execute();
+    failed = converted.GetVariable(_T("a")) != 1.5d || converted.GetVariable(_T("b")) != 6.0d;
+    failed = failed || converted.GetProfile()->GetOpcode(rush::MathOpcodeType::CallNative1).Count != 0;
+    test->Assert(_T("Native calls with float and int"), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void* TestMathAlignImage(double* memory)
+{
+    // Images must be aligned to 16 bytes like a mapped file
+    return ((void*)(((size_t)memory + 15) / 16 * 16));
+}
+
+
+//-----------------------------------------------------------------------------
+void TestImageSpeed()
+{
+    float compileTime = 0.0f;
+    float loadTime = 0.0f;
+    size_t num = 10000;
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.SetVariable(_T("y"), 0.0d);
+    eval.Compile(_T("a = x*x+sin(y); b = a-y/2; result = (a+b)*(a-b)/pow(y, 1.5)+sqrt(abs(a))"));
+    rush::MathProgram* program = eval.CreateProgram();
+    size_t size = program->GetImageSize();
+    double* memory = new double[size/8 + 2];
+    void* image = TestMathAlignImage(memory);
+    program->SaveImage(image, size);
+    delete program;
+
+    //----------------------------------------------
+    size_t ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        eval.Compile(_T("a = x*x+sin(y); b = a-y/2; result = (a+b)*(a-b)/pow(y, 1.5)+sqrt(abs(a))"));
+        delete eval.CreateProgram();
+    }
+    compileTime = (float)(rush::System::GetTicks() - ticks);
+
+    //----------------------------------------------
+    ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        delete eval.LoadProgram(image, size);
+    }
+    loadTime = (float)(rush::System::GetTicks() - ticks);
+
+    printf("MathEvaluator - image comparison: compile = %1.1fms load = %1.1fms\n",
+           compileTime, loadTime);
+    delete [] memory;
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalImage(UnitTest* test, const rush::String& code, double x, double expected, bool jit)
+{
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.SetVariable(_T("y"), 2.0d);
+    eval.Compile(code);
+    rush::MathProgram* program = eval.CreateProgram();
+    size_t size = program->GetImageSize();
+    double* memory = new double[size/8 + 2];
+    void* image = TestMathAlignImage(memory);
+    bool failed = !program->SaveImage(image, size) || program->SaveImage(image, size-1);
+    delete program;
+
+    // Load the image into another evaluation, which has other variables
+    rush::MathEvaluation other;
+    other.SetVariable(_T("z"), 5.0d);
+    other.SetJitEnabled(jit);
+    program = other.LoadProgram(image, size);
+    if (program != NULL)
+    {
+        rush::MathContext context(program);
+        context.SetVariable(_T("x"), x);
+        context.Execute();
+        failed = failed || !program->IsVerified() || program->IsJitCompiled() != (jit && other.IsJitSupported()) ||
+                 program->GetInitialValue(program->FindVariableIndex(_T("y"))) != 2.0d ||
+                 context.HasErrors() || context.GetVariable(_T("result")) != expected;
+        delete program;
+    }
+    test->Assert(rush::String::Format(_T("Image: %s"), code.c_str()), failed || program == NULL);
+    delete [] memory;
+}
+
+
+//-----------------------------------------------------------------------------
+size_t TestMathWriteImage(void* image, unsigned int version, const rush::MathInstruction* code, size_t codeCount)
+{
+    // Writes the variables x, y, result and the function sin in the layout of version 1,
+    // independent of the writer in MathProgram, so old images stay loadable
+    const size_t codeOffset = 96;
+    const size_t valuesOffset = codeOffset + (codeCount*sizeof(rush::MathInstruction) + 15) / 16 * 16;
+    const size_t namesOffset = valuesOffset + 32;
+    const size_t imageSize = namesOffset + 64;
+    unsigned char* data = (unsigned char*)image;
+    memset(data, 0, imageSize);
+    unsigned int ints[] = { version, 0x01020304, (unsigned int)sizeof(rush::MathInstruction), (unsigned int)sizeof(size_t) };
+    unsigned long long longs[] = { imageSize, codeCount, 2, 0, 3, 1, codeOffset, valuesOffset, namesOffset };
+    memcpy(data, "RUSHMATH", 8);
+    memcpy(data + 8, ints, sizeof(ints));
+    memcpy(data + 24, longs, sizeof(longs));
+    memcpy(data + codeOffset, code, codeCount*sizeof(rush::MathInstruction));
+    double values[] = { 0.5d, 3.0d, 0.0d };
+    memcpy(data + valuesOffset, values, sizeof(values));
+    unsigned char* names = data + namesOffset;
+    const char* strings[] = { "x", "y", "result", "sin" };
+    for (size_t i=0; i<4; ++i)
+    {
+        unsigned int length = (unsigned int)strlen(strings[i]);
+        unsigned int args = 1;
+        if (i == 3) { memcpy(names, &args, sizeof(args)); names += sizeof(args); }
+        memcpy(names, &length, sizeof(length));
+        memcpy(names + sizeof(length), strings[i], length);
+        names += sizeof(length) + length;
+    }
+    return (imageSize);
+}
+
+
+//-----------------------------------------------------------------------------
+bool TestMathImageRejected(rush::MathEvaluation& eval, const void* image, size_t size)
+{
+    rush::MathProgram* program = eval.LoadProgram(image, size);
+    bool rejected = (program == NULL && eval.HasErrors());
+    delete program;
+    while (eval.HasErrors())
+    {
+        eval.GetErrorMessage();
+    }
+    return (rejected);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalImageVersions(UnitTest* test)
+{
+    // result = sin(x)*y+2 with the opcode numbers of version 1
+    rush::MathInstruction code[7];
+    memset(code, 0, sizeof(code));
+    code[0].Type = (rush::MathOpcodeType)1;  code[0].Index = 0;     // LoadVariable x
+    code[1].Type = (rush::MathOpcodeType)21; code[1].Index = 0;     // Sin
+    code[2].Type = (rush::MathOpcodeType)1;  code[2].Index = 1;     // LoadVariable y
+    code[3].Type = (rush::MathOpcodeType)6;                         // Mul
+    code[4].Type = (rush::MathOpcodeType)0;  code[4].Value = 2.0d;  // LoadConstant 2
+    code[5].Type = (rush::MathOpcodeType)4;                         // Add
+    code[6].Type = (rush::MathOpcodeType)2;  code[6].Index = 2;     // SaveVariable result
+    double* memory = new double[64];
+    void* image = TestMathAlignImage(memory);
+    rush::MathEvaluation eval;
+
+    // Version 1 images are loaded by all versions
+    size_t size = TestMathWriteImage(image, 1, code, 7);
+    rush::MathProgram* program = eval.LoadProgram(image, size);
+    bool failed = (program == NULL || eval.HasErrors());
+    if (program != NULL)
+    {
+        rush::MathContext context(program);
+        context.Execute();
+        failed = failed || context.GetVariable(_T("result")) != sin(0.5d)*3.0d+2.0d;
+        delete program;
+    }
+    test->Assert(_T("Image version 1"), failed);
+
+    // Newer and invalid versions are rejected
+    TestMathWriteImage(image, 2, code, 7);
+    failed = !TestMathImageRejected(eval, image, size);
+    TestMathWriteImage(image, 0, code, 7);
+    failed = failed || !TestMathImageRejected(eval, image, size);
+    test->Assert(_T("Image unknown versions"), failed);
+
+    // Truncated, misaligned and broken images are rejected
+    TestMathWriteImage(image, 1, code, 7);
+    failed = false;
+    for (size_t i=0; i<size && !failed; ++i)
+    {
+        failed = !TestMathImageRejected(eval, image, i);
+    }
+    failed = failed || !TestMathImageRejected(eval, (char*)image + 8, size);
+    code[2].Index = 3;
+    TestMathWriteImage(image, 1, code, 7);
+    failed = failed || !TestMathImageRejected(eval, image, size);
+    code[2].Index = 1;
+    code[3].Type = (rush::MathOpcodeType)1000;
+    TestMathWriteImage(image, 1, code, 7);
+    failed = failed || !TestMathImageRejected(eval, image, size);
+    code[3].Type = (rush::MathOpcodeType)6;
+    TestMathWriteImage(image, 1, code, 5);
+    program = eval.LoadProgram(image, size);
+    failed = failed || program == NULL;
+    delete program;
+    test->Assert(_T("Image broken"), failed);
+
+    // Overridden functions are called instead of their intrinsics
+    TestMathWriteImage(image, 1, code, 7);
+    eval.SetFunction(new TestMathSinOverride());
+    program = eval.LoadProgram(image, size);
+    failed = (program == NULL);
+    if (program != NULL)
+    {
+        rush::MathContext context(program);
+        context.Execute();
+        failed = context.GetVariable(_T("result")) != (0.5d+42.0d)*3.0d+2.0d;
+        delete program;
+    }
+    test->Assert(_T("Image overridden intrinsic"), failed);
+    delete [] memory;
+}
+
+
+//-----------------------------------------------------------------------------
+rush::String TestMathIncrementalName(const rush::Char* prefix, size_t index)
+{
+    // Assigned variables cannot contain digits, the index is written with letters
+    rush::String name = prefix;
+    do
+    {
+        name.Append((rush::Char)(_T('a') + index % 26));
+        index /= 26;
+    } while (index > 0);
+    return (name);
+}
+
+
+//-----------------------------------------------------------------------------
+rush::String TestMathIncrementalScript(size_t count, size_t inputs)
+{
+    // Statement i depends on the input i%inputs and on the statement i-inputs
+    rush::String code = _T("");
+    for (size_t i=0; i<count; ++i)
+    {
+        code.AppendFormat(_T("%s = sin(%s)"), TestMathIncrementalName(_T("s"), i).c_str(),
+                          TestMathIncrementalName(_T("i"), i % inputs).c_str());
+        if (i >= inputs) code.AppendFormat(_T("+%s*0.5"), TestMathIncrementalName(_T("s"), i - inputs).c_str());
+        code.Append(_T("; "));
+    }
+    return (code);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestIncrementalSpeed()
+{
+    float fullTime = 0.0f;
+    float incrementalTime = 0.0f;
+    size_t num = 20000;
+    rush::MathEvaluation full;
+    rush::MathEvaluation incremental;
+    incremental.SetIncrementalEnabled(true);
+    full.Compile(TestMathIncrementalScript(500, 50));
+    incremental.Compile(TestMathIncrementalScript(500, 50));
+    rush::MathVariableHandle fullInput = full.GetVariableHandle(_T("id"));
+    rush::MathVariableHandle incrementalInput = incremental.GetVariableHandle(_T("id"));
+
+    //----------------------------------------------
+    size_t ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        full.SetVariable(fullInput, (double)i);
+        full.Execute();
+    }
+    fullTime = (float)(rush::System::GetTicks() - ticks);
+
+    //----------------------------------------------
+    ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        incremental.SetVariable(incrementalInput, (double)i);
+        incremental.Execute();
+    }
+    incrementalTime = (float)(rush::System::GetTicks() - ticks);
+
+    printf("MathEvaluator - incremental comparison: full = %1.1fms incremental = %1.1fms (%u of 500 statements)\n",
+           fullTime, incrementalTime, (unsigned int)incremental.GetExecutedStatementCount());
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalIncremental(UnitTest* test, const rush::String& code)
+{
+    // Change random variables and compare all variables with the full execution
+    const rush::String names[] = { _T("x"), _T("y"), _T("z"), _T("a"), _T("b"), _T("result") };
+    rush::MathEvaluation full;
+    rush::MathEvaluation incremental;
+    incremental.SetIncrementalEnabled(true);
+    for (size_t i=0; i<6; ++i)
+    {
+        full.SetVariable(names[i], 1.0d + i);
+        incremental.SetVariable(names[i], 1.0d + i);
+    }
+    bool failed = !full.Compile(code) || !incremental.Compile(code);
+    srand(17);
+    for (size_t run=0; run<200 && !failed; ++run)
+    {
+        size_t changes = rand() % 3;
+        for (size_t c=0; c<changes; ++c)
+        {
+            const rush::String& name = names[rand() % 6];
+            double value = (double)(rand() % 5) - 2.0d;
+            full.SetVariable(name, value);
+            incremental.SetVariable(name, value);
+        }
+        failed = !full.Execute() || !incremental.Execute();
+        for (size_t i=0; i<6 && !failed; ++i)
+        {
+            double a = full.GetVariable(names[i]);
+            double b = incremental.GetVariable(names[i]);
+            failed = (memcmp(&a, &b, sizeof(double)) != 0);
+        }
+    }
+    test->Assert(rush::String::Format(_T("Incremental: %s"), code.c_str()), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalIncrementalCount(UnitTest* test)
+{
+    rush::MathEvaluation eval;
+    eval.SetIncrementalEnabled(true);
+    eval.Compile(TestMathIncrementalScript(100, 10));
+    eval.Execute();
+    bool failed = (eval.GetExecutedStatementCount() != 100);
+    eval.Execute();
+    failed = failed || eval.GetExecutedStatementCount() != 0;
+    eval.SetVariable(_T("ia"), 0.0d);
+    eval.Execute();
+    failed = failed || eval.GetExecutedStatementCount() != 0;
+
+    // An input changes only the statements of its chain
+    eval.SetVariable(_T("id"), 1.0d);
+    eval.Execute();
+    failed = failed || eval.GetExecutedStatementCount() != 10;
+
+    // A computed variable changed from outside is restored by its assignment and its reader
+    eval.SetVariable(_T("sd"), 1.0d);
+    eval.Execute();
+    failed = failed || eval.GetExecutedStatementCount() != 2;
+    test->Assert(_T("Incremental statements"), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalProfile(UnitTest* test)
+{
+    rush::MathEvaluation eval;
+    eval.SetProfilingEnabled(true);
+    eval.SetVariable(_T("x"), 3.0d);
+    eval.Compile(_T("a = frac(x)*2; result = a+x*x+sin(x)"));
+    eval.Execute();
+    eval.Execute();
+    eval.Execute();
+    const rush::MathProfile* profile = eval.GetProfile();
+    bool failed = (fabs(eval.GetVariable(_T("result")) - (9.0d + sin(3.0d))) > 1e-12);
+    failed = failed || profile->GetExecutions() != 3;
+    failed = failed || profile->GetOpcode(rush::MathOpcodeType::LoadVariable).Count != 12;
+    failed = failed || profile->GetOpcode(rush::MathOpcodeType::CallFunction).Count != 3;
+    failed = failed || profile->GetOpcode(rush::MathOpcodeType::Sin).Count != 3;
+    failed = failed || profile->GetOpcode(rush::MathOpcodeType::Add).Count != 6;
+    failed = failed || profile->GetOpcode(rush::MathOpcodeType::Div).Count != 0;
+    failed = failed || profile->GetMaxStackDepth() != 3;
+    for (size_t i=0; i<profile->GetFunctionCount(); ++i)
+    {
+        const rush::MathFunctionProfile& function = profile->GetFunction(i);
+        failed = failed || function.Calls != (function.Name == _T("frac") ? 3 : 0);
+    }
+    rush::String text = eval.GetProfileText();
+    failed = failed || text.Find(_T("frac")) < 0 || text.Find(_T("SIN")) < 0 || text.Find(_T("DIV")) >= 0;
+
+    // A new program starts a new profile, disabling removes it
+    eval.Compile(_T("result = x"));
+    failed = failed || profile->GetExecutions() != 0;
+    eval.SetProfilingEnabled(false);
+    eval.Execute();
+    failed = failed || eval.GetProfile() != NULL || eval.GetVariable(_T("result")) != 3.0d;
+    test->Assert(_T("Profile"), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestFusionSpeed()
+{
+    // A polynomial and a weighted sum, both made of loads, multiplications and additions
+    rush::String code = _T("p = ((((x*0.5+1.5)*x-2.5)*x+3.5)*x-4.5)*x+5.5; ");
+    code.Append(_T("result = p+a*x+b*y+c*z+d*x*y+e*y*z+f*x*z+g*x*x+h*y*y+k*z*z"));
+    const size_t num = 1000000;
+    const rush::MathFusion fusions[] = { rush::MathFusion::None, rush::MathFusion::Superinstructions,
+                                         rush::MathFusion::MultiplyAdd };
+    const char* names[] = { "none", "superinstructions", "multiply-add" };
+    for (size_t f=0; f<3; ++f)
+    {
+        rush::MathEvaluation eval;
+        eval.SetVariable(_T("x"), 0.5d);
+        eval.SetVariable(_T("y"), 1.5d);
+        eval.SetVariable(_T("z"), 2.5d);
+        eval.SetFusion(fusions[f]);
+        eval.SetProfilingEnabled(true);
+        eval.Compile(code);
+        eval.Execute();
+        unsigned long long dispatched = 0;
+        for (size_t i=0; i<rush::MathProfileOpcodeCount; ++i)
+        {
+            dispatched += eval.GetProfile()->GetOpcode((rush::MathOpcodeType)i).Count;
+        }
+        eval.SetProfilingEnabled(false);
+
+        size_t ticks = rush::System::GetTicks();
+        for (size_t i=0; i<num; ++i)
+        {
+            eval.Execute();
+        }
+        float time = (float)(rush::System::GetTicks() - ticks);
+        printf("MathEvaluator - fusion comparison: %s = %1.1fms (%i instructions dispatched)\n",
+               names[f], time, (int)dispatched);
+    }
+}
+
+
+/**
+ * \brief Object, whose members are bound to variables.
+ **/
+struct TestParticle
+{
+    double x;
+    double v;
+    double e;
+};
+
+
+//-----------------------------------------------------------------------------
+void TestBindingSpeed()
+{
+    const size_t num = 1000000;
+    TestParticle* particles = new TestParticle[num];
+    for (size_t i=0; i<num; ++i)
+    {
+        particles[i].x = (double)(i % 100) * 0.01d;
+        particles[i].v = 1.0d;
+    }
+    rush::String code = _T("v = v+a*x; e = 0.5*v*v+k*x*x");
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("a"), 0.1d);
+    eval.SetVariable(_T("k"), 2.0d);
+    eval.Compile(code);
+
+    // Copy the members in and out with handles
+    rush::MathVariableHandle x = eval.GetVariableHandle(_T("x"));
+    rush::MathVariableHandle v = eval.GetVariableHandle(_T("v"));
+    rush::MathVariableHandle e = eval.GetVariableHandle(_T("e"));
+    size_t ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        eval.SetVariable(x, particles[i].x);
+        eval.SetVariable(v, particles[i].v);
+        eval.Execute();
+        particles[i].v = eval.GetVariable(v);
+        particles[i].e = eval.GetVariable(e);
+    }
+    float timeCopy = (float)(rush::System::GetTicks() - ticks);
+
+    // Bind the members
+    eval.BindMember(_T("x"), offsetof(TestParticle, x));
+    eval.BindMember(_T("v"), offsetof(TestParticle, v));
+    eval.BindMember(_T("e"), offsetof(TestParticle, e));
+    ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        eval.BindObject(&particles[i]);
+        eval.Execute();
+    }
+    float timeBound = (float)(rush::System::GetTicks() - ticks);
+    printf("MathEvaluator - binding comparison: copied = %1.1fms, bound = %1.1fms\n", timeCopy, timeBound);
+    delete [] particles;
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalBinding(UnitTest* test, bool jit, bool incremental, rush::MathFusion fusion)
+{
+    TestParticle particles[3] = { { 1.0d, 0.5d, 0.0d }, { -2.0d, 1.5d, 0.0d }, { 0.25d, -1.0d, 0.0d } };
+    double a = 2.0d;
+    double k = 3.0d;
+    double count = 0.0d;
+    rush::MathEvaluation eval;
+    eval.SetJitEnabled(jit);
+    eval.SetIncrementalEnabled(incremental);
+    eval.SetFusion(fusion);
+    eval.BindVariable(_T("a"), &a);
+    eval.BindMember(_T("x"), offsetof(TestParticle, x));
+    eval.Compile(_T("v = v+a*x; e = 0.5*v*v+k*x; n = n+1"));
+    eval.BindVariable(_T("k"), &k);
+    eval.BindVariable(_T("n"), &count);
+    eval.BindMember(_T("v"), offsetof(TestParticle, v));
+    eval.BindMember(_T("e"), offsetof(TestParticle, e));
+
+    // Every object is executed in place, with the bound values of the caller
+    bool failed = false;
+    for (size_t round=0; round<2; ++round)
+    {
+        for (size_t i=0; i<3; ++i)
+        {
+            TestParticle expected = particles[i];
+            expected.v = expected.v + a*expected.x;
+            expected.e = 0.5d*expected.v*expected.v + k*expected.x;
+            eval.BindObject(&particles[i]);
+            failed = failed || !eval.Execute() || particles[i].v != expected.v || particles[i].e != expected.e;
+            failed = failed || eval.GetVariable(_T("e")) != expected.e;
+        }
+        a = 4.0d;
+        eval.SetVariable(_T("k"), 5.0d);
+    }
+    failed = failed || k != 5.0d || count != 6.0d || eval.GetVariable(_T("n")) != 6.0d;
+
+    // Unbound variables keep the last value, while no object is set the members are not bound
+    eval.UnbindVariable(_T("a"));
+    a = 7.0d;
+    eval.BindObject(NULL);
+    eval.SetVariable(_T("x"), 1.0d);
+    eval.SetVariable(_T("v"), 0.0d);
+    failed = failed || !eval.Execute() || eval.GetVariable(_T("v")) != 4.0d || eval.GetVariable(_T("a")) != 4.0d;
+    failed = failed || particles[0].x != 1.0d || eval.GetBoundObject() != NULL;
+    test->Assert(rush::String::Format(_T("Binding: jit %i, incremental %i, fusion %i"), (int)jit,
+                                      (int)incremental, (int)fusion), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalFusion(UnitTest* test, const rush::String& code)
+{
+    const rush::MathFusion fusions[] = { rush::MathFusion::None, rush::MathFusion::Superinstructions,
+                                         rush::MathFusion::MultiplyAdd };
+    double results[3];
+    for (size_t f=0; f<3; ++f)
+    {
+        rush::MathEvaluation eval;
+        eval.SetVariable(_T("x"), 1.25d);
+        eval.SetVariable(_T("y"), -0.75d);
+        eval.SetVariable(_T("z"), 3.0d);
+        eval.SetVariable(_T("a"), 0.1d);
+        eval.SetFusion(fusions[f]);
+        eval.Compile(code);
+        eval.Execute();
+        results[f] = eval.GetVariable(_T("result"));
+    }
+
+    // Superinstructions keep the results, the multiply-add rounds once
+    bool failed = (memcmp(&results[0], &results[1], sizeof(double)) != 0);
+    failed = failed || fabs(results[2] - results[0]) > 1e-12 * (1.0d + fabs(results[0]));
+    test->Assert(rush::String::Format(_T("Fusion: %s"), code.c_str()), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalFusionCount(UnitTest* test)
+{
+    // LDV a, LDV x, LDV y, MUL, ADD, LDV z, LDC 2, DIV, SUB, SAV
+    const rush::MathFusion fusions[] = { rush::MathFusion::None, rush::MathFusion::Superinstructions,
+                                         rush::MathFusion::MultiplyAdd };
+    const unsigned long long expected[] = { 10, 8, 7 };
+    bool failed = false;
+    for (size_t f=0; f<3; ++f)
+    {
+        rush::MathEvaluation eval;
+        eval.SetVariable(_T("x"), 1.0d + ldexp(1.0d, -27));
+        eval.SetVariable(_T("y"), 1.0d - ldexp(1.0d, -27));
+        eval.SetVariable(_T("z"), 0.0d);
+        eval.SetVariable(_T("a"), -1.0d);
+        eval.SetFusion(fusions[f]);
+        eval.SetProfilingEnabled(true);
+        eval.Compile(_T("result = a+x*y-z/2"));
+        eval.Execute();
+        unsigned long long dispatched = 0;
+        for (size_t i=0; i<rush::MathProfileOpcodeCount; ++i)
+        {
+            dispatched += eval.GetProfile()->GetOpcode((rush::MathOpcodeType)i).Count;
+        }
+        failed = failed || dispatched != expected[f];
+
+        // x*y rounds to 1 in two steps, but not in the fused multiply-add
+        double result = eval.GetVariable(_T("result"));
+        failed = failed || result != (f < 2 ? 0.0d : -ldexp(1.0d, -54));
+    }
+    test->Assert(_T("Fusion instructions"), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestStreamSpeed()
+{
+    rush::String code = TestMathIncrementalScript(20000, 50);
+    rush::MathEvaluation whole;
+    rush::MathEvaluation stream;
+
+    size_t ticks = rush::System::GetTicks();
+    whole.Compile(code);
+    float wholeTime = (float)(rush::System::GetTicks() - ticks);
+
+    ticks = rush::System::GetTicks();
+    stream.CompileStream(code.c_str(), code.Length());
+    float streamTime = (float)(rush::System::GetTicks() - ticks);
+    printf("MathEvaluator - streaming compile comparison: whole = %1.1fms, stream = %1.1fms\n", wholeTime, streamTime);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalStream(UnitTest* test, const rush::String& code)
+{
+    // The statements compiled one by one give the same results
+    const rush::String names[] = { _T("x"), _T("y"), _T("a"), _T("b"), _T("result") };
+    rush::MathEvaluation whole;
+    rush::MathEvaluation stream;
+    for (size_t i=0; i<5; ++i)
+    {
+        whole.SetVariable(names[i], 1.5d + i);
+        stream.SetVariable(names[i], 1.5d + i);
+    }
+    bool compiled = whole.Compile(code);
+    bool failed = (stream.CompileStream(code.c_str(), code.Length()) != compiled);
+    if (compiled && !failed)
+    {
+        failed = !whole.Execute() || !stream.Execute();
+        for (size_t i=0; i<5 && !failed; ++i)
+        {
+            failed = (whole.GetVariable(names[i]) != stream.GetVariable(names[i]));
+        }
+    }
+    test->Assert(rush::String::Format(_T("Stream: %s"), code.c_str()), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalStreamFile(UnitTest* test)
+{
+    // Write more statements than one read of the file, so statements are split
+    const char* fileName = "testmathstream.tmp";
+    const size_t count = 6000;
+    FILE* file = fopen(fileName, "wb");
+    bool failed = (file == NULL);
+    for (size_t i=0; i<count && !failed; ++i)
+    {
+        if (i == 0) fprintf(file, "s = 0;\n");
+        fprintf(file, "t = x*%u+%u; s = s+t*t;\n", (unsigned int)i, (unsigned int)(i % 7));
+    }
+    if (file != NULL) fclose(file);
+
+    double expected = 0.0d;
+    for (size_t i=0; i<count; ++i)
+    {
+        double t = 0.5d*(double)i+(double)(i % 7);
+        expected = expected+t*t;
+    }
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.5d);
+    failed = failed || !eval.CompileFile(_T("testmathstream.tmp")) || !eval.Execute();
+    failed = failed || eval.GetVariable(_T("s")) != expected;
+    remove(fileName);
+
+    // A missing file is an error
+    failed = failed || eval.CompileFile(_T("testmathstream.tmp")) || !eval.HasErrors();
+    test->Assert(_T("Stream file"), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestArraySpeed()
+{
+    const size_t count = 4096;
+    const size_t num = 20000;
+    double* a = new double[count];
+    double* b = new double[count];
+    for (size_t i=0; i<count; ++i)
+    {
+        a[i] = sin((double)i);
+        b[i] = cos((double)i);
+    }
+
+    //----------------------------------------------
+    double result = 0.0d;
+    size_t ticks = rush::System::GetTicks();
+    for (size_t n=0; n<num; ++n)
+    {
+        a[n % count] += 0.5d;
+        double sum = 0.0d;
+        double min = a[0];
+        double max = a[0];
+        double dot = 0.0d;
+        for (size_t i=0; i<count; ++i)
+        {
+            sum += a[i];
+            min = (a[i] < min ? a[i] : min);
+            max = (a[i] > max ? a[i] : max);
+            dot += a[i]*b[i];
+        }
+        result += (max-min)*sum/(double)count+dot;
+    }
+    float loopTime = (float)(rush::System::GetTicks() - ticks);
+
+    //----------------------------------------------
+    rush::MathEvaluation eval;
+    eval.BindArray(_T("a"), a, count);
+    eval.BindArray(_T("b"), b, count);
+    eval.Compile(_T("result = (max(a)-min(a))*mean(a)+dot(a, b)"));
+    ticks = rush::System::GetTicks();
+    for (size_t n=0; n<num; ++n)
+    {
+        a[n % count] += 0.5d;
+        eval.Execute();
+    }
+    float arrayTime = (float)(rush::System::GetTicks() - ticks);
+    printf("MathEvaluator - array comparison: loop = %1.1fms, reductions = %1.1fms (%g)\n", loopTime, arrayTime, result);
+    delete [] a;
+    delete [] b;
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalArray(UnitTest* test, const rush::String& code, size_t count, bool jit, bool incremental)
+{
+    // Integer values are added up exactly in any order
+    double* a = new double[count];
+    double* b = new double[count];
+    double sum = 0.0d;
+    double dot = 0.0d;
+    double min = 100.0d;
+    double max = -100.0d;
+    for (size_t i=0; i<count; ++i)
+    {
+        a[i] = (double)((i*7) % 17) - 8.0d;
+        b[i] = (double)(i % 5);
+        sum += a[i];
+        dot += a[i]*b[i];
+        min = (a[i] < min ? a[i] : min);
+        max = (a[i] > max ? a[i] : max);
+    }
+    rush::MathEvaluation eval;
+    eval.SetJitEnabled(jit);
+    eval.SetIncrementalEnabled(incremental);
+    eval.SetVariable(_T("x"), 2.0d);
+    eval.SetArray(_T("a"), a, count);
+    eval.BindArray(_T("b"), b, count);
+    bool failed = !eval.Compile(code) || !eval.Execute();
+    failed = failed || eval.GetVariable(_T("s")) != sum*2.0d+sum/(double)count;
+    failed = failed || eval.GetVariable(_T("result")) != (max-min)*dot;
+
+    // Changed values are reduced again without compiling, the copy of a stays unchanged
+    b[count/2] += 1.0d;
+    a[count/2] += 1.0d;
+    failed = failed || !eval.Execute();
+    failed = failed || eval.GetVariable(_T("result")) != (max-min)*(dot+a[count/2]-1.0d);
+    eval.SetArray(_T("a"), a, count);
+    failed = failed || !eval.Execute();
+    failed = failed || eval.GetVariable(_T("s")) != (sum+1.0d)*2.0d+(sum+1.0d)/(double)count;
+
+    // Batches use the reductions as constant values
+    rush::StringArray names;
+    names.Add(_T("x"));
+    double xs[2] = { 1.0d, -3.0d };
+    double results[2];
+    const double* columns[] = { xs };
+    failed = failed || !eval.ExecuteBatch(names, columns, _T("s"), results, 2);
+    failed = failed || results[1] != (sum+1.0d)*-3.0d+(sum+1.0d)/(double)count;
+    test->Assert(rush::String::Format(_T("Array (%u values, jit %i, incremental %i): %s"),
+                                      (unsigned int)count, jit, incremental, code.c_str()), failed);
+    delete [] a;
+    delete [] b;
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalArrayProgram(UnitTest* test)
+{
+    // Programs keep the reductions of the arrays at their creation
+    double a[3] = { 1.0d, 2.0d, 3.0d };
+    rush::MathEvaluation eval;
+    eval.SetArray(_T("a"), a, 3);
+    eval.Compile(_T("r = sum(a)"));
+    rush::MathProgram* program = eval.CreateProgram();
+    a[0] = 5.0d;
+    eval.SetArray(_T("a"), a, 3);
+    rush::MathContext context(program);
+    bool failed = !context.Execute() || context.GetVariable(_T("r")) != 6.0d;
+    failed = failed || !eval.Execute() || eval.GetVariable(_T("r")) != 10.0d;
+    delete program;
+
+    // dot() of different lengths is NaN, the following reductions are calculated
+    eval.SetArray(_T("b"), a, 2);
+    eval.Compile(_T("d = dot(a, b); r = sum(a)"));
+    program = eval.CreateProgram();
+    rush::MathContext mismatch(program);
+    failed = failed || !mismatch.Execute() || mismatch.GetVariable(_T("r")) != 10.0d;
+    failed = failed || mismatch.GetVariable(_T("d")) == mismatch.GetVariable(_T("d"));
+    delete program;
+    test->Assert(_T("Array program"), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalArrayNan(UnitTest* test)
+{
+    // NaN is propagated in every position, by the vector lanes and the tail
+    double a[21];
+    rush::MathEvaluation eval;
+    eval.SetArray(_T("a"), a, 21);
+    bool failed = !eval.Compile(_T("r = min(a); s = max(a)"));
+    size_t counts[] = { 1, 3, 21 };
+    for (size_t c=0; c<3; ++c)
+    {
+        for (size_t n=0; n<counts[c]; ++n)
+        {
+            for (size_t i=0; i<counts[c]; ++i)
+            {
+                a[i] = (i == n ? NAN : (double)i);
+            }
+            eval.SetArray(_T("a"), a, counts[c]);
+            failed = failed || !eval.Execute();
+            failed = failed || eval.GetVariable(_T("r")) == eval.GetVariable(_T("r"));
+            failed = failed || eval.GetVariable(_T("s")) == eval.GetVariable(_T("s"));
+        }
+    }
+    test->Assert(_T("Array NaN"), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathEvalArrayErrors(UnitTest* test)
+{
+    double a[3] = { 1.0d, 2.0d, 3.0d };
+    rush::MathEvaluation eval;
+    eval.SetArray(_T("a"), a, 3);
+    eval.SetArray(_T("b"), a, 2);
+    eval.SetArray(_T("e"), NULL, 0);
+
+    // Different lengths fail while executing
+    bool failed = !eval.Compile(_T("result = dot(a, b)")) || eval.Execute() || !eval.HasErrors();
+    while (eval.HasErrors()) eval.GetErrorMessage();
+
+    // Empty arrays
+    failed = failed || !eval.Compile(_T("s = sum(e); result = max(e)")) || !eval.Execute();
+    failed = failed || eval.GetVariable(_T("s")) != 0.0d || eval.GetVariable(_T("result")) == eval.GetVariable(_T("result"));
+
+    // Scalar arguments are no reduction, functions with the same name are called
+    failed = failed || eval.Compile(_T("result = sum(x)")) || !eval.HasErrors();
+    while (eval.HasErrors()) eval.GetErrorMessage();
+    eval.SetFunction(_T("max"), [](double x, double y) { return (x > y ? x : y); }, true);
+    eval.SetVariable(_T("x"), 5.0d);
+    failed = failed || !eval.Compile(_T("result = max(x, 4)+max(a)")) || !eval.Execute();
+    failed = failed || eval.GetVariable(_T("result")) != 8.0d;
+    test->Assert(_T("Array errors"), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestPiecewiseSpeed()
+{
+    size_t num = 2000000;
+    double* xs = new double[num];
+    double* results = new double[num];
+    srand(5);
+    for (size_t i=0; i<num; ++i)
+    {
+        xs[i] = (double)(rand() % 2001) - 1000.0d;
+    }
+
+    //----------------------------------------------
+    // One formula per piece, the piece is chosen with a branch per row
+    rush::MathEvaluation negative;
+    rush::MathEvaluation positive;
+    negative.SetVariable(_T("x"), 0.0d);
+    positive.SetVariable(_T("x"), 0.0d);
+    negative.Compile(_T("result = -x*0.5"));
+    positive.Compile(_T("result = sqrt(x)+x"));
+    size_t ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        rush::MathEvaluation& piece = (xs[i] < 0.0d ? negative : positive);
+        piece.SetVariable(_T("x"), xs[i]);
+        piece.Execute();
+        results[i] = piece.GetVariable(_T("result"));
+    }
+    float branchTime = (float)(rush::System::GetTicks() - ticks);
+
+    //----------------------------------------------
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.Compile(_T("result = select(x < 0, -x*0.5, sqrt(abs(x))+x)"));
+    rush::StringArray names;
+    names.Add(_T("x"));
+    const double* columns[] = { xs };
+    ticks = rush::System::GetTicks();
+    eval.ExecuteBatch(names, columns, _T("result"), results, num);
+    float selectTime = (float)(rush::System::GetTicks() - ticks);
+
+    printf("MathEvaluator - piecewise comparison: branches = %1.1fms, select = %1.1fms\n", branchTime, selectTime);
+    delete [] xs;
+    delete [] results;
+}
+
+
 //-----------------------------------------------------------------------------
 void TestMathEval(UnitTest* test, const rush::String& code, double expected, bool detailed = false)
 {
@@ -111,6 +1649,20 @@ void UnitTest::TestMathEvaluation()
     this->BeginTest(_T("MathEvaluation"));
 
     //TestSpeed();
+    //TestBatchSpeed();
+    //TestTokenizerSpeed();
+    //TestCompileSpeed();
+    //TestVectorSpeed();
+    //TestParallelSpeed();
+    //TestBatchFloatSpeed();
+    //TestFusionSpeed();
+    //TestBindingSpeed();
+    //TestCallableSpeed();
+    //TestStreamSpeed();
+    //TestArraySpeed();
+    //TestPiecewiseSpeed();
+    //TestImageSpeed();
+    //TestIncrementalSpeed();
 
     // Simple tests
     TestMathEval(this, _T(""), 0.0d);
@@ -169,6 +1721,7 @@ void UnitTest::TestMathEvaluation()
     TestMathEval(this, _T("result = pi()"), M_PI);
     TestMathEval(this, _T("result = abs(-3.3)"), 3.3d);
     TestMathEval(this, _T("result = pow(2, 3)"), 8.0d);
+    TestMathEval(this, _T("result = pow(2, -1)"), 0.5d);
     TestMathEval(this, _T("result = exp(ln(2))"), 2.0d);
     TestMathEval(this, _T("result = 3.5+(60/fact(5))"), 4.0d);
     TestMathEval(this, _T("result = fact(5)"), 120.0d);
@@ -195,6 +1748,192 @@ void UnitTest::TestMathEvaluation()
     // Test long statements
     TestMathEval(this, _T("result = 1+(x/fact(1))+(pow(x,2)/fact(2))+(pow(x,3)/fact(3))"), 13.0d);
 
+    // Test optimizations
+    TestMathEval(this, _T("result = x*0+x*1+0+x-0"), 6.0d);
+    TestMathEval(this, _T("result = 1/(-(x-3)+0) > 0"), 1.0d);
+    TestMathEval(this, _T("result = --x/1"), 3.0d);
+    TestMathEval(this, _T("result = pow(x+1, 2)+pow(x, 1)"), 19.0d);
+    TestMathEval(this, _T("a = x; x = 2; result = a*x*-1"), -6.0d);
+    TestMathOpcodes(this, _T("result = 1+2"), _T("LDC '3.00' SAV 'result' "));
+    TestMathOpcodes(this, _T("result = sqrt(4)*pi()"), _T("LDC '6.28' SAV 'result' "));
+    TestMathOpcodes(this, _T("result = x*1-0+-0"), _T("LDV 'x' SAV 'result' "));
+    TestMathOpcodes(this, _T("result = x+0"), _T("LDV 'x' LDC '0.00' ADD SAV 'result' "));
+    TestMathOpcodes(this, _T("result = x*(3-3)"), _T("LDC '0.00' SAV 'result' "));
+    TestMathOpcodes(this, _T("result = --x"), _T("LDV 'x' SAV 'result' "));
+    TestMathOpcodes(this, _T("result = pow(x, 2)"), _T("LDV 'x' DBL MUL SAV 'result' "));
+
+    // Test common subexpression elimination
+    TestMathOpcodes(this, _T("a = sqrt(x*x+y*y); b = (x*x+y*y)/2"),
+                    _T("LDV 'x' DBL MUL LDV 'y' DBL MUL ADD STT '0' SQRT SAV 'a' LDT '0' LDC '2.00' DIV SAV 'b' "));
+    TestMathOpcodes(this, _T("result = sin(x)+sin(x)"), _T("LDV 'x' SIN DBL ADD SAV 'result' "));
+    TestMathOpcodes(this, _T("a = x+1; x = 2; result = x+1"),
+                    _T("LDV 'x' LDC '1.00' ADD SAV 'a' LDC '2.00' SAV 'x' LDV 'x' LDC '1.00' ADD SAV 'result' "));
+    TestMathEval(this, _T("a = x*x+1; x = 2; result = a + x*x+1"), 15.0d);
+    TestMathEval(this, _T("a = (x+1)*(x+1); b = (x+1)/2; result = a+b+(x+1)"), 22.0d);
+    TestMathEval(this, _T("a = sin(x)*cos(x); x = a+sin(x); result = x-sin(x)"), sin(3.0d)*cos(3.0d)+sin(3.0d)-sin(sin(3.0d)*cos(3.0d)+sin(3.0d)));
+
+    // Test intrinsics of the default functions
+    TestMathOpcodes(this, _T("result = sin(x)*cos(x)+sqrt(abs(x))"),
+                    _T("LDV 'x' SIN LDV 'x' COS MUL LDV 'x' ABS SQRT ADD SAV 'result' "));
+    TestMathOpcodes(this, _T("result = root(x, 3)"), _T("LDV 'x' LDC '3.00' CALL 'root' SAV 'result' "));
+    TestMathEval(this, _T("result = sin(x)+cos(x)+tan(x)"), sin(3.0d)+cos(3.0d)+tan(3.0d));
+    TestMathEval(this, _T("result = exp(-x)+ln(x)+log10(x)+sqrt(x)+abs(-x)"),
+                 exp(-3.0d)+log(3.0d)+log10(3.0d)+sqrt(3.0d)+3.0d);
+    TestMathEval(this, _T("result = pow(x, i2+d1)+mod(x+5, i3)+floor(d3-x)+ceil(d1*x)"),
+                 pow(3.0d, 2.1d)+fmod(8.0d, 3.0d)+floor(0.3d-3.0d)+ceil(0.1d*3.0d));
+    TestMathEvalOverride(this);
+    TestMathEvalCallable(this, rush::MathFusion::None, false);
+    TestMathEvalCallable(this, rush::MathFusion::Superinstructions, false);
+    TestMathEvalCallable(this, rush::MathFusion::Superinstructions, true);
+    TestMathEvalNativeCall(this);
+
+    // Test batch execution against row by row execution
+    TestMathEvalBatch(this, _T("result = x+y"));
+    TestMathEvalBatch(this, _T("result = (x-y)*(x+y)/-y"));
+    TestMathEvalBatch(this, _T("result = x*z+sin(y)"));
+    TestMathEvalBatch(this, _T("a = x*x; b = a-y; result = a/b+pow(z, 2)"));
+    TestMathEvalBatch(this, _T("x = x+1; result = x*y"));
+    TestMathEvalBatch(this, _T("result = sqrt(abs(x))+sin(y)*exp(-y)+pow(y, 0.5)+mod(x, y)+floor(x)+ceil(x)"));
+    TestMathEvalBatch(this, _T("result = ln(y)+log10(y)+cos(x)+tan(y)"));
+    TestMathEvalBatch(this, _T("a = (x+y)*(x-y); result = a*(x+y)+(x-y)"));
+    TestMathEvalBatchFloat(this, _T("result = (x-y)*(x+y)/-y"), rush::MathAccuracy::Exact);
+    TestMathEvalBatchFloat(this, _T("a = x*x; b = a-y; result = a/b+pow(z, 2)"), rush::MathAccuracy::Exact);
+    TestMathEvalBatchFloat(this, _T("result = sqrt(abs(x))+sin(y)*exp(-y)+pow(y, 0.5)+mod(x, y)+floor(x)+ceil(x)"), rush::MathAccuracy::Exact);
+    TestMathEvalBatchFloat(this, _T("result = ln(y)+log10(y)+cos(x)+tan(y)+frac(x)"), rush::MathAccuracy::Precise);
+    TestMathEvalBatchFloat(this, _T("result = exp(-x*x)*sin(x)+pow(y, 1.5)"), rush::MathAccuracy::Fast);
+    TestMathEvalBatch(this, _T("result = select(x < 0, -x, x*x)+(y >= 3)-(x == y)*2"));
+    TestMathEvalBatch(this, _T("result = select(x > y, x, y)*(x != 2)+select(x <= -y, 1, -1)"));
+    TestMathEvalBatchFloat(this, _T("result = select(x < 0, -x, x*x)+(y >= 3)-(x == y)*2"), rush::MathAccuracy::Exact);
+    TestMathEvalBatchFloat(this, _T("result = select(x > y, x, y)*(x != 2)+select(x <= -y, 1, -1)"), rush::MathAccuracy::Exact);
+
+    // Test parallel execution against the single threaded batch
+    TestMathEvalParallel(this, _T("result = x*z+sin(y)"), 0, 4);
+    TestMathEvalParallel(this, _T("result = x*z+sin(y)"), 100, 4);
+    TestMathEvalParallel(this, _T("a = x*x; b = a-y; result = a/b+pow(z, 2)"), 100000, 1);
+    TestMathEvalParallel(this, _T("a = x*x; b = a-y; result = a/b+pow(z, 2)"), 100000, 3);
+    TestMathEvalParallel(this, _T("result = exp(-y)*sin(x)+ln(y)*cos(x)+pow(y, x)"), 250001, 0);
+    TestMathEvalParallel(this, _T("result = exp(-y)*sin(x)+ln(y)*cos(x)+pow(y, x)"), 250001, 64);
+
+    // Test the vectorized functions against the math library
+    TestMathEvalAccuracy(this, _T("result = exp(x)"), rush::MathAccuracy::Exact, 1e300, 0.0d);
+    TestMathEvalAccuracy(this, _T("result = exp(x)"), rush::MathAccuracy::Precise, 1e300, 1.0d);
+    TestMathEvalAccuracy(this, _T("result = ln(x)"), rush::MathAccuracy::Precise, 1e300, 1.0d);
+    TestMathEvalAccuracy(this, _T("result = pow(x, y)"), rush::MathAccuracy::Precise, 1e300, 1.0d);
+    TestMathEvalAccuracy(this, _T("result = sin(x)"), rush::MathAccuracy::Precise, 1e300, 2.0d);
+    TestMathEvalAccuracy(this, _T("result = cos(x)"), rush::MathAccuracy::Precise, 1e300, 2.0d);
+    TestMathEvalAccuracy(this, _T("result = tan(x)"), rush::MathAccuracy::Precise, 1e300, 3.0d);
+    TestMathEvalAccuracy(this, _T("result = exp(x)"), rush::MathAccuracy::Fast, 1e300, 2e6);
+    TestMathEvalAccuracy(this, _T("result = ln(x)"), rush::MathAccuracy::Fast, 1e300, 1.3e7);
+    TestMathEvalAccuracy(this, _T("result = pow(x, y)"), rush::MathAccuracy::Fast, 1e4, 4e8);
+    TestMathEvalAccuracy(this, _T("result = sin(x)"), rush::MathAccuracy::Fast, 1e300, 1.1e6);
+    TestMathEvalAccuracy(this, _T("result = cos(x)"), rush::MathAccuracy::Fast, 1e300, 1.1e6);
+    TestMathEvalAccuracy(this, _T("result = tan(x)"), rush::MathAccuracy::Fast, 1e300, 1.4e6);
+
+    // Test programs executed with own contexts
+    TestMathEvalProgram(this, _T("result = x*y"), 3.0d, 6.0d);
+    TestMathEvalProgram(this, _T("y = y+1; result = pow(x, y)"), 2.0d, 8.0d);
+    TestMathEvalProgram(this, _T("result = sqrt(x)+y"), 16.0d, 6.0d);
+    TestMathEvalProgram(this, _T("a = sin(x)*y; result = a*a+sin(x)*y"), 0.0d, 0.0d);
+
+    // Test binary images of programs
+    TestMathEvalImage(this, _T("result = x*y"), 3.0d, 6.0d, false);
+    TestMathEvalImage(this, _T("y = y+1; result = pow(x, y)"), 2.0d, 8.0d, false);
+    TestMathEvalImage(this, _T("a = sin(x)*y; result = a*a+sin(x)*y+sqrt(x)"), 0.0d, 0.0d, false);
+    TestMathEvalImage(this, _T("a = sin(x)*y; result = a*a+sin(x)*y+sqrt(x)"), 0.0d, 0.0d, true);
+    TestMathEvalImageVersions(this);
+
+    // Test incremental execution against the full execution
+    TestMathEvalIncremental(this, _T("a = x*x; b = a-y; result = a/b+pow(z, 2)"));
+    TestMathEvalIncremental(this, _T("a = x*x+sin(y); b = a-y/2; c = sin(y)*2; result = (a+b)*(a-b)/c"));
+    TestMathEvalIncremental(this, _T("result = a+x; x = x+1; a = y*2"));
+    TestMathEvalIncremental(this, _T("a = x; b = a*2; a = a+y; result = a+b"));
+    TestMathEvalIncremental(this, _T("a = 2*3; b = a+x; result = b*b+a"));
+    TestMathEvalIncrementalCount(this);
+
+    // Test the profiling
+    TestMathEvalProfile(this);
+
+    // Test the superinstructions
+    TestMathEvalFusion(this, _T("result = a+x*y-z/2"));
+    TestMathEvalFusion(this, _T("result = ((x*0.5+1.5)*x-2.5)*x+a*y+y*y-z"));
+    TestMathEvalFusion(this, _T("b = x/y-2; result = b*b+x*2/z-sin(x)*a"));
+    TestMathEvalFusion(this, _T("result = 1-x; result = result*result+a/x"));
+    TestMathEvalFusionCount(this);
+
+    // Test the variables bound to memory of the caller
+    TestMathEvalBinding(this, false, false, rush::MathFusion::Superinstructions);
+    TestMathEvalBinding(this, false, false, rush::MathFusion::None);
+    TestMathEvalBinding(this, false, true, rush::MathFusion::Superinstructions);
+    TestMathEvalBinding(this, true, false, rush::MathFusion::Superinstructions);
+
+    // Test the streaming compiler against the whole script
+    TestMathEvalStream(this, _T("result = x+y"));
+    TestMathEvalStream(this, _T("a = x*x+sin(y);\nb = a-y/2; result = (a+b)*(a-b)/(x*x+sin(y));"));
+    TestMathEvalStream(this, _T("a = 2*3; b = a+x; ; result = b*b+a;;"));
+    TestMathEvalStream(this, _T("result = a+x; x = x+1; a = y*2"));
+    TestMathEvalStream(this, _T(";"));
+    TestMathEvalStream(this, _T("a = 1; result = (a"));
+    TestMathEvalStream(this, _T("a = 1; res ult = 2"));
+    TestMathEvalStreamFile(this);
+
+    // Test the array variables and their reductions
+    TestMathEvalArray(this, _T("s = sum(a)*x+mean(a); result = (max(a)-min(a))*dot(a, b)"), 1003, false, false);
+    TestMathEvalArray(this, _T("s = sum(a)*x+mean(a); result = (max(a)-min(a))*dot(a, b)"), 3, false, false);
+    TestMathEvalArray(this, _T("s = sum(a)*x+mean(a); result = (max(a)-min(a))*dot(a, b)"), 1003, true, false);
+    TestMathEvalArray(this, _T("s = sum(a)*x+mean(a); result = (max(a)-min(a))*dot(a, b)"), 1003, false, true);
+    TestMathEvalArrayProgram(this);
+    TestMathEvalArrayNan(this);
+    TestMathEvalArrayErrors(this);
+
+    // Test variable handles
+    TestMathEvalHandles(this, 1);
+    TestMathEvalHandles(this, 500);
+
+    // Test the tokenizer
+    TestMathTokens(this, _T("result = x"), _T("result= x ; "));
+    TestMathTokens(this, _T("a=sin(x)*-2.5;b = a"), _T("a= sin ( x ) *- 2.5 ; b= a ; "));
+    TestMathEvalError(this, _T("res ult = 1"));
+    TestMathEvalError(this, _T("result = x 1"));
+    TestMathEvalError(this, _T("result = 1 $ 2"));
+
+    // Test the comparisons and select
+    TestMathTokens(this, _T("a=x<=-2!=b>c"), _T("a= x <=- 2 != b > c ; "));
+    TestMathEval(this, _T("result = x < 4"), 1.0d);
+    TestMathEval(this, _T("result = x <= 2"), 0.0d);
+    TestMathEval(this, _T("result = x > i3"), 0.0d);
+    TestMathEval(this, _T("result = x >= i3"), 1.0d);
+    TestMathEval(this, _T("result = x == 3"), 1.0d);
+    TestMathEval(this, _T("result = x != 3"), 0.0d);
+    TestMathEval(this, _T("result = 1+2 <= x*1"), 1.0d);
+    TestMathEval(this, _T("result = x<-2"), 0.0d);
+    TestMathEval(this, _T("result = 2*(x > 1)+(x <= -1)"), 2.0d);
+    TestMathEval(this, _T("result = (0/0 == 0/0)+2*(0/0 != 0/0)+4*(0/0 < 1)"), 2.0d);
+    TestMathEval(this, _T("result = select(x > 2, x*2, -x)"), 6.0d);
+    TestMathEval(this, _T("result = select(x-3, 1, 2)"), 2.0d);
+    TestMathEval(this, _T("result = select(0/0, 1, 2)"), 1.0d);
+    TestMathEval(this, _T("result = select(i1 == 1, select(x < 0, -1, 1), 0)"), 1.0d);
+    TestMathOpcodes(this, _T("result = x < 2"), _T("LDV 'x' LDC '2.00' LT SAV 'result' "));
+    TestMathOpcodes(this, _T("result = select(2 > 1, x, 0)"), _T("LDV 'x' SAV 'result' "));
+    TestMathEvalError(this, _T("result = x = 1"));
+    TestMathEvalError(this, _T("result = x ! 1"));
+    TestMathEvalError(this, _T("result = x < = 1"));
+    TestMathEvalError(this, _T("result = select(1, 2)"));
+
+    // Test the compiler
+    TestMathEval(this, _T("result = 2*-3*4"), -24.0d);
+    TestMathEval(this, _T("result = -(2+3)*-pow(2, 2)"), 20.0d);
+    TestMathEval(this, _T("result = pow(pow(2, 1+1), (x-1))/-(-2)"), 8.0d);
+    TestMathEval(this, _T("result = i3-i2-i1+x/i3/d1"), 10.0d);
+    TestMathEvalError(this, _T("result = (1"));
+    TestMathEvalError(this, _T("result = 1)"));
+    TestMathEvalError(this, _T("result = ()"));
+    TestMathEvalError(this, _T("result = i1*"));
+    TestMathEvalError(this, _T("result = pi(1)"));
+    TestMathEvalError(this, _T("result = pow(2)"));
+    TestMathEvalError(this, _T("result = pow(2,,3)"));
+    TestMathEvalError(this, _T("result = 1, 2"));
+    TestMathEvalError(this, _T("result = 1 +* 2"));
+
     // Test errorous statements
 //    TestMathEval(this, _T("result = sin("), 0.0d, true);
 //    TestMathEval(this, _T("result = i1*"), 0.0d, true);
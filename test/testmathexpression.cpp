@@ -0,0 +1,117 @@
+/*
+ * testmathexpression.cpp - Implementation of UnitTest::TestMathExpression method
+ *
+ * This file is part of the rush utility library.
+ * Licensed under the terms of Lesser GPL v3.0 (see license.txt).
+ * Copyright 2011-2012 - Steffen Ott
+ *
+ */
+
+
+
+
+#include "unittest.h"
+#include <rush/mathevaluation.h>
+#include <rush/mathexpression.h>
+
+
+
+//-----------------------------------------------------------------------------
+void TestExpressionSpeed()
+{
+    float interpreterTime = 0.0f;
+    float expressionTime = 0.0f;
+    size_t ticks = 0;
+    size_t num = 4000000;
+    double sum = 0.0d;
+
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("s"), 10.0d);
+    eval.SetVariable(_T("t"), 33.0d);
+    eval.Compile(_T("result = 22+s*76/t*sin(s)-(s+t)*(s-t)/2"));
+    rush::MathVariableHandle s = eval.GetVariableHandle(_T("s"));
+    rush::MathVariableHandle result = eval.GetVariableHandle(_T("result"));
+
+    //----------------------------------------------
+    ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        eval.SetVariable(s, (double)i);
+        eval.Execute();
+        sum += eval.GetVariable(result);
+    }
+    interpreterTime = (float)(rush::System::GetTicks() - ticks);
+
+    //----------------------------------------------
+    auto expression = RUSH_MATH_EXPRESSION("22+s*76/t*sin(s)-(s+t)*(s-t)/2");
+    ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        sum -= expression((double)i, 33.0d);
+    }
+    expressionTime = (float)(rush::System::GetTicks() - ticks);
+
+    printf("MathExpression - speed comparison: interpreter = %1.1fms expression = %1.1fms (%g)\n",
+           interpreterTime, expressionTime, sum);
+}
+
+
+//-----------------------------------------------------------------------------
+template <class E>
+void TestMathExpressionEval(UnitTest* test, const E& expression, const rush::String& code)
+{
+    // The variables x and y must appear in this order in the code
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("x"), 0.0d);
+    eval.SetVariable(_T("y"), 0.0d);
+    eval.Compile(rush::String::Format(_T("result = %s"), code.c_str()));
+    bool failed = eval.HasErrors();
+    for (int i=-20; i<=20 && !failed; ++i)
+    {
+        double values[] = { 0.37d * i, 1.5d + 0.25d * (i + 20) };
+        eval.SetVariable(_T("x"), values[0]);
+        eval.SetVariable(_T("y"), values[1]);
+        eval.Execute();
+        double expected = eval.GetVariable(_T("result"));
+        double result = expression.Evaluate(values);
+        // The compiler may contract a*b+c into FMA instructions, which round once
+        failed = (result != expected && !(result != result && expected != expected) &&
+                  !(fabs(result - expected) <= 1e-12 * (1.0d + fabs(expected))));
+    }
+    test->Assert(rush::String::Format(_T("Expression: %s"), code.c_str()), failed);
+}
+
+
+//-----------------------------------------------------------------------------
+void UnitTest::TestMathExpression()
+{
+    this->BeginTest(_T("MathExpression"));
+
+    //TestExpressionSpeed();
+
+    // Test the parser
+    auto constant = RUSH_MATH_EXPRESSION("2*-3*4");
+    this->Assert(_T("Expression: 2*-3*4"), constant() != -24.0d);
+    auto brackets = RUSH_MATH_EXPRESSION(" -(2+3) * -pow(2, 2) ");
+    this->Assert(_T("Expression: -(2+3) * -pow(2, 2)"), brackets() != 20.0d);
+    auto numbers = RUSH_MATH_EXPRESSION("0.1+123.456+.5+7.");
+    this->Assert(_T("Expression: 0.1+123.456+.5+7."), fabs(numbers() - (0.1d+123.456d+0.5d+7.0d)) > 1e-12);
+
+    // Test the variable slots
+    auto slots = RUSH_MATH_EXPRESSION("b*10 + a - b + c_2/4");
+    static_assert(slots.GetVariableCount() == 3, "Three variables expected.");
+    static_assert(slots.GetVariableIndex("a") == 1, "Variable a must be in the second slot.");
+    this->Assert(_T("Expression slots"), slots.GetVariableIndex("b") != 0 || slots.GetVariableIndex("c_2") != 2 ||
+                                         slots.GetVariableIndex("d") != -1 || slots(2.0d, 3.0d, 8.0d) != 23.0d);
+
+    // Compare the results with the MathEvaluation
+    TestMathExpressionEval(this, RUSH_MATH_EXPRESSION("x*y + sin(x) - -2.5*(y/4)"), _T("x*y + sin(x) - -2.5*(y/4)"));
+    TestMathExpressionEval(this, RUSH_MATH_EXPRESSION("pow(pow(2, 1+1), (x-1))/-(-2)"), _T("pow(pow(2, 1+1), (x-1))/-(-2)"));
+    TestMathExpressionEval(this, RUSH_MATH_EXPRESSION("sqrt(abs(x))+exp(-y)+mod(x, y)+floor(x)+ceil(y)+frac(x)+int(y)"),
+                           _T("sqrt(abs(x))+exp(-y)+mod(x, y)+floor(x)+ceil(y)+frac(x)+int(y)"));
+    TestMathExpressionEval(this, RUSH_MATH_EXPRESSION("x+ln(y)+log10(y)+log(y, 2)+root(y, 3)+fact(y)+pi()"),
+                           _T("x+ln(y)+log10(y)+log(y, 2)+root(y, 3)+fact(y)+pi()"));
+    TestMathExpressionEval(this, RUSH_MATH_EXPRESSION("sin(x)*cos(y)/tan(x+y) - x/y/2"), _T("sin(x)*cos(y)/tan(x+y) - x/y/2"));
+
+    this->EndTest();
+}
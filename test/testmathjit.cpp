@@ -0,0 +1,162 @@
+/*
+ * testmathjit.cpp - Implementation of UnitTest::TestMathJit method
+ *
+ * This file is part of the rush utility library.
+ * Licensed under the terms of Lesser GPL v3.0 (see license.txt).
+ * Copyright 2011-2012 - Steffen Ott
+ *
+ */
+
+
+
+
+#include "unittest.h"
+#include <rush/mathevaluation.h>
+#include <string.h>
+#include <math.h>
+
+
+
+//-----------------------------------------------------------------------------
+double TestJitHypot(double a, double b)
+{
+    return (sqrt(a*a + b*b));
+}
+
+
+//-----------------------------------------------------------------------------
+void TestJitSetFunctions(rush::MathEvaluation* eval)
+{
+    eval->SetFunction(_T("hyp"), &TestJitHypot);
+    eval->SetFunction(_T("lerp"), [](double a, double b, double t) { return (a + (b-a)*t); });
+    eval->SetFunction(_T("half"), [](double a) { return (a*0.5); });
+}
+
+
+//-----------------------------------------------------------------------------
+class TestJitSumFunction : public rush::MathFunction
+{
+    public:
+        TestJitSumFunction() : rush::MathFunction(_T("sum4"), 4) {}
+
+        virtual double Evaluate(double* values, size_t num)
+        { return (values[0] + 2*values[1] + 3*values[2] + 4*values[3]); }
+};
+
+
+//-----------------------------------------------------------------------------
+void TestJitSpeed()
+{
+    float interpreterTime = 0.0f;
+    float jitTime = 0.0f;
+    size_t ticks = 0;
+    size_t num = 4000000;
+
+    rush::MathEvaluation eval;
+    eval.SetVariable(_T("s"), 10.0d);
+    eval.SetVariable(_T("t"), 33.0d);
+    eval.Compile(_T("result = 22+s*76/t*sin(s)-(s+t)*(s-t)/2"));
+
+    //----------------------------------------------
+    ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        eval.Execute();
+    }
+    interpreterTime = (float)(rush::System::GetTicks() - ticks);
+
+    //----------------------------------------------
+    eval.SetJitEnabled(true);
+    ticks = rush::System::GetTicks();
+    for (size_t i=0; i<num; ++i)
+    {
+        eval.Execute();
+    }
+    jitTime = (float)(rush::System::GetTicks() - ticks);
+
+    printf("MathEvaluator - jit comparison: interpreter = %1.1fms jit = %1.1fms\n",
+           interpreterTime, jitTime);
+}
+
+
+//-----------------------------------------------------------------------------
+void TestMathJitEval(UnitTest* test, const rush::String& code)
+{
+    const double values[] = { 0.0d, -0.0d, 1.0d, -2.5d, 3.0d, 1e-300d, 1e300d, 7.25d };
+    const size_t count = sizeof(values)/sizeof(double);
+
+    rush::MathEvaluation interpreter;
+    rush::MathEvaluation jit;
+    interpreter.SetFunction(new TestJitSumFunction());
+    jit.SetFunction(new TestJitSumFunction());
+    TestJitSetFunctions(&interpreter);
+    TestJitSetFunctions(&jit);
+    jit.SetJitEnabled(true);
+    interpreter.Compile(code);
+    jit.Compile(code);
+
+    bool failed = (jit.IsJitCompiled() != rush::MathEvaluation::IsJitSupported());
+    for (size_t i=0; i<count && !failed; ++i)
+    {
+        interpreter.SetVariable(_T("x"), values[i]);
+        interpreter.SetVariable(_T("y"), values[count-1-i]);
+        jit.SetVariable(_T("x"), values[i]);
+        jit.SetVariable(_T("y"), values[count-1-i]);
+        interpreter.Execute();
+        jit.Execute();
+        double expected = interpreter.GetVariable(_T("result"));
+        double result = jit.GetVariable(_T("result"));
+        failed = (memcmp(&expected, &result, sizeof(double)) != 0);
+    }
+    test->Assert(code, failed);
+}
+
+
+
+//-----------------------------------------------------------------------------
+void UnitTest::TestMathJit()
+{
+    this->BeginTest(_T("MathJit"));
+
+    //TestJitSpeed();
+
+    // Operators
+    TestMathJitEval(this, _T("result = x+y"));
+    TestMathJitEval(this, _T("result = x-y"));
+    TestMathJitEval(this, _T("result = x*y"));
+    TestMathJitEval(this, _T("result = x/y"));
+    TestMathJitEval(this, _T("result = -x"));
+    TestMathJitEval(this, _T("result = 1.5*x-y/3"));
+    TestMathJitEval(this, _T("result = pow(x, 2)+y"));
+
+    // Functions
+    TestMathJitEval(this, _T("result = sin(x)+cos(y)"));
+    TestMathJitEval(this, _T("result = x*sqrt(abs(y))-exp(x/1000)"));
+    TestMathJitEval(this, _T("result = sum4(x, y, x*y, 2)"));
+    TestMathJitEval(this, _T("result = x+sum4(x, y, sum4(y, x, 1, 2), x-y)*y"));
+    TestMathJitEval(this, _T("result = hyp(x, y)+lerp(x, y, 0.25)*half(y)"));
+    TestMathJitEval(this, _T("result = x-lerp(y, hyp(x, half(y)), lerp(x, y, x))"));
+
+    // Comparisons and select
+    TestMathJitEval(this, _T("result = (x < y)+2*(x <= y)+4*(x > y)+8*(x >= y)+16*(x == y)+32*(x != y)"));
+    TestMathJitEval(this, _T("result = select(x < y, x*2, y-1)+select(x, 1, -1)"));
+    TestMathJitEval(this, _T("a = x/x; result = (a < 1)+2*(a != a)+4*(a == a)+select(a, 8, 16)"));
+    TestMathJitEval(this, _T("result = x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+((x > y)+select(x >= y, x, -y))))))))))))))"));
+
+    // Multiple statements
+    TestMathJitEval(this, _T("a = x*y; b = a-x; result = a/b"));
+    TestMathJitEval(this, _T("x = x+1; y = y*x; result = x-y"));
+    TestMathJitEval(this, _T("a = sqrt(x*x+y*y); x = x*y; result = (x*x+y*y)/a+sqrt(x*x+y*y)"));
+    TestMathJitEval(this, _T("result = sin(x)*cos(y)+tan(x-y)+abs(y)+sqrt(abs(x))+exp(-abs(y))"));
+    TestMathJitEval(this, _T("result = pow(x, 2.5)+mod(x, y)+floor(x)+ceil(y)+ln(abs(x))+log10(abs(y))"));
+    TestMathJitEval(this, _T("result = x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+(y+sin(x+cos(y+pow(x, y))))))))))))))))"));
+
+    // Stack deeper than the registers
+    TestMathJitEval(this, _T("result = x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+y))))))))))))))"));
+    TestMathJitEval(this, _T("result = x*(y-(x*(y-(x*(y-(x*(y-(x*(y-(x*(y-sin(x*(y-x/y)))))))))))))"));
+    TestMathJitEval(this, _T("result = x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+sum4(x, y, x, -x)))))))))))))"));
+    TestMathJitEval(this, _T("result = x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+(y+(x+lerp(x, y, hyp(x, -y))))))))))))))"));
+    TestMathJitEval(this, _T("result = x*(y-(x*(y-(x*(y-(x*(y-(x*(y-(x*(y-lerp(x, half(y), x*y))))))))))))"));
+
+    this->EndTest();
+}
@@ -36,7 +36,10 @@ void UnitTest::TestAll()
 //    this->TestArray();
 //    this->TestConvert();
 //    this->TestList();
+//    this->TestMathCompileCache();
 //    this->TestMathEvaluation();
+//    this->TestMathExpression();
+//    this->TestMathJit();
 //    this->TestObjectArray();
 //    this->TestObjectDeque();
 //    this->TestObjectQueue();
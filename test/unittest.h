@@ -29,7 +29,10 @@ class UnitTest
         void TestArray();
         void TestConvert();
         void TestList();
+        void TestMathCompileCache();
         void TestMathEvaluation();
+        void TestMathExpression();
+        void TestMathJit();
         void TestObjectArray();
         void TestObjectDeque();
         void TestObjectQueue();